@@ -0,0 +1,96 @@
+/*
+ * ============================================================================
+ * CSV SPLITTER THROUGHPUT BENCHMARK
+ * ============================================================================
+ *
+ * Generates an in-memory roster in the import format (a mix of plain and
+ * quoted fields) and splits it with every block kernel this CPU supports,
+ * reporting GB/s and rows/s. The best of several passes is reported so
+ * page faults on the first pass do not count.
+ *
+ * Usage: bench_csv [megabytes] [passes]
+ *
+ * ============================================================================
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "csv.h"
+#include "import.h"
+
+static double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static char *generate(size_t target, size_t *size, long *rows) {
+    char *data = malloc(target + 512);
+    size_t used = 0;
+    long count = 0;
+    if (!data) {
+        return NULL;
+    }
+    while (used < target) {
+        used += (size_t)sprintf(data + used,
+            "%s,Perez,12/02/2009,rp%ld,George,\"Lisa\",93213124,%ld,CP1,%ld,ADS,66.5,CANTO,33,\"TECH\",1\n",
+            count % 3 == 0 ? "\"Rosa\"" : "Rosalind", count, 1 + count % 12, count % 100);
+        count++;
+    }
+    *size = used;
+    *rows = count;
+    return data;
+}
+
+int main(int argc, char **argv) {
+    size_t megabytes = argc > 1 ? (size_t)atol(argv[1]) : 256;
+    int passes = argc > 2 ? atoi(argv[2]) : 5;
+    size_t size;
+    long rows;
+    char *data = generate(megabytes << 20, &size, &rows);
+    if (!data) {
+        printf("Error allocating %zu MB.\n", megabytes);
+        return 1;
+    }
+
+    printf("%.1f MB, %ld rows, best of %d passes\n", size / 1048576.0, rows, passes);
+    printf("Kernel        GB/s      Mrows/s\n");
+
+    static const csv_kernel_t kernels[] = { CSV_KERNEL_SCALAR, CSV_KERNEL_SSE2, CSV_KERNEL_AVX2 };
+    for (size_t k = 0; k < sizeof(kernels) / sizeof(kernels[0]); k++) {
+        if (!csv_kernel_supported(kernels[k])) {
+            printf("%-8s  (not supported)\n", csv_kernel_name(kernels[k]));
+            continue;
+        }
+
+        double best = 0;
+        long fields_seen = 0;
+        for (int pass = 0; pass < passes; pass++) {
+            csv_reader_t reader;
+            csv_field_t fields[IMPORT_COLUMNS];
+            csv_reader_init(&reader, data, size, ',', kernels[k]);
+            fields_seen = 0;
+
+            double start = now_seconds();
+            int count;
+            while ((count = csv_next_row(&reader, fields, IMPORT_COLUMNS)) >= 0) {
+                fields_seen += count;
+            }
+            double elapsed = now_seconds() - start;
+            if (best == 0 || elapsed < best) {
+                best = elapsed;
+            }
+        }
+        if (fields_seen != rows * IMPORT_COLUMNS) {
+            printf("Error: %s split %ld fields, expected %ld.\n",
+                   csv_kernel_name(kernels[k]), fields_seen, rows * IMPORT_COLUMNS);
+        }
+        printf("%-8s  %8.2f  %11.2f\n", csv_kernel_name(kernels[k]), size / best / 1e9, rows / best / 1e6);
+    }
+
+    free(data);
+    return 0;
+}
@@ -0,0 +1,277 @@
+/*
+ * ============================================================================
+ * HTTP API BENCHMARK
+ * ============================================================================
+ *
+ * Starts the HTTP/JSON server (http.h) in-process on a loopback port and
+ * drives it with a built-in load generator: C client threads, each on
+ * its own connection, send requests in bursts of DEPTH pipelined
+ * requests and wait for all DEPTH responses before the next burst.
+ *
+ *     get/close      GET of a random student, new connection each time
+ *     get/1          GET on a kept-alive connection, one at a time
+ *     get/16         GET, 16 pipelined per burst
+ *     patch/16       PATCH of one grade, 16 pipelined per burst
+ *     post/16        POST of a new student, 16 pipelined per burst
+ *                    (saved as one studentdb_create_many batch)
+ *
+ * Reports requests/s and the p50/p99 latency of a request (the time its
+ * burst took). Uses the B+tree store in bench_http/ under the current
+ * directory.
+ *
+ * Usage: bench_http [students] [connections]
+ *
+ * ============================================================================
+ */
+
+#define _GNU_SOURCE  // memmem
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/stat.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+
+#include "http.h"
+
+#define REQUESTS_PER_CLIENT 4000
+#define MAX_DEPTH 16
+
+typedef enum {
+    OP_GET,
+    OP_PATCH,
+    OP_POST
+} op_t;
+
+typedef struct {
+    int port;
+    op_t op;
+    int depth;
+    int reconnect;            // a new connection per request
+    int requests;
+    int first_id;
+    int students;
+    unsigned seed;
+    double *latencies;        // one per request
+    long errors;
+} client_t;
+
+static const char student_json[] =
+    "{\"name\":\"Bench\",\"family_name\":\"Student\",\"dob\":\"01/01/2010\",\"student_id\":\"B1\","
+    "\"father_name\":\"Father\",\"mother_name\":\"Mother\",\"phone\":\"5550100\",\"grade\":7,"
+    "\"subject1_name\":\"Mathematics\",\"subject1_grade\":81,\"subject2_name\":\"Physics\",\"subject2_grade\":72,"
+    "\"subject3_name\":\"Chemistry\",\"subject3_grade\":63,\"subject4_name\":\"Biology\",\"subject4_grade\":94}";
+
+static double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static int compare_doubles(const void *a, const void *b) {
+    double x = *(const double *)a;
+    double y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+static int connect_to(int port) {
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0) {
+        return -1;
+    }
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons((uint16_t)port);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    int nodelay = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &nodelay, sizeof(nodelay));
+    if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+static int format_request(client_t *client, char *buf, size_t size) {
+    client->seed = client->seed * 1103515245u + 12345u;
+    int id = client->first_id + (int)((client->seed >> 8) % (unsigned)client->students);
+    const char *connection = client->reconnect ? "close" : "keep-alive";
+    if (client->op == OP_GET) {
+        return snprintf(buf, size, "GET /students/%d HTTP/1.1\r\nHost: bench\r\nConnection: %s\r\n\r\n", id,
+                        connection);
+    }
+    if (client->op == OP_PATCH) {
+        char body[64];
+        int length = snprintf(body, sizeof(body), "{\"subject1_grade\":%u}", (client->seed >> 4) % 101);
+        return snprintf(buf, size,
+                        "PATCH /students/%d HTTP/1.1\r\nHost: bench\r\nConnection: %s\r\nContent-Length: %d\r\n\r\n%s",
+                        id, connection, length, body);
+    }
+    return snprintf(buf, size, "POST /students HTTP/1.1\r\nHost: bench\r\nConnection: %s\r\nContent-Length: %zu\r\n\r\n%s",
+                    connection, sizeof(student_json) - 1, student_json);
+}
+
+// Reads count responses; returns how many had a 2xx status, or -1 if the connection failed
+static int read_responses(int fd, int count, char *buf, size_t size) {
+    size_t used = 0;
+    int ok = 0;
+    while (count > 0) {
+        char *end = used ? memmem(buf, used, "\r\n\r\n", 4) : NULL;
+        if (end) {
+            char *length_at = memmem(buf, (size_t)(end - buf), "Content-Length: ", 16);
+            size_t length = length_at ? strtoul(length_at + 16, NULL, 10) : 0;
+            size_t total = (size_t)(end - buf) + 4 + length;
+            if (used >= total) {
+                ok += buf[9] == '2';
+                memmove(buf, buf + total, used - total);
+                used -= total;
+                count--;
+                continue;
+            }
+        }
+        ssize_t got = recv(fd, buf + used, size - used, 0);
+        if (got <= 0) {
+            return -1;
+        }
+        used += (size_t)got;
+    }
+    return ok;
+}
+
+static void *run_client(void *arg) {
+    client_t *client = arg;
+    size_t size = 1 << 20;
+    char *out = malloc(MAX_DEPTH * 1024);
+    char *in = malloc(size);
+    int fd = -1;
+    for (int done = 0; out && in && done < client->requests;) {
+        int burst = client->depth < client->requests - done ? client->depth : client->requests - done;
+        size_t length = 0;
+        for (int i = 0; i < burst; i++) {
+            length += (size_t)format_request(client, out + length, 1024);
+        }
+        double start = now_seconds();
+        if (fd < 0) {
+            fd = connect_to(client->port);
+        }
+        int ok = fd >= 0 && send(fd, out, length, MSG_NOSIGNAL) == (ssize_t)length
+                     ? read_responses(fd, burst, in, size)
+                     : -1;
+        double elapsed = now_seconds() - start;
+        client->errors += ok < 0 ? burst : burst - ok;
+        for (int i = 0; i < burst; i++) {
+            client->latencies[done + i] = elapsed;
+        }
+        done += burst;
+        if (client->reconnect || ok < 0) {
+            close(fd);
+            fd = -1;
+        }
+    }
+    if (fd >= 0) {
+        close(fd);
+    }
+    free(out);
+    free(in);
+    return NULL;
+}
+
+static void run_phase(const char *name, int port, op_t op, int depth, int reconnect, int connections, int requests,
+                      int first_id, int students) {
+    client_t *clients = calloc((size_t)connections, sizeof(client_t));
+    pthread_t *threads = calloc((size_t)connections, sizeof(pthread_t));
+    double *latencies = malloc((size_t)connections * (size_t)requests * sizeof(double));
+    if (!clients || !threads || !latencies) {
+        return;
+    }
+    double start = now_seconds();
+    for (int i = 0; i < connections; i++) {
+        clients[i] = (client_t){ port, op, depth, reconnect, requests, first_id, students, 7u * (unsigned)i + 1,
+                                 latencies + (size_t)i * (size_t)requests, 0 };
+        pthread_create(&threads[i], NULL, run_client, &clients[i]);
+    }
+    long errors = 0;
+    for (int i = 0; i < connections; i++) {
+        pthread_join(threads[i], NULL);
+        errors += clients[i].errors;
+    }
+    double elapsed = now_seconds() - start;
+    long total = (long)connections * requests;
+    qsort(latencies, (size_t)total, sizeof(double), compare_doubles);
+    printf("%-10s %10.0f req/s  p50 %9.1f us  p99 %9.1f us  errors %ld\n", name, total / elapsed,
+           latencies[total / 2] * 1e6, latencies[total * 99 / 100] * 1e6, errors);
+    free(clients);
+    free(threads);
+    free(latencies);
+}
+
+int main(int argc, char **argv) {
+    int students = argc > 1 ? atoi(argv[1]) : 2000;
+    int connections = argc > 2 ? atoi(argv[2]) : 4;
+    if (students < 1) {
+        students = 1;
+    }
+    if (connections < 1 || connections > NET_MAX_CONNECTIONS) {
+        connections = 4;
+    }
+    mkdir("bench_http", 0755);
+    if (chdir("bench_http") != 0) {
+        return 1;
+    }
+
+    studentdb_t db;
+    if (studentdb_open(&db) != 0 || studentdb_use_btree(&db) != 0) {
+        printf("Could not open the B+tree store in bench_http/.\n");
+        return 1;
+    }
+    student_t *batch = calloc((size_t)students, sizeof(student_t));
+    if (!batch) {
+        return 1;
+    }
+    for (int i = 0; i < students; i++) {
+        str_set(&batch[i].name, "Bench");
+        str_set(&batch[i].family_name, "Student");
+        str_set(&batch[i].father_name, "Father");
+        str_set(&batch[i].mother_name, "Mother");
+        snprintf(batch[i].dateofbirth, sizeof(batch[i].dateofbirth), "01/01/2010");
+        snprintf(batch[i].studentid, sizeof(batch[i].studentid), "B%d", i);
+        snprintf(batch[i].phone_number, sizeof(batch[i].phone_number), "5550100");
+        batch[i].grade = 1 + i % 12;
+        subject_t *subjects[] = { &batch[i].subject1, &batch[i].subject2, &batch[i].subject3, &batch[i].subject4 };
+        for (int s = 0; s < 4; s++) {
+            str_set(&subjects[s]->name, "Mathematics");
+            subjects[s]->grade = (float)((i * 7 + s * 13) % 101);
+        }
+    }
+    int first_id = studentdb_create_many(&db, batch, students);
+    free(batch);
+    if (first_id < 0) {
+        printf("Could not create the students.\n");
+        return 1;
+    }
+
+    http_server_t server;
+    if (http_server_start(&server, &db, 0) != 0) {
+        perror("http_server_start");
+        return 1;
+    }
+    printf("%d students, %d connections, port %d\n", students, connections, server.net.port);
+    run_phase("get/close", server.net.port, OP_GET, 1, 1, connections, REQUESTS_PER_CLIENT / 4, first_id, students);
+    run_phase("get/1", server.net.port, OP_GET, 1, 0, connections, REQUESTS_PER_CLIENT, first_id, students);
+    run_phase("get/16", server.net.port, OP_GET, 16, 0, connections, REQUESTS_PER_CLIENT, first_id, students);
+    run_phase("patch/16", server.net.port, OP_PATCH, 16, 0, connections, REQUESTS_PER_CLIENT / 10, first_id, students);
+    run_phase("post/16", server.net.port, OP_POST, 16, 0, connections, REQUESTS_PER_CLIENT / 10, first_id, students);
+    http_server_stop(&server);
+    studentdb_close(&db);
+    if (chdir("..") != 0) {
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,206 @@
+/*
+ * ============================================================================
+ * BINARY RPC BENCHMARK
+ * ============================================================================
+ *
+ * Starts the RPC server (rpc.h) in-process on a loopback port and drives
+ * it with C client threads, each on its own connection, sending one
+ * frame of BATCH operations at a time and waiting for its results:
+ *
+ *     get/1        one GET of a random student per frame
+ *     get/16       16 GETs per frame
+ *     get/256      256 GETs per frame
+ *     edit/256     256 edits of one grade per frame
+ *     add/256      256 new students per frame (one create_many batch)
+ *
+ * Reports operations/s and the p50/p99 time of a frame round trip. Run
+ * bench_http with the same arguments to compare with the HTTP API. Uses
+ * the B+tree store in bench_rpc/ under the current directory.
+ *
+ * Usage: bench_rpc [students] [connections]
+ *
+ * ============================================================================
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/stat.h>
+
+#include "rpc.h"
+
+#define OPS_PER_CLIENT 64000
+
+typedef struct {
+    int port;
+    rpc_op_t op;
+    int batch;
+    int frames;
+    int first_id;
+    int students;
+    unsigned seed;
+    double *latencies;        // one per frame
+    long errors;
+} client_t;
+
+static student_t bench_student;
+
+static double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static int compare_doubles(const void *a, const void *b) {
+    double x = *(const double *)a;
+    double y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+static void make_student(student_t *student, int i) {
+    memset(student, 0, sizeof(*student));
+    str_set(&student->name, "Bench");
+    str_set(&student->family_name, "Student");
+    str_set(&student->father_name, "Father");
+    str_set(&student->mother_name, "Mother");
+    snprintf(student->dateofbirth, sizeof(student->dateofbirth), "01/01/2010");
+    snprintf(student->studentid, sizeof(student->studentid), "B%d", i);
+    snprintf(student->phone_number, sizeof(student->phone_number), "5550100");
+    student->grade = 1 + i % 12;
+    subject_t *subjects[] = { &student->subject1, &student->subject2, &student->subject3, &student->subject4 };
+    for (int s = 0; s < 4; s++) {
+        str_set(&subjects[s]->name, "Mathematics");
+        subjects[s]->grade = (float)((i * 7 + s * 13) % 101);
+    }
+}
+
+static void *run_client(void *arg) {
+    client_t *client = arg;
+    rpc_buf_t request = { 0 };
+    rpc_buf_t response = { 0 };
+    int fd = net_connect(client->port);
+    for (int frame = 0; fd >= 0 && frame < client->frames; frame++) {
+        rpc_clear(&request);
+        rpc_begin(&request, (uint32_t)frame);
+        for (int i = 0; i < client->batch; i++) {
+            client->seed = client->seed * 1103515245u + 12345u;
+            int id = client->first_id + (int)((client->seed >> 8) % (unsigned)client->students);
+            if (client->op == RPC_GET) {
+                rpc_get(&request, id);
+            } else if (client->op == RPC_EDIT) {
+                char value[8];
+                snprintf(value, sizeof(value), "%u", (client->seed >> 4) % 101);
+                rpc_edit(&request, id, FIELD_SUBJECT1_GRADE, value);
+            } else {
+                rpc_add(&request, &bench_student);
+            }
+        }
+        rpc_end(&request);
+
+        double start = now_seconds();
+        int ok = rpc_call(fd, &request, &response) == 0;
+        client->latencies[frame] = now_seconds() - start;
+        if (!ok) {
+            client->errors += client->batch;
+            break;
+        }
+        rpc_reader_t reader = rpc_reader(&response);
+        rpc_result_t result;
+        while (rpc_read(&reader, &result) > 0) {
+            client->errors += result.status != RPC_OK;
+        }
+    }
+    if (fd >= 0) {
+        close(fd);
+    }
+    rpc_buf_free(&request);
+    rpc_buf_free(&response);
+    return NULL;
+}
+
+static void run_phase(const char *name, int port, rpc_op_t op, int batch, int connections, int ops, int first_id,
+                      int students) {
+    int frames = ops / batch;
+    client_t *clients = calloc((size_t)connections, sizeof(client_t));
+    pthread_t *threads = calloc((size_t)connections, sizeof(pthread_t));
+    double *latencies = calloc((size_t)connections * (size_t)frames, sizeof(double));
+    if (!clients || !threads || !latencies) {
+        return;
+    }
+    double start = now_seconds();
+    for (int i = 0; i < connections; i++) {
+        clients[i] = (client_t){ port, op, batch, frames, first_id, students, 7u * (unsigned)i + 1,
+                                 latencies + (size_t)i * (size_t)frames, 0 };
+        pthread_create(&threads[i], NULL, run_client, &clients[i]);
+    }
+    long errors = 0;
+    for (int i = 0; i < connections; i++) {
+        pthread_join(threads[i], NULL);
+        errors += clients[i].errors;
+    }
+    double elapsed = now_seconds() - start;
+    long total = (long)connections * frames;
+    qsort(latencies, (size_t)total, sizeof(double), compare_doubles);
+    printf("%-10s %10.0f ops/s  frame p50 %9.1f us  p99 %9.1f us  errors %ld\n", name,
+           (double)total * batch / elapsed, latencies[total / 2] * 1e6, latencies[total * 99 / 100] * 1e6, errors);
+    free(clients);
+    free(threads);
+    free(latencies);
+}
+
+int main(int argc, char **argv) {
+    int students = argc > 1 ? atoi(argv[1]) : 2000;
+    int connections = argc > 2 ? atoi(argv[2]) : 4;
+    if (students < 1) {
+        students = 1;
+    }
+    if (connections < 1 || connections > NET_MAX_CONNECTIONS) {
+        connections = 4;
+    }
+    mkdir("bench_rpc", 0755);
+    if (chdir("bench_rpc") != 0) {
+        return 1;
+    }
+
+    studentdb_t db;
+    if (studentdb_open(&db) != 0 || studentdb_use_btree(&db) != 0) {
+        printf("Could not open the B+tree store in bench_rpc/.\n");
+        return 1;
+    }
+    student_t *batch = calloc((size_t)students, sizeof(student_t));
+    if (!batch) {
+        return 1;
+    }
+    for (int i = 0; i < students; i++) {
+        make_student(&batch[i], i);
+    }
+    int first_id = studentdb_create_many(&db, batch, students);
+    free(batch);
+    if (first_id < 0) {
+        printf("Could not create the students.\n");
+        return 1;
+    }
+    make_student(&bench_student, 1);
+
+    rpc_server_t server;
+    if (rpc_server_start(&server, &db, 0) != 0) {
+        perror("rpc_server_start");
+        return 1;
+    }
+    int port = server.net.port;
+    printf("%d students, %d connections, port %d\n", students, connections, port);
+    run_phase("get/1", port, RPC_GET, 1, connections, OPS_PER_CLIENT / 8, first_id, students);
+    run_phase("get/16", port, RPC_GET, 16, connections, OPS_PER_CLIENT, first_id, students);
+    run_phase("get/256", port, RPC_GET, 256, connections, OPS_PER_CLIENT, first_id, students);
+    run_phase("edit/256", port, RPC_EDIT, 256, connections, OPS_PER_CLIENT / 16, first_id, students);
+    run_phase("add/256", port, RPC_ADD, 256, connections, OPS_PER_CLIENT / 16, first_id, students);
+    rpc_server_stop(&server);
+    studentdb_close(&db);
+    if (chdir("..") != 0) {
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,119 @@
+/*
+ * ============================================================================
+ * SHARDED ENGINE SCALING BENCHMARK
+ * ============================================================================
+ *
+ * Runs the same mixed workload (1 add : 4 updates : 5 gets) from one client
+ * thread per shard against 1, 2, 4 ... N shards and reports ops/s, so the
+ * scaling of mutation throughput with shard count is visible.
+ *
+ * Each run uses a fresh bench_shard_<n>/ directory under the current one.
+ *
+ * Usage: bench_shard [max_shards] [ops_per_client]
+ *
+ * ============================================================================
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "shard.h"
+
+typedef struct {
+    shard_engine_t *engine;
+    int ops;
+    unsigned seed;
+} client_t;
+
+static double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void *client_main(void *arg) {
+    client_t *client = arg;
+    int ids[1024];
+    int id_count = 0;
+    student_t student;
+
+    for (int i = 0; i < client->ops; i++) {
+        client->seed = client->seed * 1103515245u + 12345u;
+        int pick = (int)(client->seed >> 8) % 10;
+        if (pick == 0 || id_count == 0) {
+            memset(&student, 0, sizeof(student));
+            char name[32];
+            snprintf(name, sizeof(name), "Bench%d", i);
+            str_set(&student.name, name);
+            snprintf(student.studentid, sizeof(student.studentid), "B%d", i);
+            student.grade = 1 + i % 12;
+            int id = shard_add(client->engine, &student);
+            if (id > 0 && id_count < 1024) {
+                ids[id_count++] = id;
+            }
+        } else if (pick < 5) {
+            char grade[16];
+            snprintf(grade, sizeof(grade), "%d", i % 100);
+            shard_update(client->engine, ids[client->seed % (unsigned)id_count], FIELD_SUBJECT1_GRADE, grade);
+        } else {
+            shard_get(client->engine, ids[client->seed % (unsigned)id_count], &student);
+        }
+    }
+    return NULL;
+}
+
+static double run(int shards, int ops) {
+    char dir[64];
+    snprintf(dir, sizeof(dir), "bench_shard_%d", shards);
+    mkdir(dir, 0755);
+    if (chdir(dir) != 0) {
+        return 0;
+    }
+    mkdir("data", 0755);
+
+    shard_engine_t engine;
+    if (shard_engine_open(&engine, shards) != 0) {
+        chdir("..");
+        return 0;
+    }
+
+    pthread_t threads[SHARD_MAX];
+    client_t clients[SHARD_MAX];
+    double start = now_seconds();
+    for (int i = 0; i < shards; i++) {
+        clients[i] = (client_t){ &engine, ops, (unsigned)(i + 1) * 7919u };
+        pthread_create(&threads[i], NULL, client_main, &clients[i]);
+    }
+    for (int i = 0; i < shards; i++) {
+        pthread_join(threads[i], NULL);
+    }
+    double elapsed = now_seconds() - start;
+    shard_engine_close(&engine);
+    chdir("..");
+    return (double)shards * ops / elapsed;
+}
+
+int main(int argc, char **argv) {
+    int max_shards = argc > 1 ? atoi(argv[1]) : (int)sysconf(_SC_NPROCESSORS_ONLN);
+    int ops = argc > 2 ? atoi(argv[2]) : 2000;
+    if (max_shards < 1) {
+        max_shards = 1;
+    }
+    if (max_shards > SHARD_MAX) {
+        max_shards = SHARD_MAX;
+    }
+
+    double base = 0;
+    for (int shards = 1; shards <= max_shards; shards *= 2) {
+        double rate = run(shards, ops);
+        if (shards == 1) {
+            base = rate;
+        }
+        printf("%2d shards  %10.0f ops/s  speedup %.2fx\n", shards, rate, base > 0 ? rate / base : 0);
+    }
+    return 0;
+}
@@ -0,0 +1,185 @@
+/*
+ * ============================================================================
+ * STORAGE BACKEND BENCHMARK
+ * ============================================================================
+ *
+ * Runs the same workload against every store.h backend (text files,
+ * B+tree, LSM) and reports ops/s and latency percentiles per phase:
+ *
+ *     put      insert N students in shuffled ID order
+ *     get      N lookups of random IDs
+ *     update   N single-field edits of random IDs (get + put)
+ *     scan     read every record in ID order, 10 times
+ *     delete   remove N/10 random IDs
+ *
+ * All backends write durably (an fsync or fdatasync per put), as the app
+ * does. Each backend runs in a fresh bench_store_<name>/ directory under
+ * the current one.
+ *
+ * Usage: bench_store [records]
+ *
+ * ============================================================================
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "store.h"
+
+#define SCAN_ROUNDS 10
+
+static double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static int compare_doubles(const void *a, const void *b) {
+    double x = *(const double *)a;
+    double y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+// Prints ops/s and the p50/p99/p99.9 of count latencies (seconds), sorting them
+static void report(const char *store, const char *phase, double *latencies, int count, double elapsed) {
+    qsort(latencies, (size_t)count, sizeof(double), compare_doubles);
+    printf("%-6s %-7s %10.0f ops/s  p50 %9.1f us  p99 %9.1f us  p99.9 %9.1f us\n", store, phase,
+           count / elapsed, latencies[count / 2] * 1e6, latencies[count * 99 / 100] * 1e6,
+           latencies[count * 999 / 1000] * 1e6);
+}
+
+static void count_visit(const student_t *student, void *arg) {
+    (void)student;
+    ++*(long *)arg;
+}
+
+static void run(const store_t *store, int records, const int *ids, double *latencies) {
+    const char *name = store->ops->name;
+    unsigned seed = 12345;
+    student_t student;
+
+    double start = now_seconds();
+    for (int i = 0; i < records; i++) {
+        memset(&student, 0, sizeof(student));
+        str_set(&student.name, "Bench");
+        str_set(&student.family_name, "Student");
+        str_set(&student.subject1.name, "Mathematics");
+        snprintf(student.studentid, sizeof(student.studentid), "B%d", ids[i]);
+        student.student_id = ids[i];
+        student.grade = 1 + ids[i] % 12;
+        double t = now_seconds();
+        store_put(store, ids[i], &student);
+        latencies[i] = now_seconds() - t;
+    }
+    report(name, "put", latencies, records, now_seconds() - start);
+
+    start = now_seconds();
+    for (int i = 0; i < records; i++) {
+        seed = seed * 1103515245u + 12345u;
+        double t = now_seconds();
+        store_get(store, ids[(seed >> 8) % (unsigned)records], &student);
+        latencies[i] = now_seconds() - t;
+    }
+    report(name, "get", latencies, records, now_seconds() - start);
+
+    start = now_seconds();
+    for (int i = 0; i < records; i++) {
+        seed = seed * 1103515245u + 12345u;
+        char grade[16];
+        snprintf(grade, sizeof(grade), "%d", i % 100);
+        double t = now_seconds();
+        store_update(store, ids[(seed >> 8) % (unsigned)records], FIELD_SUBJECT1_GRADE, grade);
+        latencies[i] = now_seconds() - t;
+    }
+    report(name, "update", latencies, records, now_seconds() - start);
+
+    // Scan latency is per record visited
+    long visited = 0;
+    start = now_seconds();
+    for (int i = 0; i < SCAN_ROUNDS; i++) {
+        double t = now_seconds();
+        long before = visited;
+        store_scan(store, INT32_MIN, INT32_MAX, count_visit, &visited);
+        latencies[i] = (now_seconds() - t) / (visited > before ? visited - before : 1);
+    }
+    double elapsed = now_seconds() - start;
+    qsort(latencies, SCAN_ROUNDS, sizeof(double), compare_doubles);
+    printf("%-6s %-7s %10.0f rec/s  p50 %9.3f us per record\n", name, "scan", visited / elapsed,
+           latencies[SCAN_ROUNDS / 2] * 1e6);
+
+    int deletes = records / 10 > 0 ? records / 10 : 1;
+    start = now_seconds();
+    for (int i = 0; i < deletes; i++) {
+        double t = now_seconds();
+        store_delete(store, ids[i]);
+        latencies[i] = now_seconds() - t;
+    }
+    report(name, "delete", latencies, deletes, now_seconds() - start);
+}
+
+// Runs one backend in bench_store_<name>/; kind is 0 text, 1 btree, 2 lsm
+static void run_backend(int kind, int records, const int *ids, double *latencies) {
+    static const char *names[] = { "text", "btree", "lsm" };
+    char dir[64];
+    snprintf(dir, sizeof(dir), "bench_store_%s", names[kind]);
+    mkdir(dir, 0755);
+    if (chdir(dir) != 0) {
+        return;
+    }
+    mkdir("data", 0755);
+
+    store_t store;
+    btree_t tree;
+    lsm_t lsm;
+    if (kind == 0) {
+        store_text(&store);
+        run(&store, records, ids, latencies);
+    } else if (kind == 1 && btree_open(&tree, BTREE_PATH) == 0) {
+        store_btree(&store, &tree);
+        run(&store, records, ids, latencies);
+        btree_close(&tree);
+    } else if (kind == 2 && lsm_open(&lsm, LSM_DIR, NULL) == 0) {
+        store_lsm(&store, &lsm);
+        run(&store, records, ids, latencies);
+        lsm_close(&lsm);
+    } else {
+        printf("%-6s could not open the store\n", names[kind]);
+    }
+    if (chdir("..") != 0) {
+        return;
+    }
+}
+
+int main(int argc, char **argv) {
+    int records = argc > 1 ? atoi(argv[1]) : 2000;
+    if (records < 1) {
+        records = 1;
+    }
+    int *ids = malloc((size_t)records * sizeof(int));
+    double *latencies = malloc((size_t)(records > SCAN_ROUNDS ? records : SCAN_ROUNDS) * sizeof(double));
+    if (!ids || !latencies) {
+        return 1;
+    }
+    for (int i = 0; i < records; i++) {
+        ids[i] = i + 1;
+    }
+    unsigned seed = 42;
+    for (int i = records - 1; i > 0; i--) {
+        seed = seed * 1103515245u + 12345u;
+        int j = (int)((seed >> 8) % (unsigned)(i + 1));
+        int swap = ids[i];
+        ids[i] = ids[j];
+        ids[j] = swap;
+    }
+
+    for (int kind = 0; kind < 3; kind++) {
+        run_backend(kind, records, ids, latencies);
+    }
+    free(ids);
+    free(latencies);
+    return 0;
+}
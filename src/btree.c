@@ -0,0 +1,1011 @@
+/*
+ * ============================================================================
+ * COPY-ON-WRITE B+TREE STORE (data/students.db)
+ * ============================================================================
+ *
+ * See btree.h for the file layout and the transaction model.
+ *
+ * Page formats:
+ *
+ *     leaf:   page_head_t, leaf_slot_t slots[count] growing up from the
+ *             header, values packed down from the end of the page
+ *     branch: page_head_t, keys[count], children[count + 1]; child i
+ *             holds the keys k with keys[i - 1] <= k < keys[i]
+ *
+ * Pages are rewritten whole: a change to a leaf gathers its entries,
+ * applies the change and lays the page out again, splitting it in two
+ * when the entries no longer fit.
+ *
+ * ============================================================================
+ */
+
+#include "btree.h"
+#include "crc32c.h"
+#include "mem.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#define PAGE_LEAF 1
+#define PAGE_BRANCH 2
+#define FIRST_DATA_PAGE 2
+
+typedef struct {
+    uint16_t type;
+    uint16_t count;
+} page_head_t;
+
+typedef struct {
+    int32_t key;
+    uint16_t offset;
+    uint16_t length;
+} leaf_slot_t;
+
+typedef struct {
+    page_head_t head;
+    leaf_slot_t slots[];
+} leaf_t;
+
+#define BRANCH_MAX ((BTREE_PAGE_SIZE - sizeof(page_head_t) - sizeof(uint32_t)) / 8)
+
+typedef struct {
+    page_head_t head;
+    int32_t keys[BRANCH_MAX];
+    uint32_t children[BRANCH_MAX + 1];
+} branch_t;
+
+#define LEAF_SPACE (BTREE_PAGE_SIZE - sizeof(page_head_t))
+
+typedef struct {
+    char magic[8];
+    uint32_t format_version;
+    uint32_t page_size;
+    uint64_t txn_id;
+    uint32_t root;
+    uint32_t page_count;
+    uint64_t record_count;
+    uint32_t checksum;       // CRC32C of the fields above
+} meta_t;
+
+#define LEAF_MAX ((int)(LEAF_SPACE / (sizeof(leaf_slot_t) + sizeof(student_packed_t))))
+
+typedef struct {
+    int32_t key;
+    const unsigned char *value;
+    uint16_t length;
+} entry_t;
+
+typedef struct {
+    int32_t key;
+    uint32_t page;           // 0 = no split
+} split_t;
+
+/*
+ * Meta Pages
+ * ==========
+ */
+static uint32_t meta_checksum(const meta_t *meta) {
+    return crc32c(0, meta, offsetof(meta_t, checksum));
+}
+
+static int write_meta(int fd, uint64_t txn_id, uint32_t root, uint32_t page_count, uint64_t record_count) {
+    uint64_t page[BTREE_PAGE_SIZE / 8];
+    memset(page, 0, sizeof(page));
+    meta_t *meta = (meta_t *)page;
+    memcpy(meta->magic, BTREE_MAGIC, sizeof(meta->magic));
+    meta->format_version = BTREE_FORMAT_VERSION;
+    meta->page_size = BTREE_PAGE_SIZE;
+    meta->txn_id = txn_id;
+    meta->root = root;
+    meta->page_count = page_count;
+    meta->record_count = record_count;
+    meta->checksum = meta_checksum(meta);
+    // Commits alternate between the two meta pages
+    off_t offset = (off_t)(txn_id % 2) * BTREE_PAGE_SIZE;
+    return pwrite(fd, page, BTREE_PAGE_SIZE, offset) == BTREE_PAGE_SIZE ? 0 : -1;
+}
+
+// Picks the valid meta page with the highest transaction ID
+static int read_meta(int fd, meta_t *meta) {
+    int found = 0;
+    for (int i = 0; i < 2; i++) {
+        meta_t candidate;
+        if (pread(fd, &candidate, sizeof(candidate), (off_t)i * BTREE_PAGE_SIZE) != (ssize_t)sizeof(candidate) ||
+            memcmp(candidate.magic, BTREE_MAGIC, sizeof(candidate.magic)) != 0 ||
+            candidate.format_version != BTREE_FORMAT_VERSION ||
+            candidate.page_size != BTREE_PAGE_SIZE ||
+            candidate.checksum != meta_checksum(&candidate)) {
+            continue;
+        }
+        if (!found || candidate.txn_id > meta->txn_id) {
+            *meta = candidate;
+            found = 1;
+        }
+    }
+    return found ? 0 : -1;
+}
+
+/*
+ * Published Version
+ * =================
+ * The writer updates txn_id/root/record_count under a seqlock; readers
+ * retry their copy if seq was odd or changed meanwhile.
+ */
+static void publish(btree_t *tree, uint64_t txn_id, uint32_t root, uint64_t record_count) {
+    unsigned seq = __atomic_load_n(&tree->seq, __ATOMIC_RELAXED);
+    __atomic_store_n(&tree->seq, seq + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    __atomic_store_n(&tree->root, root, __ATOMIC_RELAXED);
+    __atomic_store_n(&tree->record_count, record_count, __ATOMIC_RELAXED);
+    __atomic_store_n(&tree->txn_id, txn_id, __ATOMIC_SEQ_CST);
+    __atomic_store_n(&tree->seq, seq + 2, __ATOMIC_RELEASE);
+}
+
+static void load_version(btree_t *tree, btree_reader_t *reader) {
+    for (;;) {
+        unsigned seq = __atomic_load_n(&tree->seq, __ATOMIC_ACQUIRE);
+        reader->root = __atomic_load_n(&tree->root, __ATOMIC_RELAXED);
+        reader->record_count = __atomic_load_n(&tree->record_count, __ATOMIC_RELAXED);
+        reader->txn_id = __atomic_load_n(&tree->txn_id, __ATOMIC_RELAXED);
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        if (!(seq & 1) && __atomic_load_n(&tree->seq, __ATOMIC_RELAXED) == seq) {
+            return;
+        }
+    }
+}
+
+/*
+ * Page Access
+ * ===========
+ * txn is NULL for readers, which only ever see committed pages
+ */
+static int dirty_find(const btree_txn_t *txn, uint32_t page) {
+    if (txn->dirty_slot_capacity == 0) {
+        return -1;
+    }
+    int mask = txn->dirty_slot_capacity - 1;
+    int slot = (int)((page * 2654435761u) & (uint32_t)mask);
+    while (txn->dirty_slots[slot] != 0) {
+        int index = txn->dirty_slots[slot] - 1;
+        if (txn->dirty[index].page == page) {
+            return index;
+        }
+        slot = (slot + 1) & mask;
+    }
+    return -1;
+}
+
+static const unsigned char *page_at(const btree_t *tree, const btree_txn_t *txn, uint32_t page) {
+    int index = txn ? dirty_find(txn, page) : -1;
+    return index >= 0 ? txn->dirty[index].data : tree->map + (size_t)page * BTREE_PAGE_SIZE;
+}
+
+static int dirty_rehash(btree_txn_t *txn, int capacity) {
+    int *slots = mem_calloc(MEM_RECORDS, (size_t)capacity, sizeof(int));
+    if (!slots) {
+        return -1;
+    }
+    mem_free(txn->dirty_slots);
+    txn->dirty_slots = slots;
+    txn->dirty_slot_capacity = capacity;
+    for (int i = 0; i < txn->dirty_count; i++) {
+        int slot = (int)((txn->dirty[i].page * 2654435761u) & (uint32_t)(capacity - 1));
+        while (slots[slot] != 0) {
+            slot = (slot + 1) & (capacity - 1);
+        }
+        slots[slot] = i + 1;
+    }
+    return 0;
+}
+
+// Gives page a fresh buffer in this transaction
+static unsigned char *dirty_add(btree_txn_t *txn, uint32_t page) {
+    if (txn->dirty_count == txn->dirty_capacity) {
+        int capacity = txn->dirty_capacity ? txn->dirty_capacity * 2 : 16;
+        btree_dirty_t *dirty = mem_realloc(MEM_RECORDS, txn->dirty, (size_t)capacity * sizeof(*dirty));
+        if (!dirty) {
+            return NULL;
+        }
+        txn->dirty = dirty;
+        txn->dirty_capacity = capacity;
+    }
+    if ((txn->dirty_count + 1) * 2 > txn->dirty_slot_capacity &&
+        dirty_rehash(txn, txn->dirty_slot_capacity ? txn->dirty_slot_capacity * 2 : 64) != 0) {
+        return NULL;
+    }
+    unsigned char *data = mem_malloc(MEM_RECORDS, BTREE_PAGE_SIZE);
+    if (!data) {
+        return NULL;
+    }
+    txn->dirty[txn->dirty_count] = (btree_dirty_t){ page, data };
+    int mask = txn->dirty_slot_capacity - 1;
+    int slot = (int)((page * 2654435761u) & (uint32_t)mask);
+    while (txn->dirty_slots[slot] != 0) {
+        slot = (slot + 1) & mask;
+    }
+    txn->dirty_slots[slot] = ++txn->dirty_count;
+    return data;
+}
+
+// Takes the oldest reusable free page, or extends the file
+static unsigned char *new_page(btree_txn_t *txn, uint32_t *page) {
+    btree_t *tree = txn->tree;
+    if (tree->free_head < tree->free_count &&
+        tree->free_pages[tree->free_head].freed_txn <= txn->oldest_reader) {
+        *page = tree->free_pages[tree->free_head++].page;
+    } else {
+        if ((size_t)txn->page_count >= BTREE_MAP_SIZE / BTREE_PAGE_SIZE) {
+            errno = ENOSPC;
+            return NULL;
+        }
+        *page = txn->page_count++;
+    }
+    return dirty_add(txn, *page);
+}
+
+static int free_later(btree_txn_t *txn, uint32_t page) {
+    if (txn->freed_count == txn->freed_capacity) {
+        int capacity = txn->freed_capacity ? txn->freed_capacity * 2 : 16;
+        uint32_t *freed = mem_realloc(MEM_RECORDS, txn->freed, (size_t)capacity * sizeof(*freed));
+        if (!freed) {
+            return -1;
+        }
+        txn->freed = freed;
+        txn->freed_capacity = capacity;
+    }
+    txn->freed[txn->freed_count++] = page;
+    return 0;
+}
+
+// Returns a writable copy of *page, moving it to a new page on first write
+static unsigned char *touch_page(btree_txn_t *txn, uint32_t *page) {
+    int index = dirty_find(txn, *page);
+    if (index >= 0) {
+        return txn->dirty[index].data;
+    }
+    uint32_t old = *page;
+    unsigned char *data = new_page(txn, page);
+    if (!data || free_later(txn, old) != 0) {
+        return NULL;
+    }
+    memcpy(data, txn->tree->map + (size_t)old * BTREE_PAGE_SIZE, BTREE_PAGE_SIZE);
+    return data;
+}
+
+/*
+ * Leaf and Branch Helpers
+ * =======================
+ */
+static int leaf_search(const leaf_t *leaf, int32_t key, int *found) {
+    int lo = 0;
+    int hi = leaf->head.count;
+    while (lo < hi) {
+        int mid = (lo + hi) / 2;
+        if (leaf->slots[mid].key < key) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    *found = lo < leaf->head.count && leaf->slots[lo].key == key;
+    return lo;
+}
+
+// Index of the child that holds key
+static int branch_search(const branch_t *branch, int32_t key) {
+    int lo = 0;
+    int hi = branch->head.count;
+    while (lo < hi) {
+        int mid = (lo + hi) / 2;
+        if (branch->keys[mid] <= key) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+static int leaf_gather(const unsigned char *page, entry_t *entries) {
+    const leaf_t *leaf = (const leaf_t *)page;
+    if (leaf->head.count > LEAF_MAX) {
+        errno = EBADMSG;
+        return -1;
+    }
+    for (int i = 0; i < leaf->head.count; i++) {
+        entries[i].key = leaf->slots[i].key;
+        entries[i].value = page + leaf->slots[i].offset;
+        entries[i].length = leaf->slots[i].length;
+    }
+    return leaf->head.count;
+}
+
+static size_t entries_size(const entry_t *entries, int count) {
+    size_t size = 0;
+    for (int i = 0; i < count; i++) {
+        size += sizeof(leaf_slot_t) + entries[i].length;
+    }
+    return size;
+}
+
+static void leaf_write(unsigned char *page, const entry_t *entries, int count) {
+    memset(page, 0, BTREE_PAGE_SIZE);
+    leaf_t *leaf = (leaf_t *)page;
+    leaf->head.type = PAGE_LEAF;
+    leaf->head.count = (uint16_t)count;
+    size_t top = BTREE_PAGE_SIZE;
+    for (int i = 0; i < count; i++) {
+        top -= entries[i].length;
+        memcpy(page + top, entries[i].value, entries[i].length);
+        leaf->slots[i] = (leaf_slot_t){ entries[i].key, (uint16_t)top, entries[i].length };
+    }
+}
+
+// First entry of the right half when splitting entries by size
+static int leaf_split_point(const entry_t *entries, int count, size_t total) {
+    size_t left = 0;
+    int split = 0;
+    while (split < count - 1) {
+        size_t size = sizeof(leaf_slot_t) + entries[split].length;
+        if (left + size > total / 2) {
+            break;
+        }
+        left += size;
+        split++;
+    }
+    return split > 0 ? split : 1;
+}
+
+static void branch_init(unsigned char *page) {
+    memset(page, 0, BTREE_PAGE_SIZE);
+    ((branch_t *)page)->head.type = PAGE_BRANCH;
+}
+
+// Adds (key, child) after position index, splitting the branch when full
+static int branch_insert(btree_txn_t *txn, unsigned char *page, int index, int32_t key, uint32_t child,
+                         split_t *split) {
+    branch_t *branch = (branch_t *)page;
+    int count = branch->head.count;
+    if (count < (int)BRANCH_MAX) {
+        memmove(&branch->keys[index + 1], &branch->keys[index], (size_t)(count - index) * sizeof(int32_t));
+        memmove(&branch->children[index + 2], &branch->children[index + 1],
+                (size_t)(count - index) * sizeof(uint32_t));
+        branch->keys[index] = key;
+        branch->children[index + 1] = child;
+        branch->head.count++;
+        return 0;
+    }
+
+    int32_t keys[BRANCH_MAX + 1];
+    uint32_t children[BRANCH_MAX + 2];
+    memcpy(keys, branch->keys, (size_t)index * sizeof(int32_t));
+    keys[index] = key;
+    memcpy(keys + index + 1, branch->keys + index, (size_t)(count - index) * sizeof(int32_t));
+    memcpy(children, branch->children, (size_t)(index + 1) * sizeof(uint32_t));
+    children[index + 1] = child;
+    memcpy(children + index + 2, branch->children + index + 1, (size_t)(count - index) * sizeof(uint32_t));
+
+    uint32_t right_page;
+    unsigned char *right_data = new_page(txn, &right_page);
+    if (!right_data) {
+        return -1;
+    }
+    int total = count + 1;
+    int middle = total / 2;
+    branch_init(page);
+    branch->head.count = (uint16_t)middle;
+    memcpy(branch->keys, keys, (size_t)middle * sizeof(int32_t));
+    memcpy(branch->children, children, (size_t)(middle + 1) * sizeof(uint32_t));
+
+    branch_t *right = (branch_t *)right_data;
+    branch_init(right_data);
+    right->head.count = (uint16_t)(total - middle - 1);
+    memcpy(right->keys, keys + middle + 1, (size_t)right->head.count * sizeof(int32_t));
+    memcpy(right->children, children + middle + 1, (size_t)(right->head.count + 1) * sizeof(uint32_t));
+
+    split->key = keys[middle];
+    split->page = right_page;
+    return 0;
+}
+
+/*
+ * Tree Updates
+ * ============
+ */
+
+// Inserts or replaces entry below *page; *page is updated to its copy
+static int put_rec(btree_txn_t *txn, uint32_t *page, const entry_t *entry, split_t *split, int *added) {
+    unsigned char *data = touch_page(txn, page);
+    if (!data) {
+        return -1;
+    }
+    if (((const page_head_t *)data)->type == PAGE_BRANCH) {
+        branch_t *branch = (branch_t *)data;
+        int index = branch_search(branch, entry->key);
+        uint32_t child = branch->children[index];
+        split_t child_split = { 0, 0 };
+        if (put_rec(txn, &child, entry, &child_split, added) != 0) {
+            return -1;
+        }
+        branch->children[index] = child;
+        return child_split.page ? branch_insert(txn, data, index, child_split.key, child_split.page, split) : 0;
+    }
+
+    uint64_t scratch[BTREE_PAGE_SIZE / 8];
+    memcpy(scratch, data, BTREE_PAGE_SIZE);
+    entry_t entries[LEAF_MAX + 1];
+    int count = leaf_gather((const unsigned char *)scratch, entries);
+    if (count < 0) {
+        return -1;
+    }
+    int found;
+    int index = leaf_search((const leaf_t *)scratch, entry->key, &found);
+    if (found) {
+        entries[index] = *entry;
+    } else {
+        memmove(&entries[index + 1], &entries[index], (size_t)(count - index) * sizeof(entry_t));
+        entries[index] = *entry;
+        count++;
+        *added = 1;
+    }
+
+    size_t total = entries_size(entries, count);
+    if (total <= LEAF_SPACE) {
+        leaf_write(data, entries, count);
+        return 0;
+    }
+    // Appending a new highest ID (the common case) leaves the left page full
+    int at = !found && index == count - 1 ? count - 1 : leaf_split_point(entries, count, total);
+    uint32_t right_page;
+    unsigned char *right_data = new_page(txn, &right_page);
+    if (!right_data) {
+        return -1;
+    }
+    leaf_write(data, entries, at);
+    leaf_write(right_data, entries + at, count - at);
+    split->key = entries[at].key;
+    split->page = right_page;
+    return 0;
+}
+
+// Returns 1 if key was removed, 0 if absent; sets *empty if *page was freed
+static int delete_rec(btree_txn_t *txn, uint32_t *page, int32_t key, int *empty) {
+    const unsigned char *current = page_at(txn->tree, txn, *page);
+    if (((const page_head_t *)current)->type == PAGE_BRANCH) {
+        const branch_t *branch = (const branch_t *)current;
+        int index = branch_search(branch, key);
+        uint32_t child = branch->children[index];
+        int child_empty = 0;
+        int removed = delete_rec(txn, &child, key, &child_empty);
+        if (removed <= 0) {
+            return removed;
+        }
+        branch_t *copy = (branch_t *)touch_page(txn, page);
+        if (!copy) {
+            return -1;
+        }
+        if (!child_empty) {
+            copy->children[index] = child;
+            return 1;
+        }
+        int count = copy->head.count;
+        if (count == 0) {
+            *empty = 1;
+            return free_later(txn, *page) == 0 ? 1 : -1;
+        }
+        int key_index = index > 0 ? index - 1 : 0;
+        memmove(&copy->keys[key_index], &copy->keys[key_index + 1], (size_t)(count - key_index - 1) * sizeof(int32_t));
+        memmove(&copy->children[index], &copy->children[index + 1], (size_t)(count - index) * sizeof(uint32_t));
+        copy->head.count--;
+        return 1;
+    }
+
+    int found;
+    int index = leaf_search((const leaf_t *)current, key, &found);
+    if (!found) {
+        return 0;
+    }
+    unsigned char *data = touch_page(txn, page);
+    if (!data) {
+        return -1;
+    }
+    uint64_t scratch[BTREE_PAGE_SIZE / 8];
+    memcpy(scratch, data, BTREE_PAGE_SIZE);
+    entry_t entries[LEAF_MAX];
+    int count = leaf_gather((const unsigned char *)scratch, entries);
+    if (count < 0) {
+        return -1;
+    }
+    memmove(&entries[index], &entries[index + 1], (size_t)(count - index - 1) * sizeof(entry_t));
+    count--;
+    if (count == 0) {
+        *empty = 1;
+        return free_later(txn, *page) == 0 ? 1 : -1;
+    }
+    leaf_write(data, entries, count);
+    return 1;
+}
+
+static const unsigned char *find_value(const btree_t *tree, const btree_txn_t *txn, uint32_t root,
+                                       int32_t key, uint16_t *length) {
+    if (root == 0) {
+        return NULL;
+    }
+    const unsigned char *data = page_at(tree, txn, root);
+    while (((const page_head_t *)data)->type == PAGE_BRANCH) {
+        const branch_t *branch = (const branch_t *)data;
+        data = page_at(tree, txn, branch->children[branch_search(branch, key)]);
+    }
+    const leaf_t *leaf = (const leaf_t *)data;
+    int found;
+    int index = leaf_search(leaf, key, &found);
+    if (!found) {
+        return NULL;
+    }
+    *length = leaf->slots[index].length;
+    return data + leaf->slots[index].offset;
+}
+
+static int scan_rec(const btree_t *tree, uint32_t page, int32_t first, int32_t last,
+                    btree_visit_fn visit, void *arg) {
+    const unsigned char *data = page_at(tree, NULL, page);
+    int visited = 0;
+    if (((const page_head_t *)data)->type == PAGE_BRANCH) {
+        const branch_t *branch = (const branch_t *)data;
+        int end = branch_search(branch, last);
+        for (int i = branch_search(branch, first); i <= end; i++) {
+            int n = scan_rec(tree, branch->children[i], first, last, visit, arg);
+            if (n < 0) {
+                return -1;
+            }
+            visited += n;
+        }
+        return visited;
+    }
+    const leaf_t *leaf = (const leaf_t *)data;
+    int found;
+    for (int i = leaf_search(leaf, first, &found); i < leaf->head.count && leaf->slots[i].key <= last; i++) {
+        student_t student;
+        if (student_unpack(data + leaf->slots[i].offset, leaf->slots[i].length, &student) != 0) {
+            errno = EBADMSG;
+            return -1;
+        }
+        visit(&student, arg);
+        visited++;
+    }
+    return visited;
+}
+
+/*
+ * Free Space at Open
+ * ==================
+ * Marks every page reachable from the root; the rest are free
+ */
+static int mark_reachable(const btree_t *tree, uint32_t page, unsigned char *used) {
+    if (page < FIRST_DATA_PAGE || page >= tree->page_count || used[page]) {
+        errno = EBADMSG;
+        return -1;
+    }
+    used[page] = 1;
+    const unsigned char *data = page_at(tree, NULL, page);
+    if (((const page_head_t *)data)->type != PAGE_BRANCH) {
+        return 0;
+    }
+    const branch_t *branch = (const branch_t *)data;
+    for (int i = 0; i <= branch->head.count; i++) {
+        if (mark_reachable(tree, branch->children[i], used) != 0) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+static int free_push(btree_t *tree, uint32_t page, uint64_t freed_txn) {
+    if (tree->free_count == tree->free_capacity) {
+        // Reclaim the slots already handed out before growing
+        if (tree->free_head > 0) {
+            tree->free_count -= tree->free_head;
+            memmove(tree->free_pages, tree->free_pages + tree->free_head,
+                    (size_t)tree->free_count * sizeof(btree_free_t));
+            tree->free_head = 0;
+        }
+        if (tree->free_count == tree->free_capacity) {
+            int capacity = tree->free_capacity ? tree->free_capacity * 2 : 64;
+            btree_free_t *pages = mem_realloc(MEM_RECORDS, tree->free_pages, (size_t)capacity * sizeof(*pages));
+            if (!pages) {
+                return -1;
+            }
+            tree->free_pages = pages;
+            tree->free_capacity = capacity;
+        }
+    }
+    tree->free_pages[tree->free_count++] = (btree_free_t){ page, freed_txn };
+    return 0;
+}
+
+static int collect_free_pages(btree_t *tree) {
+    unsigned char *used = mem_calloc(MEM_RECORDS, tree->page_count, 1);
+    if (!used) {
+        return -1;
+    }
+    int rc = tree->root ? mark_reachable(tree, tree->root, used) : 0;
+    for (uint32_t page = FIRST_DATA_PAGE; rc == 0 && page < tree->page_count; page++) {
+        if (!used[page]) {
+            rc = free_push(tree, page, 0);
+        }
+    }
+    mem_free(used);
+    return rc;
+}
+
+/*
+ * FUNCTION: btree_open
+ * =====================
+ * Opens a B+tree file, creating an empty one if it does not exist
+ *
+ * Returns:
+ *   - 0 on success, -1 on error (errno EBADMSG if neither meta page is
+ *     valid or the tree is damaged, EWOULDBLOCK if another process or
+ *     btree_t has the file open)
+ */
+int btree_open(btree_t *tree, const char *path) {
+    memset(tree, 0, sizeof(*tree));
+    int fd = open(path, O_RDWR | O_CREAT, 0644);
+    if (fd < 0) {
+        return -1;
+    }
+    // Two writers would each keep their own free list and txn_id
+    struct stat st;
+    if (flock(fd, LOCK_EX | LOCK_NB) != 0 || fstat(fd, &st) != 0 ||
+        (st.st_size == 0 && (write_meta(fd, 0, 0, FIRST_DATA_PAGE, 0) != 0 ||
+                             write_meta(fd, 1, 0, FIRST_DATA_PAGE, 0) != 0 || fdatasync(fd) != 0))) {
+        close(fd);
+        return -1;
+    }
+    meta_t meta;
+    if (read_meta(fd, &meta) != 0) {
+        close(fd);
+        errno = EBADMSG;
+        return -1;
+    }
+    void *map = mmap(NULL, BTREE_MAP_SIZE, PROT_READ, MAP_SHARED, fd, 0);
+    if (map == MAP_FAILED) {
+        close(fd);
+        return -1;
+    }
+
+    tree->fd = fd;
+    tree->map = map;
+    tree->txn_id = meta.txn_id;
+    tree->root = meta.root;
+    tree->record_count = meta.record_count;
+    tree->page_count = meta.page_count;
+    pthread_mutex_init(&tree->write_lock, NULL);
+    if (collect_free_pages(tree) != 0) {
+        int saved = errno;
+        btree_close(tree);
+        errno = saved;
+        return -1;
+    }
+    return 0;
+}
+
+void btree_close(btree_t *tree) {
+    if (tree->map) {
+        munmap((void *)tree->map, BTREE_MAP_SIZE);
+        close(tree->fd);
+        pthread_mutex_destroy(&tree->write_lock);
+    }
+    mem_free(tree->free_pages);
+    memset(tree, 0, sizeof(*tree));
+}
+
+/*
+ * FUNCTION: btree_begin
+ * ======================
+ * Starts a write transaction, waiting for any other writer to finish
+ * Every transaction must end with btree_commit or btree_abort; after a
+ * failed put or delete, abort it.
+ */
+int btree_begin(btree_t *tree, btree_txn_t *txn) {
+    pthread_mutex_lock(&tree->write_lock);
+    memset(txn, 0, sizeof(*txn));
+    txn->tree = tree;
+    txn->txn_id = tree->txn_id + 1;
+    txn->root = tree->root;
+    txn->page_count = tree->page_count;
+    txn->record_count = tree->record_count;
+    txn->free_head = tree->free_head;
+
+    // Readers that start later see at least tree->txn_id
+    txn->oldest_reader = UINT64_MAX;
+    for (int i = 0; i < BTREE_MAX_READERS; i++) {
+        uint64_t pinned = __atomic_load_n(&tree->readers[i], __ATOMIC_SEQ_CST);
+        if (pinned != 0 && pinned < txn->oldest_reader) {
+            txn->oldest_reader = pinned;
+        }
+    }
+    return 0;
+}
+
+/*
+ * FUNCTION: btree_put
+ * ====================
+ * Inserts or replaces the record stored under id
+ *
+ * Returns:
+ *   - 0 on success, -1 on error (errno E2BIG if the record is larger
+ *     than BTREE_MAX_VALUE once serialized)
+ */
+int btree_put(btree_txn_t *txn, int id, const student_t *student) {
+    unsigned char value[BTREE_MAX_VALUE];
+    int length = student_pack(student, value, sizeof(value));
+    if (length < 0) {
+        errno = E2BIG;
+        return -1;
+    }
+    entry_t entry = { id, value, (uint16_t)length };
+    if (txn->root == 0) {
+        unsigned char *data = new_page(txn, &txn->root);
+        if (!data) {
+            return -1;
+        }
+        leaf_write(data, &entry, 1);
+        txn->record_count = 1;
+        return 0;
+    }
+
+    split_t split = { 0, 0 };
+    int added = 0;
+    if (put_rec(txn, &txn->root, &entry, &split, &added) != 0) {
+        return -1;
+    }
+    if (split.page) {
+        uint32_t root;
+        unsigned char *data = new_page(txn, &root);
+        if (!data) {
+            return -1;
+        }
+        branch_init(data);
+        branch_t *branch = (branch_t *)data;
+        branch->head.count = 1;
+        branch->keys[0] = split.key;
+        branch->children[0] = txn->root;
+        branch->children[1] = split.page;
+        txn->root = root;
+    }
+    txn->record_count += (uint64_t)added;
+    return 0;
+}
+
+/*
+ * FUNCTION: btree_delete
+ * =======================
+ * Removes the record stored under id
+ *
+ * Returns:
+ *   - 1 if it was removed, 0 if there was none, -1 on error
+ */
+int btree_delete(btree_txn_t *txn, int id) {
+    if (txn->root == 0) {
+        return 0;
+    }
+    int empty = 0;
+    int removed = delete_rec(txn, &txn->root, id, &empty);
+    if (removed <= 0) {
+        return removed;
+    }
+    if (empty) {
+        txn->root = 0;
+    }
+    // A root branch left with a single child is replaced by that child
+    while (txn->root != 0) {
+        const branch_t *root = (const branch_t *)page_at(txn->tree, txn, txn->root);
+        if (root->head.type != PAGE_BRANCH || root->head.count > 0) {
+            break;
+        }
+        if (free_later(txn, txn->root) != 0) {
+            return -1;
+        }
+        txn->root = root->children[0];
+    }
+    txn->record_count--;
+    return 1;
+}
+
+/*
+ * FUNCTION: btree_txn_get
+ * ========================
+ * Looks up id as this transaction sees it, including its own writes
+ *
+ * Returns:
+ *   - 0 if found, -1 otherwise
+ */
+int btree_txn_get(btree_txn_t *txn, int id, student_t *student) {
+    uint16_t length;
+    const unsigned char *value = find_value(txn->tree, txn, txn->root, id, &length);
+    return value ? student_unpack(value, length, student) : -1;
+}
+
+static void txn_release(btree_txn_t *txn) {
+    for (int i = 0; i < txn->dirty_count; i++) {
+        mem_free(txn->dirty[i].data);
+    }
+    mem_free(txn->dirty);
+    mem_free(txn->dirty_slots);
+    mem_free(txn->freed);
+    pthread_mutex_unlock(&txn->tree->write_lock);
+    memset(txn, 0, sizeof(*txn));
+}
+
+static int compare_dirty(const void *a, const void *b) {
+    uint32_t x = ((const btree_dirty_t *)a)->page;
+    uint32_t y = ((const btree_dirty_t *)b)->page;
+    return (x > y) - (x < y);
+}
+
+/*
+ * FUNCTION: btree_commit
+ * =======================
+ * Makes the transaction's changes durable and visible to new readers
+ *
+ * Process:
+ *   1. Write every new page, in file order, and fsync
+ *   2. Write the meta page the previous commit did not use, and fsync
+ *   3. Publish the new root and queue the replaced pages for reuse once
+ *      no reader can reach them
+ *
+ * Returns:
+ *   - 0 on success, -1 if the file could not be written (the tree is
+ *     left at its previous version)
+ */
+int btree_commit(btree_txn_t *txn) {
+    btree_t *tree = txn->tree;
+    if (txn->dirty_count == 0 && txn->freed_count == 0) {
+        txn_release(txn);
+        return 0;
+    }
+    qsort(txn->dirty, (size_t)txn->dirty_count, sizeof(btree_dirty_t), compare_dirty);
+    int ok = 1;
+    for (int i = 0; ok && i < txn->dirty_count; i++) {
+        off_t offset = (off_t)txn->dirty[i].page * BTREE_PAGE_SIZE;
+        ok = pwrite(tree->fd, txn->dirty[i].data, BTREE_PAGE_SIZE, offset) == BTREE_PAGE_SIZE;
+    }
+    ok = ok && fdatasync(tree->fd) == 0 &&
+         write_meta(tree->fd, txn->txn_id, txn->root, txn->page_count, txn->record_count) == 0 &&
+         fdatasync(tree->fd) == 0;
+    if (!ok) {
+        btree_abort(txn);
+        return -1;
+    }
+
+    tree->page_count = txn->page_count;
+    publish(tree, txn->txn_id, txn->root, txn->record_count);
+    for (int i = 0; i < txn->freed_count; i++) {
+        // On failure the page is only lost until the next open
+        free_push(tree, txn->freed[i], txn->txn_id);
+    }
+    txn_release(txn);
+    return 0;
+}
+
+/*
+ * FUNCTION: btree_abort
+ * ======================
+ * Drops the transaction; the tree keeps its last committed version
+ */
+void btree_abort(btree_txn_t *txn) {
+    txn->tree->free_head = txn->free_head;
+    txn_release(txn);
+}
+
+/*
+ * FUNCTION: btree_read_begin
+ * ===========================
+ * Pins the last committed version for lock-free reads
+ *
+ * Returns:
+ *   - 0 on success, -1 if BTREE_MAX_READERS readers are open (errno EAGAIN)
+ */
+int btree_read_begin(btree_t *tree, btree_reader_t *reader) {
+    reader->tree = tree;
+    load_version(tree, reader);
+    reader->slot = -1;
+    for (int i = 0; i < BTREE_MAX_READERS && reader->slot < 0; i++) {
+        uint64_t expected = 0;
+        if (__atomic_compare_exchange_n(&tree->readers[i], &expected, reader->txn_id, 0,
+                                        __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST)) {
+            reader->slot = i;
+        }
+    }
+    if (reader->slot < 0) {
+        errno = EAGAIN;
+        return -1;
+    }
+    // A writer that started before the pin was visible may reuse pages of
+    // the version loaded above, so pin the newest version until it holds
+    while (__atomic_load_n(&tree->txn_id, __ATOMIC_SEQ_CST) != reader->txn_id) {
+        load_version(tree, reader);
+        __atomic_store_n(&tree->readers[reader->slot], reader->txn_id, __ATOMIC_SEQ_CST);
+    }
+    return 0;
+}
+
+/*
+ * FUNCTION: btree_get
+ * ====================
+ * Looks up a record in the reader's version
+ *
+ * Returns:
+ *   - 0 if found, -1 otherwise
+ */
+int btree_get(const btree_reader_t *reader, int id, student_t *student) {
+    uint16_t length;
+    const unsigned char *value = find_value(reader->tree, NULL, reader->root, id, &length);
+    return value ? student_unpack(value, length, student) : -1;
+}
+
+/*
+ * FUNCTION: btree_scan
+ * =====================
+ * Visits the records with first_id <= ID <= last_id in ID order
+ *
+ * Returns:
+ *   - Number of records visited, or -1 if a record is damaged
+ */
+int btree_scan(const btree_reader_t *reader, int first_id, int last_id, btree_visit_fn visit, void *arg) {
+    if (reader->root == 0 || first_id > last_id) {
+        return 0;
+    }
+    return scan_rec(reader->tree, reader->root, first_id, last_id, visit, arg);
+}
+
+void btree_read_end(btree_reader_t *reader) {
+    if (reader->slot >= 0) {
+        __atomic_store_n(&reader->tree->readers[reader->slot], 0, __ATOMIC_RELEASE);
+        reader->slot = -1;
+    }
+}
+
+/*
+ * FUNCTION: btree_store
+ * ======================
+ * Writes one record in its own transaction
+ *
+ * Returns:
+ *   - 0 on success, -1 on error
+ */
+int btree_store(btree_t *tree, int id, const student_t *student) {
+    btree_txn_t txn;
+    btree_begin(tree, &txn);
+    if (btree_put(&txn, id, student) != 0) {
+        btree_abort(&txn);
+        return -1;
+    }
+    return btree_commit(&txn);
+}
+
+/*
+ * FUNCTION: btree_load
+ * =====================
+ * Reads one record from the last committed version
+ *
+ * Returns:
+ *   - 0 if found, -1 otherwise
+ */
+int btree_load(btree_t *tree, int id, student_t *student) {
+    btree_reader_t reader;
+    if (btree_read_begin(tree, &reader) != 0) {
+        return -1;
+    }
+    int rc = btree_get(&reader, id, student);
+    btree_read_end(&reader);
+    return rc;
+}
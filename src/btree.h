@@ -0,0 +1,144 @@
+/*
+ * ============================================================================
+ * COPY-ON-WRITE B+TREE STORE (data/students.db)
+ * ============================================================================
+ *
+ * A single-file alternative to one output_<id>.txt per student: a B+tree
+ * keyed by student_id whose leaves hold serialized student_t records.
+ * It gives point lookups, ordered range scans and crash safety without a
+ * write-ahead log.
+ *
+ * File layout (BTREE_PAGE_SIZE pages):
+ *
+ *     page 0, 1   meta pages: root page, page count, transaction ID,
+ *                 record count and a CRC32C of the meta itself
+ *     page 2...   branch and leaf pages
+ *
+ * Copy-on-write:
+ *   A write transaction never modifies a page reachable from the last
+ *   committed root. The first change to a page copies it to a free page
+ *   and the copy's parent is copied in turn, up to a new root. Commit
+ *   writes the new pages, fsyncs, then writes the meta page not used by
+ *   the previous commit and fsyncs again. A crash before the second
+ *   fsync leaves the previous meta, and with it the previous tree, intact;
+ *   open picks the valid meta with the highest transaction ID.
+ *
+ * Concurrency (as in LMDB):
+ *   - One process at a time: open takes an exclusive flock on the file
+ *     and fails (errno EWOULDBLOCK) while another holder has it open.
+ *   - One writer at a time (write_lock). Many puts can share one
+ *     transaction, so a bulk load pays the two fsyncs once.
+ *   - Readers take no lock. A reader pins the committed root it started
+ *     from in a reader slot and reads pages straight from a read-only
+ *     mapping of the file, so it sees one consistent version for as long
+ *     as it is open, whatever the writer does meanwhile.
+ *   - Pages replaced by commit T are only reused once no reader pinned a
+ *     version older than T. Free pages are not stored in the file: open
+ *     walks the tree and treats every unreachable page as free.
+ *
+ * Deleting keys removes empty pages but does not merge underfull ones.
+ * A serialized record must fit in BTREE_MAX_VALUE bytes, so names longer
+ * than a few hundred bytes are rejected (errno E2BIG).
+ *
+ * ============================================================================
+ */
+
+#ifndef BTREE_H
+#define BTREE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <pthread.h>
+#include "student.h"
+
+#define BTREE_PATH "data/students.db"
+#define BTREE_MAGIC "SDBTREE1"
+#define BTREE_FORMAT_VERSION 1
+#define BTREE_PAGE_SIZE 4096
+#define BTREE_MAX_READERS 64
+#define BTREE_MAX_VALUE 1024
+
+// Address space reserved for the mapping; the file can grow up to this
+#define BTREE_MAP_SIZE ((size_t)16 << 30)
+
+typedef struct {
+    uint32_t page;
+    uint64_t freed_txn;      // commit that replaced the page, 0 = at open
+} btree_free_t;
+
+typedef struct {
+    int fd;
+    const unsigned char *map;
+
+    // Last committed version; readers copy it under the seqlock
+    unsigned seq;
+    uint64_t txn_id;
+    uint32_t root;           // 0 = empty tree
+    uint64_t record_count;
+
+    // Version pinned by each open reader, 0 = free slot
+    uint64_t readers[BTREE_MAX_READERS];
+
+    // Writer state, guarded by write_lock
+    pthread_mutex_t write_lock;
+    uint32_t page_count;
+    btree_free_t *free_pages;    // oldest first
+    int free_head;
+    int free_count;
+    int free_capacity;
+} btree_t;
+
+typedef struct {
+    uint32_t page;
+    unsigned char *data;
+} btree_dirty_t;
+
+typedef struct {
+    btree_t *tree;
+    uint64_t txn_id;         // ID this transaction commits as
+    uint64_t oldest_reader;  // oldest version still pinned at begin
+    uint32_t root;
+    uint32_t page_count;
+    uint64_t record_count;
+    int free_head;           // tree->free_head at begin, for abort
+
+    btree_dirty_t *dirty;    // pages written by this transaction
+    int dirty_count;
+    int dirty_capacity;
+    int *dirty_slots;        // hash on page number: dirty index + 1
+    int dirty_slot_capacity;
+
+    uint32_t *freed;         // pages this transaction replaced
+    int freed_count;
+    int freed_capacity;
+} btree_txn_t;
+
+typedef struct {
+    btree_t *tree;
+    int slot;
+    uint64_t txn_id;
+    uint32_t root;
+    uint64_t record_count;
+} btree_reader_t;
+
+typedef void (*btree_visit_fn)(const student_t *student, void *arg);
+
+int btree_open(btree_t *tree, const char *path);
+void btree_close(btree_t *tree);
+
+int btree_begin(btree_t *tree, btree_txn_t *txn);
+int btree_put(btree_txn_t *txn, int id, const student_t *student);
+int btree_delete(btree_txn_t *txn, int id);
+int btree_txn_get(btree_txn_t *txn, int id, student_t *student);
+int btree_commit(btree_txn_t *txn);
+void btree_abort(btree_txn_t *txn);
+
+int btree_read_begin(btree_t *tree, btree_reader_t *reader);
+int btree_get(const btree_reader_t *reader, int id, student_t *student);
+int btree_scan(const btree_reader_t *reader, int first_id, int last_id, btree_visit_fn visit, void *arg);
+void btree_read_end(btree_reader_t *reader);
+
+int btree_store(btree_t *tree, int id, const student_t *student);
+int btree_load(btree_t *tree, int id, student_t *student);
+
+#endif
@@ -0,0 +1,240 @@
+/*
+ * ============================================================================
+ * REPORT CARD CACHE (data/cards/card_<id>.txt)
+ * ============================================================================
+ *
+ * See card.h for the entry format and invalidation rules.
+ *
+ * ============================================================================
+ */
+
+#include "card.h"
+#include "record.h"
+#include "crc32c.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include <errno.h>
+#include <sys/stat.h>
+
+/*
+ * FUNCTION: card_cache_path
+ * ==========================
+ * Builds the filename of a cached card (data/cards/card_[ID].txt)
+ */
+void card_cache_path(int id, char *buf, size_t size) {
+    snprintf(buf, size, "%s/card_%d.txt", CARD_CACHE_DIR, id);
+}
+
+// Size of the change log: grows with every save, so it versions the roster
+static long current_version(void) {
+    struct stat st;
+    return stat(RECORD_CHANGE_LOG, &st) == 0 ? (long)st.st_size : 0;
+}
+
+/*
+ * FUNCTION: card_record_version
+ * ==============================
+ * CRC32C of every field a card can show, so an entry is tied to the
+ * exact record it was rendered from
+ */
+uint32_t card_record_version(const student_t *student) {
+    const str_t *names[] = { &student->name, &student->family_name, &student->father_name,
+                             &student->mother_name, &student->subject1.name, &student->subject2.name,
+                             &student->subject3.name, &student->subject4.name };
+    const char *fixed[] = { student->studentid, student->dateofbirth, student->phone_number };
+    float grades[] = { student->subject1.grade, student->subject2.grade, student->subject3.grade,
+                       student->subject4.grade, student->average_grade };
+
+    uint32_t crc = crc32c(0, &student->student_id, sizeof(student->student_id));
+    crc = crc32c(crc, &student->grade, sizeof(student->grade));
+    crc = crc32c(crc, grades, sizeof(grades));
+    // Strings with their terminator, so adjacent values cannot run together
+    for (int i = 0; i < 8; i++) {
+        crc = crc32c(crc, str_get(names[i]), str_len(names[i]) + 1);
+    }
+    for (int i = 0; i < 3; i++) {
+        crc = crc32c(crc, fixed[i], strlen(fixed[i]) + 1);
+    }
+    return crc;
+}
+
+void card_cache_invalidate(int id) {
+    char path[128];
+    card_cache_path(id, path, sizeof(path));
+    remove(path);
+}
+
+static void on_commit(int id, const student_t *student, void *arg) {
+    (void)student;
+    (void)arg;
+    card_cache_invalidate(id);
+}
+
+/*
+ * FUNCTION: card_cache_attach
+ * ============================
+ * Drops a student's cached card whenever their record is saved
+ * Call before any writer thread starts.
+ *
+ * Returns:
+ *   - 0 on success, -1 if no commit hook slot is free
+ */
+int card_cache_attach(void) {
+    return record_add_commit_hook(on_commit, NULL);
+}
+
+void card_cache_detach(void) {
+    record_remove_commit_hook(on_commit, NULL);
+}
+
+/*
+ * FUNCTION: card_cache_get
+ * =========================
+ * Reads a cached card
+ *
+ * Parameters:
+ *   - student: the student's current record
+ *   - card: set to the card text, NUL-terminated; free with free()
+ *
+ * Returns:
+ *   - 0 on a hit, -1 if there is no entry for this template and record
+ *     version (and, for ranked templates, roster version)
+ */
+int card_cache_get(const report_template_t *tpl, const student_t *student, char **card, size_t *length) {
+    int id = student->student_id;
+    char path[128];
+    card_cache_path(id, path, sizeof(path));
+    FILE *file = fopen(path, "rb");
+    if (!file) {
+        return -1;
+    }
+    long size = -1;
+    if (fseek(file, 0, SEEK_END) == 0) {
+        size = ftell(file);
+        rewind(file);
+    }
+    char *data = size > 0 ? malloc((size_t)size + 1) : NULL;
+    int ok = data && fread(data, 1, (size_t)size, file) == (size_t)size;
+    fclose(file);
+    if (!ok) {
+        free(data);
+        return -1;
+    }
+    data[size] = '\0';
+
+    int entry_id;
+    uint64_t key;
+    uint32_t record_version;
+    long version;
+    int header = 0;
+    if (sscanf(data, "CARD %d %" SCNx64 " %" SCNx32 " %ld\n%n", &entry_id, &key, &record_version, &version,
+               &header) != 4 ||
+        header == 0 || entry_id != id || key != tpl->key || record_version != card_record_version(student) ||
+        (version >= 0 && version != current_version())) {
+        free(data);
+        return -1;
+    }
+    *length = (size_t)size - (size_t)header;
+    memmove(data, data + header, *length + 1);
+    *card = data;
+    return 0;
+}
+
+/*
+ * FUNCTION: card_cache_put
+ * =========================
+ * Stores a rendered card through a temporary file
+ *
+ * Parameters:
+ *   - student: the record the card was rendered from
+ *   - roster_version: change-log size taken before the card was rendered
+ *
+ * Returns:
+ *   - 0 on success, -1 if it could not be written or the roster changed
+ *     while the card was being rendered
+ */
+int card_cache_put(const report_template_t *tpl, const student_t *student, long roster_version,
+                   const char *card, size_t length) {
+    int id = student->student_id;
+    if (mkdir(CARD_CACHE_DIR, 0755) != 0 && errno != EEXIST) {
+        return -1;
+    }
+    char path[128];
+    char tempname[160];
+    card_cache_path(id, path, sizeof(path));
+    snprintf(tempname, sizeof(tempname), "%s.tmp", path);
+
+    FILE *file = fopen(tempname, "wb");
+    if (!file) {
+        return -1;
+    }
+    int ok = fprintf(file, "CARD %d %016" PRIx64 " %08" PRIx32 " %ld\n", id, tpl->key,
+                     card_record_version(student), tpl->ranked ? roster_version : -1L) > 0 &&
+             fwrite(card, 1, length, file) == length;
+    if (fclose(file) != 0) {
+        ok = 0;
+    }
+    // A save since rendering may already have invalidated this card
+    if (!ok || current_version() != roster_version || rename(tempname, path) != 0) {
+        remove(tempname);
+        return -1;
+    }
+    return 0;
+}
+
+/*
+ * FUNCTION: card_fetch
+ * =====================
+ * Returns a student's report card, from the cache when it is current
+ *
+ * Process:
+ *   1. Load the student's current record (record_load)
+ *   2. Cache hit: one read of data/cards/card_[ID].txt, served if it was
+ *      rendered from this version of the record
+ *   3. Miss: look the student's rank up in the class ranking view,
+ *      render the card from the loaded record and store it for next time
+ *
+ * Parameters:
+ *   - ranks: attached ranking view (studentdb_attach_ranks); only read
+ *     for templates that show a rank
+ *   - card: set to the card text, NUL-terminated; free with free()
+ *   - hit: set to 1 if the card came from the cache
+ *
+ * Returns:
+ *   - 0 on success, -1 if the student is not found or on error
+ */
+int card_fetch(const report_template_t *tpl, rank_view_t *ranks, int id, char **card, size_t *length, int *hit) {
+    *hit = 0;
+    long version = current_version();
+    student_t student;
+    if (record_load(id, &student) != 0) {
+        return -1;
+    }
+    student.student_id = id;
+    if (card_cache_get(tpl, &student, card, length) == 0) {
+        *hit = 1;
+        return 0;
+    }
+
+    report_stats_t stats = { 1, 0 };
+    if (tpl->ranked && rank_lookup(ranks, id, &stats.rank, &stats.class_size) != 0) {
+        return -1;
+    }
+
+    size_t n = report_render(tpl, &student, &stats, NULL, 0);
+    char *buf = malloc(n + 1);
+    if (buf) {
+        report_render(tpl, &student, &stats, buf, n + 1);
+    }
+    if (!buf) {
+        return -1;
+    }
+    // A failed store only costs a render next time
+    card_cache_put(tpl, &student, version, buf, n);
+    *card = buf;
+    *length = n;
+    return 0;
+}
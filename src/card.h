@@ -0,0 +1,51 @@
+/*
+ * ============================================================================
+ * REPORT CARD CACHE (data/cards/card_<id>.txt)
+ * ============================================================================
+ *
+ * Keeps the last rendered report card of each student so a repeat request
+ * is one file read instead of loading the roster and rendering again.
+ *
+ * An entry is the card preceded by one header line:
+ *
+ *     CARD <id> <template key> <record version> <roster version>
+ *
+ * The template key is report_template_t.key, so a card rendered from a
+ * different template is never served. The record version is a CRC32C of
+ * the student's fields as rendered (card_record_version); an entry is
+ * only served while the current record still has that version, for every
+ * template. The roster version is the size of data/changes.log when the
+ * card was rendered; it is an extra key only for templates that show a
+ * rank (-1 otherwise), because a classmate's edit changes the rank on
+ * every card in the class.
+ *
+ * card_cache_attach also registers a record_commit hook that deletes a
+ * student's entry on every save, so stale entries do not linger on disk.
+ *
+ * ============================================================================
+ */
+
+#ifndef CARD_H
+#define CARD_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "report.h"
+#include "rank.h"
+
+#define CARD_CACHE_DIR "data/cards"
+
+void card_cache_path(int id, char *buf, size_t size);
+
+int card_cache_attach(void);
+void card_cache_detach(void);
+void card_cache_invalidate(int id);
+
+uint32_t card_record_version(const student_t *student);
+int card_cache_get(const report_template_t *tpl, const student_t *student, char **card, size_t *length);
+int card_cache_put(const report_template_t *tpl, const student_t *student, long roster_version,
+                   const char *card, size_t length);
+
+int card_fetch(const report_template_t *tpl, rank_view_t *ranks, int id, char **card, size_t *length, int *hit);
+
+#endif
@@ -0,0 +1,344 @@
+/*
+ * ============================================================================
+ * COMMAND STREAM (app run)
+ * ============================================================================
+ *
+ * See command.h for the command language. Responses are flushed
+ * whenever the input runs dry, so a script can drive `app run` over a
+ * pipe one command at a time and read each response before sending the
+ * next, while a file or a fast writer gets its commands batched.
+ *
+ * ============================================================================
+ */
+
+#include "command.h"
+#include "csv.h"
+#include "validate.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <stdint.h>
+#include <unistd.h>
+
+#define VALUE_MAX 256
+
+typedef struct {
+    studentdb_t *db;
+    FILE *out;
+    int failed;
+    student_t adds[COMMAND_ADD_BATCH];
+    long add_lines[COMMAND_ADD_BATCH];
+    int add_count;
+} command_state_t;
+
+static void report_error(command_state_t *state, long line, const char *message) {
+    fprintf(state->out, "error %ld: %s\n", line, message);
+    state->failed++;
+}
+
+// Saves the queued adds in one batch and answers each of them in order
+static void flush_adds(command_state_t *state) {
+    if (state->add_count == 0) {
+        return;
+    }
+    int first_id = studentdb_create_many(state->db, state->adds, state->add_count);
+    for (int i = 0; i < state->add_count; i++) {
+        if (first_id < 0) {
+            report_error(state, state->add_lines[i], "could not save the student");
+        } else {
+            fprintf(state->out, "ok %d\n", first_id + i);
+        }
+    }
+    state->add_count = 0;
+}
+
+static void field_text(const csv_field_t *field, char *buf) {
+    csv_field_copy(field, buf, VALUE_MAX);
+}
+
+// Parses a whole field as an int; 0 on success
+static int field_int(const csv_field_t *field, int *value) {
+    char buf[VALUE_MAX];
+    field_text(field, buf);
+    char *end;
+    errno = 0;
+    long number = strtol(buf, &end, 10);
+    if (errno != 0 || end == buf || *end != '\0' || number < INT32_MIN || number > INT32_MAX) {
+        return -1;
+    }
+    *value = (int)number;
+    return 0;
+}
+
+static void command_add(command_state_t *state, long line, const csv_field_t *fields, int count) {
+    if (count != STUDENTDB_COLUMNS + 1) {
+        flush_adds(state);
+        report_error(state, line, "add takes 16 columns");
+        return;
+    }
+    char values[STUDENTDB_COLUMNS][VALUE_MAX];
+    const char *columns[STUDENTDB_COLUMNS];
+    for (int i = 0; i < STUDENTDB_COLUMNS; i++) {
+        field_text(&fields[1 + i], values[i]);
+        columns[i] = values[i];
+    }
+    char message[VALUE_MAX];
+    if (studentdb_parse_columns(&state->adds[state->add_count], columns, message, sizeof(message)) != 0) {
+        flush_adds(state);
+        report_error(state, line, message);
+        return;
+    }
+    state->add_lines[state->add_count++] = line;
+    if (state->add_count == COMMAND_ADD_BATCH) {
+        flush_adds(state);
+    }
+}
+
+static void command_edit(command_state_t *state, long line, const csv_field_t *fields, int count) {
+    int id;
+    field_t field;
+    char name[VALUE_MAX];
+    char value[VALUE_MAX];
+    if (count != 4 || field_int(&fields[1], &id) != 0) {
+        report_error(state, line, "usage: edit,ID,FIELD,VALUE");
+        return;
+    }
+    field_text(&fields[2], name);
+    field_text(&fields[3], value);
+    if (studentdb_field_by_name(name, &field) != 0) {
+        report_error(state, line, "unknown field");
+        return;
+    }
+    const char *error = validate_field(field, value);
+    if (error != NULL) {
+        report_error(state, line, error);
+        return;
+    }
+    int result = studentdb_update(state->db, id, field, value);
+    if (result < 0) {
+        report_error(state, line, "no such student");
+        return;
+    }
+    fprintf(state->out, "ok\n");
+    if (result == 1) {
+        // The grade is saved, so this is not an error line; it still counts as a failure
+        fprintf(state->out, "warning %ld: the grade history could not be updated\n", line);
+        state->failed++;
+    }
+}
+
+// Writes one CSV field, quoted if it contains a separator, quote or newline
+static void put_field(FILE *out, const char *text) {
+    if (strpbrk(text, ",\"\r\n") == NULL) {
+        fputs(text, out);
+        return;
+    }
+    fputc('"', out);
+    for (const char *p = text; *p; p++) {
+        if (*p == '"') {
+            fputc('"', out);
+        }
+        fputc(*p, out);
+    }
+    fputc('"', out);
+}
+
+// One record line: ID, the add columns, then the average grade
+static void put_student(FILE *out, const student_t *s) {
+    const subject_t *subjects[] = { &s->subject1, &s->subject2, &s->subject3, &s->subject4 };
+    const char *texts[] = {
+        str_get(&s->name), str_get(&s->family_name), s->dateofbirth, s->studentid,
+        str_get(&s->father_name), str_get(&s->mother_name), s->phone_number,
+    };
+    fprintf(out, "%d", s->student_id);
+    for (size_t i = 0; i < sizeof(texts) / sizeof(texts[0]); i++) {
+        fputc(',', out);
+        put_field(out, texts[i]);
+    }
+    fprintf(out, ",%d", s->grade);
+    for (int i = 0; i < 4; i++) {
+        fputc(',', out);
+        put_field(out, str_get(&subjects[i]->name));
+        fprintf(out, ",%g", subjects[i]->grade);
+    }
+    fprintf(out, ",%.2f\n", s->average_grade);
+}
+
+static void command_get(command_state_t *state, long line, const csv_field_t *fields, int count) {
+    int id;
+    student_t student;
+    if (count != 2 || field_int(&fields[1], &id) != 0) {
+        report_error(state, line, "usage: get,ID");
+        return;
+    }
+    if (studentdb_get(state->db, id, &student) < 0) {
+        report_error(state, line, "no such student");
+        return;
+    }
+    fprintf(state->out, "ok 1\n");
+    put_student(state->out, &student);
+}
+
+static void command_rank(command_state_t *state, long line, const csv_field_t *fields, int count) {
+    int id;
+    int rank;
+    int class_size;
+    if (count != 2 || field_int(&fields[1], &id) != 0) {
+        report_error(state, line, "usage: rank,ID");
+        return;
+    }
+    if (studentdb_rank(state->db, id, &rank, &class_size) < 0) {
+        report_error(state, line, "no such student");
+        return;
+    }
+    fprintf(state->out, "ok %d %d\n", rank, class_size);
+}
+
+static int in_class(const student_t *student, void *arg) {
+    return student->grade == *(const int *)arg;
+}
+
+static void command_query(command_state_t *state, long line, const csv_field_t *fields, int count) {
+    int first_id = 1;
+    int last_id = INT32_MAX;
+    int klass = 0;
+    int ok = count == 1 || count == 3 || count == 4;
+    if (ok && count >= 3) {
+        ok = field_int(&fields[1], &first_id) == 0 && field_int(&fields[2], &last_id) == 0;
+    }
+    if (ok && count == 4) {
+        ok = field_int(&fields[3], &klass) == 0;
+    }
+    if (!ok) {
+        report_error(state, line, "usage: query[,FROM,TO[,CLASS]]");
+        return;
+    }
+    student_t *results;
+    int found = studentdb_query(state->db, first_id, last_id, count == 4 ? in_class : NULL, &klass, &results);
+    if (found < 0) {
+        report_error(state, line, "could not read the store");
+        return;
+    }
+    fprintf(state->out, "ok %d\n", found);
+    for (int i = 0; i < found; i++) {
+        put_student(state->out, &results[i]);
+    }
+    free(results);
+}
+
+static void run_line(command_state_t *state, long line, const char *text, size_t length) {
+    csv_reader_t reader;
+    csv_field_t fields[COMMAND_MAX_FIELDS];
+    csv_reader_init(&reader, text, length, ',', CSV_KERNEL_AUTO);
+    int count = csv_next_row(&reader, fields, COMMAND_MAX_FIELDS);
+    if (count > COMMAND_MAX_FIELDS) {
+        flush_adds(state);
+        report_error(state, line, "too many columns");
+        return;
+    }
+
+    char verb[16];
+    csv_field_copy(&fields[0], verb, sizeof(verb));
+    if (strcmp(verb, "add") == 0) {
+        command_add(state, line, fields, count);
+        return;
+    }
+    flush_adds(state);
+    if (strcmp(verb, "edit") == 0) {
+        command_edit(state, line, fields, count);
+    } else if (strcmp(verb, "get") == 0) {
+        command_get(state, line, fields, count);
+    } else if (strcmp(verb, "query") == 0) {
+        command_query(state, line, fields, count);
+    } else if (strcmp(verb, "rank") == 0) {
+        command_rank(state, line, fields, count);
+    } else {
+        report_error(state, line, "unknown command");
+    }
+}
+
+/*
+ * FUNCTION: command_run
+ * ======================
+ * Executes the commands read from fd, writing one response per command
+ * to out (see command.h)
+ * Input is read in COMMAND_READ_SIZE chunks; all complete lines in a
+ * chunk run before the next read, and queued adds and responses are
+ * flushed before any read that may block.
+ *
+ * Returns:
+ *   - The number of commands that failed, or -1 if fd could not be read
+ */
+int command_run(studentdb_t *db, int fd, FILE *out) {
+    command_state_t *state = malloc(sizeof(*state));
+    size_t capacity = COMMAND_READ_SIZE;
+    char *buf = malloc(capacity);
+    if (!state || !buf) {
+        free(state);
+        free(buf);
+        return -1;
+    }
+    state->db = db;
+    state->out = out;
+    state->failed = 0;
+    state->add_count = 0;
+
+    size_t used = 0;
+    long line = 0;
+    int ok = 1;
+    for (;;) {
+        flush_adds(state);
+        fflush(out);
+        if (used == capacity) {
+            char *grown = realloc(buf, capacity * 2);
+            if (!grown) {
+                ok = 0;
+                break;
+            }
+            buf = grown;
+            capacity *= 2;
+        }
+        ssize_t got = read(fd, buf + used, capacity - used);
+        if (got < 0 && errno == EINTR) {
+            continue;
+        }
+        if (got < 0) {
+            ok = 0;
+            break;
+        }
+        // At end of input a last line without '\n' still runs
+        size_t end = used + (size_t)got;
+        size_t start = 0;
+        for (size_t i = used; i < end || (got == 0 && start < end); i++) {
+            if (i < end && buf[i] != '\n') {
+                continue;
+            }
+            line++;
+            size_t length = i - start;
+            while (length > 0 && buf[start + length - 1] == '\r') {
+                length--;
+            }
+            size_t skip = 0;
+            while (skip < length && (buf[start + skip] == ' ' || buf[start + skip] == '\t')) {
+                skip++;
+            }
+            if (length > skip && buf[start + skip] != '#') {
+                run_line(state, line, buf + start + skip, length - skip);
+            }
+            start = i + 1;
+        }
+        if (got == 0) {
+            break;
+        }
+        memmove(buf, buf + start, end - start);
+        used = end - start;
+    }
+    flush_adds(state);
+    fflush(out);
+    free(buf);
+    int failed = state->failed;
+    free(state);
+    return ok ? failed : -1;
+}
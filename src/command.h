@@ -0,0 +1,57 @@
+/*
+ * ============================================================================
+ * COMMAND STREAM (app run)
+ * ============================================================================
+ *
+ * Runs many commands in one process, for scripts that would otherwise
+ * start `app` once per operation and answer its prompts. Each input line
+ * is one command, written as a CSV row (csv.h; quote fields containing
+ * commas). Blank lines and lines starting with '#' are skipped.
+ *
+ *     add,NAME,FAMILY,DOB,STUDENT_ID,FATHER,MOTHER,PHONE,CLASS,
+ *         SUBJECT1,GRADE1,SUBJECT2,GRADE2,SUBJECT3,GRADE3,SUBJECT4,GRADE4
+ *                         columns as for `app import` (import.h)
+ *     edit,ID,FIELD,VALUE FIELD is a number from the edit menu or one of
+ *                         name, family_name, dob, father_name,
+ *                         mother_name, phone, grade, subject1_grade ...
+ *                         subject4_grade
+ *     get,ID
+ *     query[,FROM,TO[,CLASS]]
+ *     rank,ID                 needs the ranking view attached
+ *                             (studentdb_attach_ranks)
+ *
+ * Every command gets one response line, in input order:
+ *
+ *     ok ID                   add
+ *     ok                      edit
+ *     ok 1 / ok N             get / query, followed by 1 or N record lines:
+ *                             ID, the add columns, then the average
+ *     ok RANK CLASS_SIZE      rank, within the student's class level
+ *     error LINE: MESSAGE     nothing was changed by this command
+ *
+ * An edit whose grade was saved but whose grade history (history.h)
+ * could not be updated answers "ok" followed by one extra line,
+ * "warning LINE: MESSAGE", and counts as a failed command.
+ *
+ * Consecutive adds are queued (up to COMMAND_ADD_BATCH) and saved with
+ * studentdb_create_many, so a run of adds pays for one counter write and
+ * one sync. The queue is flushed before any other command, so a get or
+ * query always sees the adds before it, and before each read of more
+ * input, so a script waiting on a response is never left hanging.
+ *
+ * ============================================================================
+ */
+
+#ifndef COMMAND_H
+#define COMMAND_H
+
+#include <stdio.h>
+#include "studentdb.h"
+
+#define COMMAND_ADD_BATCH 256
+#define COMMAND_MAX_FIELDS 20
+#define COMMAND_READ_SIZE 65536
+
+int command_run(studentdb_t *db, int fd, FILE *out);
+
+#endif
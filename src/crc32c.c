@@ -0,0 +1,144 @@
+/*
+ * ============================================================================
+ * CRC32C (CASTAGNOLI) CHECKSUMS
+ * ============================================================================
+ *
+ * See crc32c.h.
+ *
+ * ============================================================================
+ */
+
+#include "crc32c.h"
+
+#include <pthread.h>
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define CRC32C_X86 1
+#endif
+
+#define POLY 0x82F63B78u   // reflected Castagnoli polynomial
+
+/*
+ * Slicing-by-8 Tables
+ * ===================
+ * table[0] is the classic byte-at-a-time table; table[k][b] is the CRC of
+ * byte b followed by k zero bytes, so eight bytes fold in with eight
+ * lookups and no per-bit work.
+ */
+static uint32_t table[8][256];
+static pthread_once_t table_once = PTHREAD_ONCE_INIT;
+
+static void init_table(void) {
+    for (uint32_t b = 0; b < 256; b++) {
+        uint32_t crc = b;
+        for (int i = 0; i < 8; i++) {
+            crc = (crc >> 1) ^ (POLY & -(crc & 1));
+        }
+        table[0][b] = crc;
+    }
+    for (uint32_t b = 0; b < 256; b++) {
+        for (int k = 1; k < 8; k++) {
+            table[k][b] = (table[k - 1][b] >> 8) ^ table[0][table[k - 1][b] & 0xFF];
+        }
+    }
+}
+
+static uint32_t crc32c_scalar(uint32_t crc, const unsigned char *p, size_t length) {
+    pthread_once(&table_once, init_table);
+    while (length >= 8) {
+        uint32_t lo;
+        uint32_t hi;
+        memcpy(&lo, p, 4);
+        memcpy(&hi, p + 4, 4);
+        lo ^= crc;   // little-endian byte order
+        crc = table[7][lo & 0xFF] ^ table[6][(lo >> 8) & 0xFF] ^
+              table[5][(lo >> 16) & 0xFF] ^ table[4][lo >> 24] ^
+              table[3][hi & 0xFF] ^ table[2][(hi >> 8) & 0xFF] ^
+              table[1][(hi >> 16) & 0xFF] ^ table[0][hi >> 24];
+        p += 8;
+        length -= 8;
+    }
+    while (length--) {
+        crc = (crc >> 8) ^ table[0][(crc ^ *p++) & 0xFF];
+    }
+    return crc;
+}
+
+#ifdef CRC32C_X86
+__attribute__((target("sse4.2")))
+static uint32_t crc32c_sse42(uint32_t crc, const unsigned char *p, size_t length) {
+#ifdef __x86_64__
+    uint64_t crc64 = crc;
+    while (length >= 8) {
+        uint64_t word;
+        memcpy(&word, p, 8);
+        crc64 = _mm_crc32_u64(crc64, word);
+        p += 8;
+        length -= 8;
+    }
+    crc = (uint32_t)crc64;
+#endif
+    while (length >= 4) {
+        uint32_t word;
+        memcpy(&word, p, 4);
+        crc = _mm_crc32_u32(crc, word);
+        p += 4;
+        length -= 4;
+    }
+    while (length--) {
+        crc = _mm_crc32_u8(crc, *p++);
+    }
+    return crc;
+}
+#endif
+
+/*
+ * FUNCTION: crc32c_kernel_supported
+ * ==================================
+ * Returns 1 if this build and CPU can run the given kernel
+ */
+int crc32c_kernel_supported(crc32c_kernel_t kernel) {
+    switch (kernel) {
+    case CRC32C_KERNEL_AUTO:
+    case CRC32C_KERNEL_SCALAR:
+        return 1;
+#ifdef CRC32C_X86
+    case CRC32C_KERNEL_SSE42:
+        return __builtin_cpu_supports("sse4.2");
+#else
+    default:
+        return 0;
+#endif
+    }
+    return 0;
+}
+
+const char *crc32c_kernel_name(crc32c_kernel_t kernel) {
+    static const char *names[] = { "auto", "scalar", "sse4.2" };
+    return names[kernel];
+}
+
+/*
+ * FUNCTION: crc32c_with
+ * ======================
+ * Continues a CRC32C with a specific kernel (an unsupported choice falls
+ * back to the fastest supported one)
+ */
+uint32_t crc32c_with(crc32c_kernel_t kernel, uint32_t crc, const void *data, size_t length) {
+    if (kernel == CRC32C_KERNEL_AUTO || !crc32c_kernel_supported(kernel)) {
+        kernel = crc32c_kernel_supported(CRC32C_KERNEL_SSE42) ? CRC32C_KERNEL_SSE42 : CRC32C_KERNEL_SCALAR;
+    }
+    crc = ~crc;
+#ifdef CRC32C_X86
+    if (kernel == CRC32C_KERNEL_SSE42) {
+        return ~crc32c_sse42(crc, data, length);
+    }
+#endif
+    return ~crc32c_scalar(crc, data, length);
+}
+
+uint32_t crc32c(uint32_t crc, const void *data, size_t length) {
+    return crc32c_with(CRC32C_KERNEL_AUTO, crc, data, length);
+}
@@ -0,0 +1,35 @@
+/*
+ * ============================================================================
+ * CRC32C (CASTAGNOLI) CHECKSUMS
+ * ============================================================================
+ *
+ * Checksums for record files. CRC32C is the polynomial the SSE4.2 crc32
+ * instruction computes, so on x86 a record is checksummed 8 bytes per
+ * instruction. Elsewhere a table-driven kernel (slicing-by-8) computes
+ * the same value. The best kernel the CPU supports is picked at runtime.
+ *
+ * crc32c(0, data, n) is the standard CRC32C of data; passing a previous
+ * result as crc continues the checksum over more bytes.
+ *
+ * ============================================================================
+ */
+
+#ifndef CRC32C_H
+#define CRC32C_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+typedef enum {
+    CRC32C_KERNEL_AUTO,
+    CRC32C_KERNEL_SCALAR,
+    CRC32C_KERNEL_SSE42
+} crc32c_kernel_t;
+
+uint32_t crc32c(uint32_t crc, const void *data, size_t length);
+uint32_t crc32c_with(crc32c_kernel_t kernel, uint32_t crc, const void *data, size_t length);
+
+int crc32c_kernel_supported(crc32c_kernel_t kernel);
+const char *crc32c_kernel_name(crc32c_kernel_t kernel);
+
+#endif
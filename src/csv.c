@@ -0,0 +1,309 @@
+/*
+ * ============================================================================
+ * CSV / TSV FIELD SPLITTER
+ * ============================================================================
+ *
+ * See csv.h for the format and the block-scanning approach.
+ *
+ * ============================================================================
+ */
+
+#include "csv.h"
+
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define CSV_X86 1
+#endif
+
+#define BLOCK_SIZE 64
+
+/*
+ * Block Kernels
+ * =============
+ * Each returns a mask with bit i set when block[i] is the separator, a
+ * quote, '\n' or '\r'. block always has 64 readable bytes.
+ */
+static uint64_t classify_scalar(const char *block, char separator) {
+    uint64_t mask = 0;
+    for (int i = 0; i < BLOCK_SIZE; i++) {
+        char c = block[i];
+        if (c == separator || c == '"' || c == '\n' || c == '\r') {
+            mask |= 1ULL << i;
+        }
+    }
+    return mask;
+}
+
+#ifdef CSV_X86
+__attribute__((target("sse2")))
+static uint64_t classify_sse2(const char *block, char separator) {
+    const __m128i sep = _mm_set1_epi8(separator);
+    const __m128i quote = _mm_set1_epi8('"');
+    const __m128i lf = _mm_set1_epi8('\n');
+    const __m128i cr = _mm_set1_epi8('\r');
+    uint64_t mask = 0;
+
+    for (int i = 0; i < BLOCK_SIZE; i += 16) {
+        __m128i bytes = _mm_loadu_si128((const __m128i *)(block + i));
+        __m128i hits = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(bytes, sep), _mm_cmpeq_epi8(bytes, quote)),
+                                    _mm_or_si128(_mm_cmpeq_epi8(bytes, lf), _mm_cmpeq_epi8(bytes, cr)));
+        mask |= (uint64_t)(uint16_t)_mm_movemask_epi8(hits) << i;
+    }
+    return mask;
+}
+
+__attribute__((target("avx2")))
+static uint64_t classify_avx2(const char *block, char separator) {
+    const __m256i sep = _mm256_set1_epi8(separator);
+    const __m256i quote = _mm256_set1_epi8('"');
+    const __m256i lf = _mm256_set1_epi8('\n');
+    const __m256i cr = _mm256_set1_epi8('\r');
+    uint64_t mask = 0;
+
+    for (int i = 0; i < BLOCK_SIZE; i += 32) {
+        __m256i bytes = _mm256_loadu_si256((const __m256i *)(block + i));
+        __m256i hits = _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(bytes, sep), _mm256_cmpeq_epi8(bytes, quote)),
+                                       _mm256_or_si256(_mm256_cmpeq_epi8(bytes, lf), _mm256_cmpeq_epi8(bytes, cr)));
+        mask |= (uint64_t)(uint32_t)_mm256_movemask_epi8(hits) << i;
+    }
+    return mask;
+}
+#endif
+
+/*
+ * FUNCTION: csv_kernel_supported
+ * ===============================
+ * Returns 1 if this build and CPU can run the given kernel
+ */
+int csv_kernel_supported(csv_kernel_t kernel) {
+    switch (kernel) {
+    case CSV_KERNEL_AUTO:
+    case CSV_KERNEL_SCALAR:
+        return 1;
+#ifdef CSV_X86
+    case CSV_KERNEL_SSE2:
+        return __builtin_cpu_supports("sse2");
+    case CSV_KERNEL_AVX2:
+        return __builtin_cpu_supports("avx2");
+#else
+    default:
+        return 0;
+#endif
+    }
+    return 0;
+}
+
+const char *csv_kernel_name(csv_kernel_t kernel) {
+    static const char *names[] = { "auto", "scalar", "sse2", "avx2" };
+    return names[kernel];
+}
+
+static csv_kernel_t best_kernel(void) {
+    if (csv_kernel_supported(CSV_KERNEL_AVX2)) {
+        return CSV_KERNEL_AVX2;
+    }
+    if (csv_kernel_supported(CSV_KERNEL_SSE2)) {
+        return CSV_KERNEL_SSE2;
+    }
+    return CSV_KERNEL_SCALAR;
+}
+
+/*
+ * FUNCTION: csv_reader_init
+ * ==========================
+ * Prepares to split a buffer into rows
+ *
+ * Parameters:
+ *   - reader: Reader to initialize
+ *   - data, size: The buffer; it must stay valid while fields are in use
+ *   - separator: ',' for CSV, '\t' for TSV
+ *   - kernel: Block kernel, or CSV_KERNEL_AUTO for the fastest supported
+ *             (an unsupported choice also falls back to that)
+ */
+void csv_reader_init(csv_reader_t *reader, const char *data, size_t size, char separator, csv_kernel_t kernel) {
+    if (kernel == CSV_KERNEL_AUTO || !csv_kernel_supported(kernel)) {
+        kernel = best_kernel();
+    }
+
+    memset(reader, 0, sizeof(*reader));
+    reader->data = data;
+    reader->size = size;
+    reader->line = 1;
+    reader->separator = separator;
+    reader->kernel = kernel;
+    reader->block = SIZE_MAX;
+    reader->classify = classify_scalar;
+#ifdef CSV_X86
+    if (kernel == CSV_KERNEL_SSE2) {
+        reader->classify = classify_sse2;
+    } else if (kernel == CSV_KERNEL_AVX2) {
+        reader->classify = classify_avx2;
+    }
+#endif
+}
+
+static uint64_t classify_block(csv_reader_t *reader, size_t base) {
+    if (base + BLOCK_SIZE <= reader->size) {
+        return reader->classify(reader->data + base, reader->separator);
+    }
+
+    // Last partial block: pad with bytes that can never be special
+    char padded[BLOCK_SIZE];
+    size_t tail = reader->size - base;
+    memcpy(padded, reader->data + base, tail);
+    memset(padded + tail, reader->separator == 'x' ? 'y' : 'x', BLOCK_SIZE - tail);
+    return reader->classify(padded, reader->separator);
+}
+
+/*
+ * Returns the offset of the first special byte at or after from, or
+ * reader->size if there is none. The current block's mask is cached, so
+ * walking forward through one block classifies it only once.
+ */
+static size_t next_special(csv_reader_t *reader, size_t from) {
+    while (from < reader->size) {
+        size_t base = from & ~(size_t)(BLOCK_SIZE - 1);
+        if (base != reader->block) {
+            reader->block = base;
+            reader->mask = classify_block(reader, base);
+        }
+        uint64_t mask = reader->mask & (~0ULL << (from - base));
+        if (mask) {
+            return base + (size_t)__builtin_ctzll(mask);
+        }
+        from = base + BLOCK_SIZE;
+    }
+    return reader->size;
+}
+
+/*
+ * FUNCTION: csv_next_row
+ * =======================
+ * Splits the next row into field views
+ *
+ * Parameters:
+ *   - reader: Reader positioned by csv_reader_init or a previous call
+ *   - fields: Receives up to max_fields views
+ *   - max_fields: Capacity of fields
+ *
+ * Returns:
+ *   - The number of fields in the row (may exceed max_fields; the extra
+ *     ones are counted but not stored), or -1 at the end of the buffer.
+ *     An empty line is one empty field. reader->row_line is its line.
+ */
+int csv_next_row(csv_reader_t *reader, csv_field_t *fields, int max_fields) {
+    const char *data = reader->data;
+    size_t size = reader->size;
+    size_t pos = reader->pos;
+    int count = 0;
+
+    if (pos >= size) {
+        return -1;
+    }
+    reader->row_line = reader->line;
+
+    for (;;) {
+        size_t start = pos;
+        size_t end;
+        int escaped = 0;
+
+        if (data[pos] == '"') {
+            start = ++pos;
+            for (;;) {
+                size_t hit = next_special(reader, pos);
+                if (hit >= size) {
+                    end = pos = size;  // unterminated quote runs to the end
+                    break;
+                }
+                if (data[hit] == '\n') {
+                    reader->line++;
+                }
+                if (data[hit] == '"') {
+                    if (hit + 1 < size && data[hit + 1] == '"') {
+                        escaped = 1;
+                        pos = hit + 2;
+                        continue;
+                    }
+                    end = hit;
+                    pos = hit + 1;
+                    break;
+                }
+                pos = hit + 1;  // separator or newline inside the quotes
+            }
+            // Ignore anything between the closing quote and the separator
+            while ((pos = next_special(reader, pos)) < size && data[pos] == '"') {
+                pos++;
+            }
+        } else {
+            // A stray quote inside an unquoted field is ordinary text
+            while ((pos = next_special(reader, pos)) < size && data[pos] == '"') {
+                pos++;
+            }
+            end = pos;
+        }
+
+        if (count < max_fields) {
+            fields[count].data = data + start;
+            fields[count].length = end - start;
+            fields[count].escaped = escaped;
+        }
+        count++;
+
+        if (pos >= size) {
+            reader->pos = size;
+            return count;
+        }
+        if (data[pos] == reader->separator) {
+            pos++;
+            if (pos >= size) {
+                // Trailing separator at the very end: one last empty field
+                if (count < max_fields) {
+                    fields[count].data = data + pos;
+                    fields[count].length = 0;
+                    fields[count].escaped = 0;
+                }
+                reader->pos = size;
+                return count + 1;
+            }
+            continue;
+        }
+
+        if (data[pos] == '\r' && pos + 1 < size && data[pos + 1] == '\n') {
+            pos++;
+        }
+        reader->pos = pos + 1;
+        reader->line++;
+        return count;
+    }
+}
+
+/*
+ * FUNCTION: csv_field_copy
+ * =========================
+ * Copies a field into a NUL-terminated buffer, turning "" into ",
+ * truncating to size - 1 bytes
+ *
+ * Returns:
+ *   - The number of bytes copied (excluding the NUL)
+ */
+size_t csv_field_copy(const csv_field_t *field, char *dest, size_t size) {
+    size_t out = 0;
+    if (size == 0) {
+        return 0;
+    }
+    if (!field->escaped) {
+        out = field->length < size - 1 ? field->length : size - 1;
+        memcpy(dest, field->data, out);
+    } else {
+        for (size_t i = 0; i < field->length && out < size - 1; i++) {
+            dest[out++] = field->data[i];
+            if (field->data[i] == '"' && i + 1 < field->length && field->data[i + 1] == '"') {
+                i++;
+            }
+        }
+    }
+    dest[out] = '\0';
+    return out;
+}
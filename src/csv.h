@@ -0,0 +1,65 @@
+/*
+ * ============================================================================
+ * CSV / TSV FIELD SPLITTER
+ * ============================================================================
+ *
+ * Splits an in-memory buffer (usually an mmapped file) into rows of
+ * fields. Fields are returned as views into the buffer, so nothing is
+ * copied until a value is stored into its student_t field.
+ *
+ * The buffer is scanned in 64-byte blocks: a kernel turns each block into
+ * a bitmask of the bytes the splitter cares about (separator, '"', '\n',
+ * '\r'), and the splitter jumps from set bit to set bit instead of looking
+ * at every byte. Kernels exist for AVX2, SSE2 and plain C; the best one
+ * the CPU supports is picked at runtime.
+ *
+ * Quoting follows RFC 4180: a quoted field may contain separators and
+ * newlines, and "" stands for a literal quote. Rows end at \n, \r\n or \r.
+ *
+ * ============================================================================
+ */
+
+#ifndef CSV_H
+#define CSV_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+typedef enum {
+    CSV_KERNEL_AUTO,
+    CSV_KERNEL_SCALAR,
+    CSV_KERNEL_SSE2,
+    CSV_KERNEL_AVX2
+} csv_kernel_t;
+
+/*
+ * One field. data/length exclude the surrounding quotes; escaped is set
+ * when the field still contains "" pairs (use csv_field_copy to undo them).
+ */
+typedef struct {
+    const char *data;
+    size_t length;
+    int escaped;
+} csv_field_t;
+
+typedef struct {
+    const char *data;
+    size_t size;
+    size_t pos;            // start of the next row
+    long line;             // line number the next row starts on
+    long row_line;         // line number of the row last returned
+    char separator;
+    csv_kernel_t kernel;
+    uint64_t (*classify)(const char *block, char separator);
+    size_t block;          // offset of the block described by mask
+    uint64_t mask;
+} csv_reader_t;
+
+void csv_reader_init(csv_reader_t *reader, const char *data, size_t size, char separator, csv_kernel_t kernel);
+int csv_next_row(csv_reader_t *reader, csv_field_t *fields, int max_fields);
+size_t csv_field_copy(const csv_field_t *field, char *dest, size_t size);
+
+int csv_kernel_supported(csv_kernel_t kernel);
+const char *csv_kernel_name(csv_kernel_t kernel);
+
+#endif
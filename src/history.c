@@ -0,0 +1,489 @@
+/*
+ * ============================================================================
+ * TERM-BY-TERM GRADE HISTORY (history_<id>.bin)
+ * ============================================================================
+ *
+ * See history.h for the encoding.
+ *
+ * ============================================================================
+ */
+
+#include "history.h"
+#include "record.h"
+#include "mem.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <pthread.h>
+
+#define COLUMNS (1 + HISTORY_SUBJECTS)   // term numbers, then the subjects
+
+/*
+ * FUNCTION: history_path
+ * =======================
+ * Builds the filename of a student's history (history_[ID].bin)
+ */
+void history_path(int id, char *buf, size_t size) {
+    snprintf(buf, size, "history_%d.bin", id);
+}
+
+/*
+ * Varint / Zigzag
+ * ===============
+ * Deltas are small signed numbers; zigzag maps them to small unsigned
+ * ones (0, -1, 1, -2 ... -> 0, 1, 2, 3 ...) and the varint stores 7 bits
+ * per byte, so a typical delta takes one byte.
+ */
+static uint32_t zigzag(int32_t v) {
+    return ((uint32_t)v << 1) ^ (uint32_t)(v >> 31);
+}
+
+static int32_t unzigzag(uint32_t v) {
+    return (int32_t)(v >> 1) ^ -(int32_t)(v & 1);
+}
+
+static unsigned char *write_varint(unsigned char *p, uint32_t v) {
+    while (v >= 0x80) {
+        *p++ = (unsigned char)(v | 0x80);
+        v >>= 7;
+    }
+    *p++ = (unsigned char)v;
+    return p;
+}
+
+static const unsigned char *read_varint(const unsigned char *p, const unsigned char *end, uint32_t *v) {
+    uint32_t value = 0;
+    for (int shift = 0; p < end && shift < 35; shift += 7) {
+        unsigned char byte = *p++;
+        value |= (uint32_t)(byte & 0x7F) << shift;
+        if (!(byte & 0x80)) {
+            *v = value;
+            return p;
+        }
+    }
+    return NULL;
+}
+
+static int32_t to_fixed(float grade) {
+    float scaled = grade * HISTORY_SCALE;
+    return (int32_t)(scaled < 0 ? scaled - 0.5f : scaled + 0.5f);
+}
+
+static int block_entries(const history_t *history, uint32_t block) {
+    uint32_t remaining = history->header->count - block * HISTORY_BLOCK;
+    return remaining < HISTORY_BLOCK ? (int)remaining : HISTORY_BLOCK;
+}
+
+/*
+ * Decodes one column of one block into values. Returns the number of
+ * entries, or -1 if the data is corrupt.
+ */
+static int decode_column(const history_t *history, uint32_t block, int column, int32_t *values) {
+    const history_block_t *b = &history->blocks[block];
+    const unsigned char *end = history->deltas + history->header->data_size;
+    const unsigned char *p = history->deltas + b->offsets[column];
+    int n = block_entries(history, block);
+
+    values[0] = column == 0 ? b->first_term : b->first_grades[column - 1];
+    for (int i = 1; i < n; i++) {
+        uint32_t delta;
+        if (!(p = read_varint(p, end, &delta))) {
+            return -1;
+        }
+        values[i] = values[i - 1] + unzigzag(delta);
+    }
+    return n;
+}
+
+/*
+ * Range Scan
+ * ==========
+ * Calls visit for every term in [from_term, to_term], decoding only the
+ * blocks that overlap the range and only the columns in column_mask
+ * (bit c = column c; the term column is always decoded).
+ */
+typedef void (*visit_fn)(int32_t term, const int32_t *columns, void *arg);
+
+static int scan_range(const history_t *history, int from_term, int to_term, unsigned column_mask,
+                      visit_fn visit, void *arg) {
+    uint32_t lo = 0;
+    uint32_t hi = history->header->block_count;
+    // Last block whose first term is <= from_term
+    while (lo < hi) {
+        uint32_t mid = lo + (hi - lo) / 2;
+        if (history->blocks[mid].first_term <= from_term) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    uint32_t block = lo > 0 ? lo - 1 : 0;
+
+    int32_t values[COLUMNS][HISTORY_BLOCK];
+    for (; block < history->header->block_count && history->blocks[block].first_term <= to_term; block++) {
+        int n = decode_column(history, block, 0, values[0]);
+        for (int c = 1; c < COLUMNS && n >= 0; c++) {
+            if (column_mask & (1u << c)) {
+                n = decode_column(history, block, c, values[c]) == n ? n : -1;
+            }
+        }
+        if (n < 0) {
+            return -1;
+        }
+        for (int i = 0; i < n; i++) {
+            if (values[0][i] >= from_term && values[0][i] <= to_term) {
+                int32_t row[COLUMNS];
+                for (int c = 0; c < COLUMNS; c++) {
+                    row[c] = values[c][i];
+                }
+                visit(values[0][i], row, arg);
+            }
+        }
+    }
+    return 0;
+}
+
+/*
+ * FUNCTION: history_load
+ * =======================
+ * Reads a student's history file
+ *
+ * Returns:
+ *   - 0 on success, -1 if missing (errno ENOENT) or malformed (errno
+ *     EINVAL, or the read error)
+ */
+int history_load(int id, history_t *history) {
+    char path[128];
+    history_path(id, path, sizeof(path));
+    memset(history, 0, sizeof(*history));
+
+    FILE *file = fopen(path, "rb");
+    if (!file) {
+        return -1;
+    }
+    long size = -1;
+    if (fseek(file, 0, SEEK_END) == 0) {
+        size = ftell(file);
+        rewind(file);
+    }
+    if (size < (long)sizeof(history_header_t) ||
+        !(history->data = mem_malloc(MEM_RECORDS, (size_t)size)) ||
+        fread(history->data, (size_t)size, 1, file) != 1) {
+        int error = history->data || size < (long)sizeof(history_header_t) ? EINVAL : ENOMEM;
+        fclose(file);
+        history_free(history);
+        errno = error;
+        return -1;
+    }
+    fclose(file);
+    history->size = (size_t)size;
+
+    const history_header_t *h = (const history_header_t *)history->data;
+    size_t directory = sizeof(*h) + (size_t)h->block_count * sizeof(history_block_t);
+    if (memcmp(h->magic, HISTORY_MAGIC, sizeof(h->magic)) != 0 ||
+        h->block_count != (h->count + HISTORY_BLOCK - 1) / HISTORY_BLOCK ||
+        directory + h->data_size != history->size) {
+        history_free(history);
+        errno = EINVAL;
+        return -1;
+    }
+    history->header = h;
+    history->blocks = (const history_block_t *)(history->data + sizeof(*h));
+    history->deltas = history->data + directory;
+    for (uint32_t b = 0; b < h->block_count; b++) {
+        for (int c = 0; c < COLUMNS; c++) {
+            if (history->blocks[b].offsets[c] > h->data_size) {
+                history_free(history);
+                errno = EINVAL;
+                return -1;
+            }
+        }
+    }
+    return 0;
+}
+
+void history_free(history_t *history) {
+    mem_free(history->data);
+    memset(history, 0, sizeof(*history));
+}
+
+typedef struct {
+    int32_t *terms;
+    int32_t (*grades)[HISTORY_SUBJECTS];
+    uint32_t count;
+} series_t;
+
+static void collect_all(int32_t term, const int32_t *columns, void *arg) {
+    series_t *series = arg;
+    series->terms[series->count] = term;
+    memcpy(series->grades[series->count], columns + 1, sizeof(series->grades[0]));
+    series->count++;
+}
+
+static int write_series(const char *path, const series_t *series) {
+    uint32_t block_count = (series->count + HISTORY_BLOCK - 1) / HISTORY_BLOCK;
+    size_t directory = sizeof(history_header_t) + block_count * sizeof(history_block_t);
+    size_t worst = (size_t)series->count * COLUMNS * 5;
+    unsigned char *buf = mem_calloc(MEM_RECORDS, 1, directory + worst);
+    if (!buf) {
+        return -1;
+    }
+
+    history_header_t *h = (history_header_t *)buf;
+    history_block_t *blocks = (history_block_t *)(buf + sizeof(*h));
+    unsigned char *deltas = buf + directory;
+    unsigned char *p = deltas;
+
+    for (uint32_t b = 0; b < block_count; b++) {
+        uint32_t first = b * HISTORY_BLOCK;
+        uint32_t last = first + HISTORY_BLOCK < series->count ? first + HISTORY_BLOCK : series->count;
+        blocks[b].first_term = series->terms[first];
+        for (int s = 0; s < HISTORY_SUBJECTS; s++) {
+            blocks[b].first_grades[s] = series->grades[first][s];
+        }
+        for (int c = 0; c < COLUMNS; c++) {
+            blocks[b].offsets[c] = (uint32_t)(p - deltas);
+            for (uint32_t i = first + 1; i < last; i++) {
+                int32_t delta = c == 0 ? series->terms[i] - series->terms[i - 1]
+                                       : series->grades[i][c - 1] - series->grades[i - 1][c - 1];
+                p = write_varint(p, zigzag(delta));
+            }
+        }
+    }
+    memcpy(h->magic, HISTORY_MAGIC, sizeof(h->magic));
+    h->count = series->count;
+    h->block_count = block_count;
+    h->data_size = (uint32_t)(p - deltas);
+
+    char tempname[160];
+    snprintf(tempname, sizeof(tempname), "%s.tmp", path);
+    FILE *file = fopen(tempname, "wb");
+    int ok = file && fwrite(buf, directory + h->data_size, 1, file) == 1;
+    if (file && fclose(file) != 0) {
+        ok = 0;
+    }
+    mem_free(buf);
+    if (!ok || rename(tempname, path) != 0) {
+        remove(tempname);
+        return -1;
+    }
+    return 0;
+}
+
+// Serializes every read-modify-write of a history file (and its .tmp)
+static pthread_mutex_t history_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+// Caller must hold history_mutex
+static int record_locked(int id, int term, const student_t *student) {
+    char path[128];
+    history_path(id, path, sizeof(path));
+
+    // Only a missing file starts a new history; a damaged one is kept for repair
+    history_t history;
+    uint32_t count = 0;
+    if (history_load(id, &history) == 0) {
+        count = history.header->count;
+    } else if (errno != ENOENT) {
+        return -1;
+    }
+    series_t series = { mem_malloc(MEM_RECORDS, (count + 1) * sizeof(int32_t)),
+                        mem_malloc(MEM_RECORDS, (count + 1) * sizeof(series.grades[0])), 0 };
+    int result = -1;
+
+    if (series.terms && series.grades &&
+        (count == 0 || scan_range(&history, INT32_MIN, INT32_MAX, ~0u, collect_all, &series) == 0)) {
+        uint32_t at = series.count;
+        if (at > 0 && series.terms[at - 1] == term) {
+            at--;                       // latest term: replace
+        } else if (at > 0 && series.terms[at - 1] > term) {
+            at = UINT32_MAX;            // terms only move forward
+        }
+        if (at != UINT32_MAX) {
+            const subject_t *subjects[] = { &student->subject1, &student->subject2,
+                                            &student->subject3, &student->subject4 };
+            series.terms[at] = term;
+            for (int s = 0; s < HISTORY_SUBJECTS; s++) {
+                series.grades[at][s] = to_fixed(subjects[s]->grade);
+            }
+            series.count = at + 1;
+            result = write_series(path, &series);
+        }
+    }
+
+    mem_free(series.terms);
+    mem_free(series.grades);
+    history_free(&history);
+    return result;
+}
+
+/*
+ * FUNCTION: history_record
+ * =========================
+ * Stores a student's current subject grades as the entry for a term
+ * If term is the latest term recorded its entry is replaced; otherwise it
+ * is appended. Earlier terms are never changed. Writers of the same
+ * history are serialized, so none of them loses another's entry.
+ *
+ * Returns:
+ *   - 0 on success, -1 if term is older than the latest recorded term,
+ *     the existing file is damaged (it is left as it is) or the file
+ *     could not be written
+ */
+int history_record(int id, int term, const student_t *student) {
+    pthread_mutex_lock(&history_mutex);
+    int result = record_locked(id, term, student);
+    pthread_mutex_unlock(&history_mutex);
+    return result;
+}
+
+/*
+ * FUNCTION: history_current_term
+ * ===============================
+ * Returns the term opened with `app term`, or 0 if none
+ */
+int history_current_term(void) {
+    int term = 0;
+    FILE *file = fopen(HISTORY_TERM_PATH, "r");
+    if (file) {
+        if (fscanf(file, "%d", &term) != 1) {
+            term = 0;
+        }
+        fclose(file);
+    }
+    return term;
+}
+
+/*
+ * FUNCTION: history_update_current
+ * =================================
+ * Re-records a student's grades for the current term after an edit
+ * The record is read under the history lock, so when two edits race the
+ * later writer stores the grades both of them left.
+ *
+ * Returns:
+ *   - 0 on success or when no term is open, -1 on error
+ */
+int history_update_current(int id) {
+    int term = history_current_term();
+    if (term == 0) {
+        return 0;
+    }
+    student_t student;
+    pthread_mutex_lock(&history_mutex);
+    int result = record_load(id, &student) == 0 ? record_locked(id, term, &student) : -1;
+    pthread_mutex_unlock(&history_mutex);
+    return result;
+}
+
+typedef struct {
+    history_entry_t *entries;
+    int max;
+    int count;
+} range_collect_t;
+
+static void collect_entry(int32_t term, const int32_t *columns, void *arg) {
+    range_collect_t *out = arg;
+    if (out->count < out->max) {
+        history_entry_t *e = &out->entries[out->count];
+        e->term = term;
+        for (int s = 0; s < HISTORY_SUBJECTS; s++) {
+            e->grades[s] = (float)columns[1 + s] / HISTORY_SCALE;
+        }
+    }
+    out->count++;
+}
+
+/*
+ * FUNCTION: history_range
+ * ========================
+ * Decodes the entries for terms [from_term, to_term]
+ *
+ * Returns:
+ *   - Number of terms in the range (entries holds up to max_entries of
+ *     them), or -1 if the history is corrupt
+ */
+int history_range(const history_t *history, int from_term, int to_term,
+                  history_entry_t *entries, int max_entries) {
+    range_collect_t out = { entries, max_entries, 0 };
+    unsigned all = ((1u << COLUMNS) - 1);
+    return scan_range(history, from_term, to_term, all, collect_entry, &out) == 0 ? out.count : -1;
+}
+
+typedef struct {
+    int column;
+    double n, sum_x, sum_y, sum_xy, sum_xx;
+} trend_t;
+
+static void add_point(int32_t term, const int32_t *columns, void *arg) {
+    (void)term;
+    trend_t *t = arg;
+    double x = t->n;                 // term ordinal within the range
+    double y = (double)columns[t->column] / HISTORY_SCALE;
+    t->n += 1;
+    t->sum_x += x;
+    t->sum_y += y;
+    t->sum_xy += x * y;
+    t->sum_xx += x * x;
+}
+
+/*
+ * FUNCTION: history_trend
+ * ========================
+ * Least-squares slope of one subject's grade over the terms in a range,
+ * in grade points per term. Only the term and that subject's columns are
+ * decoded.
+ *
+ * Parameters:
+ *   - subject: 0-3
+ *
+ * Returns:
+ *   - 0 on success, -1 if fewer than two terms are in range or the
+ *     history is corrupt
+ */
+int history_trend(const history_t *history, int subject, int from_term, int to_term, float *slope) {
+    if (subject < 0 || subject >= HISTORY_SUBJECTS) {
+        return -1;
+    }
+    trend_t t = { 1 + subject, 0, 0, 0, 0, 0 };
+    if (scan_range(history, from_term, to_term, 1u << t.column, add_point, &t) != 0 || t.n < 2) {
+        return -1;
+    }
+    *slope = (float)((t.n * t.sum_xy - t.sum_x * t.sum_y) / (t.n * t.sum_xx - t.sum_x * t.sum_x));
+    return 0;
+}
+
+typedef struct {
+    history_gpa_t *points;
+    int max;
+    int count;
+} gpa_collect_t;
+
+static void collect_gpa(int32_t term, const int32_t *columns, void *arg) {
+    gpa_collect_t *out = arg;
+    if (out->count < out->max) {
+        int32_t sum = 0;
+        for (int s = 0; s < HISTORY_SUBJECTS; s++) {
+            sum += columns[1 + s];
+        }
+        out->points[out->count].term = term;
+        out->points[out->count].average = (float)sum / (HISTORY_SUBJECTS * HISTORY_SCALE);
+    }
+    out->count++;
+}
+
+/*
+ * FUNCTION: history_gpa
+ * ======================
+ * Average of the four subjects for each term in [from_term, to_term]
+ *
+ * Returns:
+ *   - Number of terms in the range (points holds up to max_points), or
+ *     -1 if the history is corrupt
+ */
+int history_gpa(const history_t *history, int from_term, int to_term, history_gpa_t *points, int max_points) {
+    gpa_collect_t out = { points, max_points, 0 };
+    unsigned subjects = ((1u << COLUMNS) - 1) & ~1u;
+    return scan_range(history, from_term, to_term, subjects, collect_gpa, &out) == 0 ? out.count : -1;
+}
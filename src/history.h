@@ -0,0 +1,89 @@
+/*
+ * ============================================================================
+ * TERM-BY-TERM GRADE HISTORY (history_<id>.bin)
+ * ============================================================================
+ *
+ * student_t only holds the current four subject grades. The history keeps
+ * one entry per term for each student: the term number and the four
+ * subject grades as they stood at the end of that term.
+ *
+ * Each column (term numbers, subject 1-4) is a separate time series of
+ * fixed-point values (grades in hundredths) stored as zigzag varint deltas.
+ * The series are cut into blocks of HISTORY_BLOCK terms; each block
+ * starts from absolute values kept in a small directory:
+ *
+ *     history_header_t
+ *     history_block_t  blocks[block_count]    (first term, first grades,
+ *                                              offset of each column)
+ *     uint8_t          deltas[data_size]
+ *
+ * A query for a range of terms binary-searches the directory and decodes
+ * only the blocks that overlap the range, and only the columns it needs.
+ *
+ * Terms are increasing integers chosen by the school (e.g. 20241, 20242).
+ * `app term N` opens term N: the current term is kept in HISTORY_TERM_PATH,
+ * every student's grades are recorded for it, and later subject-grade
+ * edits update that term's entry instead of erasing last term's grades.
+ *
+ * ============================================================================
+ */
+
+#ifndef HISTORY_H
+#define HISTORY_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "student.h"
+
+#define HISTORY_MAGIC "SDBHIST1"
+#define HISTORY_TERM_PATH "data/term.txt"
+#define HISTORY_SUBJECTS 4
+#define HISTORY_BLOCK 16
+#define HISTORY_SCALE 100     // grades are stored in hundredths
+
+typedef struct {
+    char magic[8];
+    uint32_t count;           // terms recorded
+    uint32_t block_count;
+    uint32_t data_size;
+    uint32_t reserved;
+} history_header_t;
+
+typedef struct {
+    int32_t first_term;
+    int32_t first_grades[HISTORY_SUBJECTS];
+    uint32_t offsets[1 + HISTORY_SUBJECTS];   // column start within deltas
+} history_block_t;
+
+typedef struct {
+    int term;
+    float grades[HISTORY_SUBJECTS];
+} history_entry_t;
+
+typedef struct {
+    int term;
+    float average;            // mean of the four subjects, 0-100 like AVERAGE_GRADE
+} history_gpa_t;
+
+typedef struct {
+    unsigned char *data;      // whole file
+    size_t size;
+    const history_header_t *header;
+    const history_block_t *blocks;
+    const unsigned char *deltas;
+} history_t;
+
+void history_path(int id, char *buf, size_t size);
+int history_load(int id, history_t *history);
+void history_free(history_t *history);
+
+int history_record(int id, int term, const student_t *student);
+int history_current_term(void);
+int history_update_current(int id);
+
+int history_range(const history_t *history, int from_term, int to_term,
+                  history_entry_t *entries, int max_entries);
+int history_trend(const history_t *history, int subject, int from_term, int to_term, float *slope);
+int history_gpa(const history_t *history, int from_term, int to_term, history_gpa_t *points, int max_points);
+
+#endif
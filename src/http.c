@@ -0,0 +1,535 @@
+/*
+ * ============================================================================
+ * HTTP/JSON API (app serve)
+ * ============================================================================
+ *
+ * See http.h for the endpoints. Each connection reads into one fixed
+ * buffer large enough for a maximal request plus a read, parses every
+ * complete request in it in place, appends the responses to an output
+ * buffer and sends that once the buffer holds no further complete
+ * request.
+ *
+ * ============================================================================
+ */
+
+#define _GNU_SOURCE  // memmem
+
+#include "http.h"
+#include "json.h"
+#include "validate.h"
+#include "mem.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <errno.h>
+#include <stdint.h>
+#include <sys/socket.h>
+
+#define IN_SIZE (HTTP_MAX_HEADER + 4 + HTTP_MAX_BODY + HTTP_READ_SIZE)
+#define VALUE_MAX 256
+
+typedef struct {
+    const char *method;
+    size_t method_length;
+    const char *target;
+    size_t target_length;
+    const char *body;
+    size_t body_length;
+    int keep_alive;
+} http_request_t;
+
+typedef struct {
+    http_server_t *server;
+    long requests;
+    json_buf_t out;
+    json_buf_t body;                      // scratch for one response body
+    student_t adds[HTTP_ADD_BATCH];       // POSTs waiting for flush_adds
+    int add_keep_alive[HTTP_ADD_BATCH];
+    int add_count;
+} connection_t;
+
+static const char *status_text(int status) {
+    switch (status) {
+    case 200:
+        return "OK";
+    case 201:
+        return "Created";
+    case 400:
+        return "Bad Request";
+    case 404:
+        return "Not Found";
+    case 405:
+        return "Method Not Allowed";
+    case 413:
+        return "Payload Too Large";
+    case 431:
+        return "Request Header Fields Too Large";
+    case 501:
+        return "Not Implemented";
+    case 503:
+        return "Service Unavailable";
+    default:
+        return "Internal Server Error";
+    }
+}
+
+// Appends a response to the connection's output
+static void write_response(connection_t *conn, int status, const char *body, size_t body_length, int keep_alive) {
+    char header[160];
+    int length = snprintf(header, sizeof(header),
+                          "HTTP/1.1 %d %s\r\nContent-Type: application/json\r\nContent-Length: %zu\r\n"
+                          "Connection: %s\r\n\r\n",
+                          status, status_text(status), body_length, keep_alive ? "keep-alive" : "close");
+    json_buf_append(&conn->out, header, (size_t)length);
+    json_buf_append(&conn->out, body, body_length);
+}
+
+// Saves the queued POSTs as one batch and answers each of them in order
+static void flush_adds(connection_t *conn) {
+    if (conn->add_count == 0) {
+        return;
+    }
+    int first_id = studentdb_create_many(conn->server->db, conn->adds, conn->add_count);
+    for (int i = 0; i < conn->add_count; i++) {
+        char body[48];
+        int length = first_id < 0 ? snprintf(body, sizeof(body), "{\"error\":\"could not save the student\"}")
+                                  : snprintf(body, sizeof(body), "{\"id\":%d}", first_id + i);
+        write_response(conn, first_id < 0 ? 500 : 201, body, (size_t)length, conn->add_keep_alive[i]);
+    }
+    conn->add_count = 0;
+}
+
+// Answers with conn->body, after any queued POSTs
+static void reply(connection_t *conn, int status, int keep_alive) {
+    flush_adds(conn);
+    write_response(conn, status, conn->body.data, conn->body.length, keep_alive);
+}
+
+static void reply_error(connection_t *conn, int status, const char *message, int keep_alive) {
+    conn->body.length = 0;
+    json_buf_append(&conn->body, "{\"error\":", 9);
+    json_string(&conn->body, message);
+    json_buf_append(&conn->body, "}", 1);
+    reply(conn, status, keep_alive);
+}
+
+static int token_is(const char *data, size_t length, const char *token) {
+    return length == strlen(token) && strncasecmp(data, token, length) == 0;
+}
+
+/*
+ * Parses the request at the start of data
+ *
+ * Returns:
+ *   - Its length in bytes, 0 if it is not complete yet, or -status if it
+ *     is malformed or too large
+ */
+static long parse_request(const char *data, size_t length, http_request_t *request) {
+    size_t window = length < HTTP_MAX_HEADER + 4 ? length : HTTP_MAX_HEADER + 4;
+    const char *end = memmem(data, window, "\r\n\r\n", 4);
+    if (!end) {
+        return length >= HTTP_MAX_HEADER + 4 ? -431 : 0;
+    }
+    size_t header_length = (size_t)(end - data) + 4;
+
+    // Request line: METHOD SP TARGET SP VERSION
+    const char *line_end = memmem(data, header_length, "\r\n", 2);
+    const char *space1 = memchr(data, ' ', (size_t)(line_end - data));
+    const char *space2 = space1 ? memchr(space1 + 1, ' ', (size_t)(line_end - space1 - 1)) : NULL;
+    if (!space2 || space1 == data || space2 == space1 + 1) {
+        return -400;
+    }
+    const char *version = space2 + 1;
+    size_t version_length = (size_t)(line_end - version);
+    if (token_is(version, version_length, "HTTP/1.1")) {
+        request->keep_alive = 1;
+    } else if (token_is(version, version_length, "HTTP/1.0")) {
+        request->keep_alive = 0;
+    } else {
+        return -400;
+    }
+    request->method = data;
+    request->method_length = (size_t)(space1 - data);
+    request->target = space1 + 1;
+    request->target_length = (size_t)(space2 - space1 - 1);
+
+    size_t content_length = 0;
+    const char *line = line_end + 2;
+    while (line < end + 2) {
+        line_end = memmem(line, (size_t)(end + 2 - line), "\r\n", 2);
+        const char *colon = memchr(line, ':', (size_t)(line_end - line));
+        if (!colon) {
+            return -400;
+        }
+        const char *value = colon + 1;
+        const char *value_end = line_end;
+        while (value < value_end && (*value == ' ' || *value == '\t')) {
+            value++;
+        }
+        while (value_end > value && (value_end[-1] == ' ' || value_end[-1] == '\t')) {
+            value_end--;
+        }
+        size_t name_length = (size_t)(colon - line);
+        size_t value_length = (size_t)(value_end - value);
+        if (token_is(line, name_length, "Content-Length")) {
+            content_length = 0;
+            if (value_length == 0) {
+                return -400;
+            }
+            for (const char *p = value; p < value_end; p++) {
+                if (*p < '0' || *p > '9' || content_length > HTTP_MAX_BODY) {
+                    return *p < '0' || *p > '9' ? -400 : -413;
+                }
+                content_length = content_length * 10 + (size_t)(*p - '0');
+            }
+            if (content_length > HTTP_MAX_BODY) {
+                return -413;
+            }
+        } else if (token_is(line, name_length, "Transfer-Encoding")) {
+            return -501;
+        } else if (token_is(line, name_length, "Connection")) {
+            if (token_is(value, value_length, "close")) {
+                request->keep_alive = 0;
+            } else if (token_is(value, value_length, "keep-alive")) {
+                request->keep_alive = 1;
+            }
+        }
+        line = line_end + 2;
+    }
+
+    if (length - header_length < content_length) {
+        return 0;
+    }
+    request->body = data + header_length;
+    request->body_length = content_length;
+    return (long)(header_length + content_length);
+}
+
+// Parses a whole decimal int; 0 on success
+static int parse_int(const char *data, size_t length, int *value) {
+    char buf[16];
+    if (length == 0 || length >= sizeof(buf)) {
+        return -1;
+    }
+    memcpy(buf, data, length);
+    buf[length] = '\0';
+    char *end;
+    long number = strtol(buf, &end, 10);
+    if (*end != '\0' || number < INT32_MIN || number > INT32_MAX) {
+        return -1;
+    }
+    *value = (int)number;
+    return 0;
+}
+
+// Copies a string or number member's value; -1 for other types
+static int member_text(const json_member_t *member, char *dest) {
+    if (member->type != JSON_STRING && member->type != JSON_NUMBER) {
+        return -1;
+    }
+    json_copy(&member->value, dest, VALUE_MAX);
+    return 0;
+}
+
+static void handle_get(connection_t *conn, int id, int keep_alive) {
+    student_t student;
+    if (studentdb_get(conn->server->db, id, &student) < 0) {
+        reply_error(conn, 404, "no such student", keep_alive);
+        return;
+    }
+    conn->body.length = 0;
+    json_student(&conn->body, &student);
+    reply(conn, 200, keep_alive);
+}
+
+static void handle_rank(connection_t *conn, int id, int keep_alive) {
+    int rank;
+    int class_size;
+    if (studentdb_rank(conn->server->db, id, &rank, &class_size) < 0) {
+        reply_error(conn, 404, "no such student", keep_alive);
+        return;
+    }
+    conn->body.length = 0;
+    json_buf_append(&conn->body, "{\"rank\":", 8);
+    json_int(&conn->body, rank);
+    json_buf_append(&conn->body, ",\"class_size\":", 14);
+    json_int(&conn->body, class_size);
+    json_buf_append(&conn->body, "}", 1);
+    reply(conn, 200, keep_alive);
+}
+
+static void handle_post(connection_t *conn, const http_request_t *request) {
+    json_member_t members[JSON_MAX_MEMBERS];
+    int count = json_parse_object(request->body, request->body_length, members, JSON_MAX_MEMBERS);
+    if (count < 0) {
+        reply_error(conn, 400, "body is not a flat JSON object", request->keep_alive);
+        return;
+    }
+    char values[STUDENTDB_COLUMNS][VALUE_MAX] = { { 0 } };
+    const char *columns[STUDENTDB_COLUMNS] = { NULL };
+    columns[1] = "";
+    for (int i = 0; i < count; i++) {
+        for (int c = 0; c < STUDENTDB_COLUMNS; c++) {
+            if (!json_key_is(&members[i], studentdb_column_names[c])) {
+                continue;
+            }
+            if (member_text(&members[i], values[c]) != 0) {
+                reply_error(conn, 400, studentdb_column_names[c], request->keep_alive);
+                return;
+            }
+            columns[c] = values[c];
+        }
+    }
+    char message[VALUE_MAX];
+    for (int c = 0; c < STUDENTDB_COLUMNS; c++) {
+        if (!columns[c]) {
+            snprintf(message, sizeof(message), "%s: missing", studentdb_column_names[c]);
+            reply_error(conn, 400, message, request->keep_alive);
+            return;
+        }
+    }
+    if (studentdb_parse_columns(&conn->adds[conn->add_count], columns, message, sizeof(message)) != 0) {
+        reply_error(conn, 400, message, request->keep_alive);
+        return;
+    }
+    conn->add_keep_alive[conn->add_count++] = request->keep_alive;
+    if (conn->add_count == HTTP_ADD_BATCH) {
+        flush_adds(conn);
+    }
+}
+
+static void handle_patch(connection_t *conn, int id, const http_request_t *request) {
+    json_member_t members[JSON_MAX_MEMBERS];
+    int count = json_parse_object(request->body, request->body_length, members, JSON_MAX_MEMBERS);
+    if (count <= 0) {
+        reply_error(conn, 400, "body is not a flat JSON object with fields to change", request->keep_alive);
+        return;
+    }
+    field_t fields[JSON_MAX_MEMBERS];
+    char values[JSON_MAX_MEMBERS][VALUE_MAX];
+    char message[VALUE_MAX];
+    for (int i = 0; i < count; i++) {
+        char name[64];
+        json_copy(&members[i].key, name, sizeof(name));
+        const char *problem = "not a string or number";
+        if (studentdb_field_by_name(name, &fields[i]) != 0) {
+            problem = "not an editable field";
+        } else if (member_text(&members[i], values[i]) == 0) {
+            problem = validate_field(fields[i], values[i]);
+        }
+        if (problem != NULL) {
+            snprintf(message, sizeof(message), "%s: %s", name, problem);
+            reply_error(conn, 400, message, request->keep_alive);
+            return;
+        }
+    }
+
+    student_t student;
+    if (studentdb_get(conn->server->db, id, &student) < 0) {
+        reply_error(conn, 404, "no such student", request->keep_alive);
+        return;
+    }
+    for (int i = 0; i < count; i++) {
+        if (studentdb_update(conn->server->db, id, fields[i], values[i]) < 0) {
+            reply_error(conn, 500, "could not save the student", request->keep_alive);
+            return;
+        }
+    }
+    handle_get(conn, id, request->keep_alive);
+}
+
+static int in_class(const student_t *student, void *arg) {
+    return student->grade == *(const int *)arg;
+}
+
+static void handle_query(connection_t *conn, const char *query, size_t length, int keep_alive) {
+    int first_id = 1;
+    int last_id = INT32_MAX;
+    int klass = 0;
+    int by_class = 0;
+    const char *end = query + length;
+    while (query < end) {
+        const char *amp = memchr(query, '&', (size_t)(end - query));
+        const char *param_end = amp ? amp : end;
+        const char *equals = memchr(query, '=', (size_t)(param_end - query));
+        int ok = equals != NULL;
+        if (ok) {
+            size_t name_length = (size_t)(equals - query);
+            const char *value = equals + 1;
+            size_t value_length = (size_t)(param_end - value);
+            if (token_is(query, name_length, "from")) {
+                ok = parse_int(value, value_length, &first_id) == 0;
+            } else if (token_is(query, name_length, "to")) {
+                ok = parse_int(value, value_length, &last_id) == 0;
+            } else if (token_is(query, name_length, "class")) {
+                ok = parse_int(value, value_length, &klass) == 0;
+                by_class = 1;
+            } else {
+                ok = 0;
+            }
+        }
+        if (!ok) {
+            reply_error(conn, 400, "query parameters are from, to and class", keep_alive);
+            return;
+        }
+        query = param_end + (amp != NULL);
+    }
+
+    student_t *results;
+    int found = studentdb_query(conn->server->db, first_id, last_id, by_class ? in_class : NULL, &klass, &results);
+    if (found < 0) {
+        reply_error(conn, 500, "could not read the store", keep_alive);
+        return;
+    }
+    conn->body.length = 0;
+    json_buf_append(&conn->body, "[", 1);
+    for (int i = 0; i < found; i++) {
+        if (i > 0) {
+            json_buf_append(&conn->body, ",", 1);
+        }
+        json_student(&conn->body, &results[i]);
+    }
+    json_buf_append(&conn->body, "]", 1);
+    free(results);
+    reply(conn, 200, keep_alive);
+}
+
+static void handle(connection_t *conn, const http_request_t *request) {
+    static const char prefix[] = "/students";
+    const size_t prefix_length = sizeof(prefix) - 1;
+    const char *path = request->target;
+    const char *question = memchr(path, '?', request->target_length);
+    size_t path_length = question ? (size_t)(question - path) : request->target_length;
+    int get = token_is(request->method, request->method_length, "GET");
+    int post = token_is(request->method, request->method_length, "POST");
+
+    // Queued POSTs are saved before anything that could read them
+    if (!post) {
+        flush_adds(conn);
+    }
+
+    if (path_length < prefix_length || memcmp(path, prefix, prefix_length) != 0) {
+        reply_error(conn, 404, "no such endpoint", request->keep_alive);
+        return;
+    }
+    if (path_length == prefix_length) {
+        if (get) {
+            const char *query = question ? question + 1 : path + path_length;
+            handle_query(conn, query, (size_t)(request->target + request->target_length - query),
+                         request->keep_alive);
+        } else if (post) {
+            handle_post(conn, request);
+        } else {
+            reply_error(conn, 405, "use GET or POST", request->keep_alive);
+        }
+        return;
+    }
+    static const char rank_suffix[] = "/rank";
+    const size_t rank_length = sizeof(rank_suffix) - 1;
+    const char *id_text = path + prefix_length + 1;
+    size_t id_length = path_length - prefix_length - 1;
+    int rank = id_length > rank_length && memcmp(id_text + id_length - rank_length, rank_suffix, rank_length) == 0;
+    int id;
+    if (path[prefix_length] != '/' || question ||
+        parse_int(id_text, rank ? id_length - rank_length : id_length, &id) != 0) {
+        reply_error(conn, 404, "no such endpoint", request->keep_alive);
+        return;
+    }
+    if (rank) {
+        if (get) {
+            handle_rank(conn, id, request->keep_alive);
+        } else {
+            reply_error(conn, 405, "use GET", request->keep_alive);
+        }
+    } else if (get) {
+        handle_get(conn, id, request->keep_alive);
+    } else if (token_is(request->method, request->method_length, "PATCH")) {
+        handle_patch(conn, id, request);
+    } else {
+        reply_error(conn, 405, "use GET or PATCH", request->keep_alive);
+    }
+}
+
+static long serve_connection(int fd, void *arg) {
+    connection_t *conn = mem_calloc(MEM_QUEUES, 1, sizeof(connection_t));
+    char *in = mem_malloc(MEM_QUEUES, IN_SIZE);
+    size_t used = 0;
+    int closing = conn == NULL || in == NULL;
+    if (conn) {
+        conn->server = arg;
+    }
+    while (!closing) {
+        ssize_t got = recv(fd, in + used, IN_SIZE - used, 0);
+        if (got < 0 && errno == EINTR) {
+            continue;
+        }
+        if (got <= 0) {
+            break;
+        }
+        used += (size_t)got;
+
+        // Answer every complete request received so far
+        size_t start = 0;
+        while (!closing) {
+            http_request_t request;
+            long length = parse_request(in + start, used - start, &request);
+            if (length == 0) {
+                break;
+            }
+            conn->requests++;
+            if (length < 0) {
+                reply_error(conn, (int)-length, "malformed or oversized request", 0);
+                closing = 1;
+                break;
+            }
+            start += (size_t)length;
+            closing = !request.keep_alive;
+            handle(conn, &request);
+        }
+        flush_adds(conn);
+        if (conn->out.failed || net_send_all(fd, conn->out.data, conn->out.length) != 0) {
+            break;
+        }
+        conn->out.length = 0;
+        memmove(in, in + start, used - start);
+        used -= start;
+    }
+
+    long requests = conn ? conn->requests : 0;
+    mem_free(in);
+    if (conn) {
+        json_buf_free(&conn->out);
+        json_buf_free(&conn->body);
+    }
+    mem_free(conn);
+    return requests;
+}
+
+/*
+ * FUNCTION: http_server_start
+ * ============================
+ * Listens on 127.0.0.1:port (0 picks a free port, stored in
+ * server->net.port) and serves db from a background thread
+ *
+ * Returns:
+ *   - 0 on success, -1 on error (errno set)
+ */
+int http_server_start(http_server_t *server, studentdb_t *db, int port) {
+    static const char busy[] =
+        "HTTP/1.1 503 Service Unavailable\r\nContent-Type: application/json\r\nContent-Length: 23\r\n"
+        "Connection: close\r\n\r\n{\"error\":\"server busy\"}";
+    server->db = db;
+    return net_server_start(&server->net, port, serve_connection, server, busy, sizeof(busy) - 1);
+}
+
+/*
+ * FUNCTION: http_server_stop
+ * ===========================
+ * Stops accepting, closes every connection (requests being handled
+ * finish first) and waits for their threads to end
+ */
+void http_server_stop(http_server_t *server) {
+    net_server_stop(&server->net);
+}
@@ -0,0 +1,58 @@
+/*
+ * ============================================================================
+ * HTTP/JSON API (app serve)
+ * ============================================================================
+ *
+ * An embedded HTTP/1.1 server for the web front office. It listens on
+ * 127.0.0.1 only; anything that must reach it from elsewhere goes
+ * through a proxy that does its own authentication.
+ *
+ *     GET   /students/ID           200 the student (json.h), 404
+ *     GET   /students/ID/rank      200 {"rank":R,"class_size":N} within
+ *                                  the student's class level, 404
+ *     POST  /students              body: one student, keys as in
+ *                                  studentdb_column_names (family_name
+ *                                  may be left out); 201 {"id":ID}, 400
+ *     PATCH /students/ID           body: {"FIELD":VALUE,...} with FIELD as
+ *                                  for studentdb_field_by_name; every value
+ *                                  is checked before any is applied;
+ *                                  200 the updated student, 400, 404
+ *     GET   /students[?from=A&to=B&class=C]
+ *                                  200 a JSON array of students in ID order
+ *
+ * Errors have a body {"error":"message"}. Ranks come from the view
+ * studentdb_attach_ranks keeps; without one every rank is a 404.
+ *
+ * Connections are kept alive (HTTP/1.1 default, or Connection: keep-alive
+ * from an HTTP/1.0 client) and may pipeline requests. Every complete
+ * request in a read is answered before the responses go out together in
+ * one send, and consecutive POSTs in such a run are saved as one batch
+ * with studentdb_create_many. Chunked request bodies are not supported.
+ *
+ * Connections are run by net.h: each has its own thread, and those
+ * beyond NET_MAX_CONNECTIONS are answered 503 and closed.
+ *
+ * ============================================================================
+ */
+
+#ifndef HTTP_H
+#define HTTP_H
+
+#include "net.h"
+#include "studentdb.h"
+
+#define HTTP_DEFAULT_PORT 8080
+#define HTTP_MAX_HEADER 8192
+#define HTTP_MAX_BODY 65536
+#define HTTP_READ_SIZE 16384
+#define HTTP_ADD_BATCH 256
+
+typedef struct {
+    net_server_t net;                 // net.port is the port bound
+    studentdb_t *db;
+} http_server_t;
+
+int http_server_start(http_server_t *server, studentdb_t *db, int port);
+void http_server_stop(http_server_t *server);
+
+#endif
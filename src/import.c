@@ -0,0 +1,649 @@
+/*
+ * ============================================================================
+ * BULK CSV IMPORT
+ * ============================================================================
+ *
+ * See import.h for the file format and pipeline layout.
+ *
+ * ============================================================================
+ */
+
+#include "import.h"
+#include "csv.h"
+#include "mem.h"
+#include "record.h"
+#include "validate.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+// IDs reserved from the counter file at a time
+#define IMPORT_ID_BLOCK 1024
+
+// Most rows the validate stage takes from its queue at once
+#define IMPORT_VALIDATE_BATCH 64
+
+/*
+ * Bounded SPSC Ring
+ * =================
+ * One producer thread, one consumer thread. head and tail sit on separate
+ * cache lines so the two sides do not false-share, and a push or pop that
+ * finds room (or an item) touches no lock. A side that finds the ring
+ * full (or empty) sleeps on ready instead of spinning; the other side
+ * only takes the lock to wake it when waiters is non-zero. Each side
+ * updates its index before reading waiters, and a sleeper counts itself
+ * in waiters before re-checking the index, so a wakeup cannot be lost. A NULL item marks
+ * end of stream.
+ */
+typedef struct {
+    void **slots;
+    size_t mask;
+    _Alignas(64) atomic_size_t head;   // next slot to read (consumer)
+    _Alignas(64) atomic_size_t tail;   // next slot to write (producer)
+    _Alignas(64) atomic_int waiters;   // threads asleep (or going to sleep) on ready
+    pthread_mutex_t lock;
+    pthread_cond_t ready;
+} ring_t;
+
+static int ring_init(ring_t *ring, size_t capacity) {
+    ring->slots = mem_malloc(MEM_QUEUES, capacity * sizeof(void *));
+    ring->mask = capacity - 1;
+    atomic_init(&ring->head, 0);
+    atomic_init(&ring->tail, 0);
+    atomic_init(&ring->waiters, 0);
+    pthread_mutex_init(&ring->lock, NULL);
+    pthread_cond_init(&ring->ready, NULL);
+    return ring->slots ? 0 : -1;
+}
+
+static void ring_free(ring_t *ring) {
+    mem_free(ring->slots);
+    pthread_mutex_destroy(&ring->lock);
+    pthread_cond_destroy(&ring->ready);
+}
+
+static int ring_full(ring_t *ring, size_t tail) {
+    return tail - atomic_load(&ring->head) > ring->mask;
+}
+
+static int ring_empty(ring_t *ring, size_t head) {
+    return atomic_load(&ring->tail) == head;
+}
+
+/*
+ * Sleeps until blocked(ring, index) turns false. Returns 1 if it had to
+ * wait at all, for the stage's stall count.
+ */
+static int ring_wait(ring_t *ring, int (*blocked)(ring_t *, size_t), size_t index) {
+    if (!blocked(ring, index)) {
+        return 0;
+    }
+    pthread_mutex_lock(&ring->lock);
+    atomic_fetch_add(&ring->waiters, 1);
+    while (blocked(ring, index)) {
+        pthread_cond_wait(&ring->ready, &ring->lock);
+    }
+    atomic_fetch_sub(&ring->waiters, 1);
+    pthread_mutex_unlock(&ring->lock);
+    return 1;
+}
+
+static void ring_wake(ring_t *ring) {
+    if (atomic_load(&ring->waiters)) {
+        pthread_mutex_lock(&ring->lock);
+        pthread_cond_broadcast(&ring->ready);
+        pthread_mutex_unlock(&ring->lock);
+    }
+}
+
+static void ring_push(ring_t *ring, void *item, import_stage_stats_t *stats) {
+    size_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+    stats->stalls += ring_wait(ring, ring_full, tail);
+    ring->slots[tail & ring->mask] = item;
+    atomic_store(&ring->tail, tail + 1);
+    ring_wake(ring);
+}
+
+static void *ring_pop(ring_t *ring, import_stage_stats_t *stats) {
+    size_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    stats->stalls += ring_wait(ring, ring_empty, head);
+    void *item = ring->slots[head & ring->mask];
+    atomic_store(&ring->head, head + 1);
+    ring_wake(ring);
+    return item;
+}
+
+/*
+ * Takes an item if one is ready. Returns 0 when the ring is empty.
+ */
+static int ring_try_pop(ring_t *ring, void **item) {
+    size_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    if (atomic_load_explicit(&ring->tail, memory_order_acquire) == head) {
+        return 0;
+    }
+    *item = ring->slots[head & ring->mask];
+    atomic_store(&ring->head, head + 1);
+    ring_wake(ring);
+    return 1;
+}
+
+/*
+ * Pipeline Row
+ * ============
+ * Allocated by the parser, freed by the writer (or the ID stage if the
+ * row is rejected). Fields are views into the mapped input file; values
+ * are only copied once, into the student_t.
+ */
+typedef struct {
+    long line;
+    csv_field_t fields[IMPORT_COLUMNS];
+    int field_count;
+    const char *error;
+    int error_column;
+    student_t student;
+} import_row_t;
+
+typedef struct {
+    const char *input;
+    size_t input_size;
+    const import_options_t *options;
+    import_result_t *result;
+    ring_t parsed;
+    ring_t validated;
+    ring_t assigned[IMPORT_MAX_WRITERS];
+    import_stage_stats_t writer_stats[IMPORT_MAX_WRITERS];
+    long writer_failures[IMPORT_MAX_WRITERS];
+    int writers;
+    int counter_failed;
+} pipeline_t;
+
+typedef struct {
+    pipeline_t *pipeline;
+    int index;
+} writer_arg_t;
+
+static const char *column_names[IMPORT_COLUMNS] = {
+    "name", "family_name", "dob", "student_id", "father_name", "mother_name",
+    "phone", "grade", "subject1_name", "subject1_grade", "subject2_name",
+    "subject2_grade", "subject3_name", "subject3_grade", "subject4_name",
+    "subject4_grade"
+};
+
+static const value_kind_t column_kinds[IMPORT_COLUMNS] = {
+    VALUE_NAME, VALUE_FAMILY_NAME, VALUE_DATE_OF_BIRTH, VALUE_STUDENT_ID,
+    VALUE_NAME, VALUE_NAME, VALUE_PHONE_NUMBER, VALUE_CLASS_GRADE,
+    VALUE_SUBJECT_NAME, VALUE_SUBJECT_GRADE, VALUE_SUBJECT_NAME, VALUE_SUBJECT_GRADE,
+    VALUE_SUBJECT_NAME, VALUE_SUBJECT_GRADE, VALUE_SUBJECT_NAME, VALUE_SUBJECT_GRADE
+};
+
+static double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void *parse_stage(void *arg) {
+    pipeline_t *pipeline = arg;
+    import_stage_stats_t *stats = &pipeline->result->stages[IMPORT_STAGE_PARSE];
+    double start = now_seconds();
+    double waited = 0;
+
+    csv_reader_t reader;
+    csv_reader_init(&reader, pipeline->input, pipeline->input_size,
+                    pipeline->options->separator, CSV_KERNEL_AUTO);
+
+    import_row_t *row = NULL;
+    for (;;) {
+        if (!row && !(row = mem_calloc(MEM_RECORDS, 1, sizeof(*row)))) {
+            break;
+        }
+        row->field_count = csv_next_row(&reader, row->fields, IMPORT_COLUMNS);
+        if (row->field_count < 0) {
+            break;
+        }
+        row->line = reader.row_line;
+        if (row->field_count == 1 && row->fields[0].length == 0) {
+            continue;  // blank line; reuse the row
+        }
+        if (row->line == 1 && row->fields[0].length == 4 &&
+            strncasecmp(row->fields[0].data, "name", 4) == 0) {
+            continue;  // header
+        }
+
+        stats->rows++;
+        double before = now_seconds();
+        ring_push(&pipeline->parsed, row, stats);
+        waited += now_seconds() - before;
+        row = NULL;
+    }
+    mem_free(row);
+    ring_push(&pipeline->parsed, NULL, stats);
+    stats->busy_seconds = now_seconds() - start - waited;
+    return NULL;
+}
+
+static void copy_field(char *dest, size_t size, const import_row_t *row, int column) {
+    csv_field_copy(&row->fields[column], dest, size);
+}
+
+static int copy_str(str_t *dest, const import_row_t *row, int column) {
+    const csv_field_t *field = &row->fields[column];
+    if (!field->escaped) {
+        return str_set_n(dest, field->data, field->length);
+    }
+    char *buf = malloc(field->length + 1);
+    if (!buf) {
+        return -1;
+    }
+    csv_field_copy(field, buf, field->length + 1);
+    int result = str_set(dest, buf);
+    free(buf);
+    return result;
+}
+
+static float field_float(const import_row_t *row, int column) {
+    char buf[32];
+    copy_field(buf, sizeof(buf), row, column);
+    return strtof(buf, NULL);
+}
+
+/*
+ * Returns -1 if a name could not be stored (the string pool is full or
+ * memory ran out)
+ */
+static int fill_student(import_row_t *row) {
+    student_t *s = &row->student;
+    subject_t *subjects[] = { &s->subject1, &s->subject2, &s->subject3, &s->subject4 };
+    int failed = 0;
+    failed |= copy_str(&s->name, row, 0);
+    failed |= copy_str(&s->family_name, row, 1);
+    copy_field(s->dateofbirth, sizeof(s->dateofbirth), row, 2);
+    copy_field(s->studentid, sizeof(s->studentid), row, 3);
+    failed |= copy_str(&s->father_name, row, 4);
+    failed |= copy_str(&s->mother_name, row, 5);
+    copy_field(s->phone_number, sizeof(s->phone_number), row, 6);
+    s->grade = (int)field_float(row, 7);
+    for (int i = 0; i < 4; i++) {
+        failed |= copy_str(&subjects[i]->name, row, 8 + i * 2);
+        subjects[i]->grade = field_float(row, 9 + i * 2);
+    }
+    calculate_average(s);
+    return failed ? -1 : 0;
+}
+
+/*
+ * Validates a batch of rows column by column, recording the first failing
+ * column of each row, then fills in the students of the rows that passed.
+ */
+static void validate_batch(import_row_t **rows, int count) {
+    const char *values[IMPORT_VALIDATE_BATCH];
+    size_t lengths[IMPORT_VALIDATE_BATCH];
+    const char *errors[IMPORT_VALIDATE_BATCH];
+
+    for (int i = 0; i < count; i++) {
+        errors[i] = NULL;
+        if (rows[i]->field_count != IMPORT_COLUMNS) {
+            rows[i]->error = errors[i] = "wrong number of fields (expected 16)";
+            rows[i]->error_column = -1;
+        }
+    }
+    for (int c = 0; c < IMPORT_COLUMNS; c++) {
+        for (int i = 0; i < count; i++) {
+            values[i] = rows[i]->fields[c].data;
+            lengths[i] = rows[i]->fields[c].length;
+        }
+        if (validate_column(column_kinds[c], values, lengths, (size_t)count, errors) == 0) {
+            continue;
+        }
+        for (int i = 0; i < count; i++) {
+            if (errors[i] && !rows[i]->error) {
+                rows[i]->error = errors[i];
+                rows[i]->error_column = c;
+            }
+        }
+    }
+    for (int i = 0; i < count; i++) {
+        if (!rows[i]->error && fill_student(rows[i]) != 0) {
+            rows[i]->error = "names could not be stored (out of memory)";
+            rows[i]->error_column = -1;
+        }
+    }
+}
+
+static void *validate_stage(void *arg) {
+    pipeline_t *pipeline = arg;
+    import_stage_stats_t *stats = &pipeline->result->stages[IMPORT_STAGE_VALIDATE];
+    import_row_t *batch[IMPORT_VALIDATE_BATCH];
+    double start = now_seconds();
+    double waited = 0;
+    int done = 0;
+
+    while (!done) {
+        // Wait for one row, then take whatever else is already queued
+        double before = now_seconds();
+        import_row_t *row = ring_pop(&pipeline->parsed, stats);
+        waited += now_seconds() - before;
+        if (!row) {
+            break;
+        }
+        int count = 0;
+        batch[count++] = row;
+        void *item;
+        while (count < IMPORT_VALIDATE_BATCH && ring_try_pop(&pipeline->parsed, &item)) {
+            if (!item) {
+                done = 1;
+                break;
+            }
+            batch[count++] = item;
+        }
+
+        validate_batch(batch, count);
+        stats->rows += count;
+        before = now_seconds();
+        for (int i = 0; i < count; i++) {
+            ring_push(&pipeline->validated, batch[i], stats);
+        }
+        waited += now_seconds() - before;
+    }
+    ring_push(&pipeline->validated, NULL, stats);
+    stats->busy_seconds = now_seconds() - start - waited;
+    return NULL;
+}
+
+static void *assign_stage(void *arg) {
+    pipeline_t *pipeline = arg;
+    import_result_t *result = pipeline->result;
+    import_stage_stats_t *stats = &result->stages[IMPORT_STAGE_ASSIGN];
+    const char *counter_path = pipeline->options->counter_path;
+    FILE *errors = pipeline->options->errors;
+    double start = now_seconds();
+    double waited = 0;
+
+    int next_id = 0;
+    int reserved_until = 0;   // end of the block of IDs reserved so far
+    long written = 0;
+
+    for (;;) {
+        double before = now_seconds();
+        import_row_t *row = ring_pop(&pipeline->validated, stats);
+        waited += now_seconds() - before;
+        if (!row) {
+            break;
+        }
+        stats->rows++;
+        result->rows++;
+
+        if (row->error) {
+            if (row->error_column >= 0) {
+                fprintf(errors, "line %ld: %s %s\n", row->line, column_names[row->error_column], row->error);
+            } else {
+                fprintf(errors, "line %ld: %s\n", row->line, row->error);
+            }
+            result->rejected++;
+            mem_free(row);
+            continue;
+        }
+
+        if (next_id == reserved_until) {
+            // Reserve a block up front so a crash never reuses an ID
+            int first = record_reserve_ids(counter_path, IMPORT_ID_BLOCK);
+            if (first < 0) {
+                pipeline->counter_failed = 1;
+                mem_free(row);
+                result->rejected++;
+                continue;
+            }
+            next_id = first;
+            reserved_until = first + IMPORT_ID_BLOCK;
+        }
+        row->student.student_id = next_id++;
+        if (result->first_id == 0) {
+            result->first_id = row->student.student_id;
+        }
+        result->last_id = row->student.student_id;
+
+        before = now_seconds();
+        ring_push(&pipeline->assigned[written++ % pipeline->writers], row, stats);
+        waited += now_seconds() - before;
+    }
+
+    // Give back the unused part of the last block, unless IDs were taken after it
+    if (reserved_until != next_id && record_release_ids(counter_path, next_id, reserved_until) != 0) {
+        pipeline->counter_failed = 1;
+    }
+    for (int i = 0; i < pipeline->writers; i++) {
+        ring_push(&pipeline->assigned[i], NULL, stats);
+    }
+    stats->busy_seconds = now_seconds() - start - waited;
+    return NULL;
+}
+
+static void *write_stage(void *arg) {
+    writer_arg_t *writer = arg;
+    pipeline_t *pipeline = writer->pipeline;
+    import_stage_stats_t *stats = &pipeline->writer_stats[writer->index];
+    double start = now_seconds();
+    double waited = 0;
+    student_t *batch = mem_malloc(MEM_RECORDS, IMPORT_WRITE_BATCH * sizeof(student_t));
+    int pending = 0;
+
+    for (;;) {
+        double before = now_seconds();
+        import_row_t *row = ring_pop(&pipeline->assigned[writer->index], stats);
+        waited += now_seconds() - before;
+        if (row) {
+            if (batch) {
+                batch[pending++] = row->student;
+            } else {
+                pipeline->writer_failures[writer->index]++;
+            }
+            mem_free(row);
+        }
+        // One sync of the selected store per IMPORT_WRITE_BATCH rows
+        if (pending > 0 && (!row || pending >= IMPORT_WRITE_BATCH)) {
+            if (record_save_many(batch, pending) == 0) {
+                stats->rows += pending;
+            } else {
+                pipeline->writer_failures[writer->index] += pending;
+            }
+            pending = 0;
+        }
+        if (!row) {
+            break;
+        }
+    }
+    mem_free(batch);
+    stats->busy_seconds = now_seconds() - start - waited;
+    return NULL;
+}
+
+/*
+ * FUNCTION: import_csv
+ * =====================
+ * Imports every valid row of a CSV file as a new student
+ *
+ * Parameters:
+ *   - path: CSV file to read
+ *   - options: Pipeline settings, or NULL for defaults
+ *   - result: Receives row counts, the ID range and per-stage stats
+ *
+ * Returns:
+ *   - 0 if every valid row was written, -1 otherwise
+ */
+int import_csv(const char *path, const import_options_t *options, import_result_t *result) {
+    import_options_t defaults = {
+        .writers = 2,
+        .queue_capacity = 1024,
+        .counter_path = "data/next_id.txt",
+        .errors = stderr,
+        .separator = ',',
+    };
+    import_options_t opts = options ? *options : defaults;
+    if (opts.writers < 1) {
+        opts.writers = defaults.writers;
+    }
+    if (opts.writers > IMPORT_MAX_WRITERS) {
+        opts.writers = IMPORT_MAX_WRITERS;
+    }
+    if (opts.queue_capacity < 2 || (opts.queue_capacity & (opts.queue_capacity - 1)) != 0) {
+        opts.queue_capacity = defaults.queue_capacity;
+    }
+    if (!opts.counter_path) {
+        opts.counter_path = defaults.counter_path;
+    }
+    if (!opts.errors) {
+        opts.errors = defaults.errors;
+    }
+    if (!opts.separator) {
+        opts.separator = defaults.separator;
+    }
+
+    memset(result, 0, sizeof(*result));
+    int fd = open(path, O_RDONLY);
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st) != 0) {
+        if (fd >= 0) {
+            close(fd);
+        }
+        return -1;
+    }
+
+    // Map the whole file; the parser hands out views into it
+    size_t input_size = (size_t)st.st_size;
+    void *input = NULL;
+    if (input_size > 0) {
+        input = mmap(NULL, input_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (input == MAP_FAILED) {
+            close(fd);
+            return -1;
+        }
+        madvise(input, input_size, MADV_SEQUENTIAL);
+    }
+    close(fd);
+
+    pipeline_t *pipeline = mem_calloc(MEM_QUEUES, 1, sizeof(*pipeline));
+    if (!pipeline) {
+        if (input) {
+            munmap(input, input_size);
+        }
+        return -1;
+    }
+    pipeline->input = input;
+    pipeline->input_size = input_size;
+    pipeline->options = &opts;
+    pipeline->result = result;
+    pipeline->writers = opts.writers;
+
+    // Every ring is initialised, even after a failure, so all can be freed
+    int ok = ring_init(&pipeline->parsed, (size_t)opts.queue_capacity) == 0;
+    ok &= ring_init(&pipeline->validated, (size_t)opts.queue_capacity) == 0;
+    for (int i = 0; i < opts.writers; i++) {
+        ok &= ring_init(&pipeline->assigned[i], (size_t)opts.queue_capacity) == 0;
+    }
+
+    double start = now_seconds();
+    if (ok) {
+        pthread_t parse_thread;
+        pthread_t validate_thread;
+        pthread_t assign_thread;
+        pthread_t write_threads[IMPORT_MAX_WRITERS];
+        writer_arg_t writer_args[IMPORT_MAX_WRITERS];
+
+        // Downstream stages start first. If a thread cannot be created, the
+        // stream that stage would have produced is ended here instead, so
+        // the stages already running drain and exit.
+        int writers_started = 0;
+        while (writers_started < opts.writers) {
+            writer_args[writers_started] = (writer_arg_t){ pipeline, writers_started };
+            if (pthread_create(&write_threads[writers_started], NULL, write_stage,
+                               &writer_args[writers_started]) != 0) {
+                break;
+            }
+            writers_started++;
+        }
+        int assign_started = writers_started == opts.writers &&
+                             pthread_create(&assign_thread, NULL, assign_stage, pipeline) == 0;
+        int validate_started = assign_started && pthread_create(&validate_thread, NULL, validate_stage, pipeline) == 0;
+        int parse_started = validate_started && pthread_create(&parse_thread, NULL, parse_stage, pipeline) == 0;
+
+        if (!parse_started) {
+            import_stage_stats_t unused = { 0 };
+            ok = 0;
+            if (validate_started) {
+                ring_push(&pipeline->parsed, NULL, &unused);
+            } else if (assign_started) {
+                ring_push(&pipeline->validated, NULL, &unused);
+            } else {
+                for (int i = 0; i < writers_started; i++) {
+                    ring_push(&pipeline->assigned[i], NULL, &unused);
+                }
+            }
+        }
+
+        if (parse_started) {
+            pthread_join(parse_thread, NULL);
+        }
+        if (validate_started) {
+            pthread_join(validate_thread, NULL);
+        }
+        if (assign_started) {
+            pthread_join(assign_thread, NULL);
+        }
+        for (int i = 0; i < writers_started; i++) {
+            pthread_join(write_threads[i], NULL);
+        }
+    }
+    result->seconds = now_seconds() - start;
+
+    long failures = 0;
+    import_stage_stats_t *write = &result->stages[IMPORT_STAGE_WRITE];
+    for (int i = 0; i < opts.writers; i++) {
+        write->rows += pipeline->writer_stats[i].rows;
+        write->busy_seconds += pipeline->writer_stats[i].busy_seconds;
+        write->stalls += pipeline->writer_stats[i].stalls;
+        failures += pipeline->writer_failures[i];
+    }
+    result->imported = write->rows;
+    ok = ok && failures == 0 && !pipeline->counter_failed;
+
+    ring_free(&pipeline->parsed);
+    ring_free(&pipeline->validated);
+    for (int i = 0; i < opts.writers; i++) {
+        ring_free(&pipeline->assigned[i]);
+    }
+    mem_free(pipeline);
+    if (input) {
+        munmap(input, input_size);
+    }
+    return ok ? 0 : -1;
+}
+
+/*
+ * FUNCTION: import_print_result
+ * ==============================
+ * Prints the row counts and per-stage throughput of an import
+ */
+void import_print_result(const import_result_t *result) {
+    static const char *stage_names[IMPORT_STAGE_COUNT] = { "parse", "validate", "assign ID", "write" };
+
+    printf("✓ %ld rows read, %ld imported, %ld rejected in %.3f s\n",
+           result->rows, result->imported, result->rejected, result->seconds);
+    if (result->imported > 0) {
+        printf("✓ Student IDs %d-%d\n", result->first_id, result->last_id);
+    }
+    printf("Stage       Rows      Busy s    Rows/s busy  Stalls\n");
+    for (int i = 0; i < IMPORT_STAGE_COUNT; i++) {
+        const import_stage_stats_t *stage = &result->stages[i];
+        double rate = stage->busy_seconds > 0 ? stage->rows / stage->busy_seconds : 0;
+        printf("%-10s %6ld  %9.4f  %12.0f  %6ld\n",
+               stage_names[i], stage->rows, stage->busy_seconds, rate, stage->stalls);
+    }
+}
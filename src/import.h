@@ -0,0 +1,82 @@
+/*
+ * ============================================================================
+ * BULK CSV IMPORT
+ * ============================================================================
+ *
+ * Imports students from a CSV file with one student per line:
+ *
+ *     name,family_name,dob,student_id,father_name,mother_name,phone,grade,
+ *     subject1_name,subject1_grade, ... ,subject4_name,subject4_grade
+ *
+ * Fields may be quoted ("...", with "" for a literal quote). A first line
+ * whose first field is "name" is treated as a header and skipped. Tab-
+ * separated files work the same way with options->separator = '\t'.
+ * The file is mmapped and split by csv.c without copying.
+ *
+ * The import runs as a pipeline, each stage on its own thread(s),
+ * connected by bounded single-producer/single-consumer rings. A stage
+ * that finds its ring full or empty sleeps until the other side moves:
+ *
+ *     parse -> validate -> assign ID -> write (x writers)
+ *
+ * IDs are assigned by a single thread in input order, so the same file
+ * always gets the same IDs. Rows that fail validation are reported and
+ * do not consume an ID. Writers save records to the selected store
+ * (text, B+tree or LSM) in batches of up to IMPORT_WRITE_BATCH (see
+ * record_save_many), so a large import pays one disk flush per batch
+ * rather than per student. Their IDs are fresh, so the writers sync
+ * outside the record lock and overlap their flushes (the B+tree still
+ * commits one transaction at a time).
+ *
+ * ============================================================================
+ */
+
+#ifndef IMPORT_H
+#define IMPORT_H
+
+#include <stdio.h>
+
+#define IMPORT_COLUMNS 16
+#define IMPORT_MAX_WRITERS 16
+#define IMPORT_WRITE_BATCH 256
+
+typedef enum {
+    IMPORT_STAGE_PARSE,
+    IMPORT_STAGE_VALIDATE,
+    IMPORT_STAGE_ASSIGN,
+    IMPORT_STAGE_WRITE,
+    IMPORT_STAGE_COUNT
+} import_stage_t;
+
+/*
+ * Per-stage throughput: rows handled, seconds spent working (not waiting
+ * on a queue) and how often the stage had to wait
+ */
+typedef struct {
+    long rows;
+    double busy_seconds;
+    long stalls;
+} import_stage_stats_t;
+
+typedef struct {
+    int writers;              // write-stage threads (default 2)
+    int queue_capacity;       // slots per ring, power of two (default 1024)
+    const char *counter_path; // ID counter (default data/next_id.txt)
+    FILE *errors;             // per-row errors (default stderr)
+    char separator;           // ',' (default) or '\t' for TSV
+} import_options_t;
+
+typedef struct {
+    long rows;
+    long imported;
+    long rejected;
+    int first_id;
+    int last_id;
+    double seconds;
+    import_stage_stats_t stages[IMPORT_STAGE_COUNT];
+} import_result_t;
+
+int import_csv(const char *path, const import_options_t *options, import_result_t *result);
+void import_print_result(const import_result_t *result);
+
+#endif
@@ -0,0 +1,260 @@
+/*
+ * ============================================================================
+ * STRING INTERNING POOL
+ * ============================================================================
+ *
+ * See intern.h for the model.
+ *
+ * ============================================================================
+ */
+
+#include "intern.h"
+#include "mem.h"
+
+#include <errno.h>
+#include <stdint.h>
+#include <string.h>
+#include <pthread.h>
+
+// Strings are carved out of per-stripe chunks of this size
+#define CHUNK_SIZE 4096
+
+typedef struct {
+    uint64_t hash;
+    const char *value;   // NULL = empty slot
+    size_t length;
+} entry_t;
+
+typedef struct chunk {
+    struct chunk *next;
+    size_t used;
+    size_t size;
+    char data[];
+} chunk_t;
+
+/*
+ * One stripe: an open-addressing table plus the chunks its strings live
+ * in. Aligned to a cache line so neighbouring stripes' locks do not share
+ * one.
+ */
+typedef struct {
+    _Alignas(64) pthread_mutex_t lock;
+    entry_t *entries;
+    size_t capacity;     // power of two, 0 until first use
+    size_t count;
+    chunk_t *chunks;
+    size_t bytes;
+    size_t lookups;
+    size_t hits;
+    size_t refused;
+} stripe_t;
+
+static stripe_t stripes[INTERN_STRIPES];
+static pthread_once_t stripes_once = PTHREAD_ONCE_INIT;
+
+// Storage of all stripes together, checked against pool_limit
+static size_t pool_bytes;
+static size_t pool_limit = INTERN_DEFAULT_LIMIT;
+
+static void init_stripes(void) {
+    for (int i = 0; i < INTERN_STRIPES; i++) {
+        pthread_mutex_init(&stripes[i].lock, NULL);
+    }
+}
+
+static uint64_t hash_bytes(const char *value, size_t length) {
+    // FNV-1a, then a final mix so the low bits pick stripes evenly
+    uint64_t h = 14695981039346656037ull;
+    for (size_t i = 0; i < length; i++) {
+        h ^= (unsigned char)value[i];
+        h *= 1099511628211ull;
+    }
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdull;
+    h ^= h >> 33;
+    return h;
+}
+
+/*
+ * Claims bytes of the pool's budget before a stripe allocates them.
+ * Returns -1 if that would pass the limit.
+ */
+static int pool_reserve(size_t bytes) {
+    size_t limit = __atomic_load_n(&pool_limit, __ATOMIC_RELAXED);
+    size_t total = __atomic_add_fetch(&pool_bytes, bytes, __ATOMIC_RELAXED);
+    if (total > limit) {
+        __atomic_sub_fetch(&pool_bytes, bytes, __ATOMIC_RELAXED);
+        return -1;
+    }
+    return 0;
+}
+
+static void pool_release(size_t bytes) {
+    __atomic_sub_fetch(&pool_bytes, bytes, __ATOMIC_RELAXED);
+}
+
+static char *stripe_store(stripe_t *stripe, const char *value, size_t length) {
+    size_t need = length + 1;
+    chunk_t *chunk = stripe->chunks;
+    if (!chunk || chunk->size - chunk->used < need) {
+        // Big strings get a chunk of their own behind the current one
+        size_t size = need > CHUNK_SIZE / 4 ? need : CHUNK_SIZE;
+        if (pool_reserve(sizeof(chunk_t) + size) != 0) {
+            return NULL;
+        }
+        chunk_t *fresh = mem_malloc(MEM_STRINGS, sizeof(*fresh) + size);
+        if (!fresh) {
+            pool_release(sizeof(chunk_t) + size);
+            return NULL;
+        }
+        fresh->used = 0;
+        fresh->size = size;
+        if (chunk && size != CHUNK_SIZE) {
+            fresh->next = chunk->next;
+            chunk->next = fresh;
+        } else {
+            fresh->next = chunk;
+            stripe->chunks = fresh;
+        }
+        stripe->bytes += sizeof(*fresh) + size;
+        chunk = fresh;
+    }
+    char *copy = chunk->data + chunk->used;
+    chunk->used += need;
+    memcpy(copy, value, length);
+    copy[length] = '\0';
+    return copy;
+}
+
+static int stripe_grow(stripe_t *stripe) {
+    size_t capacity = stripe->capacity ? stripe->capacity * 2 : 64;
+    size_t added = (capacity - stripe->capacity) * sizeof(entry_t);
+    if (pool_reserve(added) != 0) {
+        return -1;
+    }
+    entry_t *entries = mem_calloc(MEM_STRINGS, capacity, sizeof(entry_t));
+    if (!entries) {
+        pool_release(added);
+        return -1;
+    }
+    for (size_t i = 0; i < stripe->capacity; i++) {
+        const entry_t *e = &stripe->entries[i];
+        if (e->value) {
+            size_t slot = (size_t)(e->hash >> 8) & (capacity - 1);
+            while (entries[slot].value) {
+                slot = (slot + 1) & (capacity - 1);
+            }
+            entries[slot] = *e;
+        }
+    }
+    stripe->bytes += added;
+    mem_free(stripe->entries);
+    stripe->entries = entries;
+    stripe->capacity = capacity;
+    return 0;
+}
+
+/*
+ * Probes a stripe for value. Returns its copy, or NULL with *slot set to
+ * the empty slot it would go in. The stripe's lock must be held.
+ */
+static const char *stripe_find(const stripe_t *stripe, uint64_t hash, const char *value,
+                               size_t length, size_t *slot) {
+    // Stripe is chosen by the low bits, the slot by the bits above them
+    size_t mask = stripe->capacity - 1;
+    size_t i = (size_t)(hash >> 8) & mask;
+    while (stripe->entries[i].value) {
+        const entry_t *e = &stripe->entries[i];
+        if (e->hash == hash && e->length == length && memcmp(e->value, value, length) == 0) {
+            return e->value;
+        }
+        i = (i + 1) & mask;
+    }
+    *slot = i;
+    return NULL;
+}
+
+/*
+ * FUNCTION: intern_n
+ * ===================
+ * Returns the pool's copy of length bytes of value (need not be
+ * NUL-terminated), adding it on first use
+ *
+ * Returns:
+ *   - Canonical NUL-terminated copy, valid for the life of the process
+ *   - NULL with errno ENOMEM if a new string would pass the pool's limit
+ *     or memory ran out
+ */
+const char *intern_n(const char *value, size_t length) {
+    pthread_once(&stripes_once, init_stripes);
+    uint64_t hash = hash_bytes(value, length);
+    stripe_t *stripe = &stripes[hash & (INTERN_STRIPES - 1)];
+    const char *result = NULL;
+
+    pthread_mutex_lock(&stripe->lock);
+    stripe->lookups++;
+    size_t slot = 0;
+    if (stripe->capacity && (result = stripe_find(stripe, hash, value, length, &slot)) != NULL) {
+        stripe->hits++;
+        pthread_mutex_unlock(&stripe->lock);
+        return result;
+    }
+
+    // A new string: grow first if needed, so a full pool still finds old ones
+    if ((stripe->count + 1) * 10 > stripe->capacity * 7) {
+        if (stripe_grow(stripe) == 0) {
+            stripe_find(stripe, hash, value, length, &slot);
+        } else {
+            slot = SIZE_MAX;
+        }
+    }
+    if (slot != SIZE_MAX) {
+        result = stripe_store(stripe, value, length);
+    }
+    if (result) {
+        stripe->entries[slot] = (entry_t){ hash, result, length };
+        stripe->count++;
+    } else {
+        stripe->refused++;
+    }
+    pthread_mutex_unlock(&stripe->lock);
+    if (!result) {
+        errno = ENOMEM;
+    }
+    return result;
+}
+
+const char *intern(const char *value) {
+    return intern_n(value, strlen(value));
+}
+
+/*
+ * FUNCTION: intern_set_limit
+ * ===========================
+ * Sets how many bytes the pool may allocate in total. Storage already
+ * allocated is kept even if it is over the new limit.
+ */
+void intern_set_limit(size_t bytes) {
+    __atomic_store_n(&pool_limit, bytes, __ATOMIC_RELAXED);
+}
+
+/*
+ * FUNCTION: intern_stats
+ * =======================
+ * Sums the counters of every stripe
+ */
+void intern_stats(intern_stats_t *stats) {
+    pthread_once(&stripes_once, init_stripes);
+    memset(stats, 0, sizeof(*stats));
+    for (int i = 0; i < INTERN_STRIPES; i++) {
+        stripe_t *stripe = &stripes[i];
+        pthread_mutex_lock(&stripe->lock);
+        stats->strings += stripe->count;
+        stats->bytes += stripe->bytes;
+        stats->lookups += stripe->lookups;
+        stats->hits += stripe->hits;
+        stats->refused += stripe->refused;
+        pthread_mutex_unlock(&stripe->lock);
+    }
+    stats->limit = __atomic_load_n(&pool_limit, __ATOMIC_RELAXED);
+}
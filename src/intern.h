@@ -0,0 +1,51 @@
+/*
+ * ============================================================================
+ * STRING INTERNING POOL
+ * ============================================================================
+ *
+ * Process-wide pool that keeps exactly one copy of each distinct string.
+ * intern_n returns the canonical copy, so two interned strings are equal
+ * exactly when their pointers are equal.
+ *
+ * Every long str_t value (more than 15 bytes) is interned. Records read
+ * by the loader, the importer and the snapshot builder therefore share
+ * one copy of each repeated long name, and str_eq compares such values
+ * by pointer. Short values are already stored inline in the str_t.
+ *
+ * The pool is split into INTERN_STRIPES independent hash tables, each
+ * with its own lock and its own storage, selected by the string's hash,
+ * so threads interning different strings rarely contend.
+ *
+ * str_t values are copied by value everywhere (struct assignment, memcpy
+ * into stores and snapshots), so no copy can tell the pool it is done
+ * with a string and interned strings are never freed. Instead the pool
+ * is bounded: once its storage would pass the limit (INTERN_DEFAULT_LIMIT
+ * unless intern_set_limit says otherwise), interning a new string fails
+ * with ENOMEM. Strings already in the pool are still found.
+ *
+ * ============================================================================
+ */
+
+#ifndef INTERN_H
+#define INTERN_H
+
+#include <stddef.h>
+
+#define INTERN_STRIPES 64
+#define INTERN_DEFAULT_LIMIT ((size_t)256 << 20)
+
+typedef struct {
+    size_t strings;     // distinct strings stored
+    size_t bytes;       // storage allocated for them (chunks + tables)
+    size_t lookups;     // intern calls
+    size_t hits;        // calls that found an existing copy
+    size_t refused;     // new strings turned away by the limit or malloc
+    size_t limit;       // storage limit in bytes
+} intern_stats_t;
+
+const char *intern_n(const char *value, size_t length);
+const char *intern(const char *value);
+void intern_set_limit(size_t bytes);
+void intern_stats(intern_stats_t *stats);
+
+#endif
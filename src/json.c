@@ -0,0 +1,419 @@
+/*
+ * ============================================================================
+ * JSON FOR STUDENT RECORDS
+ * ============================================================================
+ *
+ * See json.h. The writer appends to a json_buf_t that doubles as needed;
+ * the parser is a single pass over the input with no allocation.
+ *
+ * ============================================================================
+ */
+
+#include "json.h"
+#include "mem.h"
+
+#include <string.h>
+#include <math.h>
+
+void json_buf_append(json_buf_t *buf, const char *data, size_t length) {
+    if (buf->failed) {
+        return;
+    }
+    if (buf->length + length > buf->capacity) {
+        size_t capacity = buf->capacity ? buf->capacity : 256;
+        while (capacity < buf->length + length) {
+            capacity *= 2;
+        }
+        char *grown = mem_realloc(MEM_QUEUES, buf->data, capacity);
+        if (!grown) {
+            buf->failed = 1;
+            return;
+        }
+        buf->data = grown;
+        buf->capacity = capacity;
+    }
+    memcpy(buf->data + buf->length, data, length);
+    buf->length += length;
+}
+
+void json_buf_free(json_buf_t *buf) {
+    mem_free(buf->data);
+    memset(buf, 0, sizeof(*buf));
+}
+
+static void append_literal(json_buf_t *buf, const char *text) {
+    json_buf_append(buf, text, strlen(text));
+}
+
+/*
+ * FUNCTION: json_string
+ * ======================
+ * Appends value as a quoted string, escaping quotes, backslashes and
+ * control characters. Runs of plain bytes are copied in one append.
+ */
+void json_string(json_buf_t *buf, const char *value) {
+    static const char hex[] = "0123456789abcdef";
+    json_buf_append(buf, "\"", 1);
+    const char *run = value;
+    for (const char *p = value; *p; p++) {
+        unsigned char c = (unsigned char)*p;
+        if (c >= 0x20 && c != '"' && c != '\\') {
+            continue;
+        }
+        json_buf_append(buf, run, (size_t)(p - run));
+        run = p + 1;
+        if (c == '"' || c == '\\') {
+            char escape[2] = { '\\', (char)c };
+            json_buf_append(buf, escape, 2);
+        } else {
+            char escape[6] = { '\\', 'u', '0', '0', hex[c >> 4], hex[c & 15] };
+            json_buf_append(buf, escape, 6);
+        }
+    }
+    json_buf_append(buf, run, strlen(run));
+    json_buf_append(buf, "\"", 1);
+}
+
+void json_int(json_buf_t *buf, long value) {
+    char digits[24];
+    char *p = digits + sizeof(digits);
+    unsigned long magnitude = value < 0 ? 0UL - (unsigned long)value : (unsigned long)value;
+    do {
+        *--p = (char)('0' + magnitude % 10);
+        magnitude /= 10;
+    } while (magnitude);
+    if (value < 0) {
+        *--p = '-';
+    }
+    json_buf_append(buf, p, (size_t)(digits + sizeof(digits) - p));
+}
+
+/*
+ * FUNCTION: json_grade
+ * =====================
+ * Appends a grade rounded to two decimals, without trailing zeros
+ * (87.5, 90, 66.67). Values that are not finite are written as null.
+ */
+void json_grade(json_buf_t *buf, float value) {
+    if (!isfinite(value) || value > 1e15f || value < -1e15f) {
+        append_literal(buf, "null");
+        return;
+    }
+    double scaled = (double)value * 100.0;
+    long hundredths = (long)(scaled < 0 ? scaled - 0.5 : scaled + 0.5);
+    if (hundredths < 0) {
+        json_buf_append(buf, "-", 1);
+        hundredths = -hundredths;
+    }
+    json_int(buf, hundredths / 100);
+    int fraction = (int)(hundredths % 100);
+    if (fraction != 0) {
+        char decimals[3] = { '.', (char)('0' + fraction / 10), (char)('0' + fraction % 10) };
+        json_buf_append(buf, decimals, fraction % 10 ? 3 : 2);
+    }
+}
+
+/*
+ * FUNCTION: json_student
+ * =======================
+ * Appends a student as one flat object:
+ *   {"id":1,"name":"...","family_name":"...","dob":"...","student_id":"...",
+ *    "father_name":"...","mother_name":"...","phone":"...","grade":10,
+ *    "subject1_name":"...","subject1_grade":90, ... ,"average":75}
+ */
+void json_student(json_buf_t *buf, const student_t *s) {
+    static const char *const subject_keys[4][2] = {
+        { ",\"subject1_name\":", ",\"subject1_grade\":" },
+        { ",\"subject2_name\":", ",\"subject2_grade\":" },
+        { ",\"subject3_name\":", ",\"subject3_grade\":" },
+        { ",\"subject4_name\":", ",\"subject4_grade\":" },
+    };
+    const subject_t *subjects[] = { &s->subject1, &s->subject2, &s->subject3, &s->subject4 };
+    append_literal(buf, "{\"id\":");
+    json_int(buf, s->student_id);
+    append_literal(buf, ",\"name\":");
+    json_string(buf, str_get(&s->name));
+    append_literal(buf, ",\"family_name\":");
+    json_string(buf, str_get(&s->family_name));
+    append_literal(buf, ",\"dob\":");
+    json_string(buf, s->dateofbirth);
+    append_literal(buf, ",\"student_id\":");
+    json_string(buf, s->studentid);
+    append_literal(buf, ",\"father_name\":");
+    json_string(buf, str_get(&s->father_name));
+    append_literal(buf, ",\"mother_name\":");
+    json_string(buf, str_get(&s->mother_name));
+    append_literal(buf, ",\"phone\":");
+    json_string(buf, s->phone_number);
+    append_literal(buf, ",\"grade\":");
+    json_int(buf, s->grade);
+    for (int i = 0; i < 4; i++) {
+        append_literal(buf, subject_keys[i][0]);
+        json_string(buf, str_get(&subjects[i]->name));
+        append_literal(buf, subject_keys[i][1]);
+        json_grade(buf, subjects[i]->grade);
+    }
+    append_literal(buf, ",\"average\":");
+    json_grade(buf, s->average_grade);
+    json_buf_append(buf, "}", 1);
+}
+
+static size_t skip_space(const char *data, size_t length, size_t pos) {
+    while (pos < length && (data[pos] == ' ' || data[pos] == '\t' || data[pos] == '\n' || data[pos] == '\r')) {
+        pos++;
+    }
+    return pos;
+}
+
+// Scans a string starting at its opening quote; returns the position after the closing one, or 0
+static size_t scan_string(const char *data, size_t length, size_t pos, json_text_t *text) {
+    pos++;
+    text->data = data + pos;
+    text->escaped = 0;
+    while (pos < length && data[pos] != '"') {
+        if ((unsigned char)data[pos] < 0x20) {
+            return 0;
+        }
+        if (data[pos] == '\\') {
+            text->escaped = 1;
+            pos++;
+        }
+        pos++;
+    }
+    if (pos >= length) {
+        return 0;
+    }
+    text->length = (size_t)(data + pos - text->data);
+    return pos + 1;
+}
+
+// Scans a number (JSON grammar, checked loosely); returns the position after it, or 0
+static size_t scan_number(const char *data, size_t length, size_t pos, json_text_t *text) {
+    size_t start = pos;
+    if (pos < length && data[pos] == '-') {
+        pos++;
+    }
+    size_t digits = pos;
+    while (pos < length && ((data[pos] >= '0' && data[pos] <= '9') || data[pos] == '.' || data[pos] == 'e' ||
+                            data[pos] == 'E' || data[pos] == '+' || data[pos] == '-')) {
+        pos++;
+    }
+    if (pos == digits || data[digits] < '0' || data[digits] > '9') {
+        return 0;
+    }
+    text->data = data + start;
+    text->length = pos - start;
+    text->escaped = 0;
+    return pos;
+}
+
+/*
+ * FUNCTION: json_parse_object
+ * ============================
+ * Splits a flat JSON object into members
+ *
+ * Parameters:
+ *   - members: Receives up to max_members key/value views into data
+ *
+ * Returns:
+ *   - The number of members, or -1 if data is not a flat object or has
+ *     more than max_members members
+ */
+int json_parse_object(const char *data, size_t length, json_member_t *members, int max_members) {
+    static const struct {
+        const char *word;
+        json_type_t type;
+    } words[] = { { "true", JSON_TRUE }, { "false", JSON_FALSE }, { "null", JSON_NULL } };
+    size_t pos = skip_space(data, length, 0);
+    if (pos >= length || data[pos] != '{') {
+        return -1;
+    }
+    pos = skip_space(data, length, pos + 1);
+    int count = 0;
+    if (pos < length && data[pos] == '}') {
+        return skip_space(data, length, pos + 1) == length ? 0 : -1;
+    }
+    for (;;) {
+        if (count == max_members || pos >= length || data[pos] != '"') {
+            return -1;
+        }
+        json_member_t *member = &members[count++];
+        pos = scan_string(data, length, pos, &member->key);
+        if (pos == 0) {
+            return -1;
+        }
+        pos = skip_space(data, length, pos);
+        if (pos >= length || data[pos] != ':') {
+            return -1;
+        }
+        pos = skip_space(data, length, pos + 1);
+        if (pos >= length) {
+            return -1;
+        }
+        if (data[pos] == '"') {
+            member->type = JSON_STRING;
+            pos = scan_string(data, length, pos, &member->value);
+        } else if (data[pos] == '-' || (data[pos] >= '0' && data[pos] <= '9')) {
+            member->type = JSON_NUMBER;
+            pos = scan_number(data, length, pos, &member->value);
+        } else {
+            size_t start = pos;
+            pos = 0;
+            for (size_t i = 0; i < sizeof(words) / sizeof(words[0]); i++) {
+                size_t word_length = strlen(words[i].word);
+                if (length - start >= word_length && memcmp(data + start, words[i].word, word_length) == 0) {
+                    member->type = words[i].type;
+                    member->value.data = data + start;
+                    member->value.length = word_length;
+                    member->value.escaped = 0;
+                    pos = start + word_length;
+                    break;
+                }
+            }
+        }
+        if (pos == 0) {
+            return -1;
+        }
+        pos = skip_space(data, length, pos);
+        if (pos < length && data[pos] == ',') {
+            pos = skip_space(data, length, pos + 1);
+            continue;
+        }
+        if (pos < length && data[pos] == '}') {
+            return skip_space(data, length, pos + 1) == length ? count : -1;
+        }
+        return -1;
+    }
+}
+
+static int hex_value(char c) {
+    if (c >= '0' && c <= '9') {
+        return c - '0';
+    }
+    if (c >= 'a' && c <= 'f') {
+        return c - 'a' + 10;
+    }
+    if (c >= 'A' && c <= 'F') {
+        return c - 'A' + 10;
+    }
+    return -1;
+}
+
+// Reads the 4 hex digits of a \u escape at p; -1 if they are not hex
+static long read_hex4(const char *p, const char *end) {
+    if (end - p < 4) {
+        return -1;
+    }
+    long value = 0;
+    for (int i = 0; i < 4; i++) {
+        int digit = hex_value(p[i]);
+        if (digit < 0) {
+            return -1;
+        }
+        value = value * 16 + digit;
+    }
+    return value;
+}
+
+/*
+ * FUNCTION: json_copy
+ * ====================
+ * Copies a key or value into a NUL-terminated buffer, undoing escapes
+ * (\uXXXX becomes UTF-8; a lone surrogate becomes U+FFFD), truncating to
+ * size - 1 bytes
+ *
+ * Returns:
+ *   - The number of bytes copied (excluding the NUL)
+ */
+size_t json_copy(const json_text_t *text, char *dest, size_t size) {
+    if (size == 0) {
+        return 0;
+    }
+    size_t out = 0;
+    if (!text->escaped) {
+        out = text->length < size - 1 ? text->length : size - 1;
+        memcpy(dest, text->data, out);
+        dest[out] = '\0';
+        return out;
+    }
+    const char *p = text->data;
+    const char *end = text->data + text->length;
+    while (p < end && out < size - 1) {
+        if (*p != '\\' || p + 1 >= end) {
+            dest[out++] = *p++;
+            continue;
+        }
+        char c = p[1];
+        p += 2;
+        switch (c) {
+        case 'b':
+            dest[out++] = '\b';
+            continue;
+        case 'f':
+            dest[out++] = '\f';
+            continue;
+        case 'n':
+            dest[out++] = '\n';
+            continue;
+        case 'r':
+            dest[out++] = '\r';
+            continue;
+        case 't':
+            dest[out++] = '\t';
+            continue;
+        case 'u':
+            break;
+        default:
+            dest[out++] = c;
+            continue;
+        }
+        long code = read_hex4(p, end);
+        if (code < 0) {
+            continue;
+        }
+        p += 4;
+        if (code >= 0xD800 && code <= 0xDBFF && end - p >= 6 && p[0] == '\\' && p[1] == 'u') {
+            long low = read_hex4(p + 2, end);
+            if (low >= 0xDC00 && low <= 0xDFFF) {
+                code = 0x10000 + ((code - 0xD800) << 10) + (low - 0xDC00);
+                p += 6;
+            }
+        }
+        if (code >= 0xD800 && code <= 0xDFFF) {
+            code = 0xFFFD;
+        }
+        unsigned char bytes[4];
+        size_t n;
+        if (code < 0x80) {
+            bytes[0] = (unsigned char)code;
+            n = 1;
+        } else if (code < 0x800) {
+            bytes[0] = (unsigned char)(0xC0 | (code >> 6));
+            bytes[1] = (unsigned char)(0x80 | (code & 0x3F));
+            n = 2;
+        } else if (code < 0x10000) {
+            bytes[0] = (unsigned char)(0xE0 | (code >> 12));
+            bytes[1] = (unsigned char)(0x80 | ((code >> 6) & 0x3F));
+            bytes[2] = (unsigned char)(0x80 | (code & 0x3F));
+            n = 3;
+        } else {
+            bytes[0] = (unsigned char)(0xF0 | (code >> 18));
+            bytes[1] = (unsigned char)(0x80 | ((code >> 12) & 0x3F));
+            bytes[2] = (unsigned char)(0x80 | ((code >> 6) & 0x3F));
+            bytes[3] = (unsigned char)(0x80 | (code & 0x3F));
+            n = 4;
+        }
+        if (out + n > size - 1) {
+            break;
+        }
+        memcpy(dest + out, bytes, n);
+        out += n;
+    }
+    dest[out] = '\0';
+    return out;
+}
+
+int json_key_is(const json_member_t *member, const char *key) {
+    size_t length = strlen(key);
+    return !member->key.escaped && member->key.length == length && memcmp(member->key.data, key, length) == 0;
+}
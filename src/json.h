@@ -0,0 +1,69 @@
+/*
+ * ============================================================================
+ * JSON FOR STUDENT RECORDS
+ * ============================================================================
+ *
+ * Just enough JSON for the HTTP API (http.h):
+ *
+ *   - json_student writes a student_t as one flat object whose keys are
+ *     the `app import` column names plus "id" and "average". Numbers are
+ *     formatted by hand (integers, and grades to two decimals with
+ *     trailing zeros dropped) instead of through printf.
+ *   - json_parse_object splits a flat object of strings, numbers, true,
+ *     false and null into member views, csv.h style: keys and values
+ *     point into the input and are only unescaped when copied out with
+ *     json_copy. Nested objects and arrays are rejected.
+ *
+ * ============================================================================
+ */
+
+#ifndef JSON_H
+#define JSON_H
+
+#include <stddef.h>
+#include "student.h"
+
+#define JSON_MAX_MEMBERS 32
+
+typedef enum {
+    JSON_STRING,
+    JSON_NUMBER,
+    JSON_TRUE,
+    JSON_FALSE,
+    JSON_NULL
+} json_type_t;
+
+// A key or value; data/length exclude the quotes of a string
+typedef struct {
+    const char *data;
+    size_t length;
+    int escaped;              // contains backslash escapes (see json_copy)
+} json_text_t;
+
+typedef struct {
+    json_text_t key;
+    json_text_t value;
+    json_type_t type;
+} json_member_t;
+
+// Growable output buffer; all-zero is empty
+typedef struct {
+    char *data;
+    size_t length;
+    size_t capacity;
+    int failed;               // an allocation failed; data is incomplete
+} json_buf_t;
+
+void json_buf_append(json_buf_t *buf, const char *data, size_t length);
+void json_buf_free(json_buf_t *buf);
+
+void json_string(json_buf_t *buf, const char *value);
+void json_int(json_buf_t *buf, long value);
+void json_grade(json_buf_t *buf, float value);
+void json_student(json_buf_t *buf, const student_t *student);
+
+int json_parse_object(const char *data, size_t length, json_member_t *members, int max_members);
+size_t json_copy(const json_text_t *text, char *dest, size_t size);
+int json_key_is(const json_member_t *member, const char *key);
+
+#endif
@@ -0,0 +1,1279 @@
+/*
+ * ============================================================================
+ * LOG-STRUCTURED MERGE STORE (data/lsm/)
+ * ============================================================================
+ *
+ * See lsm.h for the write path, file formats and compaction policy.
+ *
+ * Locking: lsm->lock guards the memtables, the run list and the stats.
+ * Runs are immutable, so the background thread writes new runs without
+ * the lock and only takes it to swap them in. Only the background thread
+ * (or open, before it starts) changes the run list or the MANIFEST.
+ *
+ * ============================================================================
+ */
+
+#include "lsm.h"
+#include "crc32c.h"
+#include "mem.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <limits.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+
+#define LSM_DEFAULT_MEMTABLE_BYTES ((size_t)4 << 20)
+#define LSM_DEFAULT_COMPACT_TRIGGER 4
+
+// WAL record header, followed by length bytes of value (none for a delete)
+typedef struct {
+    uint32_t crc;            // CRC32C of id, length and the value
+    int32_t id;
+    uint32_t length;
+} wal_head_t;
+
+/*
+ * Memtable
+ * ========
+ * Entries in insertion order plus an open-addressing hash on the ID
+ */
+static uint32_t hash_id(int32_t id) {
+    return (uint32_t)id * 2654435761u;
+}
+
+static size_t entry_bytes(uint32_t length) {
+    return sizeof(lsm_entry_t) + (length == LSM_TOMBSTONE ? 0 : length);
+}
+
+static void memtable_free(lsm_memtable_t *table) {
+    for (int i = 0; i < table->count; i++) {
+        mem_free(table->entries[i].value);
+    }
+    mem_free(table->entries);
+    mem_free(table->slots);
+    memset(table, 0, sizeof(*table));
+}
+
+static int memtable_find(const lsm_memtable_t *table, int32_t id) {
+    if (table->slot_capacity == 0) {
+        return -1;
+    }
+    int mask = table->slot_capacity - 1;
+    int slot = (int)(hash_id(id) & (uint32_t)mask);
+    while (table->slots[slot] != 0) {
+        int index = table->slots[slot] - 1;
+        if (table->entries[index].id == id) {
+            return index;
+        }
+        slot = (slot + 1) & mask;
+    }
+    return -1;
+}
+
+static int memtable_rehash(lsm_memtable_t *table, int capacity) {
+    int *slots = mem_calloc(MEM_RECORDS, (size_t)capacity, sizeof(int));
+    if (!slots) {
+        return -1;
+    }
+    for (int i = 0; i < table->count; i++) {
+        int slot = (int)(hash_id(table->entries[i].id) & (uint32_t)(capacity - 1));
+        while (slots[slot] != 0) {
+            slot = (slot + 1) & (capacity - 1);
+        }
+        slots[slot] = i + 1;
+    }
+    mem_free(table->slots);
+    table->slots = slots;
+    table->slot_capacity = capacity;
+    return 0;
+}
+
+// Stores a copy of value (NULL with LSM_TOMBSTONE for a delete)
+static int memtable_set(lsm_memtable_t *table, int32_t id, const unsigned char *value, uint32_t length) {
+    unsigned char *copy = NULL;
+    if (length != LSM_TOMBSTONE) {
+        copy = mem_malloc(MEM_RECORDS, length ? length : 1);
+        if (!copy) {
+            return -1;
+        }
+        memcpy(copy, value, length);
+    }
+
+    int index = memtable_find(table, id);
+    if (index >= 0) {
+        lsm_entry_t *entry = &table->entries[index];
+        table->bytes += entry_bytes(length) - entry_bytes(entry->length);
+        mem_free(entry->value);
+        entry->value = copy;
+        entry->length = length;
+        return 0;
+    }
+
+    if (table->count == table->capacity) {
+        int capacity = table->capacity ? table->capacity * 2 : 256;
+        lsm_entry_t *entries = mem_realloc(MEM_RECORDS, table->entries, (size_t)capacity * sizeof(*entries));
+        if (!entries) {
+            mem_free(copy);
+            return -1;
+        }
+        table->entries = entries;
+        table->capacity = capacity;
+    }
+    if ((table->count + 1) * 2 > table->slot_capacity &&
+        memtable_rehash(table, table->slot_capacity ? table->slot_capacity * 2 : 512) != 0) {
+        mem_free(copy);
+        return -1;
+    }
+    table->entries[table->count] = (lsm_entry_t){ id, length, copy };
+    int mask = table->slot_capacity - 1;
+    int slot = (int)(hash_id(id) & (uint32_t)mask);
+    while (table->slots[slot] != 0) {
+        slot = (slot + 1) & mask;
+    }
+    table->slots[slot] = ++table->count;
+    table->bytes += entry_bytes(length);
+    return 0;
+}
+
+static int compare_entries(const void *a, const void *b) {
+    int32_t x = ((const lsm_entry_t *)a)->id;
+    int32_t y = ((const lsm_entry_t *)b)->id;
+    return (x > y) - (x < y);
+}
+
+/*
+ * Bloom Filters
+ * =============
+ * LSM_BLOOM_HASHES bit positions per ID from one 64-bit hash
+ * (Kirsch-Mitzenmacher double hashing)
+ */
+static uint64_t mix64(uint64_t x) {
+    x ^= x >> 30;
+    x *= 0xbf58476d1ce4e5b9ull;
+    x ^= x >> 27;
+    x *= 0x94d049bb133111ebull;
+    return x ^ (x >> 31);
+}
+
+static void bloom_add(uint64_t *bloom, uint32_t words, int32_t id) {
+    uint64_t h = mix64((uint32_t)id);
+    uint64_t bits = (uint64_t)words * 64;
+    for (uint64_t k = 0; k < LSM_BLOOM_HASHES; k++) {
+        uint64_t bit = ((uint32_t)h + k * ((h >> 32) | 1)) % bits;
+        bloom[bit / 64] |= 1ull << (bit % 64);
+    }
+}
+
+static int bloom_may_contain(const uint64_t *bloom, uint32_t words, int32_t id) {
+    uint64_t h = mix64((uint32_t)id);
+    uint64_t bits = (uint64_t)words * 64;
+    for (uint64_t k = 0; k < LSM_BLOOM_HASHES; k++) {
+        uint64_t bit = ((uint32_t)h + k * ((h >> 32) | 1)) % bits;
+        if (!(bloom[bit / 64] & (1ull << (bit % 64)))) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+/*
+ * Files
+ * =====
+ */
+static void file_path(const lsm_t *lsm, const char *prefix, uint64_t seq, const char *suffix,
+                      char *buf, size_t size) {
+    snprintf(buf, size, "%s/%s%llu%s", lsm->dir, prefix, (unsigned long long)seq, suffix);
+}
+
+// Parses names like run_12.sst; returns 0 on a match
+static int parse_name(const char *name, const char *prefix, const char *suffix, uint64_t *seq) {
+    size_t prefix_length = strlen(prefix);
+    if (strncmp(name, prefix, prefix_length) != 0) {
+        return -1;
+    }
+    char *end;
+    errno = 0;
+    unsigned long long value = strtoull(name + prefix_length, &end, 10);
+    if (errno != 0 || end == name + prefix_length || strcmp(end, suffix) != 0) {
+        return -1;
+    }
+    *seq = value;
+    return 0;
+}
+
+static int sync_dir(const lsm_t *lsm) {
+    int fd = open(lsm->dir, O_RDONLY);
+    if (fd < 0) {
+        return -1;
+    }
+    int rc = fsync(fd);
+    close(fd);
+    return rc;
+}
+
+static int open_wal(const lsm_t *lsm, uint64_t seq) {
+    char path[320];
+    file_path(lsm, "wal_", seq, ".log", path, sizeof(path));
+    int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_APPEND, 0644);
+    if (fd >= 0 && sync_dir(lsm) != 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+static void remove_wal(const lsm_t *lsm, uint64_t seq) {
+    char path[320];
+    file_path(lsm, "wal_", seq, ".log", path, sizeof(path));
+    remove(path);
+}
+
+static uint32_t run_checksum(const lsm_run_header_t *header) {
+    return crc32c(0, header, offsetof(lsm_run_header_t, checksum));
+}
+
+static lsm_run_t *run_open(const char *path, uint64_t seq) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        return NULL;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(lsm_run_header_t)) {
+        close(fd);
+        errno = EBADMSG;
+        return NULL;
+    }
+    size_t size = (size_t)st.st_size;
+    void *map = mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        return NULL;
+    }
+    const lsm_run_header_t *header = map;
+    if (memcmp(header->magic, LSM_MAGIC, sizeof(header->magic)) != 0 ||
+        header->format_version != LSM_FORMAT_VERSION ||
+        header->checksum != run_checksum(header) ||
+        header->file_size != size ||
+        header->index_offset % 8 != 0 ||
+        header->index_offset + (uint64_t)header->count * sizeof(lsm_index_t) != header->bloom_offset ||
+        header->bloom_offset + (uint64_t)header->bloom_words * 8 != header->file_size ||
+        header->bloom_words == 0) {
+        munmap(map, size);
+        errno = EBADMSG;
+        return NULL;
+    }
+    lsm_run_t *run = mem_calloc(MEM_INDEXES, 1, sizeof(*run));
+    if (!run) {
+        munmap(map, size);
+        return NULL;
+    }
+    run->seq = seq;
+    run->map = map;
+    run->size = size;
+    run->header = header;
+    run->index = (const lsm_index_t *)((const unsigned char *)map + header->index_offset);
+    run->bloom = (const uint64_t *)((const unsigned char *)map + header->bloom_offset);
+    run->refs = 1;
+    mem_mapped(MEM_INDEXES, (long)size);
+    return run;
+}
+
+// Drops one reference; the last one unmaps the run (and deletes it once compacted away)
+static void run_release(const lsm_t *lsm, lsm_run_t *run) {
+    if (--run->refs > 0) {
+        return;
+    }
+    if (run->obsolete) {
+        char path[320];
+        file_path(lsm, "run_", run->seq, ".sst", path, sizeof(path));
+        remove(path);
+    }
+    munmap((void *)run->map, run->size);
+    mem_mapped(MEM_INDEXES, -(long)run->size);
+    mem_free(run);
+}
+
+// Finds id in a run; returns 1 if present (possibly as a delete marker)
+static int run_find(lsm_t *lsm, const lsm_run_t *run, int32_t id, const unsigned char **value, uint32_t *length) {
+    if (!bloom_may_contain(run->bloom, run->header->bloom_words, id)) {
+        lsm->stats.bloom_skips++;
+        return 0;
+    }
+    int lo = 0;
+    int hi = (int)run->header->count;
+    while (lo < hi) {
+        int mid = (lo + hi) / 2;
+        if (run->index[mid].id < id) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    if (lo == (int)run->header->count || run->index[lo].id != id) {
+        return 0;
+    }
+    *length = run->index[lo].length;
+    *value = run->map + run->index[lo].offset;
+    return 1;
+}
+
+/*
+ * Merging
+ * =======
+ * A cursor walks a sorted memtable copy or a run. merge() visits every
+ * ID once in ascending order, taking the version from the newest source.
+ */
+typedef struct {
+    const lsm_entry_t *entries;
+    const lsm_run_t *run;
+    int pos;
+    int end;
+} cursor_t;
+
+typedef int (*emit_fn)(int32_t id, const unsigned char *value, uint32_t length, void *arg);
+
+static int32_t cursor_id(const cursor_t *cursor) {
+    return cursor->entries ? cursor->entries[cursor->pos].id : cursor->run->index[cursor->pos].id;
+}
+
+static uint32_t cursor_value(const cursor_t *cursor, const unsigned char **value) {
+    if (cursor->entries) {
+        *value = cursor->entries[cursor->pos].value;
+        return cursor->entries[cursor->pos].length;
+    }
+    const lsm_index_t *entry = &cursor->run->index[cursor->pos];
+    *value = cursor->run->map + entry->offset;
+    return entry->length;
+}
+
+// Cursor over the IDs first..last of a run
+static cursor_t run_cursor(const lsm_run_t *run, int32_t first, int32_t last) {
+    int count = (int)run->header->count;
+    int lo = 0;
+    int hi = count;
+    while (lo < hi) {
+        int mid = (lo + hi) / 2;
+        if (run->index[mid].id < first) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    int end = lo;
+    hi = count;
+    while (end < hi) {
+        int mid = (end + hi) / 2;
+        if (run->index[mid].id <= last) {
+            end = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return (cursor_t){ NULL, run, lo, end };
+}
+
+// cursors[0] is the newest source
+static int merge(cursor_t *cursors, int count, int drop_deleted, emit_fn emit, void *arg) {
+    for (;;) {
+        int winner = -1;
+        int32_t id = 0;
+        for (int i = 0; i < count; i++) {
+            if (cursors[i].pos < cursors[i].end && (winner < 0 || cursor_id(&cursors[i]) < id)) {
+                winner = i;
+                id = cursor_id(&cursors[i]);
+            }
+        }
+        if (winner < 0) {
+            return 0;
+        }
+        const unsigned char *value;
+        uint32_t length = cursor_value(&cursors[winner], &value);
+        for (int i = winner; i < count; i++) {
+            if (cursors[i].pos < cursors[i].end && cursor_id(&cursors[i]) == id) {
+                cursors[i].pos++;
+            }
+        }
+        if (length == LSM_TOMBSTONE && drop_deleted) {
+            continue;
+        }
+        if (emit(id, value, length, arg) != 0) {
+            return -1;
+        }
+    }
+}
+
+typedef struct {
+    FILE *file;
+    uint64_t offset;
+    lsm_index_t *index;
+    int count;
+    int capacity;
+} run_writer_t;
+
+static int emit_to_run(int32_t id, const unsigned char *value, uint32_t length, void *arg) {
+    run_writer_t *writer = arg;
+    if (writer->count == writer->capacity) {
+        int capacity = writer->capacity ? writer->capacity * 2 : 1024;
+        lsm_index_t *index = mem_realloc(MEM_INDEXES, writer->index, (size_t)capacity * sizeof(*index));
+        if (!index) {
+            return -1;
+        }
+        writer->index = index;
+        writer->capacity = capacity;
+    }
+    writer->index[writer->count++] = (lsm_index_t){ id, length, writer->offset };
+    if (length != LSM_TOMBSTONE) {
+        if (fwrite(value, 1, length, writer->file) != length) {
+            return -1;
+        }
+        writer->offset += length;
+    }
+    return 0;
+}
+
+/*
+ * FUNCTION: write_run
+ * ====================
+ * Merges the cursors into run_[seq].sst through a temporary file
+ *
+ * Returns:
+ *   - 0 on success with *out set to the opened run, or NULL if the merge
+ *     produced nothing; -1 on error
+ */
+static int write_run(const lsm_t *lsm, uint64_t seq, cursor_t *cursors, int count, int drop_deleted,
+                     lsm_run_t **out) {
+    char path[320];
+    char tempname[330];
+    file_path(lsm, "run_", seq, ".sst", path, sizeof(path));
+    snprintf(tempname, sizeof(tempname), "%s.tmp", path);
+    *out = NULL;
+
+    FILE *file = fopen(tempname, "wb");
+    if (!file) {
+        return -1;
+    }
+    lsm_run_header_t header;
+    memset(&header, 0, sizeof(header));
+    run_writer_t writer = { file, sizeof(header), NULL, 0, 0 };
+    int ok = fwrite(&header, sizeof(header), 1, file) == 1 &&
+             merge(cursors, count, drop_deleted, emit_to_run, &writer) == 0;
+    if (ok && writer.count == 0) {
+        fclose(file);
+        remove(tempname);
+        return 0;
+    }
+
+    static const unsigned char padding[8];
+    size_t pad = (size_t)((8 - writer.offset % 8) % 8);
+    uint32_t words = (uint32_t)(((uint64_t)writer.count * LSM_BLOOM_BITS_PER_KEY + 63) / 64);
+    uint64_t *bloom = mem_calloc(MEM_INDEXES, words, sizeof(uint64_t));
+    ok = ok && bloom && fwrite(padding, 1, pad, file) == pad;
+    for (int i = 0; ok && i < writer.count; i++) {
+        bloom_add(bloom, words, writer.index[i].id);
+    }
+
+    memcpy(header.magic, LSM_MAGIC, sizeof(header.magic));
+    header.format_version = LSM_FORMAT_VERSION;
+    header.count = (uint32_t)writer.count;
+    header.bloom_words = words;
+    header.index_offset = writer.offset + pad;
+    header.bloom_offset = header.index_offset + (uint64_t)writer.count * sizeof(lsm_index_t);
+    header.file_size = header.bloom_offset + (uint64_t)words * sizeof(uint64_t);
+    header.checksum = run_checksum(&header);
+    ok = ok && fwrite(writer.index, sizeof(lsm_index_t), (size_t)writer.count, file) == (size_t)writer.count &&
+         fwrite(bloom, sizeof(uint64_t), words, file) == words &&
+         fseek(file, 0, SEEK_SET) == 0 && fwrite(&header, sizeof(header), 1, file) == 1 &&
+         fflush(file) == 0 && fdatasync(fileno(file)) == 0;
+    if (fclose(file) != 0) {
+        ok = 0;
+    }
+    mem_free(writer.index);
+    mem_free(bloom);
+    if (!ok || rename(tempname, path) != 0) {
+        remove(tempname);
+        return -1;
+    }
+    *out = run_open(path, seq);
+    return *out ? 0 : -1;
+}
+
+/*
+ * MANIFEST
+ * ========
+ *     LSM_MANIFEST = 1
+ *     WAL_FLOOR = 7       (WALs numbered below this are in runs)
+ *     RUN = 3             (one line per run, oldest first)
+ */
+static int write_manifest(const lsm_t *lsm, lsm_run_t *const *runs, int count, uint64_t wal_floor) {
+    char path[320];
+    char tempname[330];
+    snprintf(path, sizeof(path), "%s/MANIFEST", lsm->dir);
+    snprintf(tempname, sizeof(tempname), "%s.tmp", path);
+    FILE *file = fopen(tempname, "w");
+    if (!file) {
+        return -1;
+    }
+    int ok = fprintf(file, "LSM_MANIFEST = %d\nWAL_FLOOR = %llu\n", LSM_FORMAT_VERSION,
+                     (unsigned long long)wal_floor) > 0;
+    for (int i = 0; ok && i < count; i++) {
+        ok = fprintf(file, "RUN = %llu\n", (unsigned long long)runs[i]->seq) > 0;
+    }
+    ok = ok && fflush(file) == 0 && fdatasync(fileno(file)) == 0;
+    if (fclose(file) != 0) {
+        ok = 0;
+    }
+    if (!ok || rename(tempname, path) != 0 || sync_dir(lsm) != 0) {
+        remove(tempname);
+        return -1;
+    }
+    return 0;
+}
+
+// Reads the run numbers (oldest first) and the WAL floor; a missing file is an empty store
+static int read_manifest(const lsm_t *lsm, uint64_t *seqs, int *count, uint64_t *wal_floor) {
+    char path[320];
+    snprintf(path, sizeof(path), "%s/MANIFEST", lsm->dir);
+    *count = 0;
+    *wal_floor = 0;
+    FILE *file = fopen(path, "r");
+    if (!file) {
+        return errno == ENOENT ? 0 : -1;
+    }
+    char line[128];
+    int version = 0;
+    int ok = 1;
+    while (ok && fgets(line, sizeof(line), file)) {
+        unsigned long long value;
+        if (sscanf(line, "LSM_MANIFEST = %d", &version) == 1) {
+            continue;
+        }
+        if (sscanf(line, "WAL_FLOOR = %llu", &value) == 1) {
+            *wal_floor = value;
+        } else if (sscanf(line, "RUN = %llu", &value) == 1 && *count < LSM_MAX_RUNS) {
+            seqs[(*count)++] = value;
+        } else {
+            ok = 0;
+        }
+    }
+    fclose(file);
+    if (!ok || version != LSM_FORMAT_VERSION) {
+        errno = EBADMSG;
+        return -1;
+    }
+    return 0;
+}
+
+/*
+ * Background Work
+ * ===============
+ * Both functions are entered and left with lsm->lock held
+ */
+static void flush_frozen(lsm_t *lsm) {
+    lsm_memtable_t *frozen = &lsm->frozen;
+    uint64_t seq = lsm->next_seq++;
+    pthread_mutex_unlock(&lsm->lock);
+
+    // The frozen memtable is read-only, so it is safe to read unlocked
+    lsm_entry_t *sorted = mem_malloc(MEM_RECORDS, (size_t)(frozen->count ? frozen->count : 1) * sizeof(lsm_entry_t));
+    lsm_run_t *run = NULL;
+    int ok = sorted != NULL;
+    if (ok) {
+        memcpy(sorted, frozen->entries, (size_t)frozen->count * sizeof(lsm_entry_t));
+        qsort(sorted, (size_t)frozen->count, sizeof(lsm_entry_t), compare_entries);
+        // Deletes stay in the run: older runs may still hold the ID
+        cursor_t cursor = { sorted, NULL, 0, frozen->count };
+        ok = write_run(lsm, seq, &cursor, 1, 0, &run) == 0;
+    }
+    mem_free(sorted);
+
+    pthread_mutex_lock(&lsm->lock);
+    lsm_run_t *runs[LSM_MAX_RUNS];
+    int count = lsm->run_count;
+    memcpy(runs, lsm->runs, (size_t)count * sizeof(runs[0]));
+    if (run) {
+        runs[count++] = run;
+    }
+    if (ok && write_manifest(lsm, runs, count, frozen->wal_seq + 1) == 0) {
+        memcpy(lsm->runs, runs, (size_t)count * sizeof(runs[0]));
+        lsm->run_count = count;
+        // Later MANIFESTs (compaction) must keep this WAL out of replay
+        lsm->wal_floor = frozen->wal_seq + 1;
+        remove_wal(lsm, frozen->wal_seq);
+        memtable_free(frozen);
+        lsm->has_frozen = 0;
+        lsm->stats.flushes++;
+    } else {
+        if (run) {
+            run->obsolete = 1;
+            run_release(lsm, run);
+        }
+        lsm->error = 1;
+    }
+    pthread_cond_broadcast(&lsm->changed);
+}
+
+static void compact_runs(lsm_t *lsm) {
+    int count = lsm->run_count;
+    lsm_run_t *inputs[LSM_MAX_RUNS];
+    cursor_t cursors[LSM_MAX_RUNS];
+    for (int i = 0; i < count; i++) {
+        inputs[i] = lsm->runs[i];
+        cursors[count - 1 - i] = run_cursor(inputs[i], INT32_MIN, INT32_MAX);
+    }
+    uint64_t seq = lsm->next_seq++;
+    lsm->compacting = 1;
+    pthread_mutex_unlock(&lsm->lock);
+
+    // Every run takes part, so deleted IDs can be dropped for good
+    lsm_run_t *run = NULL;
+    int ok = write_run(lsm, seq, cursors, count, 1, &run) == 0;
+
+    pthread_mutex_lock(&lsm->lock);
+    // Runs flushed meanwhile are newer and stay after the merged one
+    lsm_run_t *runs[LSM_MAX_RUNS];
+    int merged = 0;
+    if (run) {
+        runs[merged++] = run;
+    }
+    memcpy(runs + merged, lsm->runs + count, (size_t)(lsm->run_count - count) * sizeof(runs[0]));
+    int total = merged + lsm->run_count - count;
+    if (ok && write_manifest(lsm, runs, total, lsm->wal_floor) == 0) {
+        memcpy(lsm->runs, runs, (size_t)total * sizeof(runs[0]));
+        lsm->run_count = total;
+        for (int i = 0; i < count; i++) {
+            inputs[i]->obsolete = 1;
+            run_release(lsm, inputs[i]);
+        }
+        lsm->stats.compactions++;
+    } else {
+        if (run) {
+            run->obsolete = 1;
+            run_release(lsm, run);
+        }
+        lsm->error = 1;
+    }
+    lsm->compacting = 0;
+    pthread_cond_broadcast(&lsm->changed);
+}
+
+static void *worker_main(void *arg) {
+    lsm_t *lsm = arg;
+    pthread_mutex_lock(&lsm->lock);
+    while (!lsm->stop) {
+        int compact = !lsm->error && (lsm->run_count >= lsm->options.compact_trigger ||
+                                      (lsm->force_compact && lsm->run_count > 1));
+        int flush = !lsm->error && lsm->has_frozen;
+        // Flushing first keeps writers from stalling, unless the run list is full
+        if (flush && !(compact && lsm->run_count >= LSM_MAX_RUNS - 1)) {
+            flush_frozen(lsm);
+        } else if (compact) {
+            compact_runs(lsm);
+        } else {
+            pthread_cond_wait(&lsm->changed, &lsm->lock);
+        }
+    }
+    pthread_mutex_unlock(&lsm->lock);
+    return NULL;
+}
+
+/*
+ * Recovery
+ * ========
+ */
+static int compare_seq(const void *a, const void *b) {
+    uint64_t x = *(const uint64_t *)a;
+    uint64_t y = *(const uint64_t *)b;
+    return (x > y) - (x < y);
+}
+
+// Applies a WAL to the active memtable, stopping at a torn or damaged record
+static int replay_wal(lsm_t *lsm, uint64_t seq) {
+    char path[320];
+    file_path(lsm, "wal_", seq, ".log", path, sizeof(path));
+    FILE *file = fopen(path, "rb");
+    if (!file) {
+        return -1;
+    }
+    long size = -1;
+    if (fseek(file, 0, SEEK_END) == 0) {
+        size = ftell(file);
+        rewind(file);
+    }
+    unsigned char *data = size > 0 ? mem_malloc(MEM_LOGS, (size_t)size) : NULL;
+    int ok = size == 0 || (data && fread(data, 1, (size_t)size, file) == (size_t)size);
+    fclose(file);
+
+    size_t offset = 0;
+    while (ok && offset + sizeof(wal_head_t) <= (size_t)size) {
+        wal_head_t head;
+        memcpy(&head, data + offset, sizeof(head));
+        size_t length = head.length == LSM_TOMBSTONE ? 0 : head.length;
+        if (offset + sizeof(head) + length > (size_t)size) {
+            break;
+        }
+        const unsigned char *value = data + offset + sizeof(head);
+        uint32_t crc = crc32c(crc32c(0, &head.id, sizeof(head.id) + sizeof(head.length)), value, length);
+        if (crc != head.crc) {
+            break;
+        }
+        ok = memtable_set(&lsm->active, head.id, head.length == LSM_TOMBSTONE ? NULL : value, head.length) == 0;
+        offset += sizeof(head) + length;
+    }
+    mem_free(data);
+    return ok ? 0 : -1;
+}
+
+static int recover(lsm_t *lsm) {
+    uint64_t run_seqs[LSM_MAX_RUNS];
+    int run_total;
+    if (read_manifest(lsm, run_seqs, &run_total, &lsm->wal_floor) != 0) {
+        return -1;
+    }
+    for (int i = 0; i < run_total; i++) {
+        char path[320];
+        file_path(lsm, "run_", run_seqs[i], ".sst", path, sizeof(path));
+        lsm_run_t *run = run_open(path, run_seqs[i]);
+        if (!run) {
+            return -1;
+        }
+        lsm->runs[lsm->run_count++] = run;
+        if (run_seqs[i] >= lsm->next_seq) {
+            lsm->next_seq = run_seqs[i] + 1;
+        }
+    }
+    if (lsm->wal_floor > lsm->next_seq) {
+        lsm->next_seq = lsm->wal_floor;
+    }
+
+    // Keep the WALs not yet in a run; drop leftovers of interrupted work
+    DIR *dir = opendir(lsm->dir);
+    if (!dir) {
+        return -1;
+    }
+    uint64_t *wals = NULL;
+    int wal_count = 0;
+    int wal_capacity = 0;
+    int ok = 1;
+    struct dirent *entry;
+    while (ok && (entry = readdir(dir)) != NULL) {
+        // Room for the directory, '/', any name readdir returns and the NUL
+        char path[sizeof(lsm->dir) + sizeof(entry->d_name)];
+        uint64_t seq;
+        snprintf(path, sizeof(path), "%s/%s", lsm->dir, entry->d_name);
+        if (parse_name(entry->d_name, "wal_", ".log", &seq) == 0) {
+            if (seq < lsm->wal_floor) {
+                remove(path);
+                continue;
+            }
+            if (wal_count == wal_capacity) {
+                wal_capacity = wal_capacity ? wal_capacity * 2 : 8;
+                uint64_t *grown = mem_realloc(MEM_LOGS, wals, (size_t)wal_capacity * sizeof(*wals));
+                if (!grown) {
+                    ok = 0;
+                    break;
+                }
+                wals = grown;
+            }
+            wals[wal_count++] = seq;
+        } else if (parse_name(entry->d_name, "run_", ".sst", &seq) == 0) {
+            int live = 0;
+            for (int i = 0; i < run_total; i++) {
+                live |= run_seqs[i] == seq;
+            }
+            if (!live) {
+                remove(path);
+            }
+        } else if (strlen(entry->d_name) > 4 && strcmp(entry->d_name + strlen(entry->d_name) - 4, ".tmp") == 0) {
+            remove(path);
+        } else {
+            continue;
+        }
+        if (seq >= lsm->next_seq) {
+            lsm->next_seq = seq + 1;
+        }
+    }
+    closedir(dir);
+
+    if (wals) {
+        qsort(wals, (size_t)wal_count, sizeof(*wals), compare_seq);
+    }
+    for (int i = 0; ok && i < wal_count; i++) {
+        ok = replay_wal(lsm, wals[i]) == 0;
+    }
+
+    // Write what the logs held into a run so the WALs can go
+    if (ok && lsm->active.count > 0) {
+        lsm_memtable_t *active = &lsm->active;
+        qsort(active->entries, (size_t)active->count, sizeof(lsm_entry_t), compare_entries);
+        cursor_t cursor = { active->entries, NULL, 0, active->count };
+        lsm_run_t *run = NULL;
+        uint64_t seq = lsm->next_seq++;
+        ok = lsm->run_count < LSM_MAX_RUNS && write_run(lsm, seq, &cursor, 1, 0, &run) == 0;
+        if (ok && run) {
+            lsm->runs[lsm->run_count++] = run;
+        }
+        ok = ok && write_manifest(lsm, lsm->runs, lsm->run_count, lsm->next_seq) == 0;
+        if (ok) {
+            lsm->wal_floor = lsm->next_seq;
+            for (int i = 0; i < wal_count; i++) {
+                remove_wal(lsm, wals[i]);
+            }
+        }
+        memtable_free(active);
+    }
+    mem_free(wals);
+    return ok ? 0 : -1;
+}
+
+/*
+ * Takes an exclusive flock on [dir]/LOCK, held until lsm_close, so a
+ * second process cannot recover, flush or compact the same directory.
+ * Fails with EWOULDBLOCK if another lsm_t holds it.
+ */
+static int lock_dir(lsm_t *lsm) {
+    char path[320];
+    snprintf(path, sizeof(path), "%s/LOCK", lsm->dir);
+    lsm->lock_fd = open(path, O_RDWR | O_CREAT, 0644);
+    if (lsm->lock_fd < 0) {
+        return -1;
+    }
+    return flock(lsm->lock_fd, LOCK_EX | LOCK_NB);
+}
+
+/*
+ * FUNCTION: lsm_open
+ * ===================
+ * Opens (or creates) the store in dir, recovering any unflushed writes,
+ * and starts the background flush/compaction thread
+ *
+ * Parameters:
+ *   - options: Tuning, or NULL for the defaults
+ *
+ * Returns:
+ *   - 0 on success, -1 on error (errno EWOULDBLOCK if another process or
+ *     lsm_t has the store open)
+ */
+int lsm_open(lsm_t *lsm, const char *dir, const lsm_options_t *options) {
+    memset(lsm, 0, sizeof(*lsm));
+    snprintf(lsm->dir, sizeof(lsm->dir), "%s", dir);
+    lsm_options_t defaults = { LSM_DEFAULT_MEMTABLE_BYTES, LSM_DEFAULT_COMPACT_TRIGGER, 1 };
+    lsm->options = options ? *options : defaults;
+    if (lsm->options.memtable_bytes == 0) {
+        lsm->options.memtable_bytes = defaults.memtable_bytes;
+    }
+    if (lsm->options.compact_trigger < 2 || lsm->options.compact_trigger > LSM_MAX_RUNS - 1) {
+        lsm->options.compact_trigger = defaults.compact_trigger;
+    }
+    lsm->wal_fd = -1;
+    lsm->lock_fd = -1;
+    lsm->next_seq = 1;
+    if ((mkdir(dir, 0755) != 0 && errno != EEXIST) || lock_dir(lsm) != 0 || recover(lsm) != 0) {
+        int saved = errno;
+        for (int i = 0; i < lsm->run_count; i++) {
+            run_release(lsm, lsm->runs[i]);
+        }
+        memtable_free(&lsm->active);
+        if (lsm->lock_fd >= 0) {
+            close(lsm->lock_fd);
+        }
+        errno = saved;
+        return -1;
+    }
+    lsm->active.wal_seq = lsm->next_seq++;
+    lsm->wal_fd = open_wal(lsm, lsm->active.wal_seq);
+    if (lsm->wal_fd < 0) {
+        for (int i = 0; i < lsm->run_count; i++) {
+            run_release(lsm, lsm->runs[i]);
+        }
+        close(lsm->lock_fd);
+        return -1;
+    }
+    pthread_mutex_init(&lsm->lock, NULL);
+    pthread_cond_init(&lsm->changed, NULL);
+    pthread_create(&lsm->worker, NULL, worker_main, lsm);
+    return 0;
+}
+
+/*
+ * FUNCTION: lsm_close
+ * ====================
+ * Stops the background thread and releases the store
+ * Writes still in the memtable are safe in the WAL and are recovered by
+ * the next lsm_open.
+ */
+void lsm_close(lsm_t *lsm) {
+    pthread_mutex_lock(&lsm->lock);
+    lsm->stop = 1;
+    pthread_cond_broadcast(&lsm->changed);
+    pthread_mutex_unlock(&lsm->lock);
+    pthread_join(lsm->worker, NULL);
+
+    close(lsm->wal_fd);
+    close(lsm->lock_fd);
+    memtable_free(&lsm->active);
+    memtable_free(&lsm->frozen);
+    for (int i = 0; i < lsm->run_count; i++) {
+        run_release(lsm, lsm->runs[i]);
+    }
+    pthread_cond_destroy(&lsm->changed);
+    pthread_mutex_destroy(&lsm->lock);
+}
+
+/*
+ * FUNCTION: lsm_destroy
+ * ======================
+ * Deletes a closed store: its WALs, runs, MANIFEST, LOCK and temp files,
+ * then the directory itself
+ *
+ * Returns:
+ *   - 0 on success, -1 if a file could not be removed or the directory
+ *     holds files the store did not write
+ */
+int lsm_destroy(const char *dir) {
+    DIR *handle = opendir(dir);
+    if (!handle) {
+        return errno == ENOENT ? 0 : -1;
+    }
+    int ok = 1;
+    struct dirent *entry;
+    while ((entry = readdir(handle)) != NULL) {
+        const char *name = entry->d_name;
+        size_t length = strlen(name);
+        uint64_t seq;
+        if (parse_name(name, "wal_", ".log", &seq) != 0 && parse_name(name, "run_", ".sst", &seq) != 0 &&
+            strcmp(name, "MANIFEST") != 0 && strcmp(name, "LOCK") != 0 && (length <= 4 || strcmp(name + length - 4, ".tmp") != 0)) {
+            continue;
+        }
+        char path[PATH_MAX];
+        snprintf(path, sizeof(path), "%s/%s", dir, name);
+        if (remove(path) != 0) {
+            ok = 0;
+        }
+    }
+    closedir(handle);
+    return ok && rmdir(dir) == 0 ? 0 : -1;
+}
+
+// Caller holds lsm->lock. Hands the memtable to the background thread.
+static int freeze(lsm_t *lsm) {
+    // Batched writes sync once at the end, which must cover the old WAL too
+    if (lsm->options.sync && fdatasync(lsm->wal_fd) != 0) {
+        return -1;
+    }
+    uint64_t seq = lsm->next_seq++;
+    int fd = open_wal(lsm, seq);
+    if (fd < 0) {
+        return -1;
+    }
+    close(lsm->wal_fd);
+    lsm->wal_fd = fd;
+    lsm->frozen = lsm->active;
+    lsm->has_frozen = 1;
+    memset(&lsm->active, 0, sizeof(lsm->active));
+    lsm->active.wal_seq = seq;
+    pthread_cond_broadcast(&lsm->changed);
+    return 0;
+}
+
+// Caller holds lsm->lock. Logs and applies one write without syncing it.
+static int append_locked(lsm_t *lsm, int32_t id, const unsigned char *value, uint32_t length) {
+    size_t value_length = length == LSM_TOMBSTONE ? 0 : length;
+    wal_head_t head = { 0, id, length };
+    head.crc = crc32c(crc32c(0, &head.id, sizeof(head.id) + sizeof(head.length)), value, value_length);
+    struct iovec iov[2] = { { &head, sizeof(head) }, { (void *)value, value_length } };
+
+    // Both memtables full: wait for the background flush
+    while (lsm->active.bytes >= lsm->options.memtable_bytes && lsm->has_frozen && !lsm->error) {
+        lsm->stats.stalls++;
+        pthread_cond_wait(&lsm->changed, &lsm->lock);
+    }
+    int ok = !lsm->error &&
+             writev(lsm->wal_fd, iov, value_length ? 2 : 1) == (ssize_t)(sizeof(head) + value_length) &&
+             memtable_set(&lsm->active, id, value, length) == 0;
+    if (ok && lsm->active.bytes >= lsm->options.memtable_bytes && !lsm->has_frozen && freeze(lsm) != 0) {
+        lsm->error = 1;
+    }
+    return ok ? 0 : -1;
+}
+
+static int write_entry(lsm_t *lsm, int32_t id, const unsigned char *value, uint32_t length) {
+    pthread_mutex_lock(&lsm->lock);
+    int ok = append_locked(lsm, id, value, length) == 0 &&
+             (!lsm->options.sync || fdatasync(lsm->wal_fd) == 0);
+    pthread_mutex_unlock(&lsm->lock);
+    if (!ok) {
+        errno = EIO;
+        return -1;
+    }
+    return 0;
+}
+
+/*
+ * FUNCTION: lsm_put
+ * ==================
+ * Stores a record: one WAL append plus a memtable insert
+ *
+ * Returns:
+ *   - 0 on success, -1 on error (errno E2BIG if the record is larger
+ *     than LSM_MAX_VALUE once serialized)
+ */
+int lsm_put(lsm_t *lsm, int id, const student_t *student) {
+    unsigned char value[LSM_MAX_VALUE];
+    int length = student_pack(student, value, sizeof(value));
+    if (length < 0) {
+        errno = E2BIG;
+        return -1;
+    }
+    return write_entry(lsm, id, value, (uint32_t)length);
+}
+
+/*
+ * FUNCTION: lsm_put_many
+ * =======================
+ * Stores count records keyed by their student_id with one WAL sync for
+ * the lot (group commit)
+ *
+ * Returns:
+ *   - 0 on success, -1 on error; records before the failing one may
+ *     already be stored
+ */
+int lsm_put_many(lsm_t *lsm, const student_t *students, int count) {
+    unsigned char value[LSM_MAX_VALUE];
+    int ok = 1;
+    pthread_mutex_lock(&lsm->lock);
+    for (int i = 0; ok && i < count; i++) {
+        int length = student_pack(&students[i], value, sizeof(value));
+        if (length < 0) {
+            errno = E2BIG;
+            ok = 0;
+        } else if (append_locked(lsm, students[i].student_id, value, (uint32_t)length) != 0) {
+            errno = EIO;
+            ok = 0;
+        }
+    }
+    if (ok && lsm->options.sync && fdatasync(lsm->wal_fd) != 0) {
+        errno = EIO;
+        ok = 0;
+    }
+    pthread_mutex_unlock(&lsm->lock);
+    return ok ? 0 : -1;
+}
+
+/*
+ * FUNCTION: lsm_delete
+ * =====================
+ * Records that id is deleted; compaction drops it from the runs
+ */
+int lsm_delete(lsm_t *lsm, int id) {
+    return write_entry(lsm, id, NULL, LSM_TOMBSTONE);
+}
+
+/*
+ * FUNCTION: lsm_sync
+ * ===================
+ * Makes every write so far durable; with options.sync off, call this
+ * after a batch instead of paying an fdatasync per write
+ */
+int lsm_sync(lsm_t *lsm) {
+    pthread_mutex_lock(&lsm->lock);
+    int rc = fdatasync(lsm->wal_fd);
+    pthread_mutex_unlock(&lsm->lock);
+    return rc;
+}
+
+/*
+ * FUNCTION: lsm_get
+ * ==================
+ * Looks up a record: memtable, frozen memtable, then runs newest first
+ *
+ * Returns:
+ *   - 0 if found, -1 if missing or deleted
+ */
+int lsm_get(lsm_t *lsm, int id, student_t *student) {
+    pthread_mutex_lock(&lsm->lock);
+    const unsigned char *value = NULL;
+    uint32_t length = LSM_TOMBSTONE;
+    int found = 0;
+    int index = memtable_find(&lsm->active, id);
+    if (index >= 0) {
+        value = lsm->active.entries[index].value;
+        length = lsm->active.entries[index].length;
+        found = 1;
+    } else if (lsm->has_frozen && (index = memtable_find(&lsm->frozen, id)) >= 0) {
+        value = lsm->frozen.entries[index].value;
+        length = lsm->frozen.entries[index].length;
+        found = 1;
+    }
+    for (int i = lsm->run_count - 1; !found && i >= 0; i--) {
+        found = run_find(lsm, lsm->runs[i], id, &value, &length);
+    }
+    int rc = found && length != LSM_TOMBSTONE ? student_unpack(value, length, student) : -1;
+    pthread_mutex_unlock(&lsm->lock);
+    return rc;
+}
+
+// Copies the memtable entries with IDs in range, skipping IDs already taken
+static int copy_recent(const lsm_memtable_t *table, int32_t first, int32_t last,
+                       lsm_entry_t *out, int count, int skip_from) {
+    for (int i = 0; i < table->count; i++) {
+        const lsm_entry_t *entry = &table->entries[i];
+        if (entry->id < first || entry->id > last) {
+            continue;
+        }
+        int taken = 0;
+        for (int j = 0; j < skip_from && !taken; j++) {
+            taken = out[j].id == entry->id;
+        }
+        if (taken) {
+            continue;
+        }
+        unsigned char *copy = NULL;
+        if (entry->length != LSM_TOMBSTONE) {
+            copy = mem_malloc(MEM_RECORDS, entry->length ? entry->length : 1);
+            if (!copy) {
+                return -1;
+            }
+            memcpy(copy, entry->value, entry->length);
+        }
+        out[count++] = (lsm_entry_t){ entry->id, entry->length, copy };
+    }
+    return count;
+}
+
+typedef struct {
+    lsm_visit_fn visit;
+    void *arg;
+    int visited;
+} scan_state_t;
+
+static int emit_visit(int32_t id, const unsigned char *value, uint32_t length, void *arg) {
+    (void)id;
+    scan_state_t *state = arg;
+    student_t student;
+    if (student_unpack(value, length, &student) != 0) {
+        errno = EBADMSG;
+        return -1;
+    }
+    state->visit(&student, state->arg);
+    state->visited++;
+    return 0;
+}
+
+/*
+ * FUNCTION: lsm_scan
+ * ===================
+ * Visits the records with first_id <= ID <= last_id in ID order
+ * The memtables are copied and the runs pinned under the lock; the merge
+ * itself runs unlocked, so writers are not held up by a long scan.
+ *
+ * Returns:
+ *   - Number of records visited, or -1 on error
+ */
+int lsm_scan(lsm_t *lsm, int first_id, int last_id, lsm_visit_fn visit, void *arg) {
+    pthread_mutex_lock(&lsm->lock);
+    int capacity = lsm->active.count + (lsm->has_frozen ? lsm->frozen.count : 0);
+    lsm_entry_t *recent = mem_malloc(MEM_RECORDS, (size_t)(capacity ? capacity : 1) * sizeof(lsm_entry_t));
+    int count = recent ? copy_recent(&lsm->active, first_id, last_id, recent, 0, 0) : -1;
+    int active_count = count;
+    if (count >= 0 && lsm->has_frozen) {
+        // The frozen table is older: skip IDs the active one already has
+        count = copy_recent(&lsm->frozen, first_id, last_id, recent, count, active_count);
+    }
+    lsm_run_t *runs[LSM_MAX_RUNS];
+    int run_count = lsm->run_count;
+    for (int i = 0; i < run_count; i++) {
+        runs[i] = lsm->runs[run_count - 1 - i];
+        runs[i]->refs++;
+    }
+    pthread_mutex_unlock(&lsm->lock);
+
+    int visited = -1;
+    if (count >= 0) {
+        qsort(recent, (size_t)count, sizeof(lsm_entry_t), compare_entries);
+        cursor_t cursors[LSM_MAX_RUNS + 1];
+        cursors[0] = (cursor_t){ recent, NULL, 0, count };
+        for (int i = 0; i < run_count; i++) {
+            cursors[i + 1] = run_cursor(runs[i], first_id, last_id);
+        }
+        scan_state_t state = { visit, arg, 0 };
+        if (merge(cursors, run_count + 1, 1, emit_visit, &state) == 0) {
+            visited = state.visited;
+        }
+    } else {
+        count = active_count > 0 ? active_count : 0;
+    }
+    for (int i = 0; recent && i < count; i++) {
+        mem_free(recent[i].value);
+    }
+    mem_free(recent);
+
+    pthread_mutex_lock(&lsm->lock);
+    for (int i = 0; i < run_count; i++) {
+        run_release(lsm, runs[i]);
+    }
+    pthread_mutex_unlock(&lsm->lock);
+    return visited;
+}
+
+/*
+ * FUNCTION: lsm_flush
+ * ====================
+ * Writes the memtable out as a run and waits for it
+ *
+ * Returns:
+ *   - 0 on success, -1 if the background thread hit an I/O error
+ */
+int lsm_flush(lsm_t *lsm) {
+    pthread_mutex_lock(&lsm->lock);
+    if (lsm->active.count > 0) {
+        while (lsm->has_frozen && !lsm->error) {
+            pthread_cond_wait(&lsm->changed, &lsm->lock);
+        }
+        if (!lsm->error && freeze(lsm) != 0) {
+            lsm->error = 1;
+        }
+    }
+    while (lsm->has_frozen && !lsm->error) {
+        pthread_cond_wait(&lsm->changed, &lsm->lock);
+    }
+    int rc = lsm->error ? -1 : 0;
+    pthread_mutex_unlock(&lsm->lock);
+    return rc;
+}
+
+/*
+ * FUNCTION: lsm_compact
+ * ======================
+ * Merges all runs into one and waits for it
+ *
+ * Returns:
+ *   - 0 on success, -1 if the background thread hit an I/O error
+ */
+int lsm_compact(lsm_t *lsm) {
+    pthread_mutex_lock(&lsm->lock);
+    lsm->force_compact = 1;
+    pthread_cond_broadcast(&lsm->changed);
+    while ((lsm->run_count > 1 || lsm->compacting || lsm->has_frozen) && !lsm->error) {
+        pthread_cond_wait(&lsm->changed, &lsm->lock);
+    }
+    lsm->force_compact = 0;
+    int rc = lsm->error ? -1 : 0;
+    pthread_mutex_unlock(&lsm->lock);
+    return rc;
+}
+
+void lsm_get_stats(lsm_t *lsm, lsm_stats_t *stats) {
+    pthread_mutex_lock(&lsm->lock);
+    *stats = lsm->stats;
+    stats->memtable_entries = lsm->active.count + (lsm->has_frozen ? lsm->frozen.count : 0);
+    stats->runs = lsm->run_count;
+    pthread_mutex_unlock(&lsm->lock);
+}
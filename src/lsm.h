@@ -0,0 +1,163 @@
+/*
+ * ============================================================================
+ * LOG-STRUCTURED MERGE STORE (data/lsm/)
+ * ============================================================================
+ *
+ * A write-optimized store for enrollment season, when adds and edits far
+ * outnumber reads. Every write is a sequential append; sorting and
+ * merging happen later on a background thread.
+ *
+ * Write path:
+ *   1. Append the record (or a delete marker) to the write-ahead log,
+ *      wal_<seq>.log, and fdatasync it unless options.sync is off
+ *   2. Insert it into the memtable, a hash table in memory
+ *   3. When the memtable reaches options.memtable_bytes it is frozen and
+ *      a new memtable and WAL take over; the background thread writes
+ *      the frozen one out as a sorted run and deletes its WAL
+ *
+ * Runs (run_<seq>.sst) are immutable files:
+ *
+ *     lsm_run_header_t
+ *     values                    packed students, in ID order
+ *     lsm_index_t index[count]  (ID, length, offset), sorted by ID
+ *     uint64_t bloom[words]     Bloom filter over the IDs
+ *
+ * Read path: memtable, frozen memtable, then runs newest first. A run is
+ * only searched if its Bloom filter (LSM_BLOOM_BITS_PER_KEY bits per ID)
+ * says the ID may be there; otherwise it costs a few bit tests.
+ *
+ * Compaction: once options.compact_trigger runs exist, the background
+ * thread merges them into one, keeping the newest version of each ID and
+ * dropping deleted IDs, so reads touch few runs again.
+ *
+ * One process at a time: open takes an exclusive flock on LOCK in the
+ * directory and fails (errno EWOULDBLOCK) while another holder has it.
+ *
+ * MANIFEST lists the live runs and the oldest WAL not yet in a run; it
+ * is replaced atomically (temp file, rename, directory fsync) after each
+ * flush and compaction. Open replays the WALs from that point and flushes
+ * them into a run, ignoring a torn record at the end of a log.
+ *
+ * ============================================================================
+ */
+
+#ifndef LSM_H
+#define LSM_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <pthread.h>
+#include "student.h"
+
+#define LSM_DIR "data/lsm"
+#define LSM_MAGIC "SDBLSMR1"
+#define LSM_FORMAT_VERSION 1
+#define LSM_MAX_RUNS 32
+#define LSM_MAX_VALUE 8192
+#define LSM_BLOOM_BITS_PER_KEY 10
+#define LSM_BLOOM_HASHES 7
+#define LSM_TOMBSTONE UINT32_MAX
+
+typedef struct {
+    size_t memtable_bytes;   // flush threshold (0 = 4 MB)
+    int compact_trigger;     // runs that start a compaction (0 = 4)
+    int sync;                // fdatasync the WAL after every write
+} lsm_options_t;
+
+typedef struct {
+    int32_t id;
+    uint32_t length;         // LSM_TOMBSTONE for a deleted ID
+    unsigned char *value;
+} lsm_entry_t;
+
+typedef struct {
+    lsm_entry_t *entries;
+    int count;
+    int capacity;
+    int *slots;              // hash on ID: entry index + 1, 0 = empty
+    int slot_capacity;
+    size_t bytes;
+    uint64_t wal_seq;        // WAL holding these entries
+} lsm_memtable_t;
+
+typedef struct {
+    char magic[8];
+    uint32_t format_version;
+    uint32_t count;
+    uint32_t bloom_words;
+    uint32_t reserved;
+    uint64_t index_offset;
+    uint64_t bloom_offset;
+    uint64_t file_size;
+    uint32_t checksum;       // CRC32C of the fields above
+} lsm_run_header_t;
+
+typedef struct {
+    int32_t id;
+    uint32_t length;         // LSM_TOMBSTONE for a deleted ID
+    uint64_t offset;
+} lsm_index_t;
+
+typedef struct {
+    uint64_t seq;
+    const unsigned char *map;
+    size_t size;
+    const lsm_run_header_t *header;
+    const lsm_index_t *index;
+    const uint64_t *bloom;
+    int refs;                // the run list holds one; scans hold others
+    int obsolete;            // compacted away: unlink on last release
+} lsm_run_t;
+
+typedef struct {
+    long memtable_entries;
+    int runs;
+    long flushes;
+    long compactions;
+    long bloom_skips;        // run lookups avoided by a Bloom filter
+    long stalls;             // writes that waited for a flush
+} lsm_stats_t;
+
+typedef struct {
+    char dir[256];
+    lsm_options_t options;
+    pthread_mutex_t lock;
+    pthread_cond_t changed;
+    pthread_t worker;
+    int stop;
+    int force_compact;
+    int compacting;
+
+    lsm_memtable_t active;
+    lsm_memtable_t frozen;
+    int has_frozen;
+    int wal_fd;
+    int lock_fd;             // holds the flock on LOCK while open
+    uint64_t wal_floor;      // WALs numbered below this are in runs
+    uint64_t next_seq;       // next run or WAL number
+    int error;               // a flush or compaction failed: writes fail
+
+    lsm_run_t *runs[LSM_MAX_RUNS];   // oldest first
+    int run_count;
+
+    lsm_stats_t stats;
+} lsm_t;
+
+typedef void (*lsm_visit_fn)(const student_t *student, void *arg);
+
+int lsm_open(lsm_t *lsm, const char *dir, const lsm_options_t *options);
+void lsm_close(lsm_t *lsm);
+int lsm_destroy(const char *dir);
+
+int lsm_put(lsm_t *lsm, int id, const student_t *student);
+int lsm_put_many(lsm_t *lsm, const student_t *students, int count);
+int lsm_delete(lsm_t *lsm, int id);
+int lsm_sync(lsm_t *lsm);
+int lsm_get(lsm_t *lsm, int id, student_t *student);
+int lsm_scan(lsm_t *lsm, int first_id, int last_id, lsm_visit_fn visit, void *arg);
+
+int lsm_flush(lsm_t *lsm);
+int lsm_compact(lsm_t *lsm);
+void lsm_get_stats(lsm_t *lsm, lsm_stats_t *stats);
+
+#endif
@@ -9,6 +9,9 @@
  *   - Edit existing student records
  *   - Store data persistently in text files
  * 
+ * This file is the interactive CLI; the operations themselves live in
+ * the studentdb library (studentdb.h) so other programs can embed them.
+ * 
  * Each student record includes:
  *   - Personal Information: Name, Date of Birth, Parent Names, Contact Details
  *   - Academic Information: Grades in 4 subjects, Average Grade Calculation
@@ -21,78 +24,34 @@
 #include <time.h>
 #include <stdlib.h>
 #include <string.h>
+#include <errno.h>
 #include <pthread.h>
 #include <unistd.h>
-
-// Thread synchronization: Ensures only one user can edit a file at a time
-pthread_mutex_t file_mutex = PTHREAD_MUTEX_INITIALIZER;
-
-/*
- * Subject Structure
- * ================
- * Stores information about a single subject/course
- * - name: Name of the subject (e.g., Mathematics, English)
- * - grade: Numerical grade received in this subject
- */
-typedef struct {
-    char name[50];
-    float grade;
-} subject_t;
-
-/*
- * Student Structure
- * =================
- * Complete record for a single student
- * 
- * Identification:
- *   - student_id: Unique number assigned by system
- *   - studentid: Official student ID (may differ from student_id)
- * 
- * Personal Information:
- *   - name: Full name of student
- *   - dateofbirth: Date of birth (format: DD/MM/YYYY)
- *   - father_name: Father's name
- *   - mother_name: Mother's name
- *   - phone_number: Contact phone number
- * 
- * Academic Information:
- *   - grade: Overall grade/class level
- *   - subject1-4: Four subjects with individual grades
- *   - average_grade: Calculated average of all 4 subject grades
- */
-typedef struct {
-    int student_id;
-    char name[50];
-    char studentid[15];
-    int grade;
-    char dateofbirth[11];
-    char father_name[50];
-    char mother_name[50];
-    char phone_number[15];
-    subject_t subject1;
-    subject_t subject2;
-    subject_t subject3;
-    subject_t subject4;
-    float average_grade;
-} student_t;
-
-/*
- * FUNCTION: calculate_average
- * ===========================
- * Calculates the average grade across all 4 subjects
- * 
- * Parameters:
- *   - student: Pointer to student record to update
- * 
- * How it works:
- *   - Adds up all 4 subject grades
- *   - Divides by 4 to get the average
- *   - Stores result in student.average_grade
- */
-void calculate_average(student_t *student) {
-    student->average_grade = (student->subject1.grade + student->subject2.grade +
-                              student->subject3.grade + student->subject4.grade) / 4.0f;
-}
+#include <fcntl.h>
+#include <signal.h>
+
+#include "student.h"
+#include "record.h"
+#include "snapshot.h"
+#include "validate.h"
+#include "import.h"
+#include "shard.h"
+#include "mem.h"
+#include "history.h"
+#include "rank.h"
+#include "report.h"
+#include "card.h"
+#include "scrub.h"
+#include "btree.h"
+#include "lsm.h"
+#include "store.h"
+#include "studentdb.h"
+#include "command.h"
+#include "http.h"
+#include "rpc.h"
+
+// The store behind every command (studentdb.h picks the backend)
+static studentdb_t db;
 
 /*
  * FUNCTION: load_student_data
@@ -121,26 +80,60 @@ int load_student_data(const char *path) {
 }
 
 /*
- * FUNCTION: update_next_id
- * =========================
- * Updates the counter file with the next available student ID
- * Ensures each new student gets a unique ID
- * 
- * Parameters:
- *   - path: Path to the ID counter file
- *   - new_id: The next ID number to assign
+ * FUNCTION: read_value
+ * =====================
+ * Prompts for one word until it passes validate_value
+ * The word is read with %ms, so it is never cut at a fixed length.
+ *
+ * Returns:
+ *   - The accepted value (caller frees), or NULL if input ended
  */
-void update_next_id(const char *path, int new_id) {
-    FILE *file = fopen("next_id.tmp", "w");
-    if (!file) {
-        printf("Error opening file for writing.\n");
-        return;
+char *read_value(const char *prompt, value_kind_t kind) {
+    for (;;) {
+        char *input = NULL;
+        printf("%s", prompt);
+        if (scanf("%ms", &input) != 1) {
+            printf("Input ended.\n");
+            return NULL;
+        }
+        const char *error = validate_value(kind, input, strlen(input));
+        if (!error) {
+            return input;
+        }
+        printf("Invalid value: %s.\n", error);
+        free(input);
     }
-    fprintf(file, "%d\n", new_id);
-    fclose(file);
+}
 
-    remove(path);
-    rename("next_id.tmp", path);
+/*
+ * FUNCTION: prompt_value / prompt_str
+ * ====================================
+ * read_value into a fixed char array or a str_t field
+ *
+ * Returns:
+ *   - 0 on success, -1 if input ended
+ */
+int prompt_value(const char *prompt, value_kind_t kind, char *dest, size_t size) {
+    char *input = read_value(prompt, kind);
+    if (!input) {
+        return -1;
+    }
+    snprintf(dest, size, "%s", input);
+    free(input);
+    return 0;
+}
+
+int prompt_str(const char *prompt, value_kind_t kind, str_t *dest) {
+    char *input = read_value(prompt, kind);
+    if (!input) {
+        return -1;
+    }
+    int result = str_set(dest, input);
+    free(input);
+    if (result != 0) {
+        printf("Out of memory storing that name.\n");
+    }
+    return result;
 }
 
 /*
@@ -149,108 +142,68 @@ void update_next_id(const char *path, int new_id) {
  * Main function to add a new student to the system
  * 
  * Process:
- *   1. Gets next available student ID from counter file
- *   2. Prompts user for all student information
- *   3. Creates a new file named output_[STUDENT_ID].txt
- *   4. Writes all information to file in KEY = VALUE format
- *   5. Calculates and stores average grade
+ *   1. Prompts user for all student information
+ *   2. studentdb_create assigns the next ID from the counter file,
+ *      calculates the average grade and saves the record
  * 
  * Data Flow:
  *   User Input → Student Structure → File Storage
  */
 void add_student(void) {
-    // STEP 1: Initialize student and get next available ID
+    // STEP 1: Initialize student; the ID is assigned when it is saved
     student_t student;
-    FILE *id_counter = fopen("data/next_id.txt", "r");
-    if (!id_counter) {
-        printf("Error opening ID counter file.\n");
+    memset(&student, 0, sizeof(student));
+
+    // STEP 2: Collect personal information from user
+    // Each prompt repeats until the value passes validate_value
+    printf("\n===== STUDENT PERSONAL INFORMATION =====\n");
+    char grade[64];
+    subject_t *subjects[] = { &student.subject1, &student.subject2, &student.subject3, &student.subject4 };
+    if (prompt_str("Enter student name: ", VALUE_NAME, &student.name) != 0 ||
+        prompt_str("Enter family name: ", VALUE_FAMILY_NAME, &student.family_name) != 0 ||
+        prompt_value("Enter date of birth (DD/MM/YYYY): ", VALUE_DATE_OF_BIRTH, student.dateofbirth, sizeof(student.dateofbirth)) != 0 ||
+        prompt_value("Enter student ID: ", VALUE_STUDENT_ID, student.studentid, sizeof(student.studentid)) != 0 ||
+        prompt_str("Enter father's name: ", VALUE_NAME, &student.father_name) != 0 ||
+        prompt_str("Enter mother's name: ", VALUE_NAME, &student.mother_name) != 0 ||
+        prompt_value("Enter phone number: ", VALUE_PHONE_NUMBER, student.phone_number, sizeof(student.phone_number)) != 0) {
         return;
     }
-    fscanf(id_counter, "%d", &student.student_id);
-    update_next_id("data/next_id.txt", student.student_id + 1);
-    fclose(id_counter);
 
-    // STEP 2: Create file for this student (filename = output_[ID].txt)
-    char filename[256];
-    snprintf(filename, sizeof(filename), "output_%d.txt", student.student_id);
-    
-    FILE *file = fopen(filename, "a");
-    if (file == NULL) {
-        printf("Error opening file.\n");
+    // STEP 3: Collect academic information
+    printf("\n===== STUDENT ACADEMIC INFORMATION =====\n");
+    if (prompt_value("Enter student grade/class level: ", VALUE_CLASS_GRADE, grade, sizeof(grade)) != 0) {
         return;
     }
+    student.grade = atoi(grade);
 
-    // STEP 3: Collect personal information from user
-    printf("\n===== STUDENT PERSONAL INFORMATION =====\n");
-    printf("Enter student name: ");
-    scanf("%49s", student.name);
-    fprintf(file, "NAME = %s\n", student.name);
-    
-    printf("Enter date of birth (DD/MM/YYYY): ");
-    scanf("%10s", student.dateofbirth);
-    fprintf(file, "DOB = %s\n", student.dateofbirth);
-    
-    printf("Enter student ID: ");
-    scanf("%14s", student.studentid);
-    fprintf(file, "STUDENT_ID = %s\n", student.studentid);
-    
-    printf("Enter father's name: ");
-    scanf("%49s", student.father_name);
-    fprintf(file, "FATHER_NAME = %s\n", student.father_name);
-    
-    printf("Enter mother's name: ");
-    scanf("%49s", student.mother_name);
-    fprintf(file, "MOTHER_NAME = %s\n", student.mother_name);
-    
-    printf("Enter phone number: ");
-    scanf("%14s", student.phone_number);
-    fprintf(file, "PHONE_NUMBER = %s\n", student.phone_number);
-
-    // STEP 4: Collect academic information
-    printf("\n===== STUDENT ACADEMIC INFORMATION =====\n");
-    printf("Enter student grade/class level: ");
-    scanf("%d", &student.grade);
-    fprintf(file, "GRADE = %d\n", student.grade);
-    
-    // STEP 5: Collect grades for 4 subjects
+    // STEP 4: Collect grades for 4 subjects
     printf("\n===== SUBJECT GRADES (4 Subjects) =====\n");
-    
-    printf("Enter subject 1 name: ");
-    scanf("%49s", student.subject1.name);
-    fprintf(file, "SUBJECT1_NAME = %s\n", student.subject1.name);
-    printf("Enter subject 1 grade: ");
-    scanf("%f", &student.subject1.grade);
-    fprintf(file, "SUBJECT1_GRADE = %.2f\n", student.subject1.grade);
-    
-    printf("Enter subject 2 name: ");
-    scanf("%49s", student.subject2.name);
-    fprintf(file, "SUBJECT2_NAME = %s\n", student.subject2.name);
-    printf("Enter subject 2 grade: ");
-    scanf("%f", &student.subject2.grade);
-    fprintf(file, "SUBJECT2_GRADE = %.2f\n", student.subject2.grade);
-    
-    printf("Enter subject 3 name: ");
-    scanf("%49s", student.subject3.name);
-    fprintf(file, "SUBJECT3_NAME = %s\n", student.subject3.name);
-    printf("Enter subject 3 grade: ");
-    scanf("%f", &student.subject3.grade);
-    fprintf(file, "SUBJECT3_GRADE = %.2f\n", student.subject3.grade);
-    
-    printf("Enter subject 4 name: ");
-    scanf("%49s", student.subject4.name);
-    fprintf(file, "SUBJECT4_NAME = %s\n", student.subject4.name);
-    printf("Enter subject 4 grade: ");
-    scanf("%f", &student.subject4.grade);
-    fprintf(file, "SUBJECT4_GRADE = %.2f\n", student.subject4.grade);
-    
-    // STEP 6: Calculate and save average grade
-    calculate_average(&student);
-    fprintf(file, "AVERAGE_GRADE = %.2f\n", student.average_grade);
-    
+    for (int i = 0; i < 4; i++) {
+        char prompt[64];
+        snprintf(prompt, sizeof(prompt), "Enter subject %d name: ", i + 1);
+        if (prompt_str(prompt, VALUE_SUBJECT_NAME, &subjects[i]->name) != 0) {
+            return;
+        }
+        snprintf(prompt, sizeof(prompt), "Enter subject %d grade: ", i + 1);
+        if (prompt_value(prompt, VALUE_SUBJECT_GRADE, grade, sizeof(grade)) != 0) {
+            return;
+        }
+        subjects[i]->grade = strtof(grade, NULL);
+    }
+
+    // STEP 5: Assign the next ID, calculate the average grade and save
+    int id = studentdb_create(&db, &student);
+    char filename[128];
+    if (id < 0) {
+        studentdb_location(&db, studentdb_next_id(), filename, sizeof(filename));
+        printf("Error writing file %s.\n", filename);
+        return;
+    }
+    studentdb_location(&db, id, filename, sizeof(filename));
+
     printf("\n✓ Student added successfully!\n");
     printf("✓ Student ID: %d\n", student.student_id);
     printf("✓ File saved: %s\n\n", filename);
-    fclose(file);
 }
 
 /*
@@ -263,15 +216,15 @@ void add_student(void) {
  *   2. Displays menu of editable fields
  *   3. User selects which field to modify
  *   4. User enters new value
- *   5. System reads original file, finds target field, updates it
- *   6. Writes updated data to temporary file
- *   7. Replaces original file with updated version
+ *   5. record_update() loads the record (upgrading old schemas),
+ *      applies the new value and rewrites it through a temporary file
  * 
  * Safety Features:
- *   - Uses mutex lock to prevent concurrent file access
+ *   - record_update holds file_mutex for the whole read-modify-write
  *   - Creates temporary file before modifying original
- *   - Only replaces original if update was successful
- *   - Cleans up temporary files on error
+ *   - Subject grade edits recompute AVERAGE_GRADE and update the current
+ *     term's grade history (history.h)
+ *   - The save drops the student's cached report card (card.h)
  */
 void edit_student(void) {
     // SECTION 1: Get student ID from user
@@ -285,10 +238,6 @@ void edit_student(void) {
     }
     while (getchar() != '\n') { }  // clear trailing newline from input buffer
 
-    // Construct filename based on student ID
-    char filename[128];
-    snprintf(filename, sizeof(filename), "output_%d.txt", id);
-
     // SECTION 2: Display menu of editable fields
     // User selects which field they want to modify
     int choice;
@@ -302,8 +251,11 @@ void edit_student(void) {
     printf("6. Date of Birth\n");
     printf("7. Subject 1 Grade\n");
     printf("8. Subject 2 Grade\n");
+    printf("9. Subject 3 Grade\n");
+    printf("10. Subject 4 Grade\n");
+    printf("11. Family Name\n");
     printf("Choice: ");
-    if (scanf("%d", &choice) != 1) {
+    if (scanf("%d", &choice) != 1 || choice < FIELD_NAME || choice > FIELD_FAMILY_NAME) {
         printf("Invalid choice.\n");
         while (getchar() != '\n') { }
         return;
@@ -321,117 +273,642 @@ void edit_student(void) {
     // Remove trailing newline from fgets input
     new_value[strcspn(new_value, "\n")] = '\0';
 
-    // SECTION 4: Input validation (TODO)
-    // Validate new_value based on the choice made
-    // Examples: name should be alphabetic, grade should be numeric, etc.
+    // SECTION 4: Input validation
+    // Validate new_value based on the choice made (rules in validate.h)
     // If invalid, print error message and return without modifying file
+    const char *error = validate_field((field_t)choice, new_value);
+    if (error) {
+        printf("Invalid value: %s.\n", error);
+        return;
+    }
 
-    // SECTION 5: File modification with mutex lock
-    // Lock the file_mutex to ensure thread-safe file operations
-    // This prevents two users from editing the same file simultaneously
-    pthread_mutex_lock(&file_mutex);
-
-    // Open original student file for reading
-    FILE *original = fopen(filename, "r");
-    if (!original) {
-        pthread_mutex_unlock(&file_mutex);
-        perror("fopen original");
+    // SECTION 5: Read-modify-write under file_mutex
+    // Old-schema records are upgraded as part of this write, and grade
+    // edits also update the current term's history entry
+    int result = studentdb_update(&db, id, (field_t)choice, new_value);
+    if (result < 0) {
+        printf("Error: could not update student %d.\n", id);
         return;
     }
+    if (result == 1) {
+        printf("Warning: could not update grade history for student %d.\n", id);
+    }
+
+    printf("✓ Student %d updated successfully.\n\n", id);
+}
+
+/*
+ * FUNCTION: migrate_students
+ * ===========================
+ * Upgrades every record to the current schema in the background
+ * Rewrites are throttled so a large store does not cause an I/O spike.
+ */
+void migrate_students(void) {
+    int last_id = load_student_data("data/next_id.txt") - 1;
+    migrator_t migrator;
 
-    // Create temporary file to write updated student data
-    // We use a temp file to avoid losing data if update fails
-    char tempname[128];
-    snprintf(tempname, sizeof(tempname), "temp_%d.txt", id);
-    FILE *temp = fopen(tempname, "w");
-    if (!temp) {
-        fclose(original);
-        pthread_mutex_unlock(&file_mutex);
-        perror("fopen temp");
+    if (migrator_start(&migrator, 1, last_id, 50) != 0) {
+        printf("Error starting migrator.\n");
         return;
     }
+    printf("Migrating records 1-%d to schema version %d...\n", last_id, RECORD_SCHEMA_VERSION);
+    migrator_wait(&migrator);
+    printf("✓ %d records migrated, %d failed.\n\n", migrator.migrated, migrator.failed);
+}
+
+/*
+ * FUNCTION: build_snapshot
+ * =========================
+ * Writes data/snapshot.bin so a resident process can start from it
+ * instead of parsing every record file
+ */
+int build_snapshot(void) {
+    int last_id = load_student_data("data/next_id.txt") - 1;
+    int count = snapshot_build(SNAPSHOT_PATH, 1, last_id);
+    if (count < 0) {
+        printf("Error writing snapshot %s.\n", SNAPSHOT_PATH);
+        return 1;
+    }
+    printf("✓ Snapshot %s written with %d records.\n", SNAPSHOT_PATH, count);
+    return 0;
+}
+
+/*
+ * FUNCTION: import_students
+ * ==========================
+ * Bulk-imports students from a CSV file (format in import.h)
+ * Files ending in .tsv are read as tab-separated.
+ * Rejected rows are listed on stderr with their line number.
+ */
+int import_students(const char *path) {
+    import_options_t options = {
+        .writers = 2,
+        .queue_capacity = 1024,
+        .counter_path = "data/next_id.txt",
+        .errors = stderr,
+        .separator = ',',
+    };
+    size_t length = strlen(path);
+    if (length > 4 && strcmp(path + length - 4, ".tsv") == 0) {
+        options.separator = '\t';
+    }
+
+    import_result_t result;
+    int status = import_csv(path, &options, &result);
+    if (status != 0 && result.rows == 0) {
+        printf("Error importing %s.\n", path);
+        return 1;
+    }
+    import_print_result(&result);
+    return status == 0 ? 0 : 1;
+}
+
+static void count_student(const student_t *student, void *arg) {
+    (void)student;
+    (*(long *)arg)++;
+}
+
+/*
+ * FUNCTION: memory_report
+ * ========================
+ * Loads the roster the way a resident process holds it and prints the
+ * memory used per subsystem (mem.h)
+ *
+ * Process:
+ *   1. Maps data/snapshot.bin (building it first if missing or stale)
+ *      and replays the change log on top of it
+ *   2. If the store is sharded (data/shards.txt), the shard caches and
+ *      STUDENT_ID indexes studentdb_open loaded are counted too
+ *   3. Prints bytes used, bytes per student and fragmentation
+ */
+int memory_report(void) {
+    snapshot_t snap;
 
-    // SECTION 6: Process file line-by-line
-    // Read original file and write to temp, updating the selected field
-    char line[512];
-    int updated = 0;  // Flag to track if target field was found and updated
-
-    while (fgets(line, sizeof(line), original)) {
-        // Each choice corresponds to a different student field
-        // When we find the matching field, we replace it with new value
-        if (choice == 1 && strstr(line, "NAME = ") == line) {
-            fprintf(temp, "NAME = %s\n", new_value);
-            updated = 1;
-        } else if (choice == 2 && strstr(line, "GRADE = ") == line) {
-            fprintf(temp, "GRADE = %s\n", new_value);
-            updated = 1;
-        } else if (choice == 3 && strstr(line, "PHONE_NUMBER = ") == line) {
-            fprintf(temp, "PHONE_NUMBER = %s\n", new_value);
-            updated = 1;
-        } else if (choice == 4 && strstr(line, "FATHER_NAME = ") == line) {
-            fprintf(temp, "FATHER_NAME = %s\n", new_value);
-            updated = 1;
-        } else if (choice == 5 && strstr(line, "MOTHER_NAME = ") == line) {
-            fprintf(temp, "MOTHER_NAME = %s\n", new_value);
-            updated = 1;
-        } else if (choice == 6 && strstr(line, "DOB = ") == line) {
-            fprintf(temp, "DOB = %s\n", new_value);
-            updated = 1;
-        } else if (choice == 7 && strstr(line, "SUBJECT1_GRADE = ") == line) {
-            fprintf(temp, "SUBJECT1_GRADE = %s\n", new_value);
-            updated = 1;
-        } else if (choice == 8 && strstr(line, "SUBJECT2_GRADE = ") == line) {
-            fprintf(temp, "SUBJECT2_GRADE = %s\n", new_value);
-            updated = 1;
+    if (snapshot_open(&snap, SNAPSHOT_PATH) != 0) {
+        if (build_snapshot() != 0 || snapshot_open(&snap, SNAPSHOT_PATH) != 0) {
+            printf("Error opening snapshot %s.\n", SNAPSHOT_PATH);
+            return 1;
+        }
+    }
+    long students = 0;
+    if (snapshot_scan(&snap, count_student, &students) < 0) {
+        printf("Error reading snapshot %s: out of memory.\n", SNAPSHOT_PATH);
+        snapshot_close(&snap);
+        return 1;
+    }
+
+    int sharded = db.shards.shard_count > 0;
+
+    printf("Memory for %ld students%s:\n", students, sharded ? " (snapshot + shard engine)" : " (snapshot)");
+    mem_print_report(stdout, students);
+
+    snapshot_close(&snap);
+    return 0;
+}
+
+/*
+ * FUNCTION: open_term
+ * ====================
+ * Opens a new term and records every student's current grades for it
+ * Terms must increase; a student whose history already has a later term
+ * is reported and skipped.
+ */
+int open_term(int term) {
+    int last_id = load_student_data("data/next_id.txt") - 1;
+    if (term <= 0 || term < history_current_term()) {
+        printf("Error: term must be positive and not before term %d.\n", history_current_term());
+        return 1;
+    }
+    FILE *file = fopen(HISTORY_TERM_PATH, "w");
+    if (!file) {
+        printf("Error writing %s.\n", HISTORY_TERM_PATH);
+        return 1;
+    }
+    fprintf(file, "%d\n", term);
+    fclose(file);
+
+    int recorded = 0;
+    int failed = 0;
+    for (int id = 1; id <= last_id; id++) {
+        student_t student;
+        if (record_load(id, &student) != 0) {
+            continue;
+        }
+        if (history_record(id, term, &student) == 0) {
+            recorded++;
         } else {
-            // Copy unchanged lines as-is
-            fputs(line, temp);
+            printf("Error recording term %d for student %d.\n", term, id);
+            failed++;
         }
     }
+    printf("✓ Term %d opened, %d students recorded.\n", term, recorded);
+    return failed == 0 ? 0 : 1;
+}
 
-    fclose(original);
-    fclose(temp);
+/*
+ * FUNCTION: show_history
+ * =======================
+ * Prints a student's grades, average and per-subject trend for the terms
+ * in [from_term, to_term]
+ */
+int show_history(int id, int from_term, int to_term) {
+    history_t history;
+    if (history_load(id, &history) != 0) {
+        printf("No grade history for student %d.\n", id);
+        return 1;
+    }
+    history_entry_t entries[64];
+    history_gpa_t points[64];
+    int count = history_range(&history, from_term, to_term, entries, 64);
+    if (count < 0 || history_gpa(&history, from_term, to_term, points, 64) != count) {
+        printf("Error: grade history for student %d is corrupt.\n", id);
+        history_free(&history);
+        return 1;
+    }
+    if (count > 64) {
+        printf("(showing the first 64 of %d terms)\n", count);
+        count = 64;
+    }
 
-    // SECTION 7: Verify update and replace original file
-    if (!updated) {
-        printf("Warning: target field not found. No changes made.\n");
-        remove(tempname);  // Clean up temporary file
-        pthread_mutex_unlock(&file_mutex);
-        return;
+    printf("Term       Subj 1  Subj 2  Subj 3  Subj 4  Average\n");
+    for (int i = 0; i < count; i++) {
+        printf("%-8d %7.2f %7.2f %7.2f %7.2f %8.2f\n", entries[i].term, entries[i].grades[0],
+               entries[i].grades[1], entries[i].grades[2], entries[i].grades[3], points[i].average);
+    }
+    for (int s = 0; s < HISTORY_SUBJECTS; s++) {
+        float slope;
+        if (history_trend(&history, s, from_term, to_term, &slope) == 0) {
+            printf("Subject %d trend: %+.2f per term\n", s + 1, slope);
+        }
     }
+    history_free(&history);
+    return 0;
+}
 
-    // Replace original file with updated temporary file
-    if (remove(filename) != 0) {
-        perror("remove");
-        pthread_mutex_unlock(&file_mutex);
-        return;
+// Attaches the class ranking view, saying so if it cannot be built
+static int attach_ranks(void) {
+    if (studentdb_attach_ranks(&db) != 0) {
+        printf("Error building the class ranking from %s.\n", SNAPSHOT_PATH);
+        return -1;
     }
-    if (rename(tempname, filename) != 0) {
-        perror("rename");
-        pthread_mutex_unlock(&file_mutex);
-        return;
+    return 0;
+}
+
+/*
+ * FUNCTION: show_rank
+ * ====================
+ * Prints a student's rank within their class level
+ * The ranking view is built from data/snapshot.bin plus the change log.
+ */
+int show_rank(int id) {
+    if (attach_ranks() != 0) {
+        return 1;
+    }
+    student_t student;
+    int rank, class_size;
+    if (studentdb_get(&db, id, &student) != 0 || studentdb_rank(&db, id, &rank, &class_size) != 0) {
+        printf("Student %d not found.\n", id);
+        return 1;
     }
+    printf("Student %d is ranked %d of %d in class %d (average %.2f).\n",
+           id, rank, class_size, student.grade, student.average_grade);
+    return 0;
+}
 
-    // Unlock mutex after file operations complete
-    pthread_mutex_unlock(&file_mutex);
+// Compiles template_path, or the built-in template if it is NULL
+static int compile_template(report_template_t *tpl, const char *template_path) {
+    int compiled = template_path ? report_compile_file(tpl, template_path)
+                                 : report_compile(tpl, report_default_template);
+    if (compiled != 0) {
+        printf("Error compiling report template %s.\n", template_path ? template_path : "(built-in)");
+        return -1;
+    }
+    return 0;
+}
 
-    printf("✓ Student %d updated successfully.\n\n", id);
+/*
+ * FUNCTION: render_reports
+ * =========================
+ * Writes a report card for every student into data/reports/
+ * template_path may name a template file (see report.h); NULL uses the
+ * built-in one.
+ */
+int render_reports(const char *template_path) {
+    report_template_t tpl;
+    if (compile_template(&tpl, template_path) != 0) {
+        return 1;
+    }
+    if (tpl.ranked && attach_ranks() != 0) {
+        report_template_free(&tpl);
+        return 1;
+    }
+
+    report_result_t result;
+    int status = studentdb_render_reports(&db, &tpl, REPORT_DIR, &result);
+    report_template_free(&tpl);
+    if (status != 0 && result.cards == 0 && result.failed == 0) {
+        printf("Error opening snapshot %s.\n", SNAPSHOT_PATH);
+        return 1;
+    }
+    double seconds = result.load_seconds + result.render_seconds;
+    printf("✓ %ld report cards written to %s (%zu bytes, %ld failed)\n",
+           result.cards, REPORT_DIR, result.bytes, result.failed);
+    printf("  load + rank %.3f s, render + write %.3f s, %.0f cards/s\n", result.load_seconds,
+           result.render_seconds, seconds > 0 ? result.cards / seconds : 0.0);
+    return status == 0 ? 0 : 1;
 }
 
 /*
- * FUNCTION: main
- * ===============
- * Entry point of the Student Management System
- * 
- * Process:
- *   1. Shows menu: Add Student or Edit Student
- *   2. User selects choice
- *   3. Calls appropriate function
- *   4. Returns to menu or exits
+ * FUNCTION: show_card
+ * ====================
+ * Prints one student's report card, from data/cards/ when it is current
+ */
+int show_card(int id, const char *template_path) {
+    report_template_t tpl;
+    if (compile_template(&tpl, template_path) != 0) {
+        return 1;
+    }
+    if (tpl.ranked && attach_ranks() != 0) {
+        report_template_free(&tpl);
+        return 1;
+    }
+
+    char *card;
+    size_t length;
+    int hit;
+    int status = studentdb_card(&db, &tpl, id, &card, &length, &hit);
+    if (status != 0) {
+        printf("Student %d not found.\n", id);
+    } else {
+        fwrite(card, 1, length, stdout);
+        fprintf(stderr, "(%s)\n", hit ? "cached" : "rendered");
+        free(card);
+    }
+    report_template_free(&tpl);
+    return status == 0 ? 0 : 1;
+}
+
+/*
+ * FUNCTION: scrub_students
+ * =========================
+ * Checks every record in the selected store, the ID counter and leftover
+ * temporary files
+ * With repair set, fixes the counter and cleans up the leftovers.
+ */
+int scrub_students(int repair) {
+    scrub_options_t options = {
+        .record_dir = ".",
+        .counter_path = "data/next_id.txt",
+        .repair = repair,
+        .report = stdout,
+        .store = &db.store,
+    };
+    scrub_result_t result;
+    int status = scrub_store(&options, &result);
+    if (status < 0) {
+        printf("Error scanning the data directory.\n");
+        return 1;
+    }
+    scrub_print_result(&result);
+    return status;
+}
+
+/*
+ * FUNCTION: convert_to_btree
+ * ===========================
+ * Copies every output_[ID].txt into data/students.db, which selects the
+ * B+tree store from then on (studentdb_convert_to_btree)
+ */
+int convert_to_btree(void) {
+    int copied;
+    if (studentdb_convert_to_btree(&db, &copied) != 0) {
+        if (errno == EEXIST) {
+            // The text files are stale once another store took over
+            printf("Records are already in %s.\n", db.store.ops == &store_btree_ops ? BTREE_PATH : LSM_DIR);
+        } else {
+            printf("Error writing %s.\n", BTREE_PATH);
+        }
+        return 1;
+    }
+    printf("✓ %d records copied to %s.\n", copied, BTREE_PATH);
+    return 0;
+}
+
+static void print_student_line(const student_t *student, void *arg) {
+    (void)arg;
+    printf("%6d  %-15s %-15s class %2d  average %6.2f\n", student->student_id,
+           str_get(&student->name), str_get(&student->family_name), student->grade, student->average_grade);
+}
+
+/*
+ * FUNCTION: convert_to_lsm
+ * =========================
+ * Copies every output_[ID].txt into data/lsm/, which selects the LSM
+ * store from then on (studentdb_convert_to_lsm)
+ */
+int convert_to_lsm(void) {
+    int copied;
+    if (studentdb_convert_to_lsm(&db, &copied) != 0) {
+        if (errno == EEXIST) {
+            printf("Records are already in %s.\n", db.store.ops == &store_btree_ops ? BTREE_PATH : LSM_DIR);
+        } else {
+            printf("Error writing %s.\n", LSM_DIR);
+        }
+        return 1;
+    }
+    printf("✓ %d records copied to %s.\n", copied, LSM_DIR);
+    return 0;
+}
+
+/*
+ * FUNCTION: list_store
+ * =====================
+ * Prints the students with first_id <= ID <= last_id in ID order, if
+ * the store in use is the one given
+ */
+int list_store(const store_ops_t *ops, int first_id, int last_id) {
+    if (db.store.ops != ops) {
+        printf("No %s store; create one with 'app %s import'.\n", ops->name, ops->name);
+        return 1;
+    }
+    int count = store_scan(&db.store, first_id, last_id, print_student_line, NULL);
+    if (count < 0) {
+        printf("Error: the %s store is damaged.\n", ops->name);
+        return 1;
+    }
+    printf("%d students.\n", count);
+    return 0;
+}
+
+/*
+ * FUNCTION: compact_lsm
+ * ======================
+ * Flushes the memtable, merges every run into one and prints the
+ * store's counters
+ */
+int compact_lsm(void) {
+    lsm_stats_t stats;
+    if (studentdb_compact(&db, &stats) != 0) {
+        if (errno == ENOTSUP) {
+            printf("No lsm store; create one with 'app lsm import'.\n");
+        } else {
+            printf("Error compacting %s.\n", LSM_DIR);
+        }
+        return 1;
+    }
+    printf("%d run(s), %ld flushes, %ld compactions, %ld writer stalls.\n",
+           stats.runs, stats.flushes, stats.compactions, stats.stalls);
+    return 0;
+}
+
+/*
+ * FUNCTION: use_shards
+ * =====================
+ * Shards the store so creates, reads and edits from then on go through
+ * the shard engine (shard.h)
+ *
+ * Parameters:
+ *   - shard_count: Number of shards, or 0 for one per online CPU
+ */
+int use_shards(int shard_count) {
+    if (studentdb_use_shards(&db, shard_count) != 0) {
+        if (errno == EINVAL) {
+            printf("Error: the store has %d shards; the count cannot change.\n", db.shards.shard_count);
+        } else {
+            printf("Error starting the shard engine.\n");
+        }
+        return 1;
+    }
+    printf("%d shards (%s).\n", db.shards.shard_count, SHARD_CONFIG_PATH);
+    return 0;
+}
+
+/*
+ * FUNCTION: run_commands
+ * =======================
+ * Runs a command stream (see command.h) from a file, or stdin for "-"
+ *
+ * Returns:
+ *   - 0 if every command succeeded, 1 otherwise
  */
-int main(void) {
+int run_commands(const char *path) {
+    int fd = strcmp(path, "-") == 0 ? STDIN_FILENO : open(path, O_RDONLY);
+    if (fd < 0) {
+        printf("Error opening %s.\n", path);
+        return 1;
+    }
+    if (attach_ranks() != 0) {
+        if (fd != STDIN_FILENO) {
+            close(fd);
+        }
+        return 1;
+    }
+    int failed = command_run(&db, fd, stdout);
+    if (fd != STDIN_FILENO) {
+        close(fd);
+    }
+    if (failed < 0) {
+        fprintf(stderr, "Error reading %s.\n", path);
+    }
+    return failed != 0;
+}
+
+/*
+ * FUNCTION: serve
+ * ================
+ * Runs the HTTP/JSON API, or the binary RPC protocol (rpc.h) if binary
+ * is set, until SIGINT or SIGTERM, then closes every connection so the
+ * store is closed cleanly
+ */
+int serve(int port, int binary) {
+    // Blocked before the server's threads start, so they inherit the mask
+    sigset_t signals;
+    sigemptyset(&signals);
+    sigaddset(&signals, SIGINT);
+    sigaddset(&signals, SIGTERM);
+    pthread_sigmask(SIG_BLOCK, &signals, NULL);
+
+    // Before the server's threads start, as the view hooks every save
+    if (attach_ranks() != 0) {
+        return 1;
+    }
+    http_server_t http;
+    rpc_server_t rpc;
+    net_server_t *net = binary ? &rpc.net : &http.net;
+    if (binary ? rpc_server_start(&rpc, &db, port) != 0 : http_server_start(&http, &db, port) != 0) {
+        perror(binary ? "Error starting the RPC server" : "Error starting the HTTP server");
+        return 1;
+    }
+    if (binary) {
+        printf("Serving binary RPC on 127.0.0.1:%d (Ctrl-C to stop)\n", net->port);
+    } else {
+        printf("Serving on http://127.0.0.1:%d/students (Ctrl-C to stop)\n", net->port);
+    }
+    fflush(stdout);
+    int signal_number;
+    sigwait(&signals, &signal_number);
+    if (binary) {
+        rpc_server_stop(&rpc);
+    } else {
+        http_server_stop(&http);
+    }
+    printf("Served %ld requests.\n", net->requests);
+    return 0;
+}
+
+/*
+ * FUNCTION: run_command
+ * ======================
+ * Runs a command given on the command line:
+ *     app snapshot    rebuild data/snapshot.bin
+ *     app import FILE bulk-import students from a CSV/TSV file
+ *     app mem         report memory use per subsystem
+ *     app term N      open term N and record every student's grades
+ *     app history ID [FROM TO]
+ *                     show a student's grades term by term
+ *     app rank ID     show a student's rank within their class
+ *     app reports [TEMPLATE]
+ *                     write every student's report card
+ *     app card ID [TEMPLATE]
+ *                     print one report card (cached in data/cards/)
+ *     app scrub [--repair]
+ *                     check every record and the ID counter
+ *     app btree import
+ *                     copy the records into data/students.db and
+ *                     use it as the store from then on
+ *     app btree scan [FROM TO]
+ *                     list students from the B+tree store
+ *     app lsm import  copy the records into data/lsm/ and use it
+ *                     as the store from then on
+ *     app lsm scan [FROM TO]
+ *                     list students from the LSM store
+ *     app lsm compact merge the LSM store's runs into one
+ *     app shards [N]  route adds and edits through N shard workers
+ *                     (one per CPU by default) from then on
+ *     app run [FILE]  run add/edit/get/query commands from FILE or
+ *                     stdin (command.h)
+ *     app serve [PORT]
+ *                     serve the HTTP/JSON API on 127.0.0.1 (http.h)
+ *                     until interrupted
+ *     app rpc [PORT]  serve the binary RPC protocol on 127.0.0.1
+ *                     (rpc.h) until interrupted
+ *
+ * Returns:
+ *   - The process exit status
+ */
+int run_command(int argc, char **argv) {
+    if (strcmp(argv[1], "snapshot") == 0) {
+        return build_snapshot();
+    }
+    if (strcmp(argv[1], "import") == 0 && argc > 2) {
+        return import_students(argv[2]);
+    }
+    if (strcmp(argv[1], "mem") == 0) {
+        return memory_report();
+    }
+    if (strcmp(argv[1], "term") == 0 && argc > 2) {
+        return open_term(atoi(argv[2]));
+    }
+    if (strcmp(argv[1], "history") == 0 && argc > 2) {
+        int from_term = argc > 4 ? atoi(argv[3]) : INT32_MIN;
+        int to_term = argc > 4 ? atoi(argv[4]) : INT32_MAX;
+        return show_history(atoi(argv[2]), from_term, to_term);
+    }
+    if (strcmp(argv[1], "rank") == 0 && argc > 2) {
+        return show_rank(atoi(argv[2]));
+    }
+    if (strcmp(argv[1], "reports") == 0) {
+        return render_reports(argc > 2 ? argv[2] : NULL);
+    }
+    if (strcmp(argv[1], "card") == 0 && argc > 2) {
+        return show_card(atoi(argv[2]), argc > 3 ? argv[3] : NULL);
+    }
+    if (strcmp(argv[1], "scrub") == 0) {
+        return scrub_students(argc > 2 && strcmp(argv[2], "--repair") == 0);
+    }
+    if (strcmp(argv[1], "btree") == 0 && argc > 2 && strcmp(argv[2], "import") == 0) {
+        return convert_to_btree();
+    }
+    if (strcmp(argv[1], "btree") == 0 && argc > 2 && strcmp(argv[2], "scan") == 0) {
+        int first_id = argc > 4 ? atoi(argv[3]) : 1;
+        int last_id = argc > 4 ? atoi(argv[4]) : INT32_MAX;
+        return list_store(&store_btree_ops, first_id, last_id);
+    }
+    if (strcmp(argv[1], "lsm") == 0 && argc > 2 && strcmp(argv[2], "import") == 0) {
+        return convert_to_lsm();
+    }
+    if (strcmp(argv[1], "lsm") == 0 && argc > 2 && strcmp(argv[2], "scan") == 0) {
+        int first_id = argc > 4 ? atoi(argv[3]) : 1;
+        int last_id = argc > 4 ? atoi(argv[4]) : INT32_MAX;
+        return list_store(&store_lsm_ops, first_id, last_id);
+    }
+    if (strcmp(argv[1], "lsm") == 0 && argc > 2 && strcmp(argv[2], "compact") == 0) {
+        return compact_lsm();
+    }
+    if (strcmp(argv[1], "shards") == 0) {
+        return use_shards(argc > 2 ? atoi(argv[2]) : 0);
+    }
+    if (strcmp(argv[1], "run") == 0) {
+        return run_commands(argc > 2 ? argv[2] : "-");
+    }
+    if (strcmp(argv[1], "serve") == 0) {
+        return serve(argc > 2 ? atoi(argv[2]) : HTTP_DEFAULT_PORT, 0);
+    }
+    if (strcmp(argv[1], "rpc") == 0) {
+        return serve(argc > 2 ? atoi(argv[2]) : RPC_DEFAULT_PORT, 1);
+    }
+    printf("Unknown command: %s\n", argv[1]);
+    return 1;
+}
+
+/*
+ * FUNCTION: run_menu
+ * ===================
+ * Interactive mode: shows the menu (Add Student, Edit Student or Migrate
+ * Records), runs the user's choice and returns
+ */
+int run_menu(void) {
     char status;
-    student_t student;
 
     printf("\n");
     printf("╔═══════════════════════════════════════════════════╗\n");
@@ -440,12 +917,14 @@ int main(void) {
     printf("\n");
 
     do {
-        printf("Do you want to create a new student or edit an existing one? (c/e): ");
-        scanf(" %c", &status);
-        if (status != 'c' && status != 'e') {
-            printf("Invalid input. Please enter 'c' or 'e'.\n");
+        printf("Do you want to create a new student, edit an existing one or migrate records? (c/e/m): ");
+        if (scanf(" %c", &status) != 1) {
+            return 1;
+        }
+        if (status != 'c' && status != 'e' && status != 'm') {
+            printf("Invalid input. Please enter 'c', 'e' or 'm'.\n");
         }
-    } while (status != 'c' && status != 'e');
+    } while (status != 'c' && status != 'e' && status != 'm');
 
     if (status == 'c') {
         add_student();
@@ -455,5 +934,35 @@ int main(void) {
         edit_student();
     }
 
+    if (status == 'm') {
+        migrate_students();
+    }
+
     return 0;
-}
\ No newline at end of file
+}
+
+/*
+ * FUNCTION: main
+ * ===============
+ * Entry point of the Student Management System
+ *
+ * Process:
+ *   1. Opens the student store (studentdb.h)
+ *   2. Runs the command given on the command line (run_command), or the
+ *      interactive menu (run_menu) if there is none
+ *   3. Closes the store on every path and returns the command's status
+ */
+int main(int argc, char **argv) {
+    // Selects the store; every save below drops the student's cached report card
+    if (studentdb_open(&db) != 0) {
+        if (errno == EWOULDBLOCK) {
+            printf("The student store is in use by another app process.\n");
+        } else {
+            printf("Error opening the student store.\n");
+        }
+        return 1;
+    }
+    int result = argc > 1 ? run_command(argc, argv) : run_menu();
+    studentdb_close(&db);
+    return result;
+}
@@ -0,0 +1,181 @@
+/*
+ * ============================================================================
+ * MEMORY ACCOUNTING
+ * ============================================================================
+ *
+ * See mem.h for the subsystems and the tracking model.
+ *
+ * ============================================================================
+ */
+
+#include "mem.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdatomic.h>
+#include <malloc.h>
+
+/*
+ * Block Header
+ * ============
+ * 16 bytes in front of every tracked block, keeping the returned pointer
+ * as aligned as malloc's own.
+ */
+typedef struct {
+    _Alignas(16) size_t size;
+    uint32_t subsystem;
+} block_t;
+
+typedef struct {
+    _Alignas(64) atomic_size_t requested;
+    atomic_size_t reserved;
+    atomic_size_t peak;
+    atomic_size_t blocks;
+    atomic_long mapped;
+} counters_t;
+
+static counters_t counters[MEM_SUBSYSTEM_COUNT];
+
+static const char *subsystem_names[MEM_SUBSYSTEM_COUNT] = {
+    "records", "strings", "indexes", "caches", "logs", "queues"
+};
+
+static void account(block_t *block, int sign) {
+    counters_t *c = &counters[block->subsystem];
+    size_t reserved = malloc_usable_size(block);
+    if (sign > 0) {
+        size_t now = atomic_fetch_add(&c->requested, block->size) + block->size;
+        atomic_fetch_add(&c->reserved, reserved);
+        atomic_fetch_add(&c->blocks, 1);
+        size_t peak = atomic_load(&c->peak);
+        while (now > peak && !atomic_compare_exchange_weak(&c->peak, &peak, now)) {
+        }
+    } else {
+        atomic_fetch_sub(&c->requested, block->size);
+        atomic_fetch_sub(&c->reserved, reserved);
+        atomic_fetch_sub(&c->blocks, 1);
+    }
+}
+
+/*
+ * FUNCTION: mem_malloc / mem_calloc / mem_realloc / mem_free
+ * ===========================================================
+ * malloc family that charges each block to a subsystem
+ * mem_realloc(subsystem, NULL, size) behaves like mem_malloc; an existing
+ * block keeps the subsystem it was allocated under.
+ */
+void *mem_malloc(mem_subsystem_t subsystem, size_t size) {
+    block_t *block = malloc(sizeof(block_t) + size);
+    if (!block) {
+        return NULL;
+    }
+    block->size = size;
+    block->subsystem = (uint32_t)subsystem;
+    account(block, 1);
+    return block + 1;
+}
+
+void *mem_calloc(mem_subsystem_t subsystem, size_t count, size_t size) {
+    if (size != 0 && count > (SIZE_MAX - sizeof(block_t)) / size) {
+        return NULL;
+    }
+    void *ptr = mem_malloc(subsystem, count * size);
+    if (ptr) {
+        memset(ptr, 0, count * size);
+    }
+    return ptr;
+}
+
+void *mem_realloc(mem_subsystem_t subsystem, void *ptr, size_t size) {
+    if (!ptr) {
+        return mem_malloc(subsystem, size);
+    }
+    block_t *block = (block_t *)ptr - 1;
+    block_t old = *block;
+    account(block, -1);
+    block_t *grown = realloc(block, sizeof(block_t) + size);
+    if (!grown) {
+        account(block, 1);  // the old block is still live
+        return NULL;
+    }
+    grown->size = size;
+    grown->subsystem = old.subsystem;
+    account(grown, 1);
+    return grown + 1;
+}
+
+void mem_free(void *ptr) {
+    if (!ptr) {
+        return;
+    }
+    block_t *block = (block_t *)ptr - 1;
+    account(block, -1);
+    free(block);
+}
+
+/*
+ * FUNCTION: mem_mapped
+ * =====================
+ * Adds (or with a negative delta, removes) bytes of a file mapping
+ */
+void mem_mapped(mem_subsystem_t subsystem, long delta) {
+    atomic_fetch_add(&counters[subsystem].mapped, delta);
+}
+
+void mem_usage(mem_subsystem_t subsystem, mem_usage_t *usage) {
+    counters_t *c = &counters[subsystem];
+    usage->requested = atomic_load(&c->requested);
+    usage->reserved = atomic_load(&c->reserved);
+    usage->peak = atomic_load(&c->peak);
+    usage->blocks = atomic_load(&c->blocks);
+    long mapped = atomic_load(&c->mapped);
+    usage->mapped = mapped > 0 ? (size_t)mapped : 0;
+}
+
+const char *mem_subsystem_name(mem_subsystem_t subsystem) {
+    return subsystem_names[subsystem];
+}
+
+/*
+ * FUNCTION: mem_print_report
+ * ===========================
+ * Prints per-subsystem usage, bytes per student and fragmentation
+ *
+ * Parameters:
+ *   - out: Where to print
+ *   - students: Roster size used for the per-student column (0 to omit)
+ *
+ * "Slack" is memory malloc reserved beyond what was asked for (headers,
+ * size-class rounding). Heap fragmentation is free memory held inside
+ * malloc's arenas as a share of everything they hold.
+ */
+void mem_print_report(FILE *out, long students) {
+    size_t total_requested = 0;
+    size_t total_reserved = 0;
+    size_t total_mapped = 0;
+
+    fprintf(out, "Subsystem     Bytes used     Mapped    Blocks  Bytes/student  Slack\n");
+    for (int i = 0; i < MEM_SUBSYSTEM_COUNT; i++) {
+        mem_usage_t u;
+        mem_usage((mem_subsystem_t)i, &u);
+        total_requested += u.requested;
+        total_reserved += u.reserved;
+        total_mapped += u.mapped;
+        double per_student = students > 0 ? (double)(u.requested + u.mapped) / students : 0;
+        double slack = u.reserved > 0 ? 100.0 * (double)(u.reserved - u.requested) / u.reserved : 0;
+        fprintf(out, "%-10s %13zu %10zu %9zu %14.1f %5.1f%%\n",
+                subsystem_names[i], u.requested, u.mapped, u.blocks, per_student, slack);
+    }
+    double per_student = students > 0 ? (double)(total_requested + total_mapped) / students : 0;
+    double slack = total_reserved > 0 ? 100.0 * (double)(total_reserved - total_requested) / total_reserved : 0;
+    fprintf(out, "%-10s %13zu %10zu %9s %14.1f %5.1f%%\n",
+            "total", total_requested, total_mapped, "", per_student, slack);
+
+    struct mallinfo2 info = mallinfo2();
+    size_t held = info.arena + info.hblkhd;
+    size_t in_use = info.uordblks + info.hblkhd;
+    fprintf(out, "malloc: %zu bytes held, %zu in use (%zu tracked), heap fragmentation %.1f%%\n",
+            held, in_use, total_reserved,
+            info.arena > 0 ? 100.0 * (double)info.fordblks / info.arena : 0.0);
+}
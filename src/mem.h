@@ -0,0 +1,61 @@
+/*
+ * ============================================================================
+ * MEMORY ACCOUNTING
+ * ============================================================================
+ *
+ * Tracking allocator used by every long-lived structure, so the memory a
+ * roster needs can be broken down by subsystem:
+ *
+ *   - RECORDS:  student_t arrays (shard caches, snapshot overlay, import rows)
+ *   - STRINGS:  the string interning pool and snapshot string tables
+ *   - INDEXES:  STUDENT_ID hash tables, class indexes
+ *   - CACHES:   derived data kept only for speed
+ *   - LOGS:     change-log replay buffers
+ *   - QUEUES:   pipeline rings and scheduler deques
+ *
+ * mem_malloc & co. put a small header in front of each block recording its
+ * subsystem and requested size, so mem_free needs only the pointer. Each
+ * subsystem counts requested bytes, the bytes malloc actually reserved
+ * (malloc_usable_size) and live blocks. Read-only file mappings (the
+ * snapshot) are reported with mem_mapped.
+ *
+ * Counters are atomics; a block must be freed with mem_free, never free().
+ *
+ * ============================================================================
+ */
+
+#ifndef MEM_H
+#define MEM_H
+
+#include <stddef.h>
+#include <stdio.h>
+
+typedef enum {
+    MEM_RECORDS,
+    MEM_STRINGS,
+    MEM_INDEXES,
+    MEM_CACHES,
+    MEM_LOGS,
+    MEM_QUEUES,
+    MEM_SUBSYSTEM_COUNT
+} mem_subsystem_t;
+
+typedef struct {
+    size_t requested;     // bytes asked for by live blocks
+    size_t reserved;      // bytes malloc set aside for them (incl. headers)
+    size_t peak;          // highest requested seen
+    size_t blocks;        // live blocks
+    size_t mapped;        // bytes of file mappings
+} mem_usage_t;
+
+void *mem_malloc(mem_subsystem_t subsystem, size_t size);
+void *mem_calloc(mem_subsystem_t subsystem, size_t count, size_t size);
+void *mem_realloc(mem_subsystem_t subsystem, void *ptr, size_t size);
+void mem_free(void *ptr);
+void mem_mapped(mem_subsystem_t subsystem, long delta);
+
+void mem_usage(mem_subsystem_t subsystem, mem_usage_t *usage);
+const char *mem_subsystem_name(mem_subsystem_t subsystem);
+void mem_print_report(FILE *out, long students);
+
+#endif
@@ -0,0 +1,238 @@
+/*
+ * ============================================================================
+ * LOOPBACK TCP SERVER
+ * ============================================================================
+ *
+ * See net.h. One acceptor thread registers each connection in a slot
+ * under the server lock and starts a detached thread for it; the thread
+ * frees its slot when serve returns.
+ *
+ * ============================================================================
+ */
+
+#include "net.h"
+#include "mem.h"
+
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+
+typedef struct {
+    net_server_t *server;
+    int fd;
+    int slot;
+} connection_t;
+
+int net_send_all(int fd, const void *data, size_t length) {
+    const char *p = data;
+    while (length > 0) {
+        ssize_t sent = send(fd, p, length, MSG_NOSIGNAL);
+        if (sent < 0 && errno == EINTR) {
+            continue;
+        }
+        if (sent <= 0) {
+            return -1;
+        }
+        p += sent;
+        length -= (size_t)sent;
+    }
+    return 0;
+}
+
+/*
+ * FUNCTION: net_connect
+ * ======================
+ * Opens a client connection to 127.0.0.1:port with Nagle's algorithm off
+ *
+ * Returns:
+ *   - The socket, or -1 on error
+ */
+int net_connect(int port) {
+    int fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        return -1;
+    }
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = htons((uint16_t)port);
+    int nodelay = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &nodelay, sizeof(nodelay));
+    if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0) {
+        int saved = errno;
+        close(fd);
+        errno = saved;
+        return -1;
+    }
+    return fd;
+}
+
+static void *run_connection(void *arg) {
+    connection_t *conn = arg;
+    net_server_t *server = conn->server;
+    long requests = server->serve(conn->fd, server->arg);
+
+    pthread_mutex_lock(&server->lock);
+    server->clients[conn->slot] = -1;
+    close(conn->fd);
+    server->active--;
+    server->requests += requests;
+    pthread_cond_broadcast(&server->idle);
+    pthread_mutex_unlock(&server->lock);
+    mem_free(conn);
+    return NULL;
+}
+
+static void *accept_loop(void *arg) {
+    net_server_t *server = arg;
+    for (;;) {
+        int fd = accept(server->listen_fd, NULL, NULL);
+        if (fd < 0) {
+            pthread_mutex_lock(&server->lock);
+            int stop = server->stop;
+            pthread_mutex_unlock(&server->lock);
+            if (stop) {
+                break;
+            }
+            if (errno != EINTR && errno != ECONNABORTED) {
+                usleep(10000);
+            }
+            continue;
+        }
+        int nodelay = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &nodelay, sizeof(nodelay));
+
+        // Registered under the lock that stop takes, so stop shuts it down or we see stop
+        connection_t *conn = mem_calloc(MEM_QUEUES, 1, sizeof(connection_t));
+        int slot = -1;
+        pthread_mutex_lock(&server->lock);
+        int stop = server->stop;
+        for (int i = 0; conn && !stop && i < NET_MAX_CONNECTIONS && slot < 0; i++) {
+            if (server->clients[i] < 0) {
+                slot = i;
+                server->clients[i] = fd;
+                server->active++;
+            }
+        }
+        pthread_mutex_unlock(&server->lock);
+        if (slot < 0) {
+            if (!stop && server->busy) {
+                net_send_all(fd, server->busy, server->busy_length);
+            }
+            close(fd);
+            mem_free(conn);
+            if (stop) {
+                break;
+            }
+            continue;
+        }
+
+        conn->server = server;
+        conn->fd = fd;
+        conn->slot = slot;
+        pthread_t thread;
+        pthread_attr_t attr;
+        pthread_attr_init(&attr);
+        pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+        if (pthread_create(&thread, &attr, run_connection, conn) != 0) {
+            pthread_mutex_lock(&server->lock);
+            server->clients[slot] = -1;
+            close(fd);
+            server->active--;
+            pthread_mutex_unlock(&server->lock);
+            mem_free(conn);
+        }
+        pthread_attr_destroy(&attr);
+    }
+    return NULL;
+}
+
+/*
+ * FUNCTION: net_server_start
+ * ===========================
+ * Listens on 127.0.0.1:port (0 picks a free port, stored in
+ * server->port) and runs serve for each connection
+ *
+ * Parameters:
+ *   - busy: Sent to connections turned away when all slots are taken
+ *     (NULL to just close them)
+ *
+ * Returns:
+ *   - 0 on success, -1 on error (errno set)
+ */
+int net_server_start(net_server_t *server, int port, net_serve_fn serve, void *arg, const char *busy,
+                     size_t busy_length) {
+    memset(server, 0, sizeof(*server));
+    server->serve = serve;
+    server->arg = arg;
+    server->busy = busy;
+    server->busy_length = busy_length;
+    for (int i = 0; i < NET_MAX_CONNECTIONS; i++) {
+        server->clients[i] = -1;
+    }
+    server->listen_fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (server->listen_fd < 0) {
+        return -1;
+    }
+    int reuse = 1;
+    setsockopt(server->listen_fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = htons((uint16_t)port);
+    socklen_t addr_length = sizeof(addr);
+    if (bind(server->listen_fd, (struct sockaddr *)&addr, sizeof(addr)) != 0 ||
+        listen(server->listen_fd, 128) != 0 ||
+        getsockname(server->listen_fd, (struct sockaddr *)&addr, &addr_length) != 0) {
+        int saved = errno;
+        close(server->listen_fd);
+        errno = saved;
+        return -1;
+    }
+    server->port = ntohs(addr.sin_port);
+    pthread_mutex_init(&server->lock, NULL);
+    pthread_cond_init(&server->idle, NULL);
+    if (pthread_create(&server->acceptor, NULL, accept_loop, server) != 0) {
+        close(server->listen_fd);
+        pthread_mutex_destroy(&server->lock);
+        pthread_cond_destroy(&server->idle);
+        errno = EAGAIN;
+        return -1;
+    }
+    return 0;
+}
+
+/*
+ * FUNCTION: net_server_stop
+ * ==========================
+ * Stops accepting, closes every connection (requests being handled
+ * finish first) and waits for their threads to end
+ */
+void net_server_stop(net_server_t *server) {
+    pthread_mutex_lock(&server->lock);
+    server->stop = 1;
+    for (int i = 0; i < NET_MAX_CONNECTIONS; i++) {
+        if (server->clients[i] >= 0) {
+            shutdown(server->clients[i], SHUT_RDWR);
+        }
+    }
+    pthread_mutex_unlock(&server->lock);
+    shutdown(server->listen_fd, SHUT_RDWR);
+    pthread_join(server->acceptor, NULL);
+
+    pthread_mutex_lock(&server->lock);
+    while (server->active > 0) {
+        pthread_cond_wait(&server->idle, &server->lock);
+    }
+    pthread_mutex_unlock(&server->lock);
+    close(server->listen_fd);
+    pthread_mutex_destroy(&server->lock);
+    pthread_cond_destroy(&server->idle);
+}
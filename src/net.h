@@ -0,0 +1,53 @@
+/*
+ * ============================================================================
+ * LOOPBACK TCP SERVER
+ * ============================================================================
+ *
+ * The listener and connection bookkeeping shared by the HTTP API
+ * (http.h) and the binary RPC protocol (rpc.h). It binds 127.0.0.1 only.
+ *
+ * Each accepted connection runs serve(fd, arg) on its own thread, since
+ * requests block on disk I/O; serve returns the number of requests it
+ * handled once the peer closes or the server stops. At most
+ * NET_MAX_CONNECTIONS are served at once; further ones are sent the
+ * busy reply (if any) and closed.
+ *
+ * net_server_stop shuts down every connection's socket, so serve's next
+ * recv returns 0, and waits for all of them to end.
+ *
+ * ============================================================================
+ */
+
+#ifndef NET_H
+#define NET_H
+
+#include <stddef.h>
+#include <pthread.h>
+
+#define NET_MAX_CONNECTIONS 64
+
+typedef long (*net_serve_fn)(int fd, void *arg);
+
+typedef struct {
+    int listen_fd;
+    int port;                         // port bound (when 0 was asked for)
+    net_serve_fn serve;
+    void *arg;
+    const char *busy;                 // reply when full, or NULL
+    size_t busy_length;
+    pthread_t acceptor;
+    pthread_mutex_t lock;
+    pthread_cond_t idle;              // a connection ended
+    int stop;
+    int clients[NET_MAX_CONNECTIONS]; // connection sockets, -1 = free
+    int active;
+    long requests;                    // handled by connections that ended
+} net_server_t;
+
+int net_server_start(net_server_t *server, int port, net_serve_fn serve, void *arg, const char *busy,
+                     size_t busy_length);
+void net_server_stop(net_server_t *server);
+int net_send_all(int fd, const void *data, size_t length);
+int net_connect(int port);
+
+#endif
@@ -0,0 +1,365 @@
+/*
+ * ============================================================================
+ * CLASS RANKING VIEW
+ * ============================================================================
+ *
+ * See rank.h for the structure.
+ *
+ * ============================================================================
+ */
+
+#include "rank.h"
+#include "record.h"
+#include "mem.h"
+
+#include <string.h>
+
+/*
+ * Treap Helpers
+ * =============
+ * Node 0 is the empty tree. Callers hold view->lock.
+ */
+static int size_of(const rank_view_t *view, int t) {
+    return t ? view->nodes[t].size : 0;
+}
+
+static void update_size(rank_view_t *view, int t) {
+    rank_node_t *n = &view->nodes[t];
+    n->size = 1 + size_of(view, n->left) + size_of(view, n->right);
+}
+
+// Class order: higher average first, then lower ID
+static int before(const rank_view_t *view, int a, int b) {
+    float x = view->nodes[a].average;
+    float y = view->nodes[b].average;
+    return x > y || (x == y && a < b);
+}
+
+// Splits t into the nodes ordered before x and the rest
+static void split(rank_view_t *view, int t, int x, int *left, int *right) {
+    if (!t) {
+        *left = *right = 0;
+        return;
+    }
+    if (before(view, t, x)) {
+        split(view, view->nodes[t].right, x, &view->nodes[t].right, right);
+        *left = t;
+    } else {
+        split(view, view->nodes[t].left, x, left, &view->nodes[t].left);
+        *right = t;
+    }
+    update_size(view, t);
+}
+
+// Joins two trees where every node of a comes before every node of b
+static int merge(rank_view_t *view, int a, int b) {
+    if (!a || !b) {
+        return a ? a : b;
+    }
+    if (view->nodes[a].priority > view->nodes[b].priority) {
+        view->nodes[a].right = merge(view, view->nodes[a].right, b);
+        update_size(view, a);
+        return a;
+    }
+    view->nodes[b].left = merge(view, a, view->nodes[b].left);
+    update_size(view, b);
+    return b;
+}
+
+static int insert(rank_view_t *view, int t, int x) {
+    if (!t) {
+        return x;
+    }
+    if (view->nodes[x].priority > view->nodes[t].priority) {
+        split(view, t, x, &view->nodes[x].left, &view->nodes[x].right);
+        update_size(view, x);
+        return x;
+    }
+    if (before(view, x, t)) {
+        view->nodes[t].left = insert(view, view->nodes[t].left, x);
+    } else {
+        view->nodes[t].right = insert(view, view->nodes[t].right, x);
+    }
+    update_size(view, t);
+    return t;
+}
+
+static int erase(rank_view_t *view, int t, int x) {
+    if (t == x) {
+        return merge(view, view->nodes[t].left, view->nodes[t].right);
+    }
+    if (before(view, x, t)) {
+        view->nodes[t].left = erase(view, view->nodes[t].left, x);
+    } else {
+        view->nodes[t].right = erase(view, view->nodes[t].right, x);
+    }
+    update_size(view, t);
+    return t;
+}
+
+// Number of students in tree t with an average above the given one
+static int count_ahead(const rank_view_t *view, int t, float average) {
+    int count = 0;
+    while (t) {
+        if (view->nodes[t].average > average) {
+            count += size_of(view, view->nodes[t].left) + 1;
+            t = view->nodes[t].right;
+        } else {
+            t = view->nodes[t].left;
+        }
+    }
+    return count;
+}
+
+static uint32_t next_priority(rank_view_t *view) {
+    // xorshift32
+    uint32_t x = view->seed;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    return view->seed = x;
+}
+
+/*
+ * Class Directory
+ * ===============
+ * Returns the index of a class level in view->classes, or -1 if absent.
+ * With create set, an absent level is inserted (-1 only if out of memory).
+ */
+static int find_class(rank_view_t *view, int grade, int create) {
+    int lo = 0;
+    int hi = view->class_count;
+    while (lo < hi) {
+        int mid = lo + (hi - lo) / 2;
+        if (view->classes[mid].grade < grade) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    if (lo < view->class_count && view->classes[lo].grade == grade) {
+        return lo;
+    }
+    if (!create) {
+        return -1;
+    }
+    if (view->class_count == view->class_capacity) {
+        int capacity = view->class_capacity ? view->class_capacity * 2 : 16;
+        rank_class_t *classes = mem_realloc(MEM_INDEXES, view->classes, capacity * sizeof(*classes));
+        if (!classes) {
+            return -1;
+        }
+        view->classes = classes;
+        view->class_capacity = capacity;
+    }
+    memmove(&view->classes[lo + 1], &view->classes[lo], (view->class_count - lo) * sizeof(rank_class_t));
+    view->classes[lo].grade = grade;
+    view->classes[lo].root = 0;
+    view->class_count++;
+    return lo;
+}
+
+static int reserve_nodes(rank_view_t *view, int id) {
+    if (id < view->node_capacity) {
+        return 0;
+    }
+    int capacity = view->node_capacity ? view->node_capacity : 1024;
+    while (capacity <= id) {
+        capacity *= 2;
+    }
+    rank_node_t *nodes = mem_realloc(MEM_INDEXES, view->nodes, (size_t)capacity * sizeof(*nodes));
+    if (!nodes) {
+        return -1;
+    }
+    memset(&nodes[view->node_capacity], 0, (size_t)(capacity - view->node_capacity) * sizeof(*nodes));
+    view->nodes = nodes;
+    view->node_capacity = capacity;
+    return 0;
+}
+
+static void remove_locked(rank_view_t *view, int id) {
+    if (id <= 0 || id >= view->node_capacity || !view->nodes[id].present) {
+        return;
+    }
+    int c = find_class(view, view->nodes[id].grade, 0);
+    view->classes[c].root = erase(view, view->classes[c].root, id);
+    view->nodes[id].present = 0;
+}
+
+/*
+ * FUNCTION: rank_init
+ * ====================
+ * Creates an empty view
+ *
+ * Returns:
+ *   - 0 on success, -1 on error
+ */
+int rank_init(rank_view_t *view) {
+    memset(view, 0, sizeof(*view));
+    view->seed = 2463534242u;
+    return pthread_mutex_init(&view->lock, NULL) == 0 ? 0 : -1;
+}
+
+void rank_free(rank_view_t *view) {
+    pthread_mutex_destroy(&view->lock);
+    mem_free(view->nodes);
+    mem_free(view->classes);
+    memset(view, 0, sizeof(*view));
+}
+
+/*
+ * FUNCTION: rank_set
+ * ===================
+ * Places a student in the view, moving them if their class level or
+ * average changed
+ *
+ * Returns:
+ *   - 0 on success, -1 on a bad ID or out of memory (the view is unchanged)
+ */
+int rank_set(rank_view_t *view, int id, int grade, float average) {
+    if (id <= 0) {
+        return -1;
+    }
+    pthread_mutex_lock(&view->lock);
+    if (reserve_nodes(view, id) != 0 || find_class(view, grade, 1) < 0) {
+        pthread_mutex_unlock(&view->lock);
+        return -1;
+    }
+    rank_node_t *n = &view->nodes[id];
+    if (n->present && n->grade == grade && n->average == average) {
+        pthread_mutex_unlock(&view->lock);
+        return 0;
+    }
+    remove_locked(view, id);
+
+    n->average = average;
+    n->grade = grade;
+    n->priority = next_priority(view);
+    n->size = 1;
+    n->left = n->right = 0;
+    n->present = 1;
+    int c = find_class(view, grade, 0);
+    view->classes[c].root = insert(view, view->classes[c].root, id);
+    pthread_mutex_unlock(&view->lock);
+    return 0;
+}
+
+void rank_remove(rank_view_t *view, int id) {
+    pthread_mutex_lock(&view->lock);
+    remove_locked(view, id);
+    pthread_mutex_unlock(&view->lock);
+}
+
+/*
+ * FUNCTION: rank_lookup
+ * ======================
+ * Gets a student's rank within their class level
+ *
+ * Parameters:
+ *   - rank: 1 for the highest average; ties share a rank
+ *   - class_size: students in the class level (may be NULL)
+ *
+ * Returns:
+ *   - 0 on success, -1 if the student is not in the view
+ */
+int rank_lookup(rank_view_t *view, int id, int *rank, int *class_size) {
+    pthread_mutex_lock(&view->lock);
+    if (id <= 0 || id >= view->node_capacity || !view->nodes[id].present) {
+        pthread_mutex_unlock(&view->lock);
+        return -1;
+    }
+    int root = view->classes[find_class(view, view->nodes[id].grade, 0)].root;
+    *rank = count_ahead(view, root, view->nodes[id].average) + 1;
+    if (class_size) {
+        *class_size = size_of(view, root);
+    }
+    pthread_mutex_unlock(&view->lock);
+    return 0;
+}
+
+/*
+ * FUNCTION: rank_nth
+ * ===================
+ * Gets the student at a position (1-based) in a class level's order;
+ * students with equal averages are ordered by ID
+ *
+ * Returns:
+ *   - 0 on success, -1 if the position is outside the class
+ */
+int rank_nth(rank_view_t *view, int grade, int position, int *id) {
+    pthread_mutex_lock(&view->lock);
+    int c = find_class(view, grade, 0);
+    int t = c < 0 ? 0 : view->classes[c].root;
+    if (position < 1 || position > size_of(view, t)) {
+        pthread_mutex_unlock(&view->lock);
+        return -1;
+    }
+    for (;;) {
+        int left = size_of(view, view->nodes[t].left);
+        if (position <= left) {
+            t = view->nodes[t].left;
+        } else if (position == left + 1) {
+            break;
+        } else {
+            position -= left + 1;
+            t = view->nodes[t].right;
+        }
+    }
+    *id = t;
+    pthread_mutex_unlock(&view->lock);
+    return 0;
+}
+
+typedef struct {
+    rank_view_t *view;
+    int failed;
+} build_t;
+
+static void add_student(const student_t *student, void *arg) {
+    build_t *build = arg;
+    if (rank_set(build->view, student->student_id, student->grade, student->average_grade) != 0) {
+        build->failed = 1;
+    }
+}
+
+/*
+ * FUNCTION: rank_build
+ * =====================
+ * Adds every student of a snapshot (including its change-log overlay)
+ *
+ * Returns:
+ *   - 0 on success, -1 on error
+ */
+int rank_build(rank_view_t *view, const snapshot_t *snap) {
+    build_t build = { view, 0 };
+    if (snapshot_scan(snap, add_student, &build) < 0) {
+        return -1;
+    }
+    return build.failed ? -1 : 0;
+}
+
+static void on_commit(int id, const student_t *student, void *arg) {
+    if (student) {
+        rank_set(arg, id, student->grade, student->average_grade);
+    } else {
+        rank_remove(arg, id);
+    }
+}
+
+/*
+ * FUNCTION: rank_attach
+ * ======================
+ * Keeps the view current: every record written through record_commit
+ * from now on updates the student's place in it, and every record_delete
+ * takes the student out. Call before any writer thread starts.
+ *
+ * Returns:
+ *   - 0 on success, -1 if no commit hook slot is free
+ */
+int rank_attach(rank_view_t *view) {
+    return record_add_commit_hook(on_commit, view);
+}
+
+void rank_detach(rank_view_t *view) {
+    record_remove_commit_hook(on_commit, view);
+}
@@ -0,0 +1,77 @@
+/*
+ * ============================================================================
+ * CLASS RANKING VIEW
+ * ============================================================================
+ *
+ * Keeps every student ranked within their class level (student_t.grade)
+ * by average_grade, so a report card can look up a rank without sorting
+ * the class.
+ *
+ * Each class level is an order-statistic treap: a binary search tree
+ * ordered by (average_grade descending, ID ascending) in which every
+ * node also stores the size of its subtree. Inserting, removing and
+ * counting the students ahead of a given average all walk one path from
+ * the root, so each is O(log n) in the class size.
+ *
+ * Nodes live in one array indexed by student ID and refer to each other
+ * by index, so finding a student's old position on update is O(1).
+ *
+ * Ranks are competition ranks: students with equal averages share a rank
+ * and the next rank is skipped (1, 2, 2, 4).
+ *
+ * rank_attach hooks the view into record_commit, so every record written
+ * afterwards (edits, imports, shard updates) moves its student in the
+ * view and every record_delete removes one. studentdb_attach_ranks keeps
+ * one attached view per open store. The view has its own lock and may be
+ * updated from any thread.
+ *
+ * ============================================================================
+ */
+
+#ifndef RANK_H
+#define RANK_H
+
+#include <pthread.h>
+#include <stdint.h>
+#include "student.h"
+#include "snapshot.h"
+
+typedef struct {
+    float average;
+    int grade;
+    uint32_t priority;
+    int size;                // nodes in this subtree
+    int left;                // node indexes (= student IDs), 0 = none
+    int right;
+    int present;
+} rank_node_t;
+
+typedef struct {
+    int grade;
+    int root;
+} rank_class_t;
+
+typedef struct {
+    pthread_mutex_t lock;
+    rank_node_t *nodes;      // nodes[id]; index 0 is unused
+    int node_capacity;
+    rank_class_t *classes;   // sorted by grade
+    int class_count;
+    int class_capacity;
+    uint32_t seed;
+} rank_view_t;
+
+int rank_init(rank_view_t *view);
+void rank_free(rank_view_t *view);
+int rank_build(rank_view_t *view, const snapshot_t *snap);
+
+int rank_set(rank_view_t *view, int id, int grade, float average);
+void rank_remove(rank_view_t *view, int id);
+
+int rank_lookup(rank_view_t *view, int id, int *rank, int *class_size);
+int rank_nth(rank_view_t *view, int grade, int position, int *id);
+
+int rank_attach(rank_view_t *view);
+void rank_detach(rank_view_t *view);
+
+#endif
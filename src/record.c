@@ -0,0 +1,1231 @@
+/*
+ * ============================================================================
+ * STUDENT RECORD FILES (output_<id>.txt)
+ * ============================================================================
+ *
+ * See record.h for the file format and migration model.
+ *
+ * ============================================================================
+ */
+
+#define _GNU_SOURCE  // syncfs
+
+#include "record.h"
+#include "store.h"
+#include "crc32c.h"
+#include "mem.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/file.h>
+
+/*
+ * Record Key Table
+ * ================
+ * One entry per KEY = VALUE line, in the order they are written.
+ * since_version is the schema version that introduced the key.
+ */
+typedef enum { KIND_STRING, KIND_STR, KIND_INT, KIND_FLOAT } key_kind_t;
+
+typedef struct {
+    const char *key;
+    size_t offset;
+    size_t size;
+    key_kind_t kind;
+    int since_version;
+} record_key_t;
+
+#define STRING_KEY(k, member, v) { k, offsetof(student_t, member), sizeof(((student_t *)0)->member), KIND_STRING, v }
+#define STR_KEY(k, member, v) { k, offsetof(student_t, member), sizeof(str_t), KIND_STR, v }
+#define INT_KEY(k, member, v) { k, offsetof(student_t, member), sizeof(int), KIND_INT, v }
+#define FLOAT_KEY(k, member, v) { k, offsetof(student_t, member), sizeof(float), KIND_FLOAT, v }
+
+static const record_key_t record_keys[] = {
+    STR_KEY("NAME", name, 1),
+    STR_KEY("FAMILY_NAME", family_name, 2),
+    STRING_KEY("DOB", dateofbirth, 1),
+    STRING_KEY("STUDENT_ID", studentid, 1),
+    STR_KEY("FATHER_NAME", father_name, 1),
+    STR_KEY("MOTHER_NAME", mother_name, 1),
+    STRING_KEY("PHONE_NUMBER", phone_number, 1),
+    INT_KEY("GRADE", grade, 1),
+    STR_KEY("SUBJECT1_NAME", subject1.name, 1),
+    FLOAT_KEY("SUBJECT1_GRADE", subject1.grade, 1),
+    STR_KEY("SUBJECT2_NAME", subject2.name, 1),
+    FLOAT_KEY("SUBJECT2_GRADE", subject2.grade, 1),
+    STR_KEY("SUBJECT3_NAME", subject3.name, 1),
+    FLOAT_KEY("SUBJECT3_GRADE", subject3.grade, 1),
+    STR_KEY("SUBJECT4_NAME", subject4.name, 1),
+    FLOAT_KEY("SUBJECT4_GRADE", subject4.grade, 1),
+    FLOAT_KEY("AVERAGE_GRADE", average_grade, 1),
+};
+
+#define RECORD_KEY_COUNT (sizeof(record_keys) / sizeof(record_keys[0]))
+
+/*
+ * FUNCTION: record_path
+ * ======================
+ * Builds the filename of a student record (output_[ID].txt)
+ */
+void record_path(int id, char *buf, size_t size) {
+    snprintf(buf, size, "output_%d.txt", id);
+}
+
+static const record_key_t *find_key(const char *key) {
+    for (size_t i = 0; i < RECORD_KEY_COUNT; i++) {
+        if (strcmp(record_keys[i].key, key) == 0) {
+            return &record_keys[i];
+        }
+    }
+    return NULL;
+}
+
+static char *trim(char *s) {
+    while (*s == ' ' || *s == '\t') {
+        s++;
+    }
+    char *end = s + strlen(s);
+    while (end > s && (end[-1] == ' ' || end[-1] == '\t' || end[-1] == '\r' || end[-1] == '\n')) {
+        end--;
+    }
+    *end = '\0';
+    return s;
+}
+
+// Returns -1 if a long name could not be interned
+static int store_value(student_t *student, const record_key_t *k, const char *value) {
+    char *field = (char *)student + k->offset;
+    switch (k->kind) {
+    case KIND_STRING:
+        snprintf(field, k->size, "%s", value);
+        break;
+    case KIND_STR:
+        return str_set((str_t *)field, value);
+    case KIND_INT:
+        *(int *)field = (int)strtol(value, NULL, 10);
+        break;
+    case KIND_FLOAT:
+        *(float *)field = strtof(value, NULL);
+        break;
+    }
+    return 0;
+}
+
+/*
+ * Checksum Trailer
+ * ================
+ * From schema version 3 the last line of a record is
+ *
+ *     CHECKSUM = <crc32c of every byte before this line, 8 hex digits>
+ *
+ * so a file cut short or partly overwritten fails verification instead of
+ * reading as a valid record with missing fields.
+ */
+#define CHECKSUM_KEY "CHECKSUM = "
+#define CHECKSUM_SINCE_VERSION 3
+
+// Returns the length of the checksummed body, or -1 if it does not verify
+static long verify_checksum(const char *data, size_t size) {
+    if (size == 0 || data[size - 1] != '\n') {
+        return -1;
+    }
+    size_t start = size - 1;
+    while (start > 0 && data[start - 1] != '\n') {
+        start--;
+    }
+    if (strncmp(data + start, CHECKSUM_KEY, strlen(CHECKSUM_KEY)) != 0) {
+        return -1;
+    }
+    char *end;
+    unsigned long expected = strtoul(data + start + strlen(CHECKSUM_KEY), &end, 16);
+    if (end != data + size - 1 || crc32c(0, data, start) != (uint32_t)expected) {
+        return -1;
+    }
+    return (long)start;
+}
+
+// Schema version from the first line; files without the header are version 1
+static int header_version(const char *data, size_t size) {
+    const char *key = "SCHEMA_VERSION";
+    if (size < strlen(key) || strncmp(data, key, strlen(key)) != 0) {
+        return 1;
+    }
+    const char *eq = memchr(data, '=', size);
+    return eq ? atoi(eq + 1) : 0;
+}
+
+static char *read_file(FILE *file, size_t *size) {
+    long length = -1;
+    if (fseek(file, 0, SEEK_END) == 0) {
+        length = ftell(file);
+        rewind(file);
+    }
+    char *data = length >= 0 ? malloc((size_t)length + 1) : NULL;
+    if (data && fread(data, 1, (size_t)length, file) != (size_t)length) {
+        free(data);
+        return NULL;
+    }
+    if (data) {
+        data[length] = '\0';
+        *size = (size_t)length;
+    }
+    return data;
+}
+
+/*
+ * FUNCTION: record_read
+ * ======================
+ * Parses a record file into a student structure without migrating it
+ *
+ * Parameters:
+ *   - path: Record file to read
+ *   - student: Output structure (zeroed first; student_id is left at 0)
+ *   - version: Receives the schema version found (1 if no header)
+ *
+ * Returns:
+ *   - 0 on success
+ *   - -1 if the file cannot be opened (errno is preserved), or with errno
+ *     EBADMSG if it is damaged: the checksum does not match, or the file
+ *     holds no KEY = VALUE lines at all
+ *   - -1 with errno ENOMEM if a long name could not be interned
+ *
+ * Unknown keys are ignored so newer files can still be read.
+ */
+int record_read(const char *path, student_t *student, int *version) {
+    FILE *file = fopen(path, "rb");
+    if (!file) {
+        return -1;
+    }
+    size_t size = 0;
+    char *data = read_file(file, &size);
+    fclose(file);
+    if (!data) {
+        errno = EIO;
+        return -1;
+    }
+
+    // Versions with a checksum are only parsed up to the trailer
+    int found_version = header_version(data, size);
+    long body = (long)size;
+    if (found_version >= CHECKSUM_SINCE_VERSION || found_version < 1) {
+        body = found_version < 1 ? -1 : verify_checksum(data, size);
+    }
+    if (body < 0) {
+        free(data);
+        errno = EBADMSG;
+        return -1;
+    }
+
+    memset(student, 0, sizeof(*student));
+    int keys = 0;
+    int failed = 0;
+    char *line = data;
+    char *limit = data + body;
+    while (line < limit) {
+        char *newline = memchr(line, '\n', (size_t)(limit - line));
+        char *next = newline ? newline + 1 : limit;
+        *(newline ? newline : limit) = '\0';
+
+        char *eq = strchr(line, '=');
+        if (eq) {
+            *eq = '\0';
+            char *key = trim(line);
+            char *value = trim(eq + 1);
+            const record_key_t *k = find_key(key);
+            keys++;
+            if (k && store_value(student, k, value) != 0) {
+                failed = 1;
+            }
+        }
+        line = next;
+    }
+
+    free(data);
+    if (failed) {
+        errno = ENOMEM;
+        return -1;
+    }
+    if (keys == 0) {
+        errno = EBADMSG;
+        return -1;
+    }
+    if (version) {
+        *version = found_version;
+    }
+    return 0;
+}
+
+/*
+ * FUNCTION: record_write
+ * =======================
+ * Writes a student structure to a file in the current schema, ending
+ * with the checksum trailer
+ * The record is formatted in memory and written with a single fwrite.
+ *
+ * Returns:
+ *   - 0 on success, -1 if the file could not be written completely
+ */
+int record_write(const char *path, const student_t *student) {
+    char *buf = NULL;
+    size_t size = 0;
+    FILE *out = open_memstream(&buf, &size);
+    if (!out) {
+        return -1;
+    }
+
+    int ok = fprintf(out, "SCHEMA_VERSION = %d\n", RECORD_SCHEMA_VERSION) > 0;
+    for (size_t i = 0; ok && i < RECORD_KEY_COUNT; i++) {
+        const record_key_t *k = &record_keys[i];
+        const char *field = (const char *)student + k->offset;
+        switch (k->kind) {
+        case KIND_STRING:
+            ok = fprintf(out, "%s = %s\n", k->key, field) > 0;
+            break;
+        case KIND_STR:
+            ok = fprintf(out, "%s = %s\n", k->key, str_get((const str_t *)field)) > 0;
+            break;
+        case KIND_INT:
+            ok = fprintf(out, "%s = %d\n", k->key, *(const int *)field) > 0;
+            break;
+        case KIND_FLOAT:
+            ok = fprintf(out, "%s = %.2f\n", k->key, *(const float *)field) > 0;
+            break;
+        }
+    }
+    if (fclose(out) != 0) {
+        ok = 0;
+    }
+
+    FILE *file = ok ? fopen(path, "wb") : NULL;
+    if (file) {
+        char trailer[32];
+        int length = snprintf(trailer, sizeof(trailer), CHECKSUM_KEY "%08x\n", (unsigned)crc32c(0, buf, size));
+        ok = fwrite(buf, 1, size, file) == size && fwrite(trailer, 1, (size_t)length, file) == (size_t)length;
+        if (fclose(file) != 0) {
+            ok = 0;
+        }
+    }
+    free(buf);
+    return ok && file ? 0 : -1;
+}
+
+/*
+ * Schema Upgrades
+ * ===============
+ * upgrade_steps[v] converts a record from version v to v + 1.
+ * record_read() zero-fills the structure, so fields a step introduces
+ * start out empty; a step only has to derive values from older fields.
+ */
+static void upgrade_v1_to_v2(student_t *student) {
+    // FAMILY_NAME did not exist in version 1
+    str_set(&student->family_name, "");
+}
+
+static void upgrade_v2_to_v3(student_t *student) {
+    // Version 3 only adds the checksum trailer, written by record_write
+    (void)student;
+}
+
+typedef void (*upgrade_fn)(student_t *student);
+
+static const upgrade_fn upgrade_steps[RECORD_SCHEMA_VERSION] = {
+    NULL,               // version 0 is unused
+    upgrade_v1_to_v2,
+    upgrade_v2_to_v3,
+};
+
+static void upgrade(student_t *student, int from_version) {
+    if (from_version < 1) {
+        from_version = 1;
+    }
+    for (int v = from_version; v < RECORD_SCHEMA_VERSION; v++) {
+        upgrade_steps[v](student);
+    }
+}
+
+/*
+ * Change Log
+ * ==========
+ * Every successful save appends the student ID to a change log
+ * (RECORD_CHANGE_LOG for the default store). Snapshots remember the log
+ * size they were built at and replay the IDs written after it
+ * (see snapshot.c).
+ */
+typedef struct {
+    record_commit_fn fn;
+    void *arg;
+} commit_hook_t;
+
+static commit_hook_t commit_hooks[RECORD_MAX_COMMIT_HOOKS];
+
+/*
+ * FUNCTION: record_add_commit_hook
+ * =================================
+ * Registers a function called after every successful record_commit with
+ * the record just written, and after every record_delete with student
+ * NULL. Register hooks before any writer thread starts; a hook itself
+ * may run on any writer thread.
+ *
+ * Returns:
+ *   - 0 on success, -1 if RECORD_MAX_COMMIT_HOOKS are already registered
+ */
+int record_add_commit_hook(record_commit_fn fn, void *arg) {
+    for (int i = 0; i < RECORD_MAX_COMMIT_HOOKS; i++) {
+        if (!commit_hooks[i].fn) {
+            commit_hooks[i].arg = arg;
+            commit_hooks[i].fn = fn;
+            return 0;
+        }
+    }
+    return -1;
+}
+
+void record_remove_commit_hook(record_commit_fn fn, void *arg) {
+    for (int i = 0; i < RECORD_MAX_COMMIT_HOOKS; i++) {
+        if (commit_hooks[i].fn == fn && commit_hooks[i].arg == arg) {
+            commit_hooks[i].fn = NULL;
+            commit_hooks[i].arg = NULL;
+        }
+    }
+}
+
+/*
+ * FUNCTION: record_log_size
+ * ==========================
+ * Returns the current size of the change log in bytes (0 if absent)
+ */
+long record_log_size(void) {
+    pthread_mutex_lock(&file_mutex);
+    FILE *log = fopen(RECORD_CHANGE_LOG, "r");
+    long size = 0;
+    if (log) {
+        fseek(log, 0, SEEK_END);
+        size = ftell(log);
+        fclose(log);
+    }
+    pthread_mutex_unlock(&file_mutex);
+    return size < 0 ? 0 : size;
+}
+
+static void notify_commit(int id, const student_t *student) {
+    for (int i = 0; i < RECORD_MAX_COMMIT_HOOKS; i++) {
+        record_commit_fn fn = commit_hooks[i].fn;
+        if (fn) {
+            fn(id, student, commit_hooks[i].arg);
+        }
+    }
+}
+
+/*
+ * Durability Helpers
+ * ==================
+ * Batches at least RECORD_SYNCFS_MIN records long flush their temp files
+ * with a single syncfs(); smaller ones fdatasync each file, which avoids
+ * flushing unrelated dirty data for a single interactive edit.
+ */
+#define RECORD_SYNCFS_MIN 8
+
+static int sync_path(const char *path, int data_only) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        return -1;
+    }
+    int rc = data_only ? fdatasync(fd) : fsync(fd);
+    close(fd);
+    return rc;
+}
+
+static void temp_path(int id, char *buf, size_t size) {
+    snprintf(buf, size, "temp_%d.txt", id);
+}
+
+/*
+ * FUNCTION: record_write_counter
+ * ===============================
+ * Durably replaces a counter file (data/next_id.txt, a shard counter)
+ * with value
+ *
+ * Process:
+ *   1. Write [path].tmp, flush it and fsync it
+ *   2. rename() it over path, so the counter is never missing
+ *   3. fsync the directory so the rename survives a crash
+ *
+ * Returns:
+ *   - 0 on success, -1 on error (the old counter is left in place if the
+ *     rename did not happen)
+ */
+int record_write_counter(const char *path, int value) {
+    char tempname[256];
+    snprintf(tempname, sizeof(tempname), "%s.tmp", path);
+    FILE *file = fopen(tempname, "w");
+    if (!file) {
+        return -1;
+    }
+    int ok = fprintf(file, "%d\n", value) > 0 && fflush(file) == 0 && fsync(fileno(file)) == 0;
+    if (fclose(file) != 0) {
+        ok = 0;
+    }
+    if (!ok || rename(tempname, path) != 0) {
+        remove(tempname);
+        return -1;
+    }
+
+    char dir[256];
+    const char *slash = strrchr(path, '/');
+    if (!slash) {
+        snprintf(dir, sizeof(dir), ".");
+    } else {
+        snprintf(dir, sizeof(dir), "%.*s", slash == path ? 1 : (int)(slash - path), path);
+    }
+    return sync_path(dir, 0);
+}
+
+/*
+ * ID Counters
+ * ===========
+ * Every allocator (studentdb_create, the importer, the shard engine)
+ * takes IDs through record_reserve_ids, which holds counter_mutex
+ * against other threads and an flock on [path].lock against other
+ * processes while it reads and advances the counter.
+ */
+static pthread_mutex_t counter_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+// Returns the lock file descriptor, or -1 if the lock file cannot be opened
+static int lock_counter(const char *path) {
+    char lockname[256];
+    snprintf(lockname, sizeof(lockname), "%s.lock", path);
+    pthread_mutex_lock(&counter_mutex);
+    int fd = open(lockname, O_RDWR | O_CREAT, 0644);
+    if (fd < 0 || flock(fd, LOCK_EX) != 0) {
+        if (fd >= 0) {
+            close(fd);
+        }
+        pthread_mutex_unlock(&counter_mutex);
+        return -1;
+    }
+    return fd;
+}
+
+static void unlock_counter(int fd) {
+    close(fd);   // drops the flock
+    pthread_mutex_unlock(&counter_mutex);
+}
+
+static int read_counter(const char *path) {
+    int id = 1;
+    FILE *file = fopen(path, "r");
+    if (file) {
+        if (fscanf(file, "%d", &id) != 1 || id < 1) {
+            id = 1;
+        }
+        fclose(file);
+    }
+    return id;
+}
+
+/*
+ * FUNCTION: record_reserve_ids
+ * =============================
+ * Takes count consecutive IDs from the counter at path (data/next_id.txt)
+ * and durably advances it past them before returning
+ *
+ * Returns:
+ *   - The first reserved ID, or -1 if the counter could not be written
+ */
+int record_reserve_ids(const char *path, int count) {
+    int fd = lock_counter(path);
+    if (fd < 0) {
+        return -1;
+    }
+    int first = read_counter(path);
+    int result = record_write_counter(path, first + count) == 0 ? first : -1;
+    unlock_counter(fd);
+    return result;
+}
+
+/*
+ * FUNCTION: record_release_ids
+ * =============================
+ * Gives back the unused IDs [first, end) of a reservation, but only if
+ * the counter still stands at end (nobody reserved after it)
+ *
+ * Returns:
+ *   - 0 if the IDs were given back or another reservation followed,
+ *     -1 if the counter could not be written
+ */
+int record_release_ids(const char *path, int first, int end) {
+    int fd = lock_counter(path);
+    if (fd < 0) {
+        return -1;
+    }
+    int result = 0;
+    if (read_counter(path) == end) {
+        result = record_write_counter(path, first);
+    }
+    unlock_counter(fd);
+    return result;
+}
+
+static int sync_temps(const record_batch_t *batch) {
+#ifdef __linux__
+    if (batch->count >= RECORD_SYNCFS_MIN) {
+        int fd = open(".", O_RDONLY);
+        if (fd >= 0) {
+            int rc = syncfs(fd);
+            close(fd);
+            if (rc == 0) {
+                return 0;
+            }
+        }
+    }
+#endif
+    for (int i = 0; i < batch->count; i++) {
+        char tempname[128];
+        temp_path(batch->entries[i].id, tempname, sizeof(tempname));
+        if (sync_path(tempname, 1) != 0) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+/*
+ * Appends count IDs to log_path with one write and one flush. The IDs
+ * are ints at id_offset within count items stride bytes apart, so batch
+ * entries, students and a lone ID share this one writer.
+ *
+ * Returns -1 with errno set if the log could not be appended; the caller
+ * reports it, since a snapshot reading the log would miss the change.
+ */
+static int log_changes(const char *log_path, const void *items, size_t stride, size_t id_offset, int count) {
+    FILE *log = fopen(log_path, "a");
+    if (!log) {
+        return -1;
+    }
+    const char *item = items;
+    int ok = 1;
+    for (int i = 0; ok && i < count; i++, item += stride) {
+        int id;
+        memcpy(&id, item + id_offset, sizeof(id));
+        ok = fprintf(log, "%d\n", id) > 0;
+    }
+    ok = ok && fflush(log) == 0 && fdatasync(fileno(log)) == 0;
+    int saved = errno;
+    if (fclose(log) != 0) {
+        ok = 0;
+        saved = errno;
+    }
+    errno = saved;
+    return ok ? 0 : -1;
+}
+
+/*
+ * FUNCTION: record_batch_init
+ * ============================
+ * Starts an empty batch whose commits append to log_path
+ */
+void record_batch_init(record_batch_t *batch, const char *log_path) {
+    batch->log_path = log_path;
+    batch->entries = NULL;
+    batch->count = 0;
+    batch->capacity = 0;
+}
+
+/*
+ * FUNCTION: record_batch_add
+ * ===========================
+ * Writes a record to temp_[ID].txt and queues it for the next commit
+ *
+ * Returns:
+ *   - 0 on success, -1 if the temp file could not be written
+ */
+int record_batch_add(record_batch_t *batch, int id, const student_t *student) {
+    int slot = batch->count;
+    for (int i = 0; i < batch->count; i++) {
+        if (batch->entries[i].id == id) {
+            slot = i;
+            break;
+        }
+    }
+    if (slot == batch->capacity) {
+        int capacity = batch->capacity ? batch->capacity * 2 : 16;
+        record_batch_entry_t *entries = mem_realloc(MEM_RECORDS, batch->entries,
+                                                    (size_t)capacity * sizeof(*entries));
+        if (!entries) {
+            return -1;
+        }
+        batch->entries = entries;
+        batch->capacity = capacity;
+    }
+
+    char tempname[128];
+    temp_path(id, tempname, sizeof(tempname));
+    if (record_write(tempname, student) != 0) {
+        remove(tempname);
+        if (slot < batch->count) {
+            // The earlier pending version went with the temp file
+            batch->entries[slot] = batch->entries[--batch->count];
+        }
+        return -1;
+    }
+    batch->entries[slot].id = id;
+    batch->entries[slot].student = *student;
+    if (slot == batch->count) {
+        batch->count++;
+    }
+    return 0;
+}
+
+/*
+ * FUNCTION: record_batch_commit
+ * ==============================
+ * Replaces every record in the batch and empties it
+ *
+ * Process:
+ *   1. Flush all temp files to disk (one syncfs, or fdatasync per file)
+ *   2. rename() each temp file over its record; the old record stays in
+ *      place until the new one replaces it
+ *   3. fsync the directory once so the renames are durable
+ *   4. Append the IDs to the batch's log (if it has one) and flush it once
+ *   5. Call the commit hooks for each record replaced (unless notify is
+ *      0, for record_file_save)
+ *
+ * A crash at any point leaves every record either old or new, never
+ * missing. The log is written after the renames so a snapshot that reads
+ * a logged ID always finds the new record.
+ *
+ * Does not take file_mutex: the caller must make sure no one else writes
+ * the same IDs concurrently.
+ *
+ * Returns:
+ *   - Number of records committed, or -1 with errno set if the temp files
+ *     could not be flushed, a rename failed (that record is left as it
+ *     was), the directory fsync failed or the change log could not be
+ *     appended. Records already renamed are logged and notified either
+ *     way, since readers can see them.
+ */
+static int commit_batch(record_batch_t *batch, int notify) {
+    if (batch->count == 0) {
+        return 0;
+    }
+    if (sync_temps(batch) != 0) {
+        int saved = errno;
+        record_batch_abort(batch);
+        errno = saved;
+        return -1;
+    }
+
+    // Move the committed entries to the front so they can be logged together
+    int committed = 0;
+    int error = 0;
+    for (int i = 0; i < batch->count; i++) {
+        record_batch_entry_t *entry = &batch->entries[i];
+        char filename[128];
+        char tempname[128];
+        record_path(entry->id, filename, sizeof(filename));
+        temp_path(entry->id, tempname, sizeof(tempname));
+        if (rename(tempname, filename) != 0) {
+            error = errno;
+            remove(tempname);
+            continue;
+        }
+        if (committed != i) {
+            batch->entries[committed] = *entry;
+        }
+        committed++;
+    }
+    if (committed > 0 && sync_path(".", 0) != 0 && error == 0) {
+        error = errno;
+    }
+    if (batch->log_path && committed > 0 &&
+        log_changes(batch->log_path, batch->entries, sizeof(record_batch_entry_t),
+                    offsetof(record_batch_entry_t, id), committed) != 0 && error == 0) {
+        error = errno;
+    }
+
+    for (int i = 0; notify && i < committed; i++) {
+        notify_commit(batch->entries[i].id, &batch->entries[i].student);
+    }
+    batch->count = 0;
+    if (error != 0) {
+        errno = error;
+        return -1;
+    }
+    return committed;
+}
+
+int record_batch_commit(record_batch_t *batch) {
+    return commit_batch(batch, 1);
+}
+
+/*
+ * FUNCTION: record_batch_abort
+ * =============================
+ * Drops every pending record and its temp file, leaving the originals
+ */
+void record_batch_abort(record_batch_t *batch) {
+    for (int i = 0; i < batch->count; i++) {
+        char tempname[128];
+        temp_path(batch->entries[i].id, tempname, sizeof(tempname));
+        remove(tempname);
+    }
+    batch->count = 0;
+}
+
+void record_batch_free(record_batch_t *batch) {
+    record_batch_abort(batch);
+    mem_free(batch->entries);
+    batch->entries = NULL;
+    batch->capacity = 0;
+}
+
+/*
+ * FUNCTION: record_commit
+ * ========================
+ * Durably replaces one record and appends its ID to log_path, then calls
+ * the registered commit hooks (a batch of one, see record_batch_commit)
+ *
+ * Does not take file_mutex: the caller must make sure no one else writes
+ * the same ID concurrently (record_save does this with file_mutex, the
+ * sharded engine by giving every ID a single owning thread).
+ *
+ * Returns:
+ *   - 0 on success, -1 on error
+ */
+int record_commit(int id, const student_t *student, const char *log_path) {
+    // A batch of one needs no allocation
+    record_batch_entry_t entry;
+    record_batch_t batch = { log_path, &entry, 0, 1 };
+    int rc = record_batch_add(&batch, id, student) == 0 && record_batch_commit(&batch) == 1 ? 0 : -1;
+    record_batch_abort(&batch);
+    return rc;
+}
+
+/*
+ * FUNCTION: record_file_save
+ * ===========================
+ * Durably replaces output_[ID].txt like record_commit, but without
+ * logging the ID or calling the commit hooks (the text store's put; see
+ * store.h): the selected-store functions below do both for every store
+ *
+ * Returns:
+ *   - 0 on success, -1 on error
+ */
+int record_file_save(int id, const student_t *student) {
+    record_batch_entry_t entry;
+    record_batch_t batch = { NULL, &entry, 0, 1 };
+    int rc = record_batch_add(&batch, id, student) == 0 && commit_batch(&batch, 0) == 1 ? 0 : -1;
+    record_batch_abort(&batch);
+    return rc;
+}
+
+/*
+ * FUNCTION: record_file_save_many
+ * ================================
+ * record_file_save for count records keyed by their student_id, as one
+ * batch: one flush of the temp files and one directory fsync
+ *
+ * Returns:
+ *   - 0 if every record was replaced, -1 otherwise
+ */
+int record_file_save_many(const student_t *students, int count) {
+    record_batch_t batch;
+    record_batch_init(&batch, NULL);
+    int ok = 1;
+    for (int i = 0; ok && i < count; i++) {
+        ok = record_batch_add(&batch, students[i].student_id, &students[i]) == 0;
+    }
+    ok = ok && commit_batch(&batch, 0) == count;
+    record_batch_free(&batch);
+    return ok ? 0 : -1;
+}
+
+/*
+ * FUNCTION: record_file_load
+ * ===========================
+ * Reads output_[ID].txt, upgrading the file in place if it is old
+ * Takes no lock (the text store's get; see store.h).
+ *
+ * Returns:
+ *   - 0 on success, 1 if the file was upgraded and rewritten, -1 if it is
+ *     missing, damaged or could not be rewritten
+ */
+int record_file_load(int id, student_t *student) {
+    char filename[128];
+    record_path(id, filename, sizeof(filename));
+
+    int version;
+    if (record_read(filename, student, &version) != 0) {
+        return -1;
+    }
+    student->student_id = id;
+
+    if (version >= RECORD_SCHEMA_VERSION) {
+        return 0;
+    }
+    upgrade(student, version);
+    if (record_file_save(id, student) != 0) {
+        return -1;
+    }
+    return 1;
+}
+
+/*
+ * FUNCTION: record_file_read
+ * ===========================
+ * Reads output_[ID].txt, upgrading old records in memory only, so it
+ * never writes (the text store's scan; see store.h)
+ *
+ * Returns:
+ *   - 0 on success, -1 if the file is missing or damaged
+ */
+int record_file_read(int id, student_t *student) {
+    char filename[128];
+    record_path(id, filename, sizeof(filename));
+
+    int version;
+    if (record_read(filename, student, &version) != 0) {
+        return -1;
+    }
+    student->student_id = id;
+    if (version < RECORD_SCHEMA_VERSION) {
+        upgrade(student, version);
+    }
+    return 0;
+}
+
+/*
+ * FUNCTION: record_file_delete
+ * =============================
+ * Removes output_[ID].txt (the text store's remove; see record_delete)
+ *
+ * Returns:
+ *   - 0 on success, -1 on error (errno ENOENT if there was no record)
+ */
+int record_file_delete(int id) {
+    char filename[128];
+    record_path(id, filename, sizeof(filename));
+    if (remove(filename) != 0) {
+        return -1;
+    }
+    return sync_path(".", 0);
+}
+
+/*
+ * Selected Store
+ * ==============
+ * record_load, record_save and record_update go through a store_t
+ * (store.h): the text files unless record_use_store picked another. The
+ * change log and the commit hooks are written here, after the store, so
+ * snapshots (snapshot.h) and caches see changes whichever store is in
+ * use.
+ */
+static store_t record_store = { &store_text_ops, NULL };
+
+void record_use_store(const store_t *store) {
+    if (store) {
+        record_store = *store;
+    } else {
+        store_text(&record_store);
+    }
+}
+
+// Logs one changed ID; caller must hold file_mutex
+static int log_change(int id) {
+    return log_changes(RECORD_CHANGE_LOG, &id, sizeof(id), 0, 1);
+}
+
+/*
+ * Caller must hold file_mutex. If only the change log append fails the
+ * record is saved and the hooks have run, but -1 is returned so the
+ * caller reports it.
+ */
+static int save_locked(int id, const student_t *student) {
+    if (store_put(&record_store, id, student) != 0) {
+        return -1;
+    }
+    int logged = log_change(id);
+    notify_commit(id, student);
+    return logged;
+}
+
+// Caller must hold file_mutex. Returns 1 if the record was rewritten.
+static int load_locked(int id, student_t *student) {
+    int result = store_get(&record_store, id, student);
+    if (result == 1) {
+        // A schema upgrade changes no values, so a snapshot that misses
+        // this log line is still right; the read need not fail over it
+        (void)log_change(id);
+        notify_commit(id, student);
+    }
+    return result;
+}
+
+/*
+ * FUNCTION: record_load
+ * ======================
+ * Loads a student by ID, upgrading the file in place if it is old
+ *
+ * Returns:
+ *   - 0 on success, -1 if the record is missing or could not be migrated
+ */
+int record_load(int id, student_t *student) {
+    pthread_mutex_lock(&file_mutex);
+    int result = load_locked(id, student);
+    pthread_mutex_unlock(&file_mutex);
+    return result < 0 ? -1 : 0;
+}
+
+/*
+ * FUNCTION: record_save
+ * ======================
+ * Writes a student record through a temporary file (temp_[ID].txt)
+ *
+ * Returns:
+ *   - 0 on success, -1 on error; if the record was saved but its ID could
+ *     not be appended to RECORD_CHANGE_LOG, -1 with errno from the log
+ *     (the commit hooks have run)
+ */
+int record_save(int id, const student_t *student) {
+    pthread_mutex_lock(&file_mutex);
+    int result = save_locked(id, student);
+    pthread_mutex_unlock(&file_mutex);
+    return result;
+}
+
+/*
+ * FUNCTION: record_save_many
+ * ===========================
+ * Saves count new records keyed by their student_id with one sync in the
+ * selected store (see store_put_many), then calls the commit hooks
+ *
+ * The IDs must be freshly reserved (record_reserve_ids), so no other
+ * thread can be saving them. The store write and its sync then run
+ * outside file_mutex, and concurrent callers (the importer's writers)
+ * overlap their syncs; only the change log and hooks are serialized.
+ * The B+tree still commits one transaction at a time (its write_lock).
+ *
+ * Returns:
+ *   - 0 on success, -1 on error: the store write failed (the hooks are
+ *     not called then) or the change log could not be appended (they are)
+ */
+int record_save_many(const student_t *students, int count) {
+    if (store_put_many(&record_store, students, count) != 0) {
+        return -1;
+    }
+    pthread_mutex_lock(&file_mutex);
+    int logged = log_changes(RECORD_CHANGE_LOG, students, sizeof(student_t), offsetof(student_t, student_id), count);
+    for (int i = 0; i < count; i++) {
+        notify_commit(students[i].student_id, &students[i]);
+    }
+    pthread_mutex_unlock(&file_mutex);
+    return logged;
+}
+
+/*
+ * FUNCTION: record_delete
+ * ========================
+ * Removes a student from the selected store, logs the ID and tells the
+ * commit hooks (with student NULL)
+ *
+ * Returns:
+ *   - 0 on success, -1 on error (see store_delete, or the student was
+ *     removed but the change log could not be appended)
+ */
+int record_delete(int id) {
+    pthread_mutex_lock(&file_mutex);
+    int result = store_delete(&record_store, id);
+    if (result == 0) {
+        result = log_change(id);
+        notify_commit(id, NULL);
+    }
+    pthread_mutex_unlock(&file_mutex);
+    return result;
+}
+
+/*
+ * FUNCTION: record_scan
+ * ======================
+ * Visits the students with first_id <= ID <= last_id in the selected
+ * store, in ID order, holding file_mutex so no save interleaves
+ * visit must not call back into the record functions.
+ *
+ * Returns:
+ *   - Number of students visited, or -1 on error
+ */
+int record_scan(int first_id, int last_id, record_visit_fn visit, void *arg) {
+    pthread_mutex_lock(&file_mutex);
+    int result = store_scan(&record_store, first_id, last_id, visit, arg);
+    pthread_mutex_unlock(&file_mutex);
+    return result;
+}
+
+/*
+ * FUNCTION: record_update
+ * ========================
+ * Read-modify-write of a single field, holding file_mutex throughout
+ *
+ * Returns:
+ *   - 0 on success, -1 if the record is missing, the value is not valid
+ *     for the field, or the file could not be written
+ */
+int record_update(int id, field_t field, const char *value) {
+    student_t student;
+    int result = -1;
+
+    pthread_mutex_lock(&file_mutex);
+    if (load_locked(id, &student) >= 0 &&
+        record_set_field(&student, field, value) == 0) {
+        result = save_locked(id, &student);
+    }
+    pthread_mutex_unlock(&file_mutex);
+    return result;
+}
+
+/*
+ * FUNCTION: record_migrate
+ * =========================
+ * Upgrades one record to the current schema if needed
+ *
+ * Returns:
+ *   - 1 if the file was rewritten
+ *   - 0 if it was already current or does not exist
+ *   - -1 on error
+ */
+int record_migrate(int id) {
+    student_t student;
+
+    pthread_mutex_lock(&file_mutex);
+    int result = load_locked(id, &student);
+    int missing = result < 0 && errno == ENOENT;
+    pthread_mutex_unlock(&file_mutex);
+
+    return missing ? 0 : result;
+}
+
+static int parse_float(const char *value, float *out) {
+    char *end;
+    float f = strtof(value, &end);
+    if (end == value || *end != '\0') {
+        return -1;
+    }
+    *out = f;
+    return 0;
+}
+
+/*
+ * FUNCTION: record_set_field
+ * ===========================
+ * Applies a new value to one field of an in-memory record
+ * Subject grade changes recompute average_grade.
+ *
+ * Returns:
+ *   - 0 on success, -1 if a numeric field could not be parsed or a long
+ *     name could not be interned (errno ENOMEM)
+ */
+int record_set_field(student_t *student, field_t field, const char *value) {
+    switch (field) {
+    case FIELD_NAME:
+        return str_set(&student->name, value);
+    case FIELD_FAMILY_NAME:
+        return str_set(&student->family_name, value);
+    case FIELD_PHONE_NUMBER:
+        snprintf(student->phone_number, sizeof(student->phone_number), "%s", value);
+        return 0;
+    case FIELD_FATHER_NAME:
+        return str_set(&student->father_name, value);
+    case FIELD_MOTHER_NAME:
+        return str_set(&student->mother_name, value);
+    case FIELD_DATE_OF_BIRTH:
+        snprintf(student->dateofbirth, sizeof(student->dateofbirth), "%s", value);
+        return 0;
+    case FIELD_GRADE: {
+        char *end;
+        long grade = strtol(value, &end, 10);
+        if (end == value || *end != '\0') {
+            return -1;
+        }
+        student->grade = (int)grade;
+        return 0;
+    }
+    case FIELD_SUBJECT1_GRADE:
+    case FIELD_SUBJECT2_GRADE:
+    case FIELD_SUBJECT3_GRADE:
+    case FIELD_SUBJECT4_GRADE: {
+        subject_t *subjects[] = { &student->subject1, &student->subject2,
+                                  &student->subject3, &student->subject4 };
+        if (parse_float(value, &subjects[field - FIELD_SUBJECT1_GRADE]->grade) != 0) {
+            return -1;
+        }
+        calculate_average(student);
+        return 0;
+    }
+    }
+    return -1;
+}
+
+static void throttle(int max_per_second) {
+    if (max_per_second <= 0) {
+        return;
+    }
+    long interval_ns = 1000000000L / max_per_second;
+    struct timespec ts = { interval_ns / 1000000000L, interval_ns % 1000000000L };
+    nanosleep(&ts, NULL);
+}
+
+static void *migrator_main(void *arg) {
+    migrator_t *migrator = arg;
+    for (int id = migrator->first_id; id <= migrator->last_id && !migrator->stop; id++) {
+        int result = record_migrate(id);
+        if (result == 1) {
+            migrator->migrated++;
+            // Only rewrites cost I/O, so only rewrites are rate limited
+            throttle(migrator->max_per_second);
+        } else if (result < 0) {
+            migrator->failed++;
+        }
+    }
+    return NULL;
+}
+
+/*
+ * FUNCTION: migrator_start
+ * =========================
+ * Starts the background migrator thread
+ *
+ * Returns:
+ *   - 0 on success, -1 if the thread could not be created
+ */
+int migrator_start(migrator_t *migrator, int first_id, int last_id, int max_per_second) {
+    migrator->first_id = first_id;
+    migrator->last_id = last_id;
+    migrator->max_per_second = max_per_second;
+    migrator->stop = 0;
+    migrator->migrated = 0;
+    migrator->failed = 0;
+    return pthread_create(&migrator->thread, NULL, migrator_main, migrator) == 0 ? 0 : -1;
+}
+
+/*
+ * FUNCTION: migrator_wait
+ * ========================
+ * Blocks until the migrator has walked its whole range
+ */
+void migrator_wait(migrator_t *migrator) {
+    pthread_join(migrator->thread, NULL);
+}
+
+/*
+ * FUNCTION: migrator_stop
+ * ========================
+ * Asks the migrator to stop after the current record and joins it
+ */
+void migrator_stop(migrator_t *migrator) {
+    migrator->stop = 1;
+    pthread_join(migrator->thread, NULL);
+}
@@ -0,0 +1,151 @@
+/*
+ * ============================================================================
+ * STUDENT RECORD FILES (output_<id>.txt)
+ * ============================================================================
+ *
+ * Reading and writing of per-student text records in KEY = VALUE format.
+ *
+ * Every record written by this module starts with a schema header:
+ *
+ *     SCHEMA_VERSION = 3
+ *
+ * and, from version 3, ends with a CRC32C of everything before it:
+ *
+ *     CHECKSUM = 1a2b3c4d
+ *
+ * A record whose checksum does not match is reported as damaged rather
+ * than read with missing fields.
+ *
+ * Files without a header are schema version 1 (the original layout).
+ * Old records are upgraded lazily: the first time a record is loaded or
+ * edited it is converted in memory and rewritten in the current shape.
+ * A background migrator can also walk the whole ID range at a throttled
+ * rate so the store converges without an I/O spike.
+ *
+ * Saves are crash-consistent: the new record is written to temp_<id>.txt,
+ * flushed to disk, renamed over the old file (so the record always
+ * exists, old or new) and the directory is then fsynced so the rename
+ * itself survives a crash. A record_batch_t commits many records with
+ * one flush of all temp files and one directory fsync instead of a pair
+ * per record.
+ *
+ * record_load/save/update/delete/scan go through a store (store.h). By
+ * default that is these text files; record_use_store switches to another
+ * backend such as the B+tree file or the LSM store. Whichever it is, they
+ * append every changed ID to RECORD_CHANGE_LOG and call the commit hooks.
+ *
+ * ============================================================================
+ */
+
+#ifndef RECORD_H
+#define RECORD_H
+
+#include <stddef.h>
+#include <pthread.h>
+#include "student.h"
+
+struct store;
+
+// Schema version written by record_write()
+#define RECORD_SCHEMA_VERSION 3
+
+// Append-only list of IDs saved or deleted, one per line
+#define RECORD_CHANGE_LOG "data/changes.log"
+
+/*
+ * Editable fields, numbered to match the edit_student menu
+ */
+typedef enum {
+    FIELD_NAME = 1,
+    FIELD_GRADE = 2,
+    FIELD_PHONE_NUMBER = 3,
+    FIELD_FATHER_NAME = 4,
+    FIELD_MOTHER_NAME = 5,
+    FIELD_DATE_OF_BIRTH = 6,
+    FIELD_SUBJECT1_GRADE = 7,
+    FIELD_SUBJECT2_GRADE = 8,
+    FIELD_SUBJECT3_GRADE = 9,
+    FIELD_SUBJECT4_GRADE = 10,
+    FIELD_FAMILY_NAME = 11
+} field_t;
+
+// Called after every successful record_commit, and with student NULL after
+// a record_delete (see record_add_commit_hook)
+#define RECORD_MAX_COMMIT_HOOKS 4
+typedef void (*record_commit_fn)(int id, const student_t *student, void *arg);
+typedef void (*record_visit_fn)(const student_t *student, void *arg);
+
+void record_path(int id, char *buf, size_t size);
+void record_use_store(const struct store *store);
+
+int record_read(const char *path, student_t *student, int *version);
+int record_write(const char *path, const student_t *student);
+
+int record_load(int id, student_t *student);
+int record_save(int id, const student_t *student);
+int record_save_many(const student_t *students, int count);
+int record_commit(int id, const student_t *student, const char *log_path);
+int record_update(int id, field_t field, const char *value);
+int record_delete(int id);
+int record_scan(int first_id, int last_id, record_visit_fn visit, void *arg);
+int record_migrate(int id);
+int record_file_load(int id, student_t *student);
+int record_file_read(int id, student_t *student);
+int record_file_save(int id, const student_t *student);
+int record_file_save_many(const student_t *students, int count);
+int record_file_delete(int id);
+long record_log_size(void);
+int record_write_counter(const char *path, int value);
+int record_reserve_ids(const char *path, int count);
+int record_release_ids(const char *path, int first, int end);
+int record_add_commit_hook(record_commit_fn fn, void *arg);
+void record_remove_commit_hook(record_commit_fn fn, void *arg);
+
+int record_set_field(student_t *student, field_t field, const char *value);
+
+/*
+ * Write Batch
+ * ===========
+ * Records added to a batch are written to their temp files at once but
+ * only replace the originals on record_batch_commit. Adding an ID that
+ * is already in the batch replaces its pending record.
+ */
+typedef struct {
+    int id;
+    student_t student;
+} record_batch_entry_t;
+
+typedef struct {
+    const char *log_path;
+    record_batch_entry_t *entries;
+    int count;
+    int capacity;
+} record_batch_t;
+
+void record_batch_init(record_batch_t *batch, const char *log_path);
+int record_batch_add(record_batch_t *batch, int id, const student_t *student);
+int record_batch_commit(record_batch_t *batch);
+void record_batch_abort(record_batch_t *batch);
+void record_batch_free(record_batch_t *batch);
+
+/*
+ * Background Migrator
+ * ===================
+ * Upgrades records [first_id, last_id] on a worker thread, rewriting at
+ * most max_per_second files per second (0 = unthrottled).
+ */
+typedef struct {
+    pthread_t thread;
+    int first_id;
+    int last_id;
+    int max_per_second;
+    volatile int stop;
+    int migrated;
+    int failed;
+} migrator_t;
+
+int migrator_start(migrator_t *migrator, int first_id, int last_id, int max_per_second);
+void migrator_wait(migrator_t *migrator);
+void migrator_stop(migrator_t *migrator);
+
+#endif
@@ -0,0 +1,413 @@
+/*
+ * ============================================================================
+ * REPORT CARDS
+ * ============================================================================
+ *
+ * See report.h for the template language and the batch pipeline.
+ *
+ * ============================================================================
+ */
+
+#include "report.h"
+#include "rank.h"
+#include "scheduler.h"
+#include "mem.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdatomic.h>
+#include <errno.h>
+#include <time.h>
+#include <sys/stat.h>
+
+const char *report_default_template =
+    "REPORT CARD\n"
+    "===========\n"
+    "Student:       {NAME} {FAMILY_NAME}\n"
+    "Student ID:    {STUDENT_ID}\n"
+    "Class:         {CLASS}\n"
+    "Date of birth: {DOB}\n"
+    "\n"
+    "{SUBJECT1_NAME}: {SUBJECT1_GRADE}\n"
+    "{SUBJECT2_NAME}: {SUBJECT2_GRADE}\n"
+    "{SUBJECT3_NAME}: {SUBJECT3_GRADE}\n"
+    "{SUBJECT4_NAME}: {SUBJECT4_GRADE}\n"
+    "\n"
+    "Average:       {AVERAGE}\n"
+    "Class rank:    {RANK} of {CLASS_SIZE}\n";
+
+typedef struct {
+    const char *name;
+    report_op_kind_t kind;
+    int subject;
+} placeholder_t;
+
+static const placeholder_t placeholders[] = {
+    { "ID", REPORT_OP_ID, 0 },
+    { "NAME", REPORT_OP_NAME, 0 },
+    { "FAMILY_NAME", REPORT_OP_FAMILY_NAME, 0 },
+    { "STUDENT_ID", REPORT_OP_STUDENT_ID, 0 },
+    { "CLASS", REPORT_OP_CLASS, 0 },
+    { "DOB", REPORT_OP_DATE_OF_BIRTH, 0 },
+    { "FATHER_NAME", REPORT_OP_FATHER_NAME, 0 },
+    { "MOTHER_NAME", REPORT_OP_MOTHER_NAME, 0 },
+    { "PHONE", REPORT_OP_PHONE_NUMBER, 0 },
+    { "SUBJECT1_NAME", REPORT_OP_SUBJECT_NAME, 0 },
+    { "SUBJECT2_NAME", REPORT_OP_SUBJECT_NAME, 1 },
+    { "SUBJECT3_NAME", REPORT_OP_SUBJECT_NAME, 2 },
+    { "SUBJECT4_NAME", REPORT_OP_SUBJECT_NAME, 3 },
+    { "SUBJECT1_GRADE", REPORT_OP_SUBJECT_GRADE, 0 },
+    { "SUBJECT2_GRADE", REPORT_OP_SUBJECT_GRADE, 1 },
+    { "SUBJECT3_GRADE", REPORT_OP_SUBJECT_GRADE, 2 },
+    { "SUBJECT4_GRADE", REPORT_OP_SUBJECT_GRADE, 3 },
+    { "AVERAGE", REPORT_OP_AVERAGE, 0 },
+    { "RANK", REPORT_OP_RANK, 0 },
+    { "CLASS_SIZE", REPORT_OP_CLASS_SIZE, 0 },
+};
+
+#define PLACEHOLDER_COUNT (sizeof(placeholders) / sizeof(placeholders[0]))
+
+static const placeholder_t *find_placeholder(const char *name, size_t length) {
+    for (size_t i = 0; i < PLACEHOLDER_COUNT; i++) {
+        if (strlen(placeholders[i].name) == length && memcmp(placeholders[i].name, name, length) == 0) {
+            return &placeholders[i];
+        }
+    }
+    return NULL;
+}
+
+// Appends an instruction, merging adjacent runs of literal text
+static void emit(report_template_t *tpl, report_op_kind_t kind, uint32_t offset, uint32_t length, int subject) {
+    report_op_t *last = tpl->op_count > 0 ? &tpl->ops[tpl->op_count - 1] : NULL;
+    if (kind == REPORT_OP_TEXT && last && last->kind == REPORT_OP_TEXT &&
+        last->offset + last->length == offset) {
+        last->length += length;
+        return;
+    }
+    report_op_t *op = &tpl->ops[tpl->op_count++];
+    op->kind = kind;
+    op->offset = offset;
+    op->length = length;
+    op->subject = subject;
+}
+
+/*
+ * FUNCTION: report_compile
+ * =========================
+ * Compiles template source into an instruction list
+ *
+ * Returns:
+ *   - 0 on success, -1 on an unknown or unterminated placeholder or out
+ *     of memory
+ */
+int report_compile(report_template_t *tpl, const char *source) {
+    size_t length = strlen(source);
+    memset(tpl, 0, sizeof(*tpl));
+    // Never more instructions than source bytes
+    tpl->text = mem_malloc(MEM_CACHES, length + 1);
+    tpl->ops = mem_malloc(MEM_CACHES, (length + 1) * sizeof(report_op_t));
+    if (!tpl->text || !tpl->ops) {
+        report_template_free(tpl);
+        return -1;
+    }
+
+    uint32_t text_length = 0;
+    const char *p = source;
+    while (*p) {
+        if (p[0] == '{' && p[1] == '{') {
+            tpl->text[text_length] = '{';
+            emit(tpl, REPORT_OP_TEXT, text_length++, 1, 0);
+            p += 2;
+        } else if (*p == '{') {
+            const char *close = strchr(p, '}');
+            const placeholder_t *ph = close ? find_placeholder(p + 1, (size_t)(close - p - 1)) : NULL;
+            if (!ph) {
+                report_template_free(tpl);
+                return -1;
+            }
+            emit(tpl, ph->kind, 0, 0, ph->subject);
+            tpl->ranked |= ph->kind == REPORT_OP_RANK || ph->kind == REPORT_OP_CLASS_SIZE;
+            p = close + 1;
+        } else {
+            const char *run = p;
+            while (*p && *p != '{') {
+                p++;
+            }
+            memcpy(tpl->text + text_length, run, (size_t)(p - run));
+            emit(tpl, REPORT_OP_TEXT, text_length, (uint32_t)(p - run), 0);
+            text_length += (uint32_t)(p - run);
+        }
+    }
+    tpl->text[text_length] = '\0';
+
+    // FNV-1a over the source
+    tpl->key = 14695981039346656037ull;
+    for (p = source; *p; p++) {
+        tpl->key ^= (unsigned char)*p;
+        tpl->key *= 1099511628211ull;
+    }
+    return 0;
+}
+
+/*
+ * FUNCTION: report_compile_file
+ * ==============================
+ * Reads a template file and compiles it
+ *
+ * Returns:
+ *   - 0 on success, -1 if the file cannot be read or does not compile
+ */
+int report_compile_file(report_template_t *tpl, const char *path) {
+    FILE *file = fopen(path, "rb");
+    if (!file) {
+        return -1;
+    }
+    long size = -1;
+    if (fseek(file, 0, SEEK_END) == 0) {
+        size = ftell(file);
+        rewind(file);
+    }
+    char *source = size >= 0 ? malloc((size_t)size + 1) : NULL;
+    int ok = source && fread(source, 1, (size_t)size, file) == (size_t)size;
+    fclose(file);
+    int result = -1;
+    if (ok) {
+        source[size] = '\0';
+        result = report_compile(tpl, source);
+    }
+    free(source);
+    return result;
+}
+
+void report_template_free(report_template_t *tpl) {
+    mem_free(tpl->text);
+    mem_free(tpl->ops);
+    memset(tpl, 0, sizeof(*tpl));
+}
+
+/*
+ * Output Buffer
+ * =============
+ * Writes what fits and keeps counting past the end, like snprintf
+ */
+typedef struct {
+    char *buf;
+    size_t size;
+    size_t length;
+} out_t;
+
+static void put(out_t *out, const char *s, size_t n) {
+    if (out->length < out->size) {
+        size_t room = out->size - out->length;
+        memcpy(out->buf + out->length, s, n < room ? n : room);
+    }
+    out->length += n;
+}
+
+static void put_str(out_t *out, const char *s) {
+    put(out, s, strlen(s));
+}
+
+static void put_int(out_t *out, int value) {
+    char num[16];
+    int n = snprintf(num, sizeof(num), "%d", value);
+    put(out, num, (size_t)n);
+}
+
+static void put_grade(out_t *out, float value) {
+    char num[32];
+    int n = snprintf(num, sizeof(num), "%.2f", value);
+    put(out, num, (size_t)n);
+}
+
+/*
+ * FUNCTION: report_render
+ * ========================
+ * Renders one card into buf (NUL-terminated if size > 0)
+ *
+ * Returns:
+ *   - Length of the full card; if it is >= size the card was cut short
+ */
+size_t report_render(const report_template_t *tpl, const student_t *student,
+                     const report_stats_t *stats, char *buf, size_t size) {
+    const subject_t *subjects[] = { &student->subject1, &student->subject2,
+                                    &student->subject3, &student->subject4 };
+    out_t out = { buf, size ? size - 1 : 0, 0 };
+
+    for (int i = 0; i < tpl->op_count; i++) {
+        const report_op_t *op = &tpl->ops[i];
+        switch (op->kind) {
+        case REPORT_OP_TEXT:          put(&out, tpl->text + op->offset, op->length); break;
+        case REPORT_OP_ID:            put_int(&out, student->student_id); break;
+        case REPORT_OP_NAME:          put_str(&out, str_get(&student->name)); break;
+        case REPORT_OP_FAMILY_NAME:   put_str(&out, str_get(&student->family_name)); break;
+        case REPORT_OP_STUDENT_ID:    put_str(&out, student->studentid); break;
+        case REPORT_OP_CLASS:         put_int(&out, student->grade); break;
+        case REPORT_OP_DATE_OF_BIRTH: put_str(&out, student->dateofbirth); break;
+        case REPORT_OP_FATHER_NAME:   put_str(&out, str_get(&student->father_name)); break;
+        case REPORT_OP_MOTHER_NAME:   put_str(&out, str_get(&student->mother_name)); break;
+        case REPORT_OP_PHONE_NUMBER:  put_str(&out, student->phone_number); break;
+        case REPORT_OP_SUBJECT_NAME:  put_str(&out, str_get(&subjects[op->subject]->name)); break;
+        case REPORT_OP_SUBJECT_GRADE: put_grade(&out, subjects[op->subject]->grade); break;
+        case REPORT_OP_AVERAGE:       put_grade(&out, student->average_grade); break;
+        case REPORT_OP_RANK:          put_int(&out, stats->rank); break;
+        case REPORT_OP_CLASS_SIZE:    put_int(&out, stats->class_size); break;
+        }
+    }
+    if (size > 0) {
+        buf[out.length < out.size ? out.length : out.size] = '\0';
+    }
+    return out.length;
+}
+
+/*
+ * FUNCTION: report_card_path
+ * ===========================
+ * Builds the filename of a rendered card ([dir]/report_[ID].txt)
+ */
+void report_card_path(const char *dir, int id, char *buf, size_t size) {
+    snprintf(buf, size, "%s/report_%d.txt", dir, id);
+}
+
+static double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+typedef struct {
+    student_t *students;
+    size_t count;
+    size_t capacity;
+    int failed;
+} roster_t;
+
+static void preload(const student_t *student, void *arg) {
+    roster_t *roster = arg;
+    if (roster->count == roster->capacity) {
+        size_t capacity = roster->capacity ? roster->capacity * 2 : 1024;
+        student_t *grown = mem_realloc(MEM_RECORDS, roster->students, capacity * sizeof(student_t));
+        if (!grown) {
+            roster->failed = 1;
+            return;
+        }
+        roster->students = grown;
+        roster->capacity = capacity;
+    }
+    roster->students[roster->count++] = *student;
+}
+
+typedef struct {
+    const report_template_t *tpl;
+    const student_t *students;
+    const report_stats_t *stats;
+    const char *dir;
+    atomic_long failed;
+    atomic_size_t bytes;
+} render_job_t;
+
+static void render_range(long begin, long end, void *arg) {
+    render_job_t *job = arg;
+    char stack_buf[4096];
+    char *buf = stack_buf;
+    size_t size = sizeof(stack_buf);
+    long failed = 0;
+    size_t bytes = 0;
+
+    for (long i = begin; i < end; i++) {
+        size_t length = report_render(job->tpl, &job->students[i], &job->stats[i], buf, size);
+        if (length >= size) {
+            // Card larger than the buffer: grow and render again
+            char *bigger = malloc(length + 1);
+            if (!bigger) {
+                failed++;
+                continue;
+            }
+            if (buf != stack_buf) {
+                free(buf);
+            }
+            buf = bigger;
+            size = length + 1;
+            report_render(job->tpl, &job->students[i], &job->stats[i], buf, size);
+        }
+
+        char path[256];
+        report_card_path(job->dir, job->students[i].student_id, path, sizeof(path));
+        FILE *file = fopen(path, "w");
+        int ok = file && fwrite(buf, 1, length, file) == length;
+        if (file && fclose(file) != 0) {
+            ok = 0;
+        }
+        if (ok) {
+            bytes += length;
+        } else {
+            failed++;
+        }
+    }
+    if (buf != stack_buf) {
+        free(buf);
+    }
+    atomic_fetch_add(&job->failed, failed);
+    atomic_fetch_add(&job->bytes, bytes);
+}
+
+// Looks up every student of the roster once; stats[i] belongs to students[i]
+static int rank_roster(const roster_t *roster, rank_view_t *ranks, report_stats_t *stats) {
+    for (size_t i = 0; i < roster->count; i++) {
+        if (rank_lookup(ranks, roster->students[i].student_id, &stats[i].rank, &stats[i].class_size) != 0) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+/*
+ * FUNCTION: report_render_all
+ * ============================
+ * Renders a card for every student in the snapshot into dir
+ * Cards are rendered in parallel on the shared scheduler pool.
+ *
+ * Parameters:
+ *   - ranks: class ranking view covering the snapshot's students (see
+ *     studentdb_attach_ranks); only read for templates that show a rank
+ *
+ * Returns:
+ *   - 0 if every card was written, -1 otherwise (result says how many)
+ */
+int report_render_all(const report_template_t *tpl, const snapshot_t *snap, rank_view_t *ranks,
+                      const char *dir, report_result_t *result) {
+    memset(result, 0, sizeof(*result));
+    if (mkdir(dir, 0755) != 0 && errno != EEXIST) {
+        return -1;
+    }
+
+    // SECTION 1: Preload the roster and rank every class
+    double start = now_seconds();
+    roster_t roster = { NULL, 0, 0, 0 };
+    report_stats_t *stats = NULL;
+    if (snapshot_scan(snap, preload, &roster) < 0 || roster.failed ||
+        !(stats = mem_calloc(MEM_CACHES, roster.count ? roster.count : 1, sizeof(*stats))) ||
+        (tpl->ranked && rank_roster(&roster, ranks, stats) != 0)) {
+        mem_free(stats);
+        mem_free(roster.students);
+        return -1;
+    }
+    result->load_seconds = now_seconds() - start;
+
+    // SECTION 2: Render and write cards in parallel
+    start = now_seconds();
+    render_job_t job = { tpl, roster.students, stats, dir, 0, 0 };
+    sched_pool_t *pool = sched_default();
+    if (!pool || sched_parallel_for(pool, 0, (long)roster.count, 64, render_range, &job) != 0) {
+        render_range(0, (long)roster.count, &job);
+    }
+    result->render_seconds = now_seconds() - start;
+    result->failed = atomic_load(&job.failed);
+    result->cards = (long)roster.count - result->failed;
+    result->bytes = atomic_load(&job.bytes);
+
+    mem_free(stats);
+    mem_free(roster.students);
+    return result->failed == 0 ? 0 : -1;
+}
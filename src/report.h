@@ -0,0 +1,102 @@
+/*
+ * ============================================================================
+ * REPORT CARDS
+ * ============================================================================
+ *
+ * Renders one text report card per student from a template such as:
+ *
+ *     Report card for {NAME} {FAMILY_NAME} ({STUDENT_ID})
+ *     {SUBJECT1_NAME}: {SUBJECT1_GRADE}
+ *     Average: {AVERAGE}   Rank: {RANK} of {CLASS_SIZE}
+ *
+ * A template is compiled once into a list of instructions: copy a run of
+ * literal text, or append one field. Rendering a card is then a walk
+ * over that list with no parsing or lookups. "{{" writes a literal "{".
+ *
+ * report_render_all renders a whole roster:
+ *   1. Preload every record from the snapshot (plus the change log)
+ *   2. Look up each student's rank once in the caller's class ranking
+ *      view (rank.h; studentdb_attach_ranks keeps one current)
+ *   3. Render the cards in parallel on the shared scheduler pool; each
+ *      card is built in memory and written with a single fwrite to
+ *      REPORT_DIR/report_<id>.txt
+ *
+ * ============================================================================
+ */
+
+#ifndef REPORT_H
+#define REPORT_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "student.h"
+#include "snapshot.h"
+#include "rank.h"
+
+#define REPORT_DIR "data/reports"
+
+typedef enum {
+    REPORT_OP_TEXT,
+    REPORT_OP_ID,
+    REPORT_OP_NAME,
+    REPORT_OP_FAMILY_NAME,
+    REPORT_OP_STUDENT_ID,
+    REPORT_OP_CLASS,
+    REPORT_OP_DATE_OF_BIRTH,
+    REPORT_OP_FATHER_NAME,
+    REPORT_OP_MOTHER_NAME,
+    REPORT_OP_PHONE_NUMBER,
+    REPORT_OP_SUBJECT_NAME,
+    REPORT_OP_SUBJECT_GRADE,
+    REPORT_OP_AVERAGE,
+    REPORT_OP_RANK,
+    REPORT_OP_CLASS_SIZE
+} report_op_kind_t;
+
+/*
+ * Instruction: TEXT copies length bytes at offset in the template text,
+ * SUBJECT_* use subject (0-3), every other kind appends one field
+ */
+typedef struct {
+    report_op_kind_t kind;
+    uint32_t offset;
+    uint32_t length;
+    int subject;
+} report_op_t;
+
+typedef struct {
+    char *text;               // literal text, placeholders removed
+    report_op_t *ops;
+    int op_count;
+    uint64_t key;             // hash of the source, identifies the template
+    int ranked;               // uses {RANK} or {CLASS_SIZE}
+} report_template_t;
+
+// Stats that come from the whole class rather than the record
+typedef struct {
+    int rank;
+    int class_size;
+} report_stats_t;
+
+typedef struct {
+    long cards;
+    long failed;
+    size_t bytes;
+    double load_seconds;      // preload + ranking
+    double render_seconds;    // render + write
+} report_result_t;
+
+extern const char *report_default_template;
+
+int report_compile(report_template_t *tpl, const char *source);
+int report_compile_file(report_template_t *tpl, const char *path);
+void report_template_free(report_template_t *tpl);
+
+size_t report_render(const report_template_t *tpl, const student_t *student,
+                     const report_stats_t *stats, char *buf, size_t size);
+void report_card_path(const char *dir, int id, char *buf, size_t size);
+
+int report_render_all(const report_template_t *tpl, const snapshot_t *snap, rank_view_t *ranks,
+                      const char *dir, report_result_t *result);
+
+#endif
@@ -0,0 +1,499 @@
+/*
+ * ============================================================================
+ * BINARY RPC (app rpc)
+ * ============================================================================
+ *
+ * See rpc.h for the wire format. The same rpc_buf_t builds request frames
+ * on the client and result frames on the server, and the same reader
+ * walks both. The server checks a whole request frame with the reader
+ * before running any of it, so a malformed frame changes nothing.
+ *
+ * ============================================================================
+ */
+
+#include "rpc.h"
+#include "validate.h"
+#include "mem.h"
+
+#include <string.h>
+#include <errno.h>
+#include <sys/socket.h>
+
+#define PADDED(length) (((length) + 3) & ~(size_t)3)
+#define IN_SIZE (sizeof(rpc_frame_header_t) + RPC_MAX_FRAME + RPC_READ_SIZE)
+#define PACKED_MAX (sizeof(student_packed_t) + 8 * (size_t)UINT16_MAX)
+
+typedef struct {
+    rpc_server_t *server;
+    long requests;
+    rpc_buf_t out;
+    student_t adds[RPC_ADD_BATCH];        // ADDs waiting for flush_adds
+    size_t add_results[RPC_ADD_BATCH];    // offsets of their results in out
+    int add_count;
+} connection_t;
+
+void rpc_buf_free(rpc_buf_t *buf) {
+    mem_free(buf->data);
+    memset(buf, 0, sizeof(*buf));
+}
+
+// Empties buf for new frames, keeping its memory
+void rpc_clear(rpc_buf_t *buf) {
+    buf->length = 0;
+    buf->failed = 0;
+    buf->count = 0;
+    buf->frames = 0;
+}
+
+// Makes room for extra more bytes; returns where they go, or NULL
+static unsigned char *reserve(rpc_buf_t *buf, size_t extra) {
+    if (buf->failed) {
+        return NULL;
+    }
+    if (buf->length + extra > buf->capacity) {
+        size_t capacity = buf->capacity ? buf->capacity : 4096;
+        while (capacity < buf->length + extra) {
+            capacity *= 2;
+        }
+        unsigned char *grown = mem_realloc(MEM_QUEUES, buf->data, capacity);
+        if (!grown) {
+            buf->failed = 1;
+            return NULL;
+        }
+        buf->data = grown;
+        buf->capacity = capacity;
+    }
+    return buf->data + buf->length;
+}
+
+static void put_op(rpc_buf_t *buf, int op, int arg, int id, const void *payload, size_t length) {
+    unsigned char *at = reserve(buf, sizeof(rpc_op_header_t) + PADDED(length));
+    if (!at) {
+        return;
+    }
+    rpc_op_header_t head = { (uint8_t)op, (uint8_t)arg, 0, id, (uint32_t)length };
+    memcpy(at, &head, sizeof(head));
+    if (length > 0) {
+        memcpy(at + sizeof(head), payload, length);
+    }
+    memset(at + sizeof(head) + length, 0, PADDED(length) - length);
+    buf->length += sizeof(head) + PADDED(length);
+    buf->count++;
+}
+
+/*
+ * Packs student as the payload of an operation, directly into buf
+ *
+ * Returns:
+ *   - 0 on success, -1 if it cannot be packed (buf->failed is only set
+ *     if memory ran out)
+ */
+static int put_student(rpc_buf_t *buf, int op, int arg, int id, const student_t *student) {
+    size_t need = sizeof(rpc_op_header_t) + sizeof(student_packed_t) + 256;
+    for (;;) {
+        unsigned char *at = reserve(buf, need);
+        if (!at) {
+            return -1;
+        }
+        size_t room = buf->capacity - buf->length - sizeof(rpc_op_header_t) - 3;
+        int length = student_pack(student, at + sizeof(rpc_op_header_t), room);
+        if (length >= 0) {
+            rpc_op_header_t head = { (uint8_t)op, (uint8_t)arg, 0, id, (uint32_t)length };
+            memcpy(at, &head, sizeof(head));
+            memset(at + sizeof(head) + length, 0, PADDED((size_t)length) - (size_t)length);
+            buf->length += sizeof(head) + PADDED((size_t)length);
+            buf->count++;
+            return 0;
+        }
+        if (room >= PACKED_MAX) {
+            return -1;
+        }
+        need = (buf->capacity - buf->length) * 2;
+    }
+}
+
+// Starts a frame in buf (after any frames already in it)
+void rpc_begin(rpc_buf_t *buf, uint32_t tag) {
+    unsigned char *at = reserve(buf, sizeof(rpc_frame_header_t));
+    if (!at) {
+        return;
+    }
+    rpc_frame_header_t head = { RPC_MAGIC, 0, 0, tag };
+    memcpy(at, &head, sizeof(head));
+    buf->frame = buf->length;
+    buf->length += sizeof(head);
+    buf->count = 0;
+}
+
+void rpc_get(rpc_buf_t *buf, int id) {
+    put_op(buf, RPC_GET, 0, id, NULL, 0);
+}
+
+void rpc_edit(rpc_buf_t *buf, int id, field_t field, const char *value) {
+    put_op(buf, RPC_EDIT, (int)field, id, value, strlen(value) + 1);
+}
+
+void rpc_add(rpc_buf_t *buf, const student_t *student) {
+    if (put_student(buf, RPC_ADD, 0, 0, student) != 0) {
+        buf->failed = 1;
+    }
+}
+
+void rpc_rank(rpc_buf_t *buf, int id) {
+    put_op(buf, RPC_RANK, 0, id, NULL, 0);
+}
+
+// Fills in the current frame's length and count
+static void end_frame(rpc_buf_t *buf) {
+    if (buf->failed) {
+        return;
+    }
+    rpc_frame_header_t head;
+    memcpy(&head, buf->data + buf->frame, sizeof(head));
+    head.length = (uint32_t)(buf->length - buf->frame - sizeof(head));
+    head.count = buf->count;
+    memcpy(buf->data + buf->frame, &head, sizeof(head));
+    buf->frames++;
+}
+
+/*
+ * FUNCTION: rpc_end
+ * ==================
+ * Finishes the frame started by rpc_begin
+ *
+ * Returns:
+ *   - 0 on success, -1 if memory ran out or the frame is over
+ *     RPC_MAX_FRAME bytes or RPC_MAX_OPS operations
+ */
+int rpc_end(rpc_buf_t *buf) {
+    if (!buf->failed && (buf->length - buf->frame - sizeof(rpc_frame_header_t) > RPC_MAX_FRAME ||
+                         buf->count > RPC_MAX_OPS)) {
+        buf->failed = 1;
+    }
+    end_frame(buf);
+    return buf->failed ? -1 : 0;
+}
+
+/*
+ * FUNCTION: rpc_call
+ * ===================
+ * Sends every frame in request and reads their result frames into
+ * response (replacing its contents)
+ *
+ * Returns:
+ *   - 0 on success, -1 on error (request failed, connection lost or a
+ *     malformed reply)
+ */
+int rpc_call(int fd, rpc_buf_t *request, rpc_buf_t *response) {
+    if (request->failed || net_send_all(fd, request->data, request->length) != 0) {
+        return -1;
+    }
+    response->length = 0;
+    response->failed = 0;
+    size_t frame = 0;
+    for (int frames = 0; frames < request->frames;) {
+        // Complete frames in what has arrived
+        size_t have = response->length - frame;
+        if (have >= sizeof(rpc_frame_header_t)) {
+            rpc_frame_header_t head;
+            memcpy(&head, response->data + frame, sizeof(head));
+            if (head.magic != RPC_MAGIC) {
+                return -1;
+            }
+            if (have >= sizeof(head) + head.length) {
+                frame += sizeof(head) + head.length;
+                frames++;
+                continue;
+            }
+        }
+        if (!reserve(response, RPC_READ_SIZE)) {
+            return -1;
+        }
+        ssize_t got = recv(fd, response->data + response->length, response->capacity - response->length, 0);
+        if (got < 0 && errno == EINTR) {
+            continue;
+        }
+        if (got <= 0) {
+            return -1;
+        }
+        response->length += (size_t)got;
+    }
+    response->frames = request->frames;
+    return response->length == frame ? 0 : -1;
+}
+
+rpc_reader_t rpc_reader(const rpc_buf_t *buf) {
+    rpc_reader_t reader = { buf->data, buf->data + buf->length, buf->data, 0, 0 };
+    return reader;
+}
+
+/*
+ * FUNCTION: rpc_read
+ * ===================
+ * Decodes the next operation or result, moving on to the next frame when
+ * one runs out. result->data points into the buffer read.
+ *
+ * Returns:
+ *   - 1 for an operation, 0 at the end, -1 if the frames are malformed
+ */
+int rpc_read(rpc_reader_t *reader, rpc_result_t *result) {
+    while (reader->remaining == 0) {
+        if (reader->at != reader->frame_end) {
+            return -1;
+        }
+        if (reader->at == reader->end) {
+            return 0;
+        }
+        rpc_frame_header_t frame;
+        if ((size_t)(reader->end - reader->at) < sizeof(frame)) {
+            return -1;
+        }
+        memcpy(&frame, reader->at, sizeof(frame));
+        reader->at += sizeof(frame);
+        if (frame.magic != RPC_MAGIC || frame.length > (size_t)(reader->end - reader->at)) {
+            return -1;
+        }
+        reader->frame_end = reader->at + frame.length;
+        reader->remaining = frame.count;
+        reader->tag = frame.tag;
+    }
+
+    rpc_op_header_t head;
+    size_t left = (size_t)(reader->frame_end - reader->at);
+    if (left < sizeof(head)) {
+        return -1;
+    }
+    memcpy(&head, reader->at, sizeof(head));
+    if (PADDED((size_t)head.length) > left - sizeof(head)) {
+        return -1;
+    }
+    result->op = (rpc_op_t)head.op;
+    result->status = (rpc_status_t)head.arg;
+    result->id = head.id;
+    result->tag = reader->tag;
+    result->data = reader->at + sizeof(head);
+    result->length = head.length;
+    reader->at += sizeof(head) + PADDED((size_t)head.length);
+    reader->remaining--;
+    return 1;
+}
+
+// Sets the status and ID of a result already in out
+static void patch_result(rpc_buf_t *out, size_t offset, int status, int id) {
+    rpc_op_header_t head;
+    memcpy(&head, out->data + offset, sizeof(head));
+    head.arg = (uint8_t)status;
+    head.id = id;
+    memcpy(out->data + offset, &head, sizeof(head));
+}
+
+// Saves the queued ADDs as one batch and fills in their results
+static void flush_adds(connection_t *conn) {
+    if (conn->add_count == 0) {
+        return;
+    }
+    int first_id = studentdb_create_many(conn->server->db, conn->adds, conn->add_count);
+    for (int i = 0; i < conn->add_count && !conn->out.failed; i++) {
+        patch_result(&conn->out, conn->add_results[i], first_id < 0 ? RPC_FAILED : RPC_OK,
+                     first_id < 0 ? 0 : first_id + i);
+    }
+    conn->add_count = 0;
+}
+
+static void put_error(rpc_buf_t *out, int op, int status, int id, const char *message) {
+    put_op(out, op, status, id, message, message ? strlen(message) : 0);
+}
+
+static void run_get(connection_t *conn, int id) {
+    student_t student;
+    if (studentdb_get(conn->server->db, id, &student) < 0) {
+        put_error(&conn->out, RPC_GET, RPC_NOT_FOUND, id, NULL);
+    } else if (put_student(&conn->out, RPC_GET, RPC_OK, id, &student) != 0) {
+        put_error(&conn->out, RPC_GET, RPC_FAILED, id, NULL);
+    }
+}
+
+static void run_rank(connection_t *conn, int id) {
+    int32_t ranked[2];
+    int rank;
+    int class_size;
+    if (studentdb_rank(conn->server->db, id, &rank, &class_size) < 0) {
+        put_error(&conn->out, RPC_RANK, RPC_NOT_FOUND, id, NULL);
+        return;
+    }
+    ranked[0] = rank;
+    ranked[1] = class_size;
+    put_op(&conn->out, RPC_RANK, RPC_OK, id, ranked, sizeof(ranked));
+}
+
+static void run_edit(connection_t *conn, const rpc_result_t *op, field_t field) {
+    const char *value = (const char *)op->data;
+    const char *problem = NULL;
+    if (field < FIELD_NAME || field > FIELD_FAMILY_NAME) {
+        problem = "not an editable field";
+    } else if (op->length == 0 || memchr(value, '\0', op->length) != value + op->length - 1) {
+        problem = "value is not one string";
+    } else {
+        problem = validate_field(field, value);
+    }
+    student_t student;
+    if (problem) {
+        put_error(&conn->out, RPC_EDIT, RPC_INVALID, op->id, problem);
+    } else if (studentdb_get(conn->server->db, op->id, &student) < 0) {
+        put_error(&conn->out, RPC_EDIT, RPC_NOT_FOUND, op->id, NULL);
+    } else if (studentdb_update(conn->server->db, op->id, field, value) < 0) {
+        put_error(&conn->out, RPC_EDIT, RPC_FAILED, op->id, NULL);
+    } else {
+        put_op(&conn->out, RPC_EDIT, RPC_OK, op->id, NULL, 0);
+    }
+}
+
+static void run_add(connection_t *conn, const rpc_result_t *op) {
+    student_t *student = &conn->adds[conn->add_count];
+    const char *problem = "student is cut short";
+    if (student_unpack(op->data, op->length, student) == 0) {
+        problem = studentdb_validate(student);
+    }
+    if (problem) {
+        put_error(&conn->out, RPC_ADD, RPC_INVALID, 0, problem);
+        return;
+    }
+    // Answered by flush_adds once the batch is saved
+    conn->add_results[conn->add_count++] = conn->out.length;
+    put_op(&conn->out, RPC_ADD, RPC_FAILED, 0, NULL, 0);
+    if (conn->add_count == RPC_ADD_BATCH) {
+        flush_adds(conn);
+    }
+}
+
+/*
+ * Size of the request frame at the start of data
+ *
+ * Returns:
+ *   - Its length in bytes, 0 if it is not complete yet, or -1 if its
+ *     header is invalid
+ */
+static long frame_size(const unsigned char *data, size_t length) {
+    rpc_frame_header_t head;
+    if (length < sizeof(head)) {
+        return 0;
+    }
+    memcpy(&head, data, sizeof(head));
+    if (head.magic != RPC_MAGIC || head.length > RPC_MAX_FRAME || head.length % 4 != 0 ||
+        head.count > RPC_MAX_OPS) {
+        return -1;
+    }
+    size_t size = sizeof(head) + head.length;
+    return length >= size ? (long)size : 0;
+}
+
+// Runs one request frame and appends its results; -1 if it is malformed
+static int run_frame(connection_t *conn, const unsigned char *data, size_t size) {
+    rpc_reader_t reader = { data, data + size, data, 0, 0 };
+    rpc_result_t op;
+    int status;
+    while ((status = rpc_read(&reader, &op)) > 0) {
+        if (op.op < RPC_GET || op.op > RPC_RANK) {
+            return -1;
+        }
+    }
+    if (status < 0) {
+        return -1;
+    }
+
+    reader = (rpc_reader_t){ data, data + size, data, 0, 0 };
+    rpc_frame_header_t head;
+    memcpy(&head, data, sizeof(head));
+    rpc_begin(&conn->out, head.tag);
+    while (rpc_read(&reader, &op) > 0) {
+        conn->requests++;
+        if (op.op == RPC_ADD) {
+            run_add(conn, &op);
+            continue;
+        }
+        // Queued ADDs are saved before anything that could read them
+        flush_adds(conn);
+        if (op.op == RPC_GET) {
+            run_get(conn, op.id);
+        } else if (op.op == RPC_RANK) {
+            run_rank(conn, op.id);
+        } else {
+            run_edit(conn, &op, (field_t)op.status);
+        }
+    }
+    end_frame(&conn->out);
+    return 0;
+}
+
+static long serve_connection(int fd, void *arg) {
+    connection_t *conn = mem_calloc(MEM_QUEUES, 1, sizeof(connection_t));
+    unsigned char *in = mem_malloc(MEM_QUEUES, IN_SIZE);
+    size_t used = 0;
+    int closing = conn == NULL || in == NULL;
+    if (conn) {
+        conn->server = arg;
+    }
+    while (!closing) {
+        ssize_t got = recv(fd, in + used, IN_SIZE - used, 0);
+        if (got < 0 && errno == EINTR) {
+            continue;
+        }
+        if (got <= 0) {
+            break;
+        }
+        used += (size_t)got;
+
+        // Answer every complete frame received so far
+        size_t start = 0;
+        for (;;) {
+            long size = frame_size(in + start, used - start);
+            if (size == 0) {
+                break;
+            }
+            if (size < 0 || run_frame(conn, in + start, (size_t)size) != 0) {
+                closing = 1;
+                break;
+            }
+            start += (size_t)size;
+        }
+        flush_adds(conn);
+        if (conn->out.failed || net_send_all(fd, conn->out.data, conn->out.length) != 0) {
+            break;
+        }
+        conn->out.length = 0;
+        memmove(in, in + start, used - start);
+        used -= start;
+    }
+
+    long requests = conn ? conn->requests : 0;
+    mem_free(in);
+    if (conn) {
+        rpc_buf_free(&conn->out);
+    }
+    mem_free(conn);
+    return requests;
+}
+
+/*
+ * FUNCTION: rpc_server_start
+ * ===========================
+ * Listens on 127.0.0.1:port (0 picks a free port, stored in
+ * server->net.port) and serves db from a background thread
+ *
+ * Returns:
+ *   - 0 on success, -1 on error (errno set)
+ */
+int rpc_server_start(rpc_server_t *server, studentdb_t *db, int port) {
+    server->db = db;
+    return net_server_start(&server->net, port, serve_connection, server, NULL, 0);
+}
+
+/*
+ * FUNCTION: rpc_server_stop
+ * ==========================
+ * Stops accepting, closes every connection (frames being run finish
+ * first) and waits for their threads to end
+ */
+void rpc_server_stop(rpc_server_t *server) {
+    net_server_stop(&server->net);
+}
@@ -0,0 +1,148 @@
+/*
+ * ============================================================================
+ * BINARY RPC (app rpc)
+ * ============================================================================
+ *
+ * A compact protocol for internal services that read and edit many
+ * students at a time, where the HTTP API (http.h) would spend most of
+ * its time formatting and parsing JSON. Like it, the server listens on
+ * 127.0.0.1 only (see net.h).
+ *
+ * The client sends frames; each is answered by one frame with the same
+ * tag holding one result per operation, in order:
+ *
+ *     frame      rpc_frame_header_t, then `count` operations
+ *                (`length` bytes after the header)
+ *     operation  rpc_op_header_t, then `length` payload bytes, padded
+ *                with zeros to a multiple of 4
+ *
+ *     op          request                      result payload
+ *     RPC_GET     id                           the packed student (RPC_OK)
+ *     RPC_EDIT    id, arg = field_t, payload   none
+ *                 = the value and a '\0'
+ *     RPC_ADD     payload = a packed student   none; id = the new ID
+ *     RPC_RANK    id                           int32 rank, int32 class
+ *                                              size (RPC_OK), from the
+ *                                              studentdb_attach_ranks view
+ *
+ * A result's arg is its status; RPC_INVALID results carry the error
+ * message as their payload. Students are packed as in the stores
+ * (student_pack, student.h). All integers are in host byte order, as
+ * both ends run on the same machine.
+ *
+ * The server decodes frames where they were received: operation headers
+ * and payloads are read in place, added students are unpacked straight
+ * from the receive buffer and fetched ones are packed straight into the
+ * send buffer. Every frame complete in a read is answered before the
+ * results go out together in one send, and the adds of a run are saved
+ * as one studentdb_create_many batch (one counter write, one sync). A
+ * frame that breaks these rules closes the connection.
+ *
+ * Usage (client):
+ *     rpc_buf_t request = {0}, response = {0};
+ *     rpc_begin(&request, 1);
+ *     rpc_get(&request, 17);
+ *     rpc_edit(&request, 17, FIELD_SUBJECT1_GRADE, "95");
+ *     rpc_end(&request);
+ *     rpc_call(fd, &request, &response);
+ *     rpc_reader_t reader = rpc_reader(&response);
+ *     rpc_result_t result;
+ *     while (rpc_read(&reader, &result) > 0) { ... }
+ *
+ * ============================================================================
+ */
+
+#ifndef RPC_H
+#define RPC_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "net.h"
+#include "studentdb.h"
+
+#define RPC_DEFAULT_PORT 8081
+#define RPC_MAGIC 0x31424453u     // "SDB1"
+#define RPC_MAX_FRAME (1 << 20)   // bytes after a request frame's header
+#define RPC_MAX_OPS 4096
+#define RPC_READ_SIZE 65536
+#define RPC_ADD_BATCH 256
+
+typedef enum {
+    RPC_GET = 1,
+    RPC_EDIT = 2,
+    RPC_ADD = 3,
+    RPC_RANK = 4
+} rpc_op_t;
+
+typedef enum {
+    RPC_OK = 0,
+    RPC_NOT_FOUND = 1,
+    RPC_INVALID = 2,
+    RPC_FAILED = 3
+} rpc_status_t;
+
+typedef struct {
+    uint32_t magic;
+    uint32_t length;
+    uint32_t count;
+    uint32_t tag;             // chosen by the client, echoed back
+} rpc_frame_header_t;
+
+typedef struct {
+    uint8_t op;
+    uint8_t arg;              // field_t in requests, rpc_status_t in results
+    uint16_t reserved;
+    int32_t id;
+    uint32_t length;
+} rpc_op_header_t;
+
+// Growable frame buffer; all-zero is empty
+typedef struct {
+    unsigned char *data;
+    size_t length;
+    size_t capacity;
+    int failed;               // an allocation failed or a frame is too large
+    size_t frame;             // offset of the frame being built
+    uint32_t count;           // its operations so far
+    int frames;               // frames ended with rpc_end
+} rpc_buf_t;
+
+typedef struct {
+    rpc_op_t op;
+    rpc_status_t status;      // the arg byte (a field_t in requests)
+    int id;
+    uint32_t tag;
+    const unsigned char *data; // payload, in the buffer read
+    size_t length;
+} rpc_result_t;
+
+typedef struct {
+    const unsigned char *at;
+    const unsigned char *end;
+    const unsigned char *frame_end;
+    uint32_t remaining;       // operations left in the current frame
+    uint32_t tag;
+} rpc_reader_t;
+
+typedef struct {
+    net_server_t net;         // net.port is the port bound
+    studentdb_t *db;
+} rpc_server_t;
+
+void rpc_buf_free(rpc_buf_t *buf);
+void rpc_clear(rpc_buf_t *buf);
+void rpc_begin(rpc_buf_t *buf, uint32_t tag);
+void rpc_get(rpc_buf_t *buf, int id);
+void rpc_edit(rpc_buf_t *buf, int id, field_t field, const char *value);
+void rpc_add(rpc_buf_t *buf, const student_t *student);
+void rpc_rank(rpc_buf_t *buf, int id);
+int rpc_end(rpc_buf_t *buf);
+int rpc_call(int fd, rpc_buf_t *request, rpc_buf_t *response);
+
+rpc_reader_t rpc_reader(const rpc_buf_t *buf);
+int rpc_read(rpc_reader_t *reader, rpc_result_t *result);
+
+int rpc_server_start(rpc_server_t *server, studentdb_t *db, int port);
+void rpc_server_stop(rpc_server_t *server);
+
+#endif
@@ -0,0 +1,437 @@
+/*
+ * ============================================================================
+ * WORK-STEALING TASK SCHEDULER
+ * ============================================================================
+ *
+ * See scheduler.h for the scheduling model.
+ *
+ * ============================================================================
+ */
+
+#include "scheduler.h"
+#include "mem.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+// Worker running on this thread (NULL outside any pool)
+static __thread sched_worker_t *current_worker;
+
+/*
+ * Deque operations (take deque->lock)
+ */
+static int deque_push(sched_deque_t *deque, const sched_task_t *task, int *depth) {
+    pthread_mutex_lock(&deque->lock);
+    if (deque->size == deque->capacity) {
+        int capacity = deque->capacity ? deque->capacity * 2 : 64;
+        sched_task_t *tasks = mem_malloc(MEM_QUEUES, (size_t)capacity * sizeof(sched_task_t));
+        if (!tasks) {
+            pthread_mutex_unlock(&deque->lock);
+            return -1;
+        }
+        for (int i = 0; i < deque->size; i++) {
+            tasks[i] = deque->tasks[(deque->head + i) % deque->capacity];
+        }
+        mem_free(deque->tasks);
+        deque->tasks = tasks;
+        deque->capacity = capacity;
+        deque->head = 0;
+    }
+    deque->tasks[(deque->head + deque->size) % deque->capacity] = *task;
+    deque->size++;
+    *depth = deque->size;
+    pthread_mutex_unlock(&deque->lock);
+    return 0;
+}
+
+static int deque_pop_tail(sched_deque_t *deque, sched_task_t *task) {
+    pthread_mutex_lock(&deque->lock);
+    int found = deque->size > 0;
+    if (found) {
+        deque->size--;
+        *task = deque->tasks[(deque->head + deque->size) % deque->capacity];
+    }
+    pthread_mutex_unlock(&deque->lock);
+    return found;
+}
+
+static int deque_steal_head(sched_deque_t *deque, sched_task_t *task) {
+    // Cheap unlocked peek so idle thieves do not hammer busy locks
+    if (__atomic_load_n(&deque->size, __ATOMIC_RELAXED) == 0) {
+        return 0;
+    }
+    pthread_mutex_lock(&deque->lock);
+    int found = deque->size > 0;
+    if (found) {
+        *task = deque->tasks[deque->head];
+        deque->head = (deque->head + 1) % deque->capacity;
+        deque->size--;
+    }
+    pthread_mutex_unlock(&deque->lock);
+    return found;
+}
+
+/*
+ * Finds one task: own deque first, then steal, starting after ourselves
+ * so thieves spread across victims. self may be NULL (external thread).
+ */
+static int find_task(sched_pool_t *pool, sched_worker_t *self, sched_task_t *task) {
+    if (self && deque_pop_tail(&self->deque, task)) {
+        __atomic_fetch_sub(&pool->queued, 1, __ATOMIC_RELAXED);
+        return 1;
+    }
+    int start = self ? self->index + 1 : 0;
+    for (int i = 0; i < pool->worker_count; i++) {
+        sched_worker_t *victim = &pool->workers[(start + i) % pool->worker_count];
+        if (victim == self) {
+            continue;
+        }
+        if (self) {
+            self->steal_attempts++;
+        }
+        if (deque_steal_head(&victim->deque, task)) {
+            __atomic_fetch_sub(&pool->queued, 1, __ATOMIC_RELAXED);
+            if (self) {
+                self->steals++;
+            }
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static void run_task(sched_worker_t *self, const sched_task_t *task) {
+    task->fn(task->arg);
+    if (self) {
+        self->executed++;
+    }
+    if (task->group) {
+        sched_group_t *group = task->group;
+        pthread_mutex_lock(&group->lock);
+        if (--group->pending == 0) {
+            pthread_cond_broadcast(&group->done);
+        }
+        pthread_mutex_unlock(&group->lock);
+    }
+}
+
+static void *worker_main(void *arg) {
+    sched_worker_t *self = arg;
+    sched_pool_t *pool = self->pool;
+    current_worker = self;
+
+    for (;;) {
+        sched_task_t task;
+        if (find_task(pool, self, &task)) {
+            run_task(self, &task);
+            continue;
+        }
+        pthread_mutex_lock(&pool->idle_lock);
+        while (__atomic_load_n(&pool->queued, __ATOMIC_RELAXED) == 0 && !pool->stop) {
+            pthread_cond_wait(&pool->idle_cond, &pool->idle_lock);
+        }
+        int stop = pool->stop && __atomic_load_n(&pool->queued, __ATOMIC_RELAXED) == 0;
+        pthread_mutex_unlock(&pool->idle_lock);
+        if (stop) {
+            break;
+        }
+    }
+    current_worker = NULL;
+    return NULL;
+}
+
+/*
+ * FUNCTION: sched_pool_init
+ * ==========================
+ * Starts a pool of worker threads
+ *
+ * Parameters:
+ *   - workers: Number of threads, or 0 for one per online CPU
+ *
+ * Returns:
+ *   - 0 on success, -1 on error
+ */
+int sched_pool_init(sched_pool_t *pool, int workers) {
+    memset(pool, 0, sizeof(*pool));
+    if (workers <= 0) {
+        workers = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    }
+    if (workers < 1) {
+        workers = 1;
+    }
+    if (workers > SCHED_MAX_WORKERS) {
+        workers = SCHED_MAX_WORKERS;
+    }
+
+    pthread_mutex_init(&pool->idle_lock, NULL);
+    pthread_cond_init(&pool->idle_cond, NULL);
+    for (int i = 0; i < workers; i++) {
+        sched_worker_t *worker = &pool->workers[i];
+        worker->pool = pool;
+        worker->index = i;
+        pthread_mutex_init(&worker->deque.lock, NULL);
+    }
+    for (int i = 0; i < workers; i++) {
+        if (pthread_create(&pool->workers[i].thread, NULL, worker_main, &pool->workers[i]) != 0) {
+            sched_pool_destroy(pool);
+            return -1;
+        }
+        pool->worker_count = i + 1;
+    }
+    return 0;
+}
+
+/*
+ * FUNCTION: sched_pool_destroy
+ * =============================
+ * Runs every queued task, then stops and joins the workers
+ */
+void sched_pool_destroy(sched_pool_t *pool) {
+    pthread_mutex_lock(&pool->idle_lock);
+    pool->stop = 1;
+    pthread_cond_broadcast(&pool->idle_cond);
+    pthread_mutex_unlock(&pool->idle_lock);
+
+    for (int i = 0; i < pool->worker_count; i++) {
+        pthread_join(pool->workers[i].thread, NULL);
+    }
+    for (int i = 0; i < SCHED_MAX_WORKERS; i++) {
+        mem_free(pool->workers[i].deque.tasks);
+        if (pool->workers[i].pool) {
+            pthread_mutex_destroy(&pool->workers[i].deque.lock);
+        }
+    }
+    pthread_mutex_destroy(&pool->idle_lock);
+    pthread_cond_destroy(&pool->idle_cond);
+    pool->worker_count = 0;
+}
+
+static sched_pool_t default_pool;
+static int default_pool_ready;
+static pthread_once_t default_pool_once = PTHREAD_ONCE_INIT;
+
+static void destroy_default_pool(void) {
+    sched_pool_destroy(&default_pool);
+}
+
+static void init_default_pool(void) {
+    if (sched_pool_init(&default_pool, 0) == 0) {
+        default_pool_ready = 1;
+        atexit(destroy_default_pool);
+    }
+}
+
+/*
+ * FUNCTION: sched_default
+ * ========================
+ * Returns the process-wide pool all batch operations share
+ * Created on first use with one worker per CPU; NULL if that failed.
+ */
+sched_pool_t *sched_default(void) {
+    pthread_once(&default_pool_once, init_default_pool);
+    return default_pool_ready ? &default_pool : NULL;
+}
+
+void sched_group_init(sched_group_t *group) {
+    pthread_mutex_init(&group->lock, NULL);
+    pthread_cond_init(&group->done, NULL);
+    group->pending = 0;
+}
+
+/*
+ * FUNCTION: sched_submit
+ * =======================
+ * Queues fn(arg) as part of group
+ * From a worker of this pool the task goes on that worker's own deque;
+ * from any other thread it goes to the next worker round-robin.
+ *
+ * Returns:
+ *   - 0 on success, -1 if the task could not be queued
+ */
+int sched_submit(sched_pool_t *pool, sched_group_t *group, sched_task_fn fn, void *arg) {
+    sched_worker_t *target = current_worker;
+    if (!target || target->pool != pool) {
+        unsigned turn = __atomic_fetch_add(&pool->next_submit, 1, __ATOMIC_RELAXED);
+        target = &pool->workers[turn % (unsigned)pool->worker_count];
+    }
+
+    if (group) {
+        pthread_mutex_lock(&group->lock);
+        group->pending++;
+        pthread_mutex_unlock(&group->lock);
+    }
+
+    sched_task_t task = { fn, arg, group };
+    int depth;
+    if (deque_push(&target->deque, &task, &depth) != 0) {
+        if (group) {
+            pthread_mutex_lock(&group->lock);
+            group->pending--;
+            pthread_mutex_unlock(&group->lock);
+        }
+        return -1;
+    }
+    if (depth > target->max_depth) {
+        target->max_depth = depth;
+    }
+
+    pthread_mutex_lock(&pool->idle_lock);
+    __atomic_fetch_add(&pool->queued, 1, __ATOMIC_RELAXED);
+    pthread_cond_signal(&pool->idle_cond);
+    pthread_mutex_unlock(&pool->idle_lock);
+    return 0;
+}
+
+/*
+ * FUNCTION: sched_group_wait
+ * ===========================
+ * Waits until every task in group has finished, running queued tasks
+ * on the calling thread meanwhile
+ */
+void sched_group_wait(sched_pool_t *pool, sched_group_t *group) {
+    sched_worker_t *self = current_worker && current_worker->pool == pool ? current_worker : NULL;
+
+    for (;;) {
+        pthread_mutex_lock(&group->lock);
+        int pending = group->pending;
+        pthread_mutex_unlock(&group->lock);
+        if (pending == 0) {
+            break;
+        }
+
+        sched_task_t task;
+        if (find_task(pool, self, &task)) {
+            run_task(self, &task);
+            continue;
+        }
+
+        // Nothing to help with: wait briefly for the running tasks
+        struct timespec deadline;
+        clock_gettime(CLOCK_REALTIME, &deadline);
+        deadline.tv_nsec += 1000000;
+        if (deadline.tv_nsec >= 1000000000L) {
+            deadline.tv_sec++;
+            deadline.tv_nsec -= 1000000000L;
+        }
+        pthread_mutex_lock(&group->lock);
+        if (group->pending > 0) {
+            pthread_cond_timedwait(&group->done, &group->lock, &deadline);
+        }
+        pthread_mutex_unlock(&group->lock);
+    }
+    pthread_mutex_destroy(&group->lock);
+    pthread_cond_destroy(&group->done);
+}
+
+/*
+ * Parallel For
+ * ============
+ * A range task keeps halving its range, queueing the upper half, until it
+ * is at most grain long; thieves therefore take large halves first.
+ */
+typedef struct {
+    sched_pool_t *pool;
+    sched_group_t *group;
+    long begin;
+    long end;
+    long grain;
+    sched_range_fn fn;
+    void *arg;
+} range_task_t;
+
+static void range_task_main(void *arg) {
+    range_task_t *range = arg;
+    while (range->end - range->begin > range->grain) {
+        long mid = range->begin + (range->end - range->begin) / 2;
+        range_task_t *upper = malloc(sizeof(*upper));
+        if (!upper) {
+            break;
+        }
+        *upper = *range;
+        upper->begin = mid;
+        if (sched_submit(range->pool, range->group, range_task_main, upper) != 0) {
+            free(upper);
+            break;
+        }
+        range->end = mid;
+    }
+    range->fn(range->begin, range->end, range->arg);
+    free(range);
+}
+
+/*
+ * FUNCTION: sched_parallel_for
+ * =============================
+ * Calls fn(chunk_begin, chunk_end, arg) over [begin, end) in chunks of at
+ * most grain, and returns when every chunk has run
+ *
+ * Returns:
+ *   - 0 on success, -1 if the work could not be queued
+ */
+int sched_parallel_for(sched_pool_t *pool, long begin, long end, long grain, sched_range_fn fn, void *arg) {
+    if (end <= begin) {
+        return 0;
+    }
+    if (grain < 1) {
+        grain = 1;
+    }
+    range_task_t *root = malloc(sizeof(*root));
+    if (!root) {
+        return -1;
+    }
+    sched_group_t group;
+    sched_group_init(&group);
+    *root = (range_task_t){ pool, &group, begin, end, grain, fn, arg };
+    if (sched_submit(pool, &group, range_task_main, root) != 0) {
+        free(root);
+        sched_group_wait(pool, &group);
+        return -1;
+    }
+    sched_group_wait(pool, &group);
+    return 0;
+}
+
+/*
+ * FUNCTION: sched_stats
+ * ======================
+ * Copies the task counters of every worker
+ * Counters are read without stopping the pool, so totals are approximate
+ * while tasks are running.
+ */
+void sched_stats(sched_pool_t *pool, sched_stats_t *stats) {
+    memset(stats, 0, sizeof(*stats));
+    stats->worker_count = pool->worker_count;
+    for (int i = 0; i < pool->worker_count; i++) {
+        sched_worker_t *worker = &pool->workers[i];
+        stats->executed[i] = worker->executed;
+        stats->steals[i] = worker->steals;
+        stats->depth[i] = __atomic_load_n(&worker->deque.size, __ATOMIC_RELAXED);
+        stats->max_depth[i] = worker->max_depth;
+        stats->total_executed += worker->executed;
+        stats->total_steals += worker->steals;
+        stats->total_steal_attempts += worker->steal_attempts;
+    }
+    stats->queued = __atomic_load_n(&pool->queued, __ATOMIC_RELAXED);
+}
+
+/*
+ * FUNCTION: sched_print_stats
+ * ============================
+ * Prints one line per worker plus totals
+ */
+void sched_print_stats(sched_pool_t *pool) {
+    sched_stats_t stats;
+    sched_stats(pool, &stats);
+    printf("Worker  Executed    Steals  Depth  Max depth\n");
+    for (int i = 0; i < stats.worker_count; i++) {
+        printf("%6d  %8llu  %8llu  %5d  %9d\n", i,
+               (unsigned long long)stats.executed[i], (unsigned long long)stats.steals[i],
+               stats.depth[i], stats.max_depth[i]);
+    }
+    printf("Total   %8llu  %8llu  (%llu steal attempts, %d queued)\n",
+           (unsigned long long)stats.total_executed, (unsigned long long)stats.total_steals,
+           (unsigned long long)stats.total_steal_attempts, stats.queued);
+}
@@ -0,0 +1,115 @@
+/*
+ * ============================================================================
+ * WORK-STEALING TASK SCHEDULER
+ * ============================================================================
+ *
+ * One shared thread pool for short parallel batch work (text store scans,
+ * and so snapshot builds; report rendering; scrub checks) so features do
+ * not each spin up their own threads. The importer's pipeline stages and
+ * the shard workers block on queues for their whole run, so they keep
+ * their own threads rather than tie up pool workers.
+ *
+ * Each worker owns a deque. Tasks submitted from a worker go to the tail
+ * of its own deque and it pops from the tail (most recent first, which
+ * keeps recursive splits cache-warm). Idle workers steal from the head of
+ * another worker's deque (oldest first, i.e. the biggest pieces of work).
+ * Tasks submitted from outside the pool are spread round-robin.
+ *
+ * Callers group related tasks in a sched_group_t and wait on it; a waiting
+ * thread runs queued tasks itself instead of blocking, so nested waits
+ * cannot starve the pool.
+ *
+ * ============================================================================
+ */
+
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+
+#include <pthread.h>
+#include <stdint.h>
+
+#define SCHED_MAX_WORKERS 64
+
+typedef void (*sched_task_fn)(void *arg);
+typedef void (*sched_range_fn)(long begin, long end, void *arg);
+
+typedef struct {
+    pthread_mutex_t lock;
+    pthread_cond_t done;
+    int pending;
+} sched_group_t;
+
+typedef struct {
+    sched_task_fn fn;
+    void *arg;
+    sched_group_t *group;
+} sched_task_t;
+
+/*
+ * Worker Deque
+ * ============
+ * Ring buffer guarded by a per-worker lock. The owner works the tail,
+ * thieves take from the head.
+ */
+typedef struct {
+    pthread_mutex_t lock;
+    sched_task_t *tasks;
+    int capacity;
+    int head;
+    int size;
+} sched_deque_t;
+
+typedef struct sched_pool sched_pool_t;
+
+typedef struct {
+    sched_pool_t *pool;
+    int index;
+    pthread_t thread;
+    sched_deque_t deque;
+    uint64_t executed;
+    uint64_t steals;
+    uint64_t steal_attempts;
+    int max_depth;
+} sched_worker_t;
+
+struct sched_pool {
+    int worker_count;
+    sched_worker_t workers[SCHED_MAX_WORKERS];
+    pthread_mutex_t idle_lock;
+    pthread_cond_t idle_cond;
+    int queued;              // tasks sitting in deques
+    int stop;
+    unsigned next_submit;
+};
+
+/*
+ * Pool Metrics
+ * ============
+ * Snapshot of per-worker and total task counters
+ */
+typedef struct {
+    int worker_count;
+    uint64_t executed[SCHED_MAX_WORKERS];
+    uint64_t steals[SCHED_MAX_WORKERS];
+    int depth[SCHED_MAX_WORKERS];
+    int max_depth[SCHED_MAX_WORKERS];
+    uint64_t total_executed;
+    uint64_t total_steals;
+    uint64_t total_steal_attempts;
+    int queued;
+} sched_stats_t;
+
+int sched_pool_init(sched_pool_t *pool, int workers);
+void sched_pool_destroy(sched_pool_t *pool);
+sched_pool_t *sched_default(void);
+
+void sched_group_init(sched_group_t *group);
+int sched_submit(sched_pool_t *pool, sched_group_t *group, sched_task_fn fn, void *arg);
+void sched_group_wait(sched_pool_t *pool, sched_group_t *group);
+
+int sched_parallel_for(sched_pool_t *pool, long begin, long end, long grain, sched_range_fn fn, void *arg);
+
+void sched_stats(sched_pool_t *pool, sched_stats_t *stats);
+void sched_print_stats(sched_pool_t *pool);
+
+#endif
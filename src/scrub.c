@@ -0,0 +1,490 @@
+/*
+ * ============================================================================
+ * STORE SCRUB / FSCK
+ * ============================================================================
+ *
+ * See scrub.h for what is checked and repaired.
+ *
+ * ============================================================================
+ */
+
+#include "scrub.h"
+#include "record.h"
+#include "validate.h"
+#include "scheduler.h"
+#include "mem.h"
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <dirent.h>
+
+#define PATH_SIZE 512
+
+typedef enum {
+    CHECK_OK,
+    CHECK_DAMAGED,
+    CHECK_INVALID
+} check_status_t;
+
+// Outcome for one record; messages are static strings
+typedef struct {
+    check_status_t status;
+    const char *field;
+    const char *problem;
+} check_t;
+
+typedef struct {
+    char path[PATH_SIZE];
+    int id;                     // temp_<id>.txt, or -1 for other files
+} orphan_t;
+
+typedef struct {
+    int *ids;
+    size_t count;
+    size_t capacity;
+    orphan_t *orphans;
+    size_t orphan_count;
+    size_t orphan_capacity;
+} listing_t;
+
+static double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static int add_id(listing_t *listing, int id) {
+    if (listing->count == listing->capacity) {
+        size_t capacity = listing->capacity ? listing->capacity * 2 : 4096;
+        int *ids = mem_realloc(MEM_RECORDS, listing->ids, capacity * sizeof(int));
+        if (!ids) {
+            return -1;
+        }
+        listing->ids = ids;
+        listing->capacity = capacity;
+    }
+    listing->ids[listing->count++] = id;
+    return 0;
+}
+
+static int add_orphan(listing_t *listing, const char *dir, const char *name, int id) {
+    if (listing->orphan_count == listing->orphan_capacity) {
+        size_t capacity = listing->orphan_capacity ? listing->orphan_capacity * 2 : 16;
+        orphan_t *orphans = mem_realloc(MEM_RECORDS, listing->orphans, capacity * sizeof(orphan_t));
+        if (!orphans) {
+            return -1;
+        }
+        listing->orphans = orphans;
+        listing->orphan_capacity = capacity;
+    }
+    orphan_t *o = &listing->orphans[listing->orphan_count++];
+    snprintf(o->path, sizeof(o->path), "%s/%s", dir, name);
+    o->id = id;
+    return 0;
+}
+
+// Matches prefix<number>suffix exactly
+static int parse_numbered(const char *name, const char *prefix, const char *suffix, int *id) {
+    size_t plen = strlen(prefix);
+    if (strncmp(name, prefix, plen) != 0) {
+        return 0;
+    }
+    char *end;
+    long value = strtol(name + plen, &end, 10);
+    if (end == name + plen || strcmp(end, suffix) != 0 || value <= 0 || value > 0x7FFFFFFF) {
+        return 0;
+    }
+    *id = (int)value;
+    return 1;
+}
+
+/*
+ * A temporary file the app writes in data/ and renames into place
+ * (record_write_counter, snapshot_write and the shard counters all use
+ * [path].tmp); a crash can leave one behind
+ */
+static int known_leftover(const char *name, const char *counter_name) {
+    static const char shard_prefix[] = "shard_";
+    static const char shard_suffix[] = "_next.txt.tmp";
+    char counter_tmp[PATH_SIZE];
+    snprintf(counter_tmp, sizeof(counter_tmp), "%s.tmp", counter_name);
+    if (strcmp(name, counter_tmp) == 0 || strcmp(name, "snapshot.bin.tmp") == 0) {
+        return 1;
+    }
+    if (strncmp(name, shard_prefix, sizeof(shard_prefix) - 1) != 0) {
+        return 0;
+    }
+    const char *digits = name + sizeof(shard_prefix) - 1;
+    const char *end = digits;
+    while (*end >= '0' && *end <= '9') {
+        end++;
+    }
+    return end > digits && strcmp(end, shard_suffix) == 0;
+}
+
+/*
+ * Directory Listing
+ * =================
+ * One readdir pass over the record directory (record IDs only when the
+ * text files are the store) and one over the counter's directory
+ */
+static int list_store(listing_t *listing, const char *record_dir, const char *data_dir,
+                      const char *counter_name, int text) {
+    DIR *dir = opendir(record_dir);
+    if (!dir) {
+        return -1;
+    }
+    struct dirent *entry;
+    int ok = 1;
+    while (ok && (entry = readdir(dir))) {
+        int id;
+        if (parse_numbered(entry->d_name, "output_", ".txt", &id)) {
+            ok = !text || add_id(listing, id) == 0;
+        } else if (parse_numbered(entry->d_name, "temp_", ".txt", &id)) {
+            ok = add_orphan(listing, record_dir, entry->d_name, text ? id : -1) == 0;
+        } else if (strcmp(entry->d_name, "next_id.tmp") == 0) {
+            ok = add_orphan(listing, record_dir, entry->d_name, -1) == 0;
+        }
+    }
+    closedir(dir);
+
+    if (ok && (dir = opendir(data_dir))) {
+        while (ok && (entry = readdir(dir))) {
+            if (known_leftover(entry->d_name, counter_name)) {
+                ok = add_orphan(listing, data_dir, entry->d_name, -1) == 0;
+            }
+        }
+        closedir(dir);
+    }
+    return ok ? 0 : -1;
+}
+
+static void output_path(const char *record_dir, int id, char *buf, size_t size) {
+    snprintf(buf, size, "%s/output_%d.txt", record_dir, id);
+}
+
+/*
+ * Record that reads back with a verified checksum: 1 if it does, 0 if
+ * not, -1 if it could not be told (its names could not be interned)
+ */
+static int verifies(const char *path) {
+    student_t student;
+    int version;
+    if (record_read(path, &student, &version) != 0) {
+        return errno == ENOMEM ? -1 : 0;
+    }
+    return version >= RECORD_SCHEMA_VERSION;
+}
+
+static int find_id(const listing_t *listing, int id) {
+    for (size_t i = 0; i < listing->count; i++) {
+        if (listing->ids[i] == id) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/*
+ * Orphan Repair
+ * =============
+ * A temp_<id>.txt is left behind when a save stops between writing it
+ * and renaming it over output_<id>.txt. If the temp file is complete and
+ * the record is missing or damaged, the temp file is the newest good
+ * copy and is moved into place; otherwise it is deleted.
+ */
+static void repair_orphans(listing_t *listing, const char *record_dir, scrub_result_t *result, FILE *report) {
+    for (size_t i = 0; i < listing->orphan_count; i++) {
+        const orphan_t *o = &listing->orphans[i];
+        if (o->id > 0) {
+            char path[PATH_SIZE];
+            output_path(record_dir, o->id, path, sizeof(path));
+            int record_ok = verifies(path);
+            int temp_ok = record_ok == 0 ? verifies(o->path) : 0;
+            if (record_ok < 0 || temp_ok < 0) {
+                // Never delete what might be the only good copy
+                if (report) {
+                    fprintf(report, "%s: kept, out of memory while checking it\n", o->path);
+                }
+                continue;
+            }
+            if (!record_ok && temp_ok && rename(o->path, path) == 0) {
+                if (!find_id(listing, o->id)) {
+                    add_id(listing, o->id);
+                }
+                result->recovered++;
+                if (report) {
+                    fprintf(report, "%s: recovered as %s\n", o->path, path);
+                }
+                continue;
+            }
+        }
+        if (remove(o->path) == 0) {
+            result->removed++;
+            if (report) {
+                fprintf(report, "%s: removed\n", o->path);
+            }
+        }
+    }
+}
+
+static void check_fields(const student_t *s, check_t *check) {
+    char grade[16];
+    char subject_grades[4][32];
+    const subject_t *subjects[] = { &s->subject1, &s->subject2, &s->subject3, &s->subject4 };
+    snprintf(grade, sizeof(grade), "%d", s->grade);
+    for (int i = 0; i < 4; i++) {
+        snprintf(subject_grades[i], sizeof(subject_grades[i]), "%.2f", subjects[i]->grade);
+    }
+
+    const struct {
+        const char *key;
+        value_kind_t kind;
+        const char *value;
+    } fields[] = {
+        { "NAME", VALUE_NAME, str_get(&s->name) },
+        { "FAMILY_NAME", VALUE_FAMILY_NAME, str_get(&s->family_name) },
+        { "STUDENT_ID", VALUE_STUDENT_ID, s->studentid },
+        { "DOB", VALUE_DATE_OF_BIRTH, s->dateofbirth },
+        { "FATHER_NAME", VALUE_NAME, str_get(&s->father_name) },
+        { "MOTHER_NAME", VALUE_NAME, str_get(&s->mother_name) },
+        { "PHONE_NUMBER", VALUE_PHONE_NUMBER, s->phone_number },
+        { "GRADE", VALUE_CLASS_GRADE, grade },
+        { "SUBJECT1_NAME", VALUE_SUBJECT_NAME, str_get(&s->subject1.name) },
+        { "SUBJECT1_GRADE", VALUE_SUBJECT_GRADE, subject_grades[0] },
+        { "SUBJECT2_NAME", VALUE_SUBJECT_NAME, str_get(&s->subject2.name) },
+        { "SUBJECT2_GRADE", VALUE_SUBJECT_GRADE, subject_grades[1] },
+        { "SUBJECT3_NAME", VALUE_SUBJECT_NAME, str_get(&s->subject3.name) },
+        { "SUBJECT3_GRADE", VALUE_SUBJECT_GRADE, subject_grades[2] },
+        { "SUBJECT4_NAME", VALUE_SUBJECT_NAME, str_get(&s->subject4.name) },
+        { "SUBJECT4_GRADE", VALUE_SUBJECT_GRADE, subject_grades[3] },
+    };
+
+    for (size_t i = 0; i < sizeof(fields) / sizeof(fields[0]); i++) {
+        const char *problem = validate_value(fields[i].kind, fields[i].value, strlen(fields[i].value));
+        if (problem) {
+            check->status = CHECK_INVALID;
+            check->field = fields[i].key;
+            check->problem = problem;
+            return;
+        }
+    }
+
+    float difference = (s->subject1.grade + s->subject2.grade + s->subject3.grade + s->subject4.grade) / 4.0f -
+                       s->average_grade;
+    if (difference > 0.01f || difference < -0.01f) {
+        check->status = CHECK_INVALID;
+        check->field = "AVERAGE_GRADE";
+        check->problem = "does not match the subject grades";
+    }
+}
+
+typedef struct {
+    const char *record_dir;
+    const int *ids;
+    check_t *checks;
+} check_job_t;
+
+static void check_range(long begin, long end, void *arg) {
+    check_job_t *job = arg;
+    for (long i = begin; i < end; i++) {
+        char path[PATH_SIZE];
+        student_t student;
+        check_t *check = &job->checks[i];
+        output_path(job->record_dir, job->ids[i], path, sizeof(path));
+        check->status = CHECK_OK;
+        if (record_read(path, &student, NULL) != 0) {
+            check->status = CHECK_DAMAGED;
+            check->field = NULL;
+            check->problem = errno == EBADMSG ? "checksum mismatch or truncated" :
+                             errno == ENOMEM ? "unreadable (out of memory)" : "unreadable";
+            continue;
+        }
+        check_fields(&student, check);
+    }
+}
+
+typedef struct {
+    listing_t *listing;
+    check_t *checks;
+    size_t capacity;
+    int failed;
+} scan_state_t;
+
+// Checks each student a store scan visits; checks[i] belongs to ids[i]
+static void check_scanned(const student_t *student, void *arg) {
+    scan_state_t *state = arg;
+    if (state->failed) {
+        return;
+    }
+    if (state->listing->count == state->capacity) {
+        size_t capacity = state->capacity ? state->capacity * 2 : 4096;
+        check_t *checks = mem_realloc(MEM_RECORDS, state->checks, capacity * sizeof(check_t));
+        if (!checks) {
+            state->failed = 1;
+            return;
+        }
+        state->checks = checks;
+        state->capacity = capacity;
+    }
+    check_t *check = &state->checks[state->listing->count];
+    if (add_id(state->listing, student->student_id) != 0) {
+        state->failed = 1;
+        return;
+    }
+    check->status = CHECK_OK;
+    check_fields(student, check);
+}
+
+static int compare_ints(const void *a, const void *b) {
+    int x = *(const int *)a;
+    int y = *(const int *)b;
+    return (x > y) - (x < y);
+}
+
+static int read_counter(const char *path) {
+    int counter = 0;
+    FILE *file = fopen(path, "r");
+    if (file) {
+        if (fscanf(file, "%d", &counter) != 1) {
+            counter = 0;
+        }
+        fclose(file);
+    }
+    return counter;
+}
+
+/*
+ * FUNCTION: scrub_store
+ * ======================
+ * Checks (and with options->repair, repairs) a store
+ *
+ * Returns:
+ *   - 0 if the store is clean (after repairs), 1 if problems remain,
+ *     -1 if it could not be scanned
+ */
+int scrub_store(const scrub_options_t *options, scrub_result_t *result) {
+    const char *record_dir = options->record_dir ? options->record_dir : ".";
+    const char *counter_path = options->counter_path ? options->counter_path : "data/next_id.txt";
+    const store_t *store = options->store;
+    int text = !store || store->ops == &store_text_ops;
+    FILE *report = options->report;
+    memset(result, 0, sizeof(*result));
+    double start = now_seconds();
+
+    char data_dir[PATH_SIZE];
+    snprintf(data_dir, sizeof(data_dir), "%s", counter_path);
+    char *slash = strrchr(data_dir, '/');
+    const char *counter_name = slash ? strrchr(counter_path, '/') + 1 : counter_path;
+    if (slash) {
+        *slash = '\0';
+    } else {
+        snprintf(data_dir, sizeof(data_dir), ".");
+    }
+
+    // SECTION 1: List records and leftovers
+    listing_t listing;
+    memset(&listing, 0, sizeof(listing));
+    if (list_store(&listing, record_dir, data_dir, counter_name, text) != 0) {
+        mem_free(listing.ids);
+        mem_free(listing.orphans);
+        return -1;
+    }
+    result->orphans = (long)listing.orphan_count;
+    if (options->repair) {
+        repair_orphans(&listing, record_dir, result, report);
+    } else if (report) {
+        for (size_t i = 0; i < listing.orphan_count; i++) {
+            fprintf(report, "%s: leftover temporary file\n", listing.orphans[i].path);
+        }
+    }
+
+    // SECTION 2: Verify every record (text files in parallel, others by scan)
+    check_t *checks = NULL;
+    if (text) {
+        qsort(listing.ids, listing.count, sizeof(int), compare_ints);
+        checks = mem_malloc(MEM_RECORDS, (listing.count ? listing.count : 1) * sizeof(check_t));
+        if (!checks) {
+            mem_free(listing.ids);
+            mem_free(listing.orphans);
+            return -1;
+        }
+        check_job_t job = { record_dir, listing.ids, checks };
+        sched_pool_t *pool = sched_default();
+        if (!pool || sched_parallel_for(pool, 0, (long)listing.count, 256, check_range, &job) != 0) {
+            check_range(0, (long)listing.count, &job);
+        }
+    } else {
+        scan_state_t state = { &listing, NULL, 0, 0 };
+        int scanned = store_scan(store, 1, INT32_MAX, check_scanned, &state);
+        checks = state.checks;
+        if (state.failed) {
+            mem_free(checks);
+            mem_free(listing.ids);
+            mem_free(listing.orphans);
+            return -1;
+        }
+        if (scanned < 0) {
+            result->damaged++;
+            if (report) {
+                fprintf(report, "%s store: scan stopped at a damaged record\n", store->ops->name);
+            }
+        }
+    }
+
+    result->records = (long)listing.count;
+    for (size_t i = 0; i < listing.count; i++) {
+        if (checks[i].status == CHECK_DAMAGED) {
+            result->damaged++;
+        } else if (checks[i].status == CHECK_INVALID) {
+            result->invalid++;
+        }
+        if (checks[i].status != CHECK_OK && report) {
+            if (text) {
+                fprintf(report, "output_%d.txt: ", listing.ids[i]);
+            } else {
+                fprintf(report, "%s store, student %d: ", store->ops->name, listing.ids[i]);
+            }
+            fprintf(report, "%s%s%s\n", checks[i].field ? checks[i].field : "", checks[i].field ? " " : "",
+                    checks[i].problem);
+        }
+    }
+    // Both listings are in ID order: sorted, or as the store scans them
+    result->max_id = listing.count ? listing.ids[listing.count - 1] : 0;
+
+    // SECTION 3: The counter must be past every ID
+    result->counter = read_counter(counter_path);
+    int counter_ok = result->counter > result->max_id;
+    if (!counter_ok && report) {
+        fprintf(report, "%s: next ID %d is not above the highest record ID %d\n",
+                counter_path, result->counter, result->max_id);
+    }
+    if (!counter_ok && options->repair && record_write_counter(counter_path, result->max_id + 1) == 0) {
+        result->counter_repaired = result->max_id + 1;
+        counter_ok = 1;
+    }
+
+    mem_free(checks);
+    mem_free(listing.ids);
+    mem_free(listing.orphans);
+    result->seconds = now_seconds() - start;
+
+    long orphans_left = options->repair ? result->orphans - result->recovered - result->removed : result->orphans;
+    return result->damaged == 0 && result->invalid == 0 && orphans_left == 0 && counter_ok ? 0 : 1;
+}
+
+void scrub_print_result(const scrub_result_t *result) {
+    printf("%ld records checked in %.2f s (%.0f records/s)\n", result->records, result->seconds,
+           result->seconds > 0 ? result->records / result->seconds : 0.0);
+    printf("  damaged: %ld, invalid fields: %ld\n", result->damaged, result->invalid);
+    printf("  leftover temporary files: %ld (%ld recovered, %ld removed)\n",
+           result->orphans, result->recovered, result->removed);
+    if (result->counter_repaired) {
+        printf("  next ID raised from %d to %d\n", result->counter, result->counter_repaired);
+    } else {
+        printf("  next ID %d, highest record ID %d\n", result->counter, result->max_id);
+    }
+}
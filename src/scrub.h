@@ -0,0 +1,62 @@
+/*
+ * ============================================================================
+ * STORE SCRUB / FSCK
+ * ============================================================================
+ *
+ * Checks a data directory after an incident:
+ *
+ *   1. Lists the leftover temporary files the app itself writes:
+ *      temp_<id>.txt and next_id.tmp in the record directory, and the
+ *      counter's, the snapshot's and the shard counters' .tmp files in
+ *      data/. Other files are never touched.
+ *   2. Verifies every record: every field against the validate.h rules
+ *      and AVERAGE_GRADE against the subject grades. For the text store
+ *      the record directory is listed once and every output_<id>.txt is
+ *      read in parallel on the shared scheduler pool, so a bad checksum
+ *      (record.h) is reported per file; any other store (options.store)
+ *      is read with store_scan, and a scan error counts as damage.
+ *   3. Checks that the ID counter is greater than every record ID
+ *
+ * With repair set it also:
+ *   - raises the counter to one past the highest ID
+ *   - recovers a temp_<id>.txt whose checksum verifies when its text
+ *     record is missing or damaged (a crash between writing and renaming
+ *     it), and deletes the other leftovers listed in step 1
+ *
+ * Damaged and invalid records are only reported; they need a person.
+ * Run the scrub while nothing else is writing to the store.
+ *
+ * ============================================================================
+ */
+
+#ifndef SCRUB_H
+#define SCRUB_H
+
+#include <stdio.h>
+#include "store.h"
+
+typedef struct {
+    const char *record_dir;     // where output_<id>.txt live (default ".")
+    const char *counter_path;   // ID counter (default data/next_id.txt)
+    int repair;
+    FILE *report;               // one line per problem (NULL = quiet)
+    const store_t *store;       // records to check (NULL = the text files)
+} scrub_options_t;
+
+typedef struct {
+    long records;
+    long damaged;               // missing or bad checksum, unreadable
+    long invalid;               // readable but a field breaks the rules
+    long orphans;               // leftover temporary files
+    long recovered;             // orphans promoted to records
+    long removed;               // orphans deleted
+    int max_id;
+    int counter;                // counter found (0 if missing)
+    int counter_repaired;       // new counter value, 0 if unchanged
+    double seconds;
+} scrub_result_t;
+
+int scrub_store(const scrub_options_t *options, scrub_result_t *result);
+void scrub_print_result(const scrub_result_t *result);
+
+#endif
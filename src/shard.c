@@ -0,0 +1,631 @@
+/*
+ * ============================================================================
+ * SHARDED STUDENT ENGINE
+ * ============================================================================
+ *
+ * See shard.h for the partitioning and ownership model.
+ *
+ * ============================================================================
+ */
+
+#define _GNU_SOURCE  // pthread_setaffinity_np
+
+#include "shard.h"
+#include "mem.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <errno.h>
+#include <sched.h>
+#include <unistd.h>
+
+typedef enum {
+    SHARD_OP_ADD,
+    SHARD_OP_GET,
+    SHARD_OP_FIND,
+    SHARD_OP_UPDATE,
+    SHARD_OP_QUERY
+} shard_op_t;
+
+// Counts outstanding requests of one call (1 for point ops, N for fan-out)
+typedef struct {
+    pthread_mutex_t lock;
+    pthread_cond_t done;
+    int pending;
+} completion_t;
+
+typedef struct shard_request {
+    shard_op_t op;
+    int id;
+    field_t field;
+    const char *value;
+    const char *studentid;
+    student_t *student;
+    shard_filter_fn filter;
+    void *filter_arg;
+    student_t *results;
+    int result_count;
+    int status;
+    completion_t *completion;
+    struct shard_request *next;
+} shard_request_t;
+
+static uint32_t hash_studentid(const char *s) {
+    // FNV-1a
+    uint32_t h = 2166136261u;
+    for (; *s; s++) {
+        h ^= (unsigned char)*s;
+        h *= 16777619u;
+    }
+    return h;
+}
+
+/*
+ * Per-shard state helpers (worker thread only)
+ */
+static int seq_of(const shard_t *shard, int id) {
+    return (id - 1) / shard->shard_count;
+}
+
+static int id_of(const shard_t *shard, int seq) {
+    return seq * shard->shard_count + shard->index + 1;
+}
+
+// First local sequence whose ID is at least id
+static int seq_from(const shard_t *shard, int id) {
+    int gap = id - shard->index - 1;
+    return gap > 0 ? (gap + shard->shard_count - 1) / shard->shard_count : 0;
+}
+
+static int read_int_file(const char *path, int *value) {
+    FILE *file = fopen(path, "r");
+    if (!file) {
+        return -1;
+    }
+    int ok = fscanf(file, "%d", value) == 1;
+    fclose(file);
+    return ok ? 0 : -1;
+}
+
+static int save_counter(const shard_t *shard) {
+    return record_write_counter(shard->counter_path, shard->next_seq);
+}
+
+/*
+ * Moves the shard into the engine's current block of global IDs,
+ * reserving a new block from data/next_id.txt (record_reserve_ids, the
+ * allocator studentdb_create and the importer use) if the shard has used
+ * up its share of the current one. ids->lock only guards the block.
+ */
+static int reserve_ids(shard_t *shard) {
+    shard_ids_t *ids = shard->ids;
+    pthread_mutex_lock(&ids->lock);
+    int seq = seq_from(shard, ids->start);
+    if (seq < shard->next_seq) {
+        seq = shard->next_seq;
+    }
+    if (id_of(shard, seq) >= ids->end) {
+        int start = record_reserve_ids(SHARD_COUNTER_PATH, SHARD_ID_BLOCK * shard->shard_count);
+        if (start < 0) {
+            pthread_mutex_unlock(&ids->lock);
+            return -1;
+        }
+        ids->start = start;
+        ids->end = start + SHARD_ID_BLOCK * shard->shard_count;
+        seq = seq_from(shard, start);
+        if (seq < shard->next_seq) {
+            seq = shard->next_seq;
+        }
+    }
+    shard->next_seq = seq;
+    shard->limit_seq = seq_from(shard, ids->end);
+    pthread_mutex_unlock(&ids->lock);
+    return 0;
+}
+
+static void sid_insert(shard_t *shard, int seq) {
+    const char *sid = shard->cache[seq].studentid;
+    int mask = shard->sid_capacity - 1;
+    int slot = (int)(hash_studentid(sid) & (uint32_t)mask);
+    while (shard->sid_slots[slot] != 0) {
+        if (shard->sid_slots[slot] == seq + 1) {
+            return;
+        }
+        slot = (slot + 1) & mask;
+    }
+    shard->sid_slots[slot] = seq + 1;
+}
+
+static int sid_rebuild(shard_t *shard, int capacity) {
+    int *slots = mem_calloc(MEM_INDEXES, (size_t)capacity, sizeof(int));
+    if (!slots) {
+        return -1;
+    }
+    mem_free(shard->sid_slots);
+    shard->sid_slots = slots;
+    shard->sid_capacity = capacity;
+    for (int seq = 0; seq < shard->cache_capacity; seq++) {
+        if (shard->cache[seq].student_id != 0) {
+            sid_insert(shard, seq);
+        }
+    }
+    return 0;
+}
+
+static int cache_put(shard_t *shard, int seq, const student_t *student) {
+    if (seq >= shard->cache_capacity) {
+        int capacity = shard->cache_capacity ? shard->cache_capacity : 64;
+        while (capacity <= seq) {
+            capacity *= 2;
+        }
+        student_t *grown = mem_realloc(MEM_RECORDS, shard->cache, (size_t)capacity * sizeof(student_t));
+        if (!grown) {
+            return -1;
+        }
+        memset(grown + shard->cache_capacity, 0,
+               (size_t)(capacity - shard->cache_capacity) * sizeof(student_t));
+        shard->cache = grown;
+        shard->cache_capacity = capacity;
+    }
+
+    if (shard->cache[seq].student_id == 0) {
+        shard->record_count++;
+    }
+    shard->cache[seq] = *student;
+
+    if (shard->record_count * 2 > shard->sid_capacity) {
+        return sid_rebuild(shard, shard->sid_capacity ? shard->sid_capacity * 2 : 128);
+    }
+    sid_insert(shard, seq);
+    return 0;
+}
+
+static const student_t *cache_get(const shard_t *shard, int id) {
+    if (id < 1 || (id - 1) % shard->shard_count != shard->index) {
+        return NULL;
+    }
+    int seq = seq_of(shard, id);
+    if (seq >= shard->cache_capacity || shard->cache[seq].student_id == 0) {
+        return NULL;
+    }
+    return &shard->cache[seq];
+}
+
+static void load_cache(shard_t *shard) {
+    for (int seq = 0; seq < shard->next_seq; seq++) {
+        student_t student;
+        if (record_load(id_of(shard, seq), &student) == 0) {
+            cache_put(shard, seq, &student);
+        }
+    }
+}
+
+/*
+ * Returns the cached copy of one of this shard's students, loading it
+ * from the selected store first if it was created outside the engine
+ * (by the importer or studentdb_create_many)
+ */
+static const student_t *cache_load(shard_t *shard, int id) {
+    const student_t *cached = cache_get(shard, id);
+    student_t student;
+    if (cached || id < 1 || (id - 1) % shard->shard_count != shard->index || record_load(id, &student) != 0 || cache_put(shard, seq_of(shard, id), &student) != 0) {
+        return cached;
+    }
+    return cache_get(shard, id);
+}
+
+/*
+ * Request handlers (worker thread only)
+ */
+static void handle_add(shard_t *shard, shard_request_t *req) {
+    if (shard->next_seq >= shard->limit_seq && reserve_ids(shard) != 0) {
+        req->status = -1;
+        return;
+    }
+    int seq = shard->next_seq;
+    shard->next_seq++;
+    // Persist the counter first so a crash can never hand out the ID twice
+    if (save_counter(shard) != 0) {
+        shard->next_seq--;
+        req->status = -1;
+        return;
+    }
+    req->student->student_id = id_of(shard, seq);
+    // A fresh ID, so the store sync runs outside the record lock
+    if (record_save_many(req->student, 1) != 0 || cache_put(shard, seq, req->student) != 0) {
+        req->status = -1;
+        return;
+    }
+    req->status = req->student->student_id;
+}
+
+static void handle_update(shard_t *shard, shard_request_t *req) {
+    const student_t *cached = cache_load(shard, req->id);
+    if (!cached) {
+        req->status = -1;
+        return;
+    }
+    student_t student = *cached;
+    if (record_set_field(&student, req->field, req->value) != 0 || record_save(req->id, &student) != 0) {
+        req->status = -1;
+        return;
+    }
+    req->status = cache_put(shard, seq_of(shard, req->id), &student);
+}
+
+static void handle_find(shard_t *shard, shard_request_t *req) {
+    req->status = -1;
+    if (shard->sid_capacity == 0) {
+        return;
+    }
+    int mask = shard->sid_capacity - 1;
+    int slot = (int)(hash_studentid(req->studentid) & (uint32_t)mask);
+    while (shard->sid_slots[slot] != 0) {
+        const student_t *candidate = &shard->cache[shard->sid_slots[slot] - 1];
+        if (strcmp(candidate->studentid, req->studentid) == 0) {
+            *req->student = *candidate;
+            req->status = 0;
+            return;
+        }
+        slot = (slot + 1) & mask;
+    }
+}
+
+static void handle_query(shard_t *shard, shard_request_t *req) {
+    req->results = mem_malloc(MEM_RECORDS, (size_t)(shard->record_count ? shard->record_count : 1) * sizeof(student_t));
+    req->result_count = 0;
+    if (!req->results) {
+        req->status = -1;
+        return;
+    }
+    for (int seq = 0; seq < shard->cache_capacity; seq++) {
+        const student_t *student = &shard->cache[seq];
+        if (student->student_id != 0 && (!req->filter || req->filter(student, req->filter_arg))) {
+            req->results[req->result_count++] = *student;
+        }
+    }
+    req->status = 0;
+}
+
+static void complete(shard_request_t *req) {
+    completion_t *c = req->completion;
+    pthread_mutex_lock(&c->lock);
+    if (--c->pending == 0) {
+        pthread_cond_signal(&c->done);
+    }
+    pthread_mutex_unlock(&c->lock);
+}
+
+static void *shard_main(void *arg) {
+    shard_t *shard = arg;
+    load_cache(shard);
+
+    for (;;) {
+        pthread_mutex_lock(&shard->queue_lock);
+        while (!shard->queue_head && !shard->stop) {
+            pthread_cond_wait(&shard->queue_ready, &shard->queue_lock);
+        }
+        shard_request_t *req = shard->queue_head;
+        if (!req) {
+            pthread_mutex_unlock(&shard->queue_lock);
+            break;
+        }
+        shard->queue_head = req->next;
+        if (!shard->queue_head) {
+            shard->queue_tail = NULL;
+        }
+        pthread_mutex_unlock(&shard->queue_lock);
+
+        switch (req->op) {
+        case SHARD_OP_ADD:
+            handle_add(shard, req);
+            break;
+        case SHARD_OP_GET: {
+            const student_t *cached = cache_load(shard, req->id);
+            if (cached) {
+                *req->student = *cached;
+            }
+            req->status = cached ? 0 : -1;
+            break;
+        }
+        case SHARD_OP_FIND:
+            handle_find(shard, req);
+            break;
+        case SHARD_OP_UPDATE:
+            handle_update(shard, req);
+            break;
+        case SHARD_OP_QUERY:
+            handle_query(shard, req);
+            break;
+        }
+        complete(req);
+    }
+    return NULL;
+}
+
+/*
+ * Request submission (any thread)
+ */
+static void submit(shard_t *shard, shard_request_t *req, completion_t *completion) {
+    req->completion = completion;
+    req->next = NULL;
+    pthread_mutex_lock(&shard->queue_lock);
+    if (shard->queue_tail) {
+        shard->queue_tail->next = req;
+    } else {
+        shard->queue_head = req;
+    }
+    shard->queue_tail = req;
+    pthread_cond_signal(&shard->queue_ready);
+    pthread_mutex_unlock(&shard->queue_lock);
+}
+
+static void completion_init(completion_t *c, int pending) {
+    pthread_mutex_init(&c->lock, NULL);
+    pthread_cond_init(&c->done, NULL);
+    c->pending = pending;
+}
+
+static void completion_wait(completion_t *c) {
+    pthread_mutex_lock(&c->lock);
+    while (c->pending > 0) {
+        pthread_cond_wait(&c->done, &c->lock);
+    }
+    pthread_mutex_unlock(&c->lock);
+    pthread_mutex_destroy(&c->lock);
+    pthread_cond_destroy(&c->done);
+}
+
+static int call(shard_t *shard, shard_request_t *req) {
+    completion_t completion;
+    completion_init(&completion, 1);
+    submit(shard, req, &completion);
+    completion_wait(&completion);
+    return req->status;
+}
+
+/*
+ * FUNCTION: shard_engine_open
+ * ============================
+ * Starts one worker per shard and loads each shard's records
+ *
+ * Parameters:
+ *   - shard_count: Number of shards, or 0 to use the stored count
+ *     (or one per online CPU for a new store)
+ *
+ * Returns:
+ *   - 0 on success, -1 on error (errno EINVAL for a shard count out of
+ *     range or that does not match data/shards.txt)
+ */
+int shard_engine_open(shard_engine_t *engine, int shard_count) {
+    memset(engine, 0, sizeof(*engine));
+
+    int ncpu = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    if (ncpu < 1) {
+        ncpu = 1;
+    }
+    int stored = 0;
+    if (read_int_file(SHARD_CONFIG_PATH, &stored) == 0) {
+        if (shard_count != 0 && shard_count != stored) {
+            errno = EINVAL;
+            return -1;
+        }
+        shard_count = stored;
+    } else if (shard_count == 0) {
+        shard_count = ncpu;
+    }
+    if (shard_count < 1 || shard_count > SHARD_MAX) {
+        errno = EINVAL;
+        return -1;
+    }
+    if (!stored) {
+        FILE *config = fopen(SHARD_CONFIG_PATH, "w");
+        if (!config) {
+            return -1;
+        }
+        fprintf(config, "%d\n", shard_count);
+        fclose(config);
+    }
+
+    // IDs already issued by the single global counter
+    int global_next = 1;
+    read_int_file(SHARD_COUNTER_PATH, &global_next);
+
+    engine->shard_count = shard_count;
+    pthread_mutex_init(&engine->ids.lock, NULL);
+    for (int i = 0; i < shard_count; i++) {
+        shard_t *shard = &engine->shards[i];
+        shard->index = i;
+        shard->shard_count = shard_count;
+        shard->ids = &engine->ids;
+        shard->cpu = i % ncpu;
+        snprintf(shard->counter_path, sizeof(shard->counter_path), "data/shard_%d_next.txt", i);
+
+        if (read_int_file(shard->counter_path, &shard->next_seq) != 0) {
+            shard->next_seq = seq_from(shard, global_next);
+            if (save_counter(shard) != 0) {
+                shard_engine_close(engine);
+                return -1;
+            }
+        }
+
+        pthread_mutex_init(&shard->queue_lock, NULL);
+        pthread_cond_init(&shard->queue_ready, NULL);
+        if (pthread_create(&shard->worker, NULL, shard_main, shard) != 0) {
+            shard_engine_close(engine);
+            return -1;
+        }
+        cpu_set_t cpus;
+        CPU_ZERO(&cpus);
+        CPU_SET(shard->cpu, &cpus);
+        pthread_setaffinity_np(shard->worker, sizeof(cpus), &cpus);
+    }
+    return 0;
+}
+
+/*
+ * FUNCTION: shard_engine_close
+ * =============================
+ * Drains every shard queue, stops the workers and frees shard state
+ */
+void shard_engine_close(shard_engine_t *engine) {
+    for (int i = 0; i < engine->shard_count; i++) {
+        shard_t *shard = &engine->shards[i];
+        if (!shard->worker) {
+            continue;
+        }
+        pthread_mutex_lock(&shard->queue_lock);
+        shard->stop = 1;
+        pthread_cond_signal(&shard->queue_ready);
+        pthread_mutex_unlock(&shard->queue_lock);
+        pthread_join(shard->worker, NULL);
+        pthread_mutex_destroy(&shard->queue_lock);
+        pthread_cond_destroy(&shard->queue_ready);
+        mem_free(shard->cache);
+        mem_free(shard->sid_slots);
+    }
+    if (engine->shard_count > 0) {
+        pthread_mutex_destroy(&engine->ids.lock);
+    }
+    memset(engine, 0, sizeof(*engine));
+}
+
+/*
+ * FUNCTION: shard_of
+ * ===================
+ * Returns the index of the shard that owns a student ID
+ */
+int shard_of(const shard_engine_t *engine, int id) {
+    return (id - 1) % engine->shard_count;
+}
+
+/*
+ * FUNCTION: shard_add
+ * ====================
+ * Adds a student on the next shard in round-robin order
+ * student->student_id is set to the assigned ID.
+ *
+ * Returns:
+ *   - The new student ID, or -1 on error
+ */
+int shard_add(shard_engine_t *engine, student_t *student) {
+    unsigned turn = __atomic_fetch_add(&engine->next_shard, 1, __ATOMIC_RELAXED);
+    shard_request_t req = { .op = SHARD_OP_ADD, .student = student };
+    return call(&engine->shards[turn % (unsigned)engine->shard_count], &req);
+}
+
+/*
+ * FUNCTION: shard_get
+ * ====================
+ * Point lookup routed to the owning shard
+ *
+ * Returns:
+ *   - 0 if found, -1 otherwise
+ */
+int shard_get(shard_engine_t *engine, int id, student_t *student) {
+    if (id < 1) {
+        return -1;
+    }
+    shard_request_t req = { .op = SHARD_OP_GET, .id = id, .student = student };
+    return call(&engine->shards[shard_of(engine, id)], &req);
+}
+
+/*
+ * FUNCTION: shard_update
+ * =======================
+ * Updates one field on the owning shard and rewrites the record
+ *
+ * Returns:
+ *   - 0 on success, -1 if missing, invalid, or not written
+ */
+int shard_update(shard_engine_t *engine, int id, field_t field, const char *value) {
+    if (id < 1) {
+        return -1;
+    }
+    shard_request_t req = { .op = SHARD_OP_UPDATE, .id = id, .field = field, .value = value };
+    return call(&engine->shards[shard_of(engine, id)], &req);
+}
+
+/*
+ * FUNCTION: shard_find_studentid
+ * ===============================
+ * Looks up an official STUDENT_ID on every shard in parallel
+ *
+ * Returns:
+ *   - 0 if found, -1 otherwise
+ */
+int shard_find_studentid(shard_engine_t *engine, const char *studentid, student_t *student) {
+    shard_request_t reqs[SHARD_MAX];
+    student_t found[SHARD_MAX];
+    completion_t completion;
+
+    completion_init(&completion, engine->shard_count);
+    for (int i = 0; i < engine->shard_count; i++) {
+        reqs[i] = (shard_request_t){ .op = SHARD_OP_FIND, .studentid = studentid, .student = &found[i] };
+        submit(&engine->shards[i], &reqs[i], &completion);
+    }
+    completion_wait(&completion);
+
+    for (int i = 0; i < engine->shard_count; i++) {
+        if (reqs[i].status == 0) {
+            *student = found[i];
+            return 0;
+        }
+    }
+    return -1;
+}
+
+static int compare_by_id(const void *a, const void *b) {
+    int x = ((const student_t *)a)->student_id;
+    int y = ((const student_t *)b)->student_id;
+    return (x > y) - (x < y);
+}
+
+/*
+ * FUNCTION: shard_query
+ * ======================
+ * Runs a filter on every shard in parallel and merges the matches
+ *
+ * Parameters:
+ *   - filter: Returns non-zero for records to keep (NULL keeps all)
+ *   - results: Receives a malloc'd array sorted by student_id; free it
+ *
+ * Returns:
+ *   - Number of matches, or -1 on error
+ */
+int shard_query(shard_engine_t *engine, shard_filter_fn filter, void *arg, student_t **results) {
+    shard_request_t reqs[SHARD_MAX];
+    completion_t completion;
+
+    completion_init(&completion, engine->shard_count);
+    for (int i = 0; i < engine->shard_count; i++) {
+        reqs[i] = (shard_request_t){ .op = SHARD_OP_QUERY, .filter = filter, .filter_arg = arg };
+        submit(&engine->shards[i], &reqs[i], &completion);
+    }
+    completion_wait(&completion);
+
+    int total = 0;
+    int failed = 0;
+    for (int i = 0; i < engine->shard_count; i++) {
+        failed |= reqs[i].status != 0;
+        total += reqs[i].result_count;
+    }
+
+    student_t *merged = failed ? NULL : malloc((size_t)(total ? total : 1) * sizeof(student_t));
+    int count = 0;
+    for (int i = 0; i < engine->shard_count; i++) {
+        if (merged) {
+            memcpy(merged + count, reqs[i].results, (size_t)reqs[i].result_count * sizeof(student_t));
+            count += reqs[i].result_count;
+        }
+        mem_free(reqs[i].results);
+    }
+    if (!merged) {
+        return -1;
+    }
+    qsort(merged, (size_t)count, sizeof(student_t), compare_by_id);
+    *results = merged;
+    return count;
+}
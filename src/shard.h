@@ -0,0 +1,113 @@
+/*
+ * ============================================================================
+ * SHARDED STUDENT ENGINE
+ * ============================================================================
+ *
+ * Partitions students across N shards so ID allocation and the cached
+ * copies of records never contend on a global lock, and the global ID
+ * counter is only touched once per block of IDs.
+ *
+ * ID partitioning:
+ *   Shard i owns every ID with (id - 1) % N == i. Its k-th student gets
+ *   ID k * N + i + 1, so routing is a modulo and each shard issues IDs
+ *   from its own counter file (data/shard_<i>_next.txt).
+ *
+ *   Shards only issue IDs the global counter (data/next_id.txt) has
+ *   handed to the engine through record_reserve_ids, the allocator
+ *   studentdb_create_many and the importer use, so they never collide.
+ *   The engine takes SHARD_ID_BLOCK IDs per shard at a time; a shard
+ *   whose next ID lies outside the current block skips to its first ID
+ *   inside it.
+ *
+ * Ownership:
+ *   Each shard has one worker thread (pinned to a core when possible)
+ *   that is the only code touching the shard's cache and indexes.
+ *   Callers post requests to the shard's queue and wait for the reply.
+ *   Queries fan out to every shard and the per-shard results are merged
+ *   in ID order.
+ *
+ * Writes go through the record layer (record_save, and record_save_many
+ * for a new ID), so they land in the selected store, the change log and
+ * the commit hooks like every other write. Records created outside the
+ * engine are loaded into the owning shard's cache on first use.
+ * studentdb routes its creates, reads and edits through the engine when
+ * data/shards.txt exists (see studentdb_use_shards).
+ *
+ * The shard count is stored in data/shards.txt on first open. Opening an
+ * existing single-counter store adopts its records: each record stays at
+ * its ID and the shard counters start past data/next_id.txt.
+ *
+ * ============================================================================
+ */
+
+#ifndef SHARD_H
+#define SHARD_H
+
+#include <pthread.h>
+#include "student.h"
+#include "record.h"
+
+#define SHARD_MAX 64
+#define SHARD_CONFIG_PATH "data/shards.txt"
+#define SHARD_COUNTER_PATH "data/next_id.txt"
+#define SHARD_ID_BLOCK 64        // IDs per shard reserved from the global counter at a time
+
+typedef int (*shard_filter_fn)(const student_t *student, void *arg);
+
+struct shard_request;
+
+// The block of global IDs [start, end) the engine last reserved
+typedef struct {
+    pthread_mutex_t lock;
+    int start;
+    int end;
+} shard_ids_t;
+
+/*
+ * Shard
+ * =====
+ * State owned by a single worker thread. Only queue_lock is shared.
+ */
+typedef struct {
+    int index;
+    int shard_count;
+    pthread_t worker;
+    int cpu;
+
+    // Request queue (the only state other threads touch)
+    pthread_mutex_t queue_lock;
+    pthread_cond_t queue_ready;
+    struct shard_request *queue_head;
+    struct shard_request *queue_tail;
+    int stop;
+
+    // Owned by the worker
+    int next_seq;            // local sequence of the next student
+    int limit_seq;           // first sequence past the reserved block
+    shard_ids_t *ids;
+    student_t *cache;        // cache[seq], student_id == 0 if absent
+    int cache_capacity;
+    int *sid_slots;          // STUDENT_ID hash index: seq + 1, 0 = empty
+    int sid_capacity;
+    int record_count;
+    char counter_path[64];
+} shard_t;
+
+typedef struct {
+    int shard_count;
+    unsigned next_shard;     // round-robin cursor for shard_add
+    shard_ids_t ids;
+    shard_t shards[SHARD_MAX];
+} shard_engine_t;
+
+int shard_engine_open(shard_engine_t *engine, int shard_count);
+void shard_engine_close(shard_engine_t *engine);
+
+int shard_of(const shard_engine_t *engine, int id);
+int shard_add(shard_engine_t *engine, student_t *student);
+int shard_get(shard_engine_t *engine, int id, student_t *student);
+int shard_find_studentid(shard_engine_t *engine, const char *studentid, student_t *student);
+int shard_update(shard_engine_t *engine, int id, field_t field, const char *value);
+int shard_query(shard_engine_t *engine, shard_filter_fn filter, void *arg, student_t **results);
+
+#endif
@@ -0,0 +1,747 @@
+/*
+ * ============================================================================
+ * PERSISTENT ROSTER SNAPSHOT (data/snapshot.bin)
+ * ============================================================================
+ *
+ * See snapshot.h for the file layout.
+ *
+ * ============================================================================
+ */
+
+#define _GNU_SOURCE  // qsort_r
+
+#include "snapshot.h"
+#include "record.h"
+#include "mem.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+/*
+ * String Table
+ * ============
+ * Collects the long names of a snapshot while records are packed
+ */
+typedef struct {
+    char *data;
+    size_t size;
+    size_t capacity;
+} strtab_t;
+
+static int pack_str(const str_t *value, snap_str_t *out, strtab_t *strings) {
+    memset(out, 0, sizeof(*out));
+    if (!str_is_heap(value)) {
+        memcpy(out->small, value->small, sizeof(out->small));
+        return 0;
+    }
+
+    size_t length = value->heap.length;
+    if (strings->size + length + 1 > strings->capacity) {
+        size_t capacity = strings->capacity ? strings->capacity * 2 : 4096;
+        while (capacity < strings->size + length + 1) {
+            capacity *= 2;
+        }
+        char *grown = mem_realloc(MEM_STRINGS, strings->data, capacity);
+        if (!grown) {
+            return -1;
+        }
+        strings->data = grown;
+        strings->capacity = capacity;
+    }
+    memcpy(strings->data + strings->size, value->heap.ptr, length + 1);
+    out->far.offset = (uint32_t)strings->size;
+    out->far.length = (uint32_t)length;
+    out->small[15] = STR_HEAP_TAG;
+    strings->size += length + 1;
+    return 0;
+}
+
+static int unpack_str(const snap_str_t *packed, const char *strings, str_t *out) {
+    if (packed->small[15] != STR_HEAP_TAG) {
+        memcpy(out->small, packed->small, sizeof(out->small));
+        return 0;
+    }
+    // Interned, so the value outlives the mapping and compares by pointer
+    return str_set_n(out, strings + packed->far.offset, packed->far.length);
+}
+
+/*
+ * Converts student_t to the packed on-disk record, adding long names to
+ * strings. Returns -1 if the string table could not grow.
+ */
+static int pack_record(const student_t *student, snap_record_t *record, strtab_t *strings) {
+    const subject_t *subjects[] = { &student->subject1, &student->subject2,
+                                    &student->subject3, &student->subject4 };
+    int ok = 1;
+    memset(record, 0, sizeof(*record));
+    record->student_id = student->student_id;
+    record->grade = student->grade;
+    ok &= pack_str(&student->name, &record->name, strings) == 0;
+    ok &= pack_str(&student->family_name, &record->family_name, strings) == 0;
+    memcpy(record->studentid, student->studentid, sizeof(record->studentid));
+    memcpy(record->dateofbirth, student->dateofbirth, sizeof(record->dateofbirth));
+    ok &= pack_str(&student->father_name, &record->father_name, strings) == 0;
+    ok &= pack_str(&student->mother_name, &record->mother_name, strings) == 0;
+    memcpy(record->phone_number, student->phone_number, sizeof(record->phone_number));
+    for (int i = 0; i < 4; i++) {
+        ok &= pack_str(&subjects[i]->name, &record->subject_names[i], strings) == 0;
+        record->subject_grades[i] = subjects[i]->grade;
+    }
+    record->average_grade = student->average_grade;
+    return ok ? 0 : -1;
+}
+
+/*
+ * FUNCTION: snapshot_unpack
+ * ==========================
+ * Converts a packed record of an open snapshot back to student_t
+ *
+ * Returns:
+ *   - 0 on success, -1 with errno ENOMEM if a long name could not be
+ *     interned
+ */
+int snapshot_unpack(const snapshot_t *snap, const snap_record_t *record, student_t *student) {
+    subject_t *subjects[] = { &student->subject1, &student->subject2,
+                              &student->subject3, &student->subject4 };
+    int failed = 0;
+    memset(student, 0, sizeof(*student));
+    student->student_id = record->student_id;
+    student->grade = record->grade;
+    failed |= unpack_str(&record->name, snap->strings, &student->name);
+    failed |= unpack_str(&record->family_name, snap->strings, &student->family_name);
+    memcpy(student->studentid, record->studentid, sizeof(student->studentid));
+    memcpy(student->dateofbirth, record->dateofbirth, sizeof(student->dateofbirth));
+    failed |= unpack_str(&record->father_name, snap->strings, &student->father_name);
+    failed |= unpack_str(&record->mother_name, snap->strings, &student->mother_name);
+    memcpy(student->phone_number, record->phone_number, sizeof(student->phone_number));
+    for (int i = 0; i < 4; i++) {
+        failed |= unpack_str(&record->subject_names[i], snap->strings, &subjects[i]->name);
+        subjects[i]->grade = record->subject_grades[i];
+    }
+    student->average_grade = record->average_grade;
+    return failed ? -1 : 0;
+}
+
+static uint32_t hash_studentid(const char *s, size_t max) {
+    // FNV-1a
+    uint32_t h = 2166136261u;
+    for (size_t i = 0; i < max && s[i]; i++) {
+        h ^= (unsigned char)s[i];
+        h *= 16777619u;
+    }
+    return h;
+}
+
+static uint64_t align8(uint64_t n) {
+    return (n + 7) & ~(uint64_t)7;
+}
+
+static int compare_by_class(const void *a, const void *b, void *arg) {
+    const snap_record_t *records = arg;
+    const snap_record_t *ra = &records[*(const uint32_t *)a];
+    const snap_record_t *rb = &records[*(const uint32_t *)b];
+    if (ra->grade != rb->grade) {
+        return ra->grade < rb->grade ? -1 : 1;
+    }
+    return (ra->student_id > rb->student_id) - (ra->student_id < rb->student_id);
+}
+
+static int write_section(FILE *file, uint64_t offset, const void *data, size_t size) {
+    if (fseek(file, (long)offset, SEEK_SET) != 0) {
+        return -1;
+    }
+    return size == 0 || fwrite(data, size, 1, file) == 1 ? 0 : -1;
+}
+
+/*
+ * Writes packed records (sorted by student_id), their indexes and the
+ * string table to [path] through [path].tmp. Returns the record count or -1.
+ */
+static int write_packed(const char *path, const snap_record_t *records, size_t count,
+                        const strtab_t *strings, uint64_t log_offset) {
+    // Hash index on the official STUDENT_ID (slot = record index + 1, 0 = empty)
+    uint32_t sid_capacity = 16;
+    while (sid_capacity < count * 2) {
+        sid_capacity *= 2;
+    }
+    uint32_t *sid_slots = mem_calloc(MEM_INDEXES, sid_capacity, sizeof(uint32_t));
+
+    // Class-level index: record indexes grouped by grade
+    uint32_t *members = mem_malloc(MEM_INDEXES, (count ? count : 1) * sizeof(uint32_t));
+    snap_class_t *classes = mem_malloc(MEM_INDEXES, (count ? count : 1) * sizeof(snap_class_t));
+    if (!sid_slots || !members || !classes) {
+        mem_free(sid_slots);
+        mem_free(members);
+        mem_free(classes);
+        return -1;
+    }
+
+    for (uint32_t i = 0; i < count; i++) {
+        uint32_t slot = hash_studentid(records[i].studentid, sizeof(records[i].studentid)) & (sid_capacity - 1);
+        while (sid_slots[slot] != 0) {
+            slot = (slot + 1) & (sid_capacity - 1);
+        }
+        sid_slots[slot] = i + 1;
+        members[i] = i;
+    }
+
+    qsort_r(members, count, sizeof(uint32_t), compare_by_class, (void *)records);
+    uint32_t class_count = 0;
+    for (uint32_t i = 0; i < count; i++) {
+        int grade = records[members[i]].grade;
+        if (class_count == 0 || classes[class_count - 1].grade != grade) {
+            classes[class_count].grade = grade;
+            classes[class_count].start = i;
+            classes[class_count].count = 0;
+            class_count++;
+        }
+        classes[class_count - 1].count++;
+    }
+
+    snap_header_t header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, SNAPSHOT_MAGIC, sizeof(header.magic));
+    header.format_version = SNAPSHOT_FORMAT_VERSION;
+    header.record_size = sizeof(snap_record_t);
+    header.record_count = (uint32_t)count;
+    header.sid_capacity = sid_capacity;
+    header.class_count = class_count;
+    header.log_offset = log_offset;
+    header.records_offset = align8(sizeof(header));
+    header.sid_offset = align8(header.records_offset + count * sizeof(snap_record_t));
+    header.classes_offset = align8(header.sid_offset + sid_capacity * sizeof(uint32_t));
+    header.members_offset = align8(header.classes_offset + class_count * sizeof(snap_class_t));
+    header.strings_offset = header.members_offset + count * sizeof(uint32_t);
+    header.strings_size = strings->size;
+    header.file_size = header.strings_offset + strings->size;
+
+    char tempname[512];
+    snprintf(tempname, sizeof(tempname), "%s.tmp", path);
+    FILE *file = fopen(tempname, "wb");
+    int ok = file != NULL;
+    if (ok) {
+        ok = write_section(file, 0, &header, sizeof(header)) == 0 &&
+             write_section(file, header.records_offset, records, count * sizeof(snap_record_t)) == 0 &&
+             write_section(file, header.sid_offset, sid_slots, sid_capacity * sizeof(uint32_t)) == 0 &&
+             write_section(file, header.classes_offset, classes, class_count * sizeof(snap_class_t)) == 0 &&
+             write_section(file, header.members_offset, members, count * sizeof(uint32_t)) == 0 &&
+             write_section(file, header.strings_offset, strings->data, strings->size) == 0;
+        if (fclose(file) != 0) {
+            ok = 0;
+        }
+    }
+
+    mem_free(sid_slots);
+    mem_free(members);
+    mem_free(classes);
+
+    if (!ok || rename(tempname, path) != 0) {
+        remove(tempname);
+        return -1;
+    }
+    return (int)count;
+}
+
+static int snapshot_write_at(const char *path, const student_t *students, size_t count, uint64_t log_offset) {
+    strtab_t strings = { NULL, 0, 0 };
+    snap_record_t *records = mem_malloc(MEM_RECORDS, (count ? count : 1) * sizeof(*records));
+    int ok = records != NULL;
+    for (size_t i = 0; ok && i < count; i++) {
+        ok = pack_record(&students[i], &records[i], &strings) == 0;
+    }
+    int result = ok ? write_packed(path, records, count, &strings, log_offset) : -1;
+    mem_free(records);
+    mem_free(strings.data);
+    return result;
+}
+
+typedef struct {
+    student_t *students;
+    size_t count;
+    size_t capacity;
+    int failed;
+} build_scan_t;
+
+static void collect_student(const student_t *student, void *arg) {
+    build_scan_t *scan = arg;
+    if (scan->failed) {
+        return;
+    }
+    if (scan->count == scan->capacity) {
+        size_t capacity = scan->capacity ? scan->capacity * 2 : 1024;
+        student_t *grown = mem_realloc(MEM_RECORDS, scan->students, capacity * sizeof(student_t));
+        if (!grown) {
+            scan->failed = 1;
+            return;
+        }
+        scan->students = grown;
+        scan->capacity = capacity;
+    }
+    scan->students[scan->count++] = *student;
+}
+
+/*
+ * FUNCTION: snapshot_build
+ * =========================
+ * Reads records [first_id, last_id] from the selected store (record_scan,
+ * so text, B+tree or LSM) and writes a snapshot file
+ * The file is written to [path].tmp and renamed into place.
+ *
+ * Returns:
+ *   - Number of records in the snapshot, or -1 on error
+ */
+int snapshot_build(const char *path, int first_id, int last_id) {
+    // Log position is taken first: anything saved while we scan is replayed later
+    uint64_t log_offset = (uint64_t)record_log_size();
+
+    build_scan_t scan = { NULL, 0, 0, 0 };
+    if (record_scan(first_id, last_id, collect_student, &scan) < 0 || scan.failed) {
+        mem_free(scan.students);
+        return -1;
+    }
+    // The scan visits IDs in ascending order
+    int result = snapshot_write_at(path, scan.students, scan.count, log_offset);
+    mem_free(scan.students);
+    return result;
+}
+
+/*
+ * FUNCTION: snapshot_write
+ * =========================
+ * Writes a snapshot from records already in memory
+ * students must be sorted by student_id. The change-log position is
+ * taken at the time of the call.
+ *
+ * Returns:
+ *   - Number of records written, or -1 on error
+ */
+int snapshot_write(const char *path, const student_t *students, size_t count) {
+    return snapshot_write_at(path, students, count, (uint64_t)record_log_size());
+}
+
+static int compare_ints(const void *a, const void *b) {
+    int x = *(const int *)a;
+    int y = *(const int *)b;
+    return (x > y) - (x < y);
+}
+
+/*
+ * Replays change-log entries written after the snapshot into snap->overlay
+ * Returns -1 if the log is shorter than the snapshot expects (it was reset).
+ */
+static int replay_changes(snapshot_t *snap) {
+    FILE *log = fopen(RECORD_CHANGE_LOG, "r");
+    if (!log) {
+        return snap->header->log_offset == 0 ? 0 : -1;
+    }
+    fseek(log, 0, SEEK_END);
+    long size = ftell(log);
+    if (size < 0 || (uint64_t)size < snap->header->log_offset) {
+        fclose(log);
+        return -1;
+    }
+    fseek(log, (long)snap->header->log_offset, SEEK_SET);
+
+    int count = 0;
+    int capacity = 16;
+    int *ids = mem_malloc(MEM_LOGS, capacity * sizeof(int));
+    int id;
+    while (ids && fscanf(log, "%d", &id) == 1) {
+        if (count == capacity) {
+            capacity *= 2;
+            int *grown = mem_realloc(MEM_LOGS, ids, capacity * sizeof(int));
+            if (!grown) {
+                break;
+            }
+            ids = grown;
+        }
+        ids[count++] = id;
+    }
+    fclose(log);
+    if (!ids) {
+        return -1;
+    }
+
+    qsort(ids, count, sizeof(int), compare_ints);
+    snap->overlay = mem_malloc(MEM_RECORDS, (count ? count : 1) * sizeof(student_t));
+    snap->overlay_removed = mem_calloc(MEM_RECORDS, count ? count : 1, 1);
+    if (!snap->overlay || !snap->overlay_removed) {
+        mem_free(ids);
+        return -1;
+    }
+    for (int i = 0; i < count; i++) {
+        if (i > 0 && ids[i] == ids[i - 1]) {
+            continue;
+        }
+        student_t *student = &snap->overlay[snap->overlay_count];
+        if (record_load(ids[i], student) != 0) {
+            // Deleted or unreadable: a tombstone hides the packed copy
+            memset(student, 0, sizeof(*student));
+            snap->overlay_removed[snap->overlay_count] = 1;
+        }
+        student->student_id = ids[i];
+        snap->overlay_count++;
+    }
+    mem_free(ids);
+    return 0;
+}
+
+/*
+ * Maps the snapshot according to flags. Huge-page modes copy the file into
+ * anonymous memory, since MAP_HUGETLB cannot back a regular file and THP
+ * for file mappings depends on the filesystem.
+ */
+static int map_file(snapshot_t *snap, int fd, size_t size, int flags) {
+    int populate = (flags & SNAPSHOT_MAP_POPULATE) ? MAP_POPULATE : 0;
+
+    if (!(flags & (SNAPSHOT_MAP_HUGETLB | SNAPSHOT_MAP_THP))) {
+        void *map = mmap(NULL, size, PROT_READ, MAP_PRIVATE | populate, fd, 0);
+        if (map == MAP_FAILED) {
+            return -1;
+        }
+        snap->map = map;
+        snap->map_size = size;
+        return 0;
+    }
+
+    void *map = MAP_FAILED;
+    size_t length = size;
+    if (flags & SNAPSHOT_MAP_HUGETLB) {
+        length = (size + SNAPSHOT_HUGE_PAGE_SIZE - 1) & ~(size_t)(SNAPSHOT_HUGE_PAGE_SIZE - 1);
+        map = mmap(NULL, length, PROT_READ | PROT_WRITE,
+                   MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB | populate, -1, 0);
+        if (map != MAP_FAILED) {
+            snap->huge_pages = SNAPSHOT_PAGES_HUGETLB;
+        }
+    }
+    if (map == MAP_FAILED) {
+        // No reserved huge pages: fall back to transparent huge pages
+        length = size;
+        map = mmap(NULL, length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (map == MAP_FAILED) {
+            return -1;
+        }
+        if (madvise(map, length, MADV_HUGEPAGE) == 0) {
+            snap->huge_pages = SNAPSHOT_PAGES_THP;
+        }
+    }
+
+    size_t done = 0;
+    while (done < size) {
+        ssize_t n = pread(fd, (char *)map + done, size - done, (off_t)done);
+        if (n <= 0) {
+            munmap(map, length);
+            snap->huge_pages = SNAPSHOT_PAGES_NORMAL;
+            return -1;
+        }
+        done += (size_t)n;
+    }
+    mprotect(map, length, PROT_READ);
+    snap->map = map;
+    snap->map_size = length;
+    return 0;
+}
+
+/*
+ * Charges the mapped sections to their subsystems (sign +1 at open,
+ * -1 at close)
+ */
+static void account_mapping(const snapshot_t *snap, long sign) {
+    const snap_header_t *h = snap->header;
+    mem_mapped(MEM_RECORDS, sign * (long)(h->sid_offset - h->records_offset));
+    mem_mapped(MEM_INDEXES, sign * (long)(h->strings_offset - h->sid_offset));
+    mem_mapped(MEM_STRINGS, sign * (long)h->strings_size);
+}
+
+/*
+ * FUNCTION: snapshot_open
+ * ========================
+ * Maps a snapshot file and replays changes made since it was built
+ *
+ * Returns:
+ *   - 0 on success
+ *   - -1 if the file is missing, malformed, or older than the change log
+ *     (rebuild it with snapshot_build)
+ */
+int snapshot_open(snapshot_t *snap, const char *path) {
+    return snapshot_open_with(snap, path, SNAPSHOT_MAP_DEFAULT);
+}
+
+/*
+ * FUNCTION: snapshot_open_with
+ * =============================
+ * snapshot_open with SNAPSHOT_MAP_* flags for page size and access hints
+ */
+int snapshot_open_with(snapshot_t *snap, const char *path, int flags) {
+    memset(snap, 0, sizeof(*snap));
+    snap->map_flags = flags;
+
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        return -1;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(snap_header_t) ||
+        map_file(snap, fd, (size_t)st.st_size, flags) != 0) {
+        close(fd);
+        return -1;
+    }
+    close(fd);
+    void *map = snap->map;
+
+    const snap_header_t *h = map;
+    if (memcmp(h->magic, SNAPSHOT_MAGIC, sizeof(h->magic)) != 0 ||
+        h->format_version != SNAPSHOT_FORMAT_VERSION ||
+        h->record_size != sizeof(snap_record_t) ||
+        h->file_size != (uint64_t)st.st_size ||
+        (h->sid_capacity & (h->sid_capacity - 1)) != 0 ||
+        h->records_offset + (uint64_t)h->record_count * sizeof(snap_record_t) > h->file_size ||
+        h->sid_offset + (uint64_t)h->sid_capacity * sizeof(uint32_t) > h->file_size ||
+        h->classes_offset + (uint64_t)h->class_count * sizeof(snap_class_t) > h->file_size ||
+        h->members_offset + (uint64_t)h->record_count * sizeof(uint32_t) > h->file_size ||
+        h->strings_offset + h->strings_size > h->file_size ||
+        (h->strings_size > 0 && ((const char *)map)[h->strings_offset + h->strings_size - 1] != '\0')) {
+        snapshot_close(snap);
+        return -1;
+    }
+
+    const char *base = map;
+    snap->header = h;
+    snap->records = (const snap_record_t *)(base + h->records_offset);
+    snap->sid_slots = (const uint32_t *)(base + h->sid_offset);
+    snap->classes = (const snap_class_t *)(base + h->classes_offset);
+    snap->class_members = (const uint32_t *)(base + h->members_offset);
+    snap->strings = base + h->strings_offset;
+    account_mapping(snap, 1);
+
+    if (replay_changes(snap) != 0) {
+        snapshot_close(snap);
+        return -1;
+    }
+    if (flags & SNAPSHOT_MAP_ADVISE) {
+        snapshot_advise(snap, SNAPSHOT_ACCESS_RANDOM);
+    }
+    return 0;
+}
+
+/*
+ * FUNCTION: snapshot_advise
+ * ==========================
+ * Passes an access-pattern hint for the whole mapping to the kernel
+ * SEQUENTIAL enlarges readahead for scans; RANDOM disables it so point
+ * lookups fault in single pages.
+ *
+ * Returns:
+ *   - 0 on success, -1 if madvise failed
+ */
+int snapshot_advise(const snapshot_t *snap, snapshot_access_t access) {
+    int advice = MADV_NORMAL;
+    if (access == SNAPSHOT_ACCESS_SEQUENTIAL) {
+        advice = MADV_SEQUENTIAL;
+    } else if (access == SNAPSHOT_ACCESS_RANDOM) {
+        advice = MADV_RANDOM;
+    }
+    return madvise(snap->map, snap->map_size, advice) == 0 ? 0 : -1;
+}
+
+/*
+ * FUNCTION: snapshot_close
+ * =========================
+ * Unmaps the snapshot and frees the overlay
+ */
+void snapshot_close(snapshot_t *snap) {
+    if (snap->header) {
+        account_mapping(snap, -1);
+    }
+    if (snap->map) {
+        munmap(snap->map, snap->map_size);
+    }
+    mem_free(snap->overlay);
+    mem_free(snap->overlay_removed);
+    memset(snap, 0, sizeof(*snap));
+}
+
+// Index of id in the overlay (a changed record or a tombstone), or -1
+static int overlay_find(const snapshot_t *snap, int id) {
+    int lo = 0;
+    int hi = snap->overlay_count - 1;
+    while (lo <= hi) {
+        int mid = lo + (hi - lo) / 2;
+        int mid_id = snap->overlay[mid].student_id;
+        if (mid_id == id) {
+            return mid;
+        }
+        if (mid_id < id) {
+            lo = mid + 1;
+        } else {
+            hi = mid - 1;
+        }
+    }
+    return -1;
+}
+
+/*
+ * FUNCTION: snapshot_get
+ * =======================
+ * Point lookup by system ID (overlay first, then binary search)
+ *
+ * Returns:
+ *   - 0 if found, -1 otherwise (errno ENOMEM if it was found but its
+ *     names could not be interned)
+ */
+int snapshot_get(const snapshot_t *snap, int id, student_t *student) {
+    int changed = overlay_find(snap, id);
+    if (changed >= 0) {
+        if (snap->overlay_removed[changed]) {
+            return -1;
+        }
+        *student = snap->overlay[changed];
+        return 0;
+    }
+
+    uint32_t lo = 0;
+    uint32_t hi = snap->header->record_count;
+    while (lo < hi) {
+        uint32_t mid = lo + (hi - lo) / 2;
+        if (snap->records[mid].student_id < id) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    if (lo < snap->header->record_count && snap->records[lo].student_id == id) {
+        return snapshot_unpack(snap, &snap->records[lo], student);
+    }
+    return -1;
+}
+
+/*
+ * FUNCTION: snapshot_find_studentid
+ * ==================================
+ * Lookup by official STUDENT_ID through the hash index
+ *
+ * Returns:
+ *   - 0 if found, -1 otherwise (errno ENOMEM if it was found but its
+ *     names could not be interned)
+ */
+int snapshot_find_studentid(const snapshot_t *snap, const char *studentid, student_t *student) {
+    for (int i = 0; i < snap->overlay_count; i++) {
+        if (!snap->overlay_removed[i] && strcmp(snap->overlay[i].studentid, studentid) == 0) {
+            *student = snap->overlay[i];
+            return 0;
+        }
+    }
+
+    uint32_t mask = snap->header->sid_capacity - 1;
+    uint32_t slot = hash_studentid(studentid, sizeof(snap->records[0].studentid)) & mask;
+    while (snap->sid_slots[slot] != 0) {
+        const snap_record_t *record = &snap->records[snap->sid_slots[slot] - 1];
+        if (strncmp(record->studentid, studentid, sizeof(record->studentid)) == 0 &&
+            overlay_find(snap, record->student_id) < 0) {
+            return snapshot_unpack(snap, record, student);
+        }
+        slot = (slot + 1) & mask;
+    }
+    return -1;
+}
+
+/*
+ * FUNCTION: snapshot_scan
+ * ========================
+ * Visits every record in student_id order, merging in the overlay
+ *
+ * Returns:
+ *   - Number of records visited, or -1 with errno ENOMEM if a record's
+ *     names could not be interned (the scan stops there)
+ */
+int snapshot_scan(const snapshot_t *snap, snapshot_visit_fn visit, void *arg) {
+    uint32_t r = 0;
+    int o = 0;
+    int visited = 0;
+    student_t student;
+
+    if (snap->map_flags & SNAPSHOT_MAP_ADVISE) {
+        snapshot_advise(snap, SNAPSHOT_ACCESS_SEQUENTIAL);
+    }
+
+    while (r < snap->header->record_count || o < snap->overlay_count) {
+        int take_overlay = o < snap->overlay_count &&
+            (r >= snap->header->record_count ||
+             snap->overlay[o].student_id <= snap->records[r].student_id);
+        if (take_overlay) {
+            if (r < snap->header->record_count &&
+                snap->records[r].student_id == snap->overlay[o].student_id) {
+                r++;  // superseded by the overlay copy or tombstone
+            }
+            if (snap->overlay_removed[o]) {
+                o++;
+                continue;
+            }
+            visit(&snap->overlay[o++], arg);
+        } else {
+            if (snapshot_unpack(snap, &snap->records[r++], &student) != 0) {
+                visited = -1;
+                break;
+            }
+            visit(&student, arg);
+        }
+        visited++;
+    }
+
+    if (snap->map_flags & SNAPSHOT_MAP_ADVISE) {
+        snapshot_advise(snap, SNAPSHOT_ACCESS_RANDOM);
+    }
+    return visited;
+}
+
+/*
+ * FUNCTION: snapshot_scan_class
+ * ==============================
+ * Visits every record in one class level (GRADE) using the class index
+ *
+ * Returns:
+ *   - Number of records visited, or -1 with errno ENOMEM if a record's
+ *     names could not be interned (the scan stops there)
+ */
+int snapshot_scan_class(const snapshot_t *snap, int grade, snapshot_visit_fn visit, void *arg) {
+    int visited = 0;
+    student_t student;
+
+    uint32_t lo = 0;
+    uint32_t hi = snap->header->class_count;
+    while (lo < hi) {
+        uint32_t mid = lo + (hi - lo) / 2;
+        if (snap->classes[mid].grade < grade) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    if (lo < snap->header->class_count && snap->classes[lo].grade == grade) {
+        const snap_class_t *cls = &snap->classes[lo];
+        for (uint32_t i = 0; i < cls->count; i++) {
+            const snap_record_t *record = &snap->records[snap->class_members[cls->start + i]];
+            if (overlay_find(snap, record->student_id) >= 0) {
+                continue;
+            }
+            if (snapshot_unpack(snap, record, &student) != 0) {
+                return -1;
+            }
+            visit(&student, arg);
+            visited++;
+        }
+    }
+
+    for (int i = 0; i < snap->overlay_count; i++) {
+        if (!snap->overlay_removed[i] && snap->overlay[i].grade == grade) {
+            visit(&snap->overlay[i], arg);
+            visited++;
+        }
+    }
+    return visited;
+}
@@ -0,0 +1,161 @@
+/*
+ * ============================================================================
+ * PERSISTENT ROSTER SNAPSHOT (data/snapshot.bin)
+ * ============================================================================
+ *
+ * A snapshot is a single file holding every record in packed binary form
+ * together with the lookup indexes, laid out so it can be mmapped and used
+ * without parsing:
+ *
+ *     snap_header_t
+ *     snap_record_t   records[record_count]        (sorted by student_id)
+ *     uint32_t        sid_slots[sid_capacity]       (hash on STUDENT_ID)
+ *     snap_class_t    classes[class_count]          (sorted by grade)
+ *     uint32_t        class_members[record_count]
+ *     char            strings[strings_size]         (long names, NUL-terminated)
+ *
+ * Every reference inside the file is an offset or an array index, never
+ * a pointer, so the mapping works at any address.
+ *
+ * The header records how long the change log (data/changes.log) was when
+ * the snapshot was built. Opening a snapshot replays the IDs logged after
+ * that point by loading those records from the selected store (record.h)
+ * into a small overlay, so the view is current without rebuilding. A
+ * logged ID that no longer loads (deleted, or failing its checksum) is
+ * kept in the overlay as a tombstone and hides the packed copy.
+ *
+ * ============================================================================
+ */
+
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "student.h"
+
+#define SNAPSHOT_PATH "data/snapshot.bin"
+#define SNAPSHOT_MAGIC "SDBSNAP1"
+#define SNAPSHOT_FORMAT_VERSION 2
+
+/*
+ * Map Options (snapshot_open_with)
+ * ================================
+ *   - HUGETLB: copy into explicit 2 MB pages (needs vm.nr_hugepages),
+ *              falling back to THP when none are reserved
+ *   - THP: copy into anonymous memory advised MADV_HUGEPAGE
+ *   - ADVISE: MADV_RANDOM for lookups, MADV_SEQUENTIAL during full scans
+ *   - POPULATE: prefault the whole mapping at open (MAP_POPULATE)
+ */
+#define SNAPSHOT_MAP_DEFAULT  0x0
+#define SNAPSHOT_MAP_HUGETLB  0x1
+#define SNAPSHOT_MAP_THP      0x2
+#define SNAPSHOT_MAP_ADVISE   0x4
+#define SNAPSHOT_MAP_POPULATE 0x8
+
+#define SNAPSHOT_HUGE_PAGE_SIZE (2u * 1024 * 1024)
+
+// Page size actually obtained for the mapping
+#define SNAPSHOT_PAGES_NORMAL  0
+#define SNAPSHOT_PAGES_HUGETLB 1
+#define SNAPSHOT_PAGES_THP     2
+
+typedef enum {
+    SNAPSHOT_ACCESS_NORMAL,
+    SNAPSHOT_ACCESS_SEQUENTIAL,
+    SNAPSHOT_ACCESS_RANDOM
+} snapshot_access_t;
+
+/*
+ * Packed String
+ * =============
+ * File form of str_t: up to 15 bytes inline, otherwise small[15] is
+ * STR_HEAP_TAG and the value is at far.offset in the strings section
+ */
+typedef union {
+    char small[16];
+    struct {
+        uint32_t offset;
+        uint32_t length;
+    } far;
+} snap_str_t;
+
+/*
+ * Packed Record
+ * =============
+ * Fixed-size, pointer-free copy of student_t
+ */
+typedef struct {
+    int32_t student_id;
+    int32_t grade;
+    snap_str_t name;
+    snap_str_t family_name;
+    char studentid[15];
+    char dateofbirth[11];
+    snap_str_t father_name;
+    snap_str_t mother_name;
+    char phone_number[15];
+    snap_str_t subject_names[4];
+    float subject_grades[4];
+    float average_grade;
+} snap_record_t;
+
+typedef struct {
+    int32_t grade;
+    uint32_t start;   // first index into class_members
+    uint32_t count;
+} snap_class_t;
+
+typedef struct {
+    char magic[8];
+    uint32_t format_version;
+    uint32_t record_size;
+    uint32_t record_count;
+    uint32_t sid_capacity;     // power of two
+    uint32_t class_count;
+    uint32_t reserved;
+    uint64_t log_offset;       // change log size when the snapshot was built
+    uint64_t records_offset;
+    uint64_t sid_offset;
+    uint64_t classes_offset;
+    uint64_t members_offset;
+    uint64_t strings_offset;
+    uint64_t strings_size;
+    uint64_t file_size;
+} snap_header_t;
+
+typedef struct {
+    void *map;
+    size_t map_size;
+    int map_flags;
+    int huge_pages;
+    const snap_header_t *header;
+    const snap_record_t *records;
+    const uint32_t *sid_slots;
+    const snap_class_t *classes;
+    const uint32_t *class_members;
+    const char *strings;
+
+    // Records changed since the snapshot was built, sorted by student_id
+    student_t *overlay;
+    unsigned char *overlay_removed;   // 1 for a tombstone (ID no longer loads)
+    int overlay_count;
+} snapshot_t;
+
+typedef void (*snapshot_visit_fn)(const student_t *student, void *arg);
+
+int snapshot_build(const char *path, int first_id, int last_id);
+int snapshot_write(const char *path, const student_t *students, size_t count);
+int snapshot_open(snapshot_t *snap, const char *path);
+int snapshot_open_with(snapshot_t *snap, const char *path, int flags);
+int snapshot_advise(const snapshot_t *snap, snapshot_access_t access);
+void snapshot_close(snapshot_t *snap);
+
+int snapshot_get(const snapshot_t *snap, int id, student_t *student);
+int snapshot_find_studentid(const snapshot_t *snap, const char *studentid, student_t *student);
+int snapshot_scan(const snapshot_t *snap, snapshot_visit_fn visit, void *arg);
+int snapshot_scan_class(const snapshot_t *snap, int grade, snapshot_visit_fn visit, void *arg);
+
+int snapshot_unpack(const snapshot_t *snap, const snap_record_t *record, student_t *student);
+
+#endif
@@ -0,0 +1,268 @@
+/*
+ * ============================================================================
+ * STORAGE BACKENDS
+ * ============================================================================
+ *
+ * See store.h for the interface. The adapters below map it onto
+ * record.c, btree.c and lsm.c.
+ *
+ * ============================================================================
+ */
+
+#include "store.h"
+#include "scheduler.h"
+#include "mem.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <dirent.h>
+
+/*
+ * Text Files
+ * ==========
+ */
+// Records parsed in parallel before a text scan visits them
+#define TEXT_SCAN_CHUNK 4096
+
+static int text_put(void *handle, int id, const student_t *student) {
+    (void)handle;
+    return record_file_save(id, student);
+}
+
+static int text_put_many(void *handle, const student_t *students, int count) {
+    (void)handle;
+    return record_file_save_many(students, count);
+}
+
+static int text_get(void *handle, int id, student_t *student) {
+    (void)handle;
+    return record_file_load(id, student);
+}
+
+static int text_remove(void *handle, int id) {
+    (void)handle;
+    return record_file_delete(id);
+}
+
+static int compare_ints(const void *a, const void *b) {
+    int x = *(const int *)a;
+    int y = *(const int *)b;
+    return (x > y) - (x < y);
+}
+
+typedef struct {
+    const int *ids;
+    student_t *students;
+    char *present;
+} text_chunk_t;
+
+static void read_chunk(long begin, long end, void *arg) {
+    text_chunk_t *chunk = arg;
+    for (long i = begin; i < end; i++) {
+        chunk->present[i] = record_file_read(chunk->ids[i], &chunk->students[i]) == 0;
+    }
+}
+
+// Lists the IDs of the output_[ID].txt files in range, then parses them
+// TEXT_SCAN_CHUNK at a time on the shared pool and visits them in order.
+// Old records are upgraded in memory only: a scan never writes.
+static int text_scan(void *handle, int first_id, int last_id, store_visit_fn visit, void *arg) {
+    (void)handle;
+    DIR *dir = opendir(".");
+    if (!dir) {
+        return -1;
+    }
+    int *ids = NULL;
+    int count = 0;
+    int capacity = 0;
+    int ok = 1;
+    struct dirent *entry;
+    while (ok && (entry = readdir(dir)) != NULL) {
+        if (strncmp(entry->d_name, "output_", 7) != 0) {
+            continue;
+        }
+        char *end;
+        errno = 0;
+        long id = strtol(entry->d_name + 7, &end, 10);
+        if (errno != 0 || end == entry->d_name + 7 || strcmp(end, ".txt") != 0 ||
+            id < first_id || id > last_id) {
+            continue;
+        }
+        if (count == capacity) {
+            capacity = capacity ? capacity * 2 : 256;
+            int *grown = mem_realloc(MEM_INDEXES, ids, (size_t)capacity * sizeof(int));
+            if (!grown) {
+                ok = 0;
+                break;
+            }
+            ids = grown;
+        }
+        ids[count++] = (int)id;
+    }
+    closedir(dir);
+
+    int visited = 0;
+    if (ok && count > 0) {
+        qsort(ids, (size_t)count, sizeof(int), compare_ints);
+    }
+    text_chunk_t chunk = { ids, mem_malloc(MEM_RECORDS, TEXT_SCAN_CHUNK * sizeof(student_t)),
+                           mem_malloc(MEM_RECORDS, TEXT_SCAN_CHUNK) };
+    ok = ok && chunk.students && chunk.present;
+    sched_pool_t *pool = sched_default();
+    for (int begin = 0; ok && begin < count; begin += TEXT_SCAN_CHUNK) {
+        int end = count - begin < TEXT_SCAN_CHUNK ? count : begin + TEXT_SCAN_CHUNK;
+        chunk.ids = ids + begin;
+        if (!pool || sched_parallel_for(pool, 0, end - begin, 64, read_chunk, &chunk) != 0) {
+            read_chunk(0, end - begin, &chunk);
+        }
+        for (int i = 0; i < end - begin; i++) {
+            // A record removed since the listing is skipped
+            if (chunk.present[i]) {
+                visit(&chunk.students[i], arg);
+                visited++;
+            }
+        }
+    }
+    mem_free(chunk.students);
+    mem_free(chunk.present);
+    mem_free(ids);
+    return ok ? visited : -1;
+}
+
+const store_ops_t store_text_ops = { "text", text_put, text_put_many, text_get, text_remove, text_scan };
+
+/*
+ * B+tree
+ * ======
+ */
+static int btree_put_one(void *handle, int id, const student_t *student) {
+    return btree_store(handle, id, student);
+}
+
+static int btree_put_many(void *handle, const student_t *students, int count) {
+    btree_txn_t txn;
+    if (btree_begin(handle, &txn) != 0) {
+        return -1;
+    }
+    for (int i = 0; i < count; i++) {
+        if (btree_put(&txn, students[i].student_id, &students[i]) != 0) {
+            btree_abort(&txn);
+            return -1;
+        }
+    }
+    return btree_commit(&txn);
+}
+
+static int btree_get_one(void *handle, int id, student_t *student) {
+    return btree_load(handle, id, student);
+}
+
+static int btree_remove_one(void *handle, int id) {
+    btree_txn_t txn;
+    if (btree_begin(handle, &txn) != 0) {
+        return -1;
+    }
+    int removed = btree_delete(&txn, id);
+    if (removed <= 0) {
+        btree_abort(&txn);
+        if (removed == 0) {
+            errno = ENOENT;
+        }
+        return -1;
+    }
+    return btree_commit(&txn);
+}
+
+static int btree_scan_range(void *handle, int first_id, int last_id, store_visit_fn visit, void *arg) {
+    btree_reader_t reader;
+    if (btree_read_begin(handle, &reader) != 0) {
+        return -1;
+    }
+    int count = btree_scan(&reader, first_id, last_id, visit, arg);
+    btree_read_end(&reader);
+    return count;
+}
+
+const store_ops_t store_btree_ops = { "btree", btree_put_one, btree_put_many, btree_get_one, btree_remove_one, btree_scan_range };
+
+/*
+ * LSM
+ * ===
+ */
+static int lsm_put_one(void *handle, int id, const student_t *student) {
+    return lsm_put(handle, id, student);
+}
+
+static int lsm_put_batch(void *handle, const student_t *students, int count) {
+    return lsm_put_many(handle, students, count);
+}
+
+static int lsm_get_one(void *handle, int id, student_t *student) {
+    return lsm_get(handle, id, student);
+}
+
+static int lsm_remove_one(void *handle, int id) {
+    return lsm_delete(handle, id);
+}
+
+static int lsm_scan_range(void *handle, int first_id, int last_id, store_visit_fn visit, void *arg) {
+    return lsm_scan(handle, first_id, last_id, visit, arg);
+}
+
+const store_ops_t store_lsm_ops = { "lsm", lsm_put_one, lsm_put_batch, lsm_get_one, lsm_remove_one, lsm_scan_range };
+
+void store_text(store_t *store) {
+    store->ops = &store_text_ops;
+    store->handle = NULL;
+}
+
+void store_btree(store_t *store, btree_t *tree) {
+    store->ops = &store_btree_ops;
+    store->handle = tree;
+}
+
+void store_lsm(store_t *store, lsm_t *lsm) {
+    store->ops = &store_lsm_ops;
+    store->handle = lsm;
+}
+
+int store_put(const store_t *store, int id, const student_t *student) {
+    return store->ops->put(store->handle, id, student);
+}
+
+int store_put_many(const store_t *store, const student_t *students, int count) {
+    return store->ops->put_many(store->handle, students, count);
+}
+
+int store_get(const store_t *store, int id, student_t *student) {
+    return store->ops->get(store->handle, id, student);
+}
+
+/*
+ * FUNCTION: store_update
+ * =======================
+ * Read-modify-write of one field (see record_set_field)
+ * Not atomic against other writers of the same ID; record_update adds
+ * the locking.
+ *
+ * Returns:
+ *   - 0 on success, -1 if the record is missing, the value is not valid
+ *     for the field, or the write failed
+ */
+int store_update(const store_t *store, int id, field_t field, const char *value) {
+    student_t student;
+    if (store_get(store, id, &student) < 0 || record_set_field(&student, field, value) != 0) {
+        return -1;
+    }
+    return store_put(store, id, &student);
+}
+
+int store_delete(const store_t *store, int id) {
+    return store->ops->remove(store->handle, id);
+}
+
+int store_scan(const store_t *store, int first_id, int last_id, store_visit_fn visit, void *arg) {
+    return store->ops->scan(store->handle, first_id, last_id, visit, arg);
+}
@@ -0,0 +1,79 @@
+/*
+ * ============================================================================
+ * STORAGE BACKENDS
+ * ============================================================================
+ *
+ * One interface over the places a student record can live, so callers
+ * (record.c, the benchmark) do not care which one is in use:
+ *
+ *     text    output_<id>.txt files (record.h), the default
+ *     btree   the copy-on-write B+tree in data/students.db (btree.h)
+ *     lsm     the log-structured merge store in data/lsm/ (lsm.h)
+ *
+ * A store_t is a table of operations plus the backend's handle. The
+ * functions below are thin dispatchers; store_update is built from get
+ * and put, so a backend only supplies the five primitives.
+ *
+ * Stores do no locking of their own beyond what the backend does, write
+ * no change log and call no commit hooks; record_load/save/update add
+ * all three.
+ *
+ * ============================================================================
+ */
+
+#ifndef STORE_H
+#define STORE_H
+
+#include "student.h"
+#include "record.h"
+#include "btree.h"
+#include "lsm.h"
+
+typedef record_visit_fn store_visit_fn;
+
+/*
+ * Backend operations
+ *   put     insert or replace; 0 on success, -1 on error
+ *   put_many  put count records keyed by their student_id, paying the
+ *           backend's sync cost once (text: one record batch, B+tree:
+ *           one transaction, LSM: one WAL sync); 0 if all were stored,
+ *           -1 on error (the B+tree stores none; the others may have
+ *           stored some)
+ *   get     0 if found, 1 if found and rewritten in the current format
+ *           (text records upgraded in place), -1 if missing or on error
+ *   remove  0 on success, -1 on error (errno ENOENT if the backend can
+ *           tell the ID was absent; the LSM store cannot and returns 0)
+ *   scan    visits first_id <= ID <= last_id in ID order without
+ *           writing (text records are upgraded in memory only); returns
+ *           the number visited or -1 on error
+ */
+typedef struct {
+    const char *name;
+    int (*put)(void *handle, int id, const student_t *student);
+    int (*put_many)(void *handle, const student_t *students, int count);
+    int (*get)(void *handle, int id, student_t *student);
+    int (*remove)(void *handle, int id);
+    int (*scan)(void *handle, int first_id, int last_id, store_visit_fn visit, void *arg);
+} store_ops_t;
+
+typedef struct store {
+    const store_ops_t *ops;
+    void *handle;
+} store_t;
+
+extern const store_ops_t store_text_ops;
+extern const store_ops_t store_btree_ops;
+extern const store_ops_t store_lsm_ops;
+
+void store_text(store_t *store);
+void store_btree(store_t *store, btree_t *tree);
+void store_lsm(store_t *store, lsm_t *lsm);
+
+int store_put(const store_t *store, int id, const student_t *student);
+int store_put_many(const store_t *store, const student_t *students, int count);
+int store_get(const store_t *store, int id, student_t *student);
+int store_update(const store_t *store, int id, field_t field, const char *value);
+int store_delete(const store_t *store, int id);
+int store_scan(const store_t *store, int first_id, int last_id, store_visit_fn visit, void *arg);
+
+#endif
@@ -0,0 +1,64 @@
+/*
+ * ============================================================================
+ * COMPACT STRINGS (str_t)
+ * ============================================================================
+ *
+ * See str.h for the representation.
+ *
+ * ============================================================================
+ */
+
+#include "str.h"
+#include "intern.h"
+
+#include <string.h>
+
+/*
+ * FUNCTION: str_set_n
+ * ====================
+ * Stores length bytes of value (need not be NUL-terminated)
+ * Values longer than STR_INLINE_MAX are interned (intern.c).
+ *
+ * Returns:
+ *   - 0 on success
+ *   - -1 with errno ENOMEM if the value could not be interned; the field
+ *     keeps its old value
+ */
+int str_set_n(str_t *s, const char *value, size_t length) {
+    if (length <= STR_INLINE_MAX) {
+        memset(s, 0, sizeof(*s));
+        memcpy(s->small, value, length);
+        return 0;
+    }
+    const char *copy = intern_n(value, length);
+    if (!copy) {
+        return -1;
+    }
+    memset(s, 0, sizeof(*s));
+    s->heap.ptr = copy;
+    s->heap.length = (uint32_t)length;
+    s->small[15] = STR_HEAP_TAG;
+    return 0;
+}
+
+int str_set(str_t *s, const char *value) {
+    return str_set_n(s, value, strlen(value));
+}
+
+size_t str_len(const str_t *s) {
+    return str_is_heap(s) ? s->heap.length : strlen(s->small);
+}
+
+/*
+ * FUNCTION: str_eq
+ * =================
+ * Compares two values without looking at their characters: inline values
+ * are compared as 16 bytes, heap values are interned so equal values
+ * share a pointer, and an inline value never equals a heap one.
+ */
+int str_eq(const str_t *a, const str_t *b) {
+    if (str_is_heap(a) && str_is_heap(b)) {
+        return a->heap.ptr == b->heap.ptr;
+    }
+    return memcmp(a->small, b->small, sizeof(a->small)) == 0;
+}
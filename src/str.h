@@ -0,0 +1,58 @@
+/*
+ * ============================================================================
+ * COMPACT STRINGS (str_t)
+ * ============================================================================
+ *
+ * Variable-length text fields of student_t (names, parent names, subject
+ * names). A str_t is 16 bytes:
+ *
+ *   - up to STR_INLINE_MAX (15) bytes are stored inline, NUL-terminated,
+ *     which covers almost every real name
+ *   - longer values are interned in the shared string pool (intern.h)
+ *     and the str_t holds a pointer and length; small[15] is
+ *     STR_HEAP_TAG then
+ *
+ * Pooled strings are immutable and never freed, so a str_t can be copied
+ * by value (struct assignment, memcpy) like the char arrays it replaces.
+ * Setting a new value simply points the field somewhere else. The pool
+ * is bounded, so setting a long value can fail; str_set then returns -1
+ * and leaves the field as it was. Because
+ * they are interned, str_eq compares long values by pointer.
+ *
+ * An all-zero str_t is the empty string.
+ *
+ * ============================================================================
+ */
+
+#ifndef STR_H
+#define STR_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define STR_INLINE_MAX 15
+#define STR_HEAP_TAG ((char)0xFF)
+
+typedef union {
+    char small[16];
+    struct {
+        const char *ptr;
+        uint32_t length;
+    } heap;
+} str_t;
+
+static inline int str_is_heap(const str_t *s) {
+    return s->small[15] == STR_HEAP_TAG;
+}
+
+// NUL-terminated contents; valid until the field is set again
+static inline const char *str_get(const str_t *s) {
+    return str_is_heap(s) ? s->heap.ptr : s->small;
+}
+
+int str_set(str_t *s, const char *value);
+int str_set_n(str_t *s, const char *value, size_t length);
+size_t str_len(const str_t *s);
+int str_eq(const str_t *a, const str_t *b);
+
+#endif
@@ -0,0 +1,124 @@
+/*
+ * ============================================================================
+ * STUDENT RECORD HELPERS
+ * ============================================================================
+ */
+
+#include "student.h"
+
+#include <string.h>
+
+// Thread synchronization: Ensures only one user can edit a file at a time
+pthread_mutex_t file_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+/*
+ * FUNCTION: calculate_average
+ * ===========================
+ * Calculates the average grade across all 4 subjects
+ *
+ * Parameters:
+ *   - student: Pointer to student record to update
+ *
+ * How it works:
+ *   - Adds up all 4 subject grades
+ *   - Divides by 4 to get the average
+ *   - Stores result in student.average_grade
+ */
+void calculate_average(student_t *student) {
+    student->average_grade = (student->subject1.grade + student->subject2.grade +
+                              student->subject3.grade + student->subject4.grade) / 4.0f;
+}
+
+static void student_names(student_t *student, str_t *names[8]) {
+    names[0] = &student->name;
+    names[1] = &student->family_name;
+    names[2] = &student->father_name;
+    names[3] = &student->mother_name;
+    names[4] = &student->subject1.name;
+    names[5] = &student->subject2.name;
+    names[6] = &student->subject3.name;
+    names[7] = &student->subject4.name;
+}
+
+/*
+ * FUNCTION: student_pack
+ * =======================
+ * Serializes a student into buf (format: student_packed_t)
+ *
+ * Returns:
+ *   - Number of bytes written, or -1 if they do not fit in size
+ */
+int student_pack(const student_t *student, unsigned char *buf, size_t size) {
+    student_packed_t head;
+    if (size < sizeof(head)) {
+        return -1;
+    }
+    memset(&head, 0, sizeof(head));
+    head.student_id = student->student_id;
+    head.grade = student->grade;
+    head.subject_grades[0] = student->subject1.grade;
+    head.subject_grades[1] = student->subject2.grade;
+    head.subject_grades[2] = student->subject3.grade;
+    head.subject_grades[3] = student->subject4.grade;
+    head.average_grade = student->average_grade;
+    memcpy(head.studentid, student->studentid, sizeof(head.studentid));
+    memcpy(head.dateofbirth, student->dateofbirth, sizeof(head.dateofbirth));
+    memcpy(head.phone_number, student->phone_number, sizeof(head.phone_number));
+
+    str_t *names[8];
+    student_names((student_t *)student, names);
+    size_t length = sizeof(head);
+    for (int i = 0; i < 8; i++) {
+        size_t n = str_len(names[i]);
+        if (n > UINT16_MAX || length + n > size) {
+            return -1;
+        }
+        memcpy(buf + length, str_get(names[i]), n);
+        head.lengths[i] = (uint16_t)n;
+        length += n;
+    }
+    memcpy(buf, &head, sizeof(head));
+    return (int)length;
+}
+
+/*
+ * FUNCTION: student_unpack
+ * =========================
+ * Rebuilds a student from student_pack output
+ *
+ * Returns:
+ *   - 0 on success, -1 if the bytes are cut short or a long name could
+ *     not be interned (errno ENOMEM)
+ */
+int student_unpack(const unsigned char *buf, size_t length, student_t *student) {
+    student_packed_t head;
+    if (length < sizeof(head)) {
+        return -1;
+    }
+    memcpy(&head, buf, sizeof(head));
+    memset(student, 0, sizeof(*student));
+    student->student_id = head.student_id;
+    student->grade = head.grade;
+    student->subject1.grade = head.subject_grades[0];
+    student->subject2.grade = head.subject_grades[1];
+    student->subject3.grade = head.subject_grades[2];
+    student->subject4.grade = head.subject_grades[3];
+    student->average_grade = head.average_grade;
+    memcpy(student->studentid, head.studentid, sizeof(head.studentid) - 1);
+    memcpy(student->dateofbirth, head.dateofbirth, sizeof(head.dateofbirth) - 1);
+    memcpy(student->phone_number, head.phone_number, sizeof(head.phone_number) - 1);
+
+    str_t *names[8];
+    student_names(student, names);
+    size_t offset = sizeof(head);
+    for (int i = 0; i < 8; i++) {
+        if (offset + head.lengths[i] > length) {
+            return -1;
+        }
+        if (str_set_n(names[i], (const char *)buf + offset, head.lengths[i]) != 0) {
+            return -1;
+        }
+        offset += head.lengths[i];
+    }
+    return 0;
+}
@@ -0,0 +1,102 @@
+/*
+ * ============================================================================
+ * STUDENT RECORD TYPES
+ * ============================================================================
+ *
+ * Shared definitions for the student record and the global file lock.
+ * Every module that reads or writes student data includes this header.
+ *
+ * ============================================================================
+ */
+
+#ifndef STUDENT_H
+#define STUDENT_H
+
+#include <pthread.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "str.h"
+
+// Thread synchronization: Ensures only one user can edit a file at a time
+extern pthread_mutex_t file_mutex;
+
+/*
+ * Subject Structure
+ * ================
+ * Stores information about a single subject/course
+ * - name: Name of the subject (e.g., Mathematics, English)
+ * - grade: Numerical grade received in this subject
+ */
+typedef struct {
+    str_t name;
+    float grade;
+} subject_t;
+
+/*
+ * Student Structure
+ * =================
+ * Complete record for a single student
+ *
+ * Identification:
+ *   - student_id: Unique number assigned by system
+ *   - studentid: Official student ID (may differ from student_id)
+ *
+ * Personal Information:
+ *   - name: Full name of student
+ *   - family_name: Family name (added in schema version 2)
+ *   - dateofbirth: Date of birth (format: DD/MM/YYYY)
+ *   - father_name: Father's name
+ *   - mother_name: Mother's name
+ *   - phone_number: Contact phone number
+ *
+ * Academic Information:
+ *   - grade: Overall grade/class level
+ *   - subject1-4: Four subjects with individual grades
+ *   - average_grade: Calculated average of all 4 subject grades
+ *
+ * Names are str_t (see str.h): short values are stored inline, longer
+ * ones in the shared string heap, so nothing is truncated. The IDs, date
+ * and phone number have fixed, validated lengths and stay char arrays.
+ */
+typedef struct {
+    int student_id;
+    str_t name;
+    str_t family_name;
+    char studentid[15];
+    int grade;
+    char dateofbirth[11];
+    str_t father_name;
+    str_t mother_name;
+    char phone_number[15];
+    subject_t subject1;
+    subject_t subject2;
+    subject_t subject3;
+    subject_t subject4;
+    float average_grade;
+} student_t;
+
+/*
+ * Packed Student
+ * ==============
+ * Byte form of student_t used by the B+tree and LSM stores: this header
+ * followed by the eight names (name, family name, father, mother,
+ * subject 1-4) back to back, without terminators. Copy it out with
+ * memcpy; packed values are not aligned.
+ */
+typedef struct {
+    int32_t student_id;
+    int32_t grade;
+    float subject_grades[4];
+    float average_grade;
+    char studentid[15];
+    char dateofbirth[11];
+    char phone_number[15];
+    uint8_t reserved;
+    uint16_t lengths[8];
+} student_packed_t;
+
+void calculate_average(student_t *student);
+int student_pack(const student_t *student, unsigned char *buf, size_t size);
+int student_unpack(const unsigned char *buf, size_t length, student_t *student);
+
+#endif
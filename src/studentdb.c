@@ -0,0 +1,740 @@
+/*
+ * ============================================================================
+ * STUDENTDB LIBRARY API
+ * ============================================================================
+ *
+ * See studentdb.h. These are the operations main.c used to perform
+ * inline around its prompts, minus the prompts and printing.
+ *
+ * ============================================================================
+ */
+
+#include "studentdb.h"
+#include "validate.h"
+#include "history.h"
+#include "card.h"
+#include "snapshot.h"
+#include "report.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+// A conversion to the B+tree commits this many records per transaction
+#define BTREE_CONVERT_BATCH 4096
+
+/*
+ * FUNCTION: studentdb_open
+ * =========================
+ * Selects the store present in data/, starts the shard engine if the
+ * store is sharded and attaches the report card cache so every save
+ * drops the student's cached card
+ *
+ * Returns:
+ *   - 0 on success, -1 if the store could not be opened (errno
+ *     EWOULDBLOCK if another process has it open)
+ */
+int studentdb_open(studentdb_t *db) {
+    memset(db, 0, sizeof(*db));
+    store_text(&db->store);
+    mkdir("data", 0755);
+    if (access(BTREE_PATH, F_OK) == 0) {
+        if (btree_open(&db->tree, BTREE_PATH) != 0) {
+            return -1;
+        }
+        store_btree(&db->store, &db->tree);
+    } else if (access(LSM_DIR, F_OK) == 0) {
+        if (lsm_open(&db->lsm, LSM_DIR, NULL) != 0) {
+            return -1;
+        }
+        store_lsm(&db->store, &db->lsm);
+    }
+    record_use_store(&db->store);
+    if (access(SHARD_CONFIG_PATH, F_OK) == 0 && shard_engine_open(&db->shards, 0) != 0) {
+        studentdb_close(db);
+        return -1;
+    }
+    card_cache_attach();
+    return 0;
+}
+
+void studentdb_close(studentdb_t *db) {
+    if (db->ranked) {
+        rank_detach(&db->ranks);
+        rank_free(&db->ranks);
+        db->ranked = 0;
+    }
+    if (db->shards.shard_count > 0) {
+        shard_engine_close(&db->shards);
+    }
+    card_cache_detach();
+    record_use_store(NULL);
+    if (db->store.ops == &store_btree_ops) {
+        btree_close(&db->tree);
+    } else if (db->store.ops == &store_lsm_ops) {
+        lsm_close(&db->lsm);
+    }
+}
+
+/*
+ * FUNCTION: studentdb_use_btree / studentdb_use_lsm
+ * ==================================================
+ * Creates (or opens) the B+tree file or LSM directory and switches the
+ * text-file store over to it. Existing records are not copied.
+ *
+ * Returns:
+ *   - 0 on success, -1 if another backend is already in use or the store
+ *     could not be created
+ */
+int studentdb_use_btree(studentdb_t *db) {
+    if (db->store.ops == &store_btree_ops) {
+        return 0;
+    }
+    if (db->store.ops != &store_text_ops || btree_open(&db->tree, BTREE_PATH) != 0) {
+        return -1;
+    }
+    store_btree(&db->store, &db->tree);
+    record_use_store(&db->store);
+    return 0;
+}
+
+int studentdb_use_lsm(studentdb_t *db, const lsm_options_t *options) {
+    if (db->store.ops == &store_lsm_ops) {
+        return 0;
+    }
+    if (db->store.ops != &store_text_ops || lsm_open(&db->lsm, LSM_DIR, options) != 0) {
+        return -1;
+    }
+    store_lsm(&db->store, &db->lsm);
+    record_use_store(&db->store);
+    return 0;
+}
+
+/*
+ * FUNCTION: studentdb_use_shards
+ * ===============================
+ * Starts the shard engine and records the shard count in data/shards.txt
+ * so later opens route creates, reads and edits through it too.
+ * Existing records stay where they are.
+ *
+ * Parameters:
+ *   - shard_count: Number of shards, or 0 for one per online CPU
+ *
+ * Returns:
+ *   - 0 on success, -1 on error (errno EINVAL if the store is already
+ *     sharded with a different count, or the count is out of range)
+ */
+int studentdb_use_shards(studentdb_t *db, int shard_count) {
+    if (db->shards.shard_count > 0) {
+        if (shard_count != 0 && shard_count != db->shards.shard_count) {
+            errno = EINVAL;
+            return -1;
+        }
+        return 0;
+    }
+    return shard_engine_open(&db->shards, shard_count);
+}
+
+// Opens data/snapshot.bin, writing it first if there is none
+static int open_snapshot(snapshot_t *snap) {
+    if (snapshot_open(snap, SNAPSHOT_PATH) == 0) {
+        return 0;
+    }
+    if (snapshot_build(SNAPSHOT_PATH, 1, studentdb_next_id() - 1) < 0) {
+        return -1;
+    }
+    return snapshot_open(snap, SNAPSHOT_PATH);
+}
+
+/*
+ * FUNCTION: studentdb_attach_ranks
+ * =================================
+ * Builds the class ranking view from data/snapshot.bin (writing the
+ * snapshot first if there is none) and attaches it, so every later save
+ * or delete moves the student in it. Call before any writer thread
+ * starts; a second call does nothing.
+ *
+ * Returns:
+ *   - 0 on success, -1 if the snapshot could not be read or the view
+ *     not built
+ */
+int studentdb_attach_ranks(studentdb_t *db) {
+    if (db->ranked) {
+        return 0;
+    }
+    snapshot_t snap;
+    if (open_snapshot(&snap) != 0) {
+        return -1;
+    }
+    if (rank_init(&db->ranks) != 0) {
+        snapshot_close(&snap);
+        return -1;
+    }
+    int built = rank_build(&db->ranks, &snap) == 0 && rank_attach(&db->ranks) == 0;
+    snapshot_close(&snap);
+    if (!built) {
+        rank_free(&db->ranks);
+        return -1;
+    }
+    db->ranked = 1;
+    return 0;
+}
+
+// Copies output_1..last_id into the B+tree, BTREE_CONVERT_BATCH per transaction
+static int copy_to_btree(btree_t *tree, int last_id, int *copied) {
+    btree_txn_t txn;
+    if (btree_begin(tree, &txn) != 0) {
+        return -1;
+    }
+    for (int id = 1; id <= last_id; id++) {
+        char filename[128];
+        student_t student;
+        record_path(id, filename, sizeof(filename));
+        if (record_read(filename, &student, NULL) != 0) {
+            continue;
+        }
+        student.student_id = id;
+        if (btree_put(&txn, id, &student) != 0) {
+            btree_abort(&txn);
+            return -1;
+        }
+        if (++*copied % BTREE_CONVERT_BATCH == 0) {
+            // A failed commit or begin leaves no transaction open
+            if (btree_commit(&txn) != 0 || btree_begin(tree, &txn) != 0) {
+                return -1;
+            }
+        }
+    }
+    return btree_commit(&txn);
+}
+
+// Copies output_1..last_id into the LSM store and flushes it once
+static int copy_to_lsm(lsm_t *lsm, int last_id, int *copied) {
+    for (int id = 1; id <= last_id; id++) {
+        char filename[128];
+        student_t student;
+        record_path(id, filename, sizeof(filename));
+        if (record_read(filename, &student, NULL) != 0) {
+            continue;
+        }
+        student.student_id = id;
+        if (lsm_put(lsm, id, &student) != 0) {
+            return -1;
+        }
+        ++*copied;
+    }
+    return lsm_flush(lsm);
+}
+
+/*
+ * FUNCTION: studentdb_convert_to_btree / studentdb_convert_to_lsm
+ * ================================================================
+ * Copies every output_[ID].txt into data/students.db or data/lsm/, which
+ * selects that store from then on
+ * The B+tree copy commits BTREE_CONVERT_BATCH records per transaction,
+ * so it costs two fsyncs per batch rather than per student; the LSM copy
+ * runs with per-write fdatasync off and flushes once at the end. If the
+ * copy fails, the new store is removed and the text files stay the store.
+ *
+ * Parameters:
+ *   - copied: Set to the number of records copied
+ *
+ * Returns:
+ *   - 0 on success, -1 on error (errno EEXIST if another store is
+ *     already in use, since the text files are then stale)
+ */
+int studentdb_convert_to_btree(studentdb_t *db, int *copied) {
+    *copied = 0;
+    if (db->store.ops != &store_text_ops) {
+        errno = EEXIST;
+        return -1;
+    }
+    if (studentdb_use_btree(db) != 0) {
+        return -1;
+    }
+    if (copy_to_btree(&db->tree, studentdb_next_id() - 1, copied) != 0) {
+        int saved = errno;
+        store_text(&db->store);
+        record_use_store(&db->store);
+        btree_close(&db->tree);
+        remove(BTREE_PATH);
+        errno = saved;
+        return -1;
+    }
+    return 0;
+}
+
+int studentdb_convert_to_lsm(studentdb_t *db, int *copied) {
+    *copied = 0;
+    if (db->store.ops != &store_text_ops) {
+        errno = EEXIST;
+        return -1;
+    }
+    lsm_options_t options = { 0, 0, 0 };
+    if (studentdb_use_lsm(db, &options) != 0) {
+        return -1;
+    }
+    if (copy_to_lsm(&db->lsm, studentdb_next_id() - 1, copied) != 0) {
+        int saved = errno;
+        store_text(&db->store);
+        record_use_store(&db->store);
+        lsm_close(&db->lsm);
+        lsm_destroy(LSM_DIR);
+        errno = saved;
+        return -1;
+    }
+    return 0;
+}
+
+/*
+ * FUNCTION: studentdb_compact
+ * ============================
+ * Flushes the LSM store's memtable and merges every run into one
+ *
+ * Parameters:
+ *   - stats: Set to the store's counters afterwards; may be NULL
+ *
+ * Returns:
+ *   - 0 on success, -1 on error (errno ENOTSUP if the store is not the
+ *     LSM store)
+ */
+int studentdb_compact(studentdb_t *db, lsm_stats_t *stats) {
+    if (db->store.ops != &store_lsm_ops) {
+        errno = ENOTSUP;
+        return -1;
+    }
+    if (lsm_flush(&db->lsm) != 0 || lsm_compact(&db->lsm) != 0) {
+        return -1;
+    }
+    if (stats) {
+        lsm_get_stats(&db->lsm, stats);
+    }
+    return 0;
+}
+
+/*
+ * FUNCTION: studentdb_validate
+ * =============================
+ * Checks every field of a new student against validate.h's rules
+ *
+ * Returns:
+ *   - NULL if the record is valid, else a message naming the bad field
+ */
+const char *studentdb_validate(const student_t *student) {
+    static const char *const subject_errors[4][2] = {
+        { "subject 1 name", "subject 1 grade" },
+        { "subject 2 name", "subject 2 grade" },
+        { "subject 3 name", "subject 3 grade" },
+        { "subject 4 name", "subject 4 grade" },
+    };
+    const struct {
+        value_kind_t kind;
+        const char *value;
+        const char *field;
+    } checks[] = {
+        { VALUE_NAME, str_get(&student->name), "name" },
+        { VALUE_FAMILY_NAME, str_get(&student->family_name), "family name" },
+        { VALUE_DATE_OF_BIRTH, student->dateofbirth, "date of birth" },
+        { VALUE_STUDENT_ID, student->studentid, "student ID" },
+        { VALUE_NAME, str_get(&student->father_name), "father's name" },
+        { VALUE_NAME, str_get(&student->mother_name), "mother's name" },
+        { VALUE_PHONE_NUMBER, student->phone_number, "phone number" },
+    };
+    for (size_t i = 0; i < sizeof(checks) / sizeof(checks[0]); i++) {
+        if (validate_value(checks[i].kind, checks[i].value, strlen(checks[i].value)) != NULL) {
+            return checks[i].field;
+        }
+    }
+    char number[32];
+    snprintf(number, sizeof(number), "%d", student->grade);
+    if (validate_value(VALUE_CLASS_GRADE, number, strlen(number)) != NULL) {
+        return "class level";
+    }
+    const subject_t *subjects[] = { &student->subject1, &student->subject2, &student->subject3, &student->subject4 };
+    for (int i = 0; i < 4; i++) {
+        const char *name = str_get(&subjects[i]->name);
+        if (validate_value(VALUE_SUBJECT_NAME, name, strlen(name)) != NULL) {
+            return subject_errors[i][0];
+        }
+        snprintf(number, sizeof(number), "%g", subjects[i]->grade);
+        if (validate_value(VALUE_SUBJECT_GRADE, number, strlen(number)) != NULL) {
+            return subject_errors[i][1];
+        }
+    }
+    return NULL;
+}
+
+const char *const studentdb_column_names[STUDENTDB_COLUMNS] = {
+    "name", "family_name", "dob", "student_id", "father_name", "mother_name",
+    "phone", "grade", "subject1_name", "subject1_grade", "subject2_name",
+    "subject2_grade", "subject3_name", "subject3_grade", "subject4_name",
+    "subject4_grade",
+};
+
+static const value_kind_t column_kinds[STUDENTDB_COLUMNS] = {
+    VALUE_NAME, VALUE_FAMILY_NAME, VALUE_DATE_OF_BIRTH, VALUE_STUDENT_ID,
+    VALUE_NAME, VALUE_NAME, VALUE_PHONE_NUMBER, VALUE_CLASS_GRADE,
+    VALUE_SUBJECT_NAME, VALUE_SUBJECT_GRADE, VALUE_SUBJECT_NAME, VALUE_SUBJECT_GRADE,
+    VALUE_SUBJECT_NAME, VALUE_SUBJECT_GRADE, VALUE_SUBJECT_NAME, VALUE_SUBJECT_GRADE,
+};
+
+/*
+ * FUNCTION: studentdb_parse_columns
+ * ==================================
+ * Validates a new student given as text (the command stream's and HTTP
+ * API's input) and fills in student
+ *
+ * Parameters:
+ *   - columns: STUDENTDB_COLUMNS values in studentdb_column_names order
+ *   - error: Receives "column: problem" when a value is invalid
+ *
+ * Returns:
+ *   - 0 on success, -1 if a value is invalid or a long name could not be
+ *     stored (errno ENOMEM)
+ */
+int studentdb_parse_columns(student_t *student, const char *const *columns, char *error, size_t size) {
+    for (int i = 0; i < STUDENTDB_COLUMNS; i++) {
+        const char *problem = validate_value(column_kinds[i], columns[i], strlen(columns[i]));
+        if (problem != NULL) {
+            snprintf(error, size, "%s: %s", studentdb_column_names[i], problem);
+            return -1;
+        }
+    }
+    memset(student, 0, sizeof(*student));
+    subject_t *subjects[] = { &student->subject1, &student->subject2, &student->subject3, &student->subject4 };
+    str_t *names[] = { &student->name, &student->family_name, NULL, NULL,
+                       &student->father_name, &student->mother_name };
+    for (int i = 0; i < 6; i++) {
+        if (names[i] && str_set(names[i], columns[i]) != 0) {
+            snprintf(error, size, "%s: out of memory", studentdb_column_names[i]);
+            return -1;
+        }
+    }
+    snprintf(student->dateofbirth, sizeof(student->dateofbirth), "%s", columns[2]);
+    snprintf(student->studentid, sizeof(student->studentid), "%s", columns[3]);
+    snprintf(student->phone_number, sizeof(student->phone_number), "%s", columns[6]);
+    student->grade = atoi(columns[7]);
+    for (int i = 0; i < 4; i++) {
+        if (str_set(&subjects[i]->name, columns[8 + i * 2]) != 0) {
+            snprintf(error, size, "%s: out of memory", studentdb_column_names[8 + i * 2]);
+            return -1;
+        }
+        subjects[i]->grade = strtof(columns[9 + i * 2], NULL);
+    }
+    return 0;
+}
+
+/*
+ * FUNCTION: studentdb_field_by_name
+ * ==================================
+ * Maps an editable field's edit menu number ("7") or name
+ * ("subject1_grade", as in studentdb_column_names) to its field_t
+ *
+ * Returns:
+ *   - 0 on success, -1 if there is no such editable field
+ */
+int studentdb_field_by_name(const char *name, field_t *field) {
+    static const struct {
+        const char *name;
+        field_t field;
+    } fields[] = {
+        { "name", FIELD_NAME },
+        { "grade", FIELD_GRADE },
+        { "phone", FIELD_PHONE_NUMBER },
+        { "father_name", FIELD_FATHER_NAME },
+        { "mother_name", FIELD_MOTHER_NAME },
+        { "dob", FIELD_DATE_OF_BIRTH },
+        { "subject1_grade", FIELD_SUBJECT1_GRADE },
+        { "subject2_grade", FIELD_SUBJECT2_GRADE },
+        { "subject3_grade", FIELD_SUBJECT3_GRADE },
+        { "subject4_grade", FIELD_SUBJECT4_GRADE },
+        { "family_name", FIELD_FAMILY_NAME },
+    };
+    char *end;
+    long number = strtol(name, &end, 10);
+    if (end != name && *end == '\0') {
+        if (number < FIELD_NAME || number > FIELD_FAMILY_NAME) {
+            return -1;
+        }
+        *field = (field_t)number;
+        return 0;
+    }
+    for (size_t i = 0; i < sizeof(fields) / sizeof(fields[0]); i++) {
+        if (strcasecmp(name, fields[i].name) == 0) {
+            *field = fields[i].field;
+            return 0;
+        }
+    }
+    return -1;
+}
+
+/*
+ * FUNCTION: studentdb_next_id
+ * ============================
+ * Reads the next unassigned ID from the counter (1 if there is none)
+ */
+int studentdb_next_id(void) {
+    FILE *file = fopen(STUDENTDB_COUNTER_PATH, "r");
+    int id = 1;
+    if (file) {
+        if (fscanf(file, "%d", &id) != 1 || id < 1) {
+            id = 1;
+        }
+        fclose(file);
+    }
+    return id;
+}
+
+/*
+ * FUNCTION: studentdb_create
+ * ===========================
+ * Adds a new student: assigns the next ID, computes the average grade
+ * and saves the record (on the next shard in turn if the store is
+ * sharded)
+ *
+ * Parameters:
+ *   - student: Filled-in record; student_id and average_grade are set
+ *
+ * Returns:
+ *   - The new student's ID, or -1 on error (errno EINVAL if a field is
+ *     invalid, see studentdb_validate)
+ */
+int studentdb_create(studentdb_t *db, student_t *student) {
+    if (studentdb_validate(student) != NULL) {
+        errno = EINVAL;
+        return -1;
+    }
+    if (db->shards.shard_count > 0) {
+        calculate_average(student);
+        return shard_add(&db->shards, student);
+    }
+    int id = record_reserve_ids(STUDENTDB_COUNTER_PATH, 1);
+    if (id < 0) {
+        return -1;
+    }
+
+    student->student_id = id;
+    calculate_average(student);
+    if (record_save(id, student) != 0) {
+        return -1;
+    }
+    return id;
+}
+
+/*
+ * FUNCTION: studentdb_create_many
+ * ================================
+ * studentdb_create for count students at once: one counter write
+ * reserves all their IDs and the records are saved with a single sync
+ * (see record_save_many)
+ *
+ * Returns:
+ *   - The first new ID (the rest follow in order), or -1 on error
+ *     (errno EINVAL if any record is invalid; then none are saved)
+ */
+int studentdb_create_many(studentdb_t *db, student_t *students, int count) {
+    for (int i = 0; i < count; i++) {
+        if (studentdb_validate(&students[i]) != NULL) {
+            errno = EINVAL;
+            return -1;
+        }
+    }
+    (void)db;
+    int first_id = record_reserve_ids(STUDENTDB_COUNTER_PATH, count);
+    if (first_id < 0) {
+        return -1;
+    }
+
+    for (int i = 0; i < count; i++) {
+        students[i].student_id = first_id + i;
+        calculate_average(&students[i]);
+    }
+    if (record_save_many(students, count) != 0) {
+        return -1;
+    }
+    return first_id;
+}
+
+/*
+ * FUNCTION: studentdb_get
+ * ========================
+ * Loads one student by ID
+ *
+ * Returns:
+ *   - 0 on success, -1 if the student does not exist
+ */
+int studentdb_get(studentdb_t *db, int id, student_t *student) {
+    if (db->shards.shard_count > 0) {
+        return shard_get(&db->shards, id, student);
+    }
+    return record_load(id, student);
+}
+
+/*
+ * FUNCTION: studentdb_update
+ * ===========================
+ * Validates and applies a new value for one field (see record_update)
+ * Subject grade changes also update the current term's grade history.
+ *
+ * Returns:
+ *   - 0 on success
+ *   - 1 if the record was updated but the grade history could not be
+ *   - -1 on error (errno EINVAL if the value is invalid for the field)
+ */
+int studentdb_update(studentdb_t *db, int id, field_t field, const char *value) {
+    if (validate_field(field, value) != NULL) {
+        errno = EINVAL;
+        return -1;
+    }
+    int updated = db->shards.shard_count > 0 ? shard_update(&db->shards, id, field, value)
+                                             : record_update(id, field, value);
+    if (updated != 0) {
+        return -1;
+    }
+    if (field >= FIELD_SUBJECT1_GRADE && field <= FIELD_SUBJECT4_GRADE && history_update_current(id) != 0) {
+        return 1;
+    }
+    return 0;
+}
+
+/*
+ * FUNCTION: studentdb_rank
+ * =========================
+ * Looks up a student's competition rank within their class level in the
+ * attached view (see studentdb_attach_ranks)
+ *
+ * Parameters:
+ *   - class_size: set to the number of students in the class; may be NULL
+ *
+ * Returns:
+ *   - 0 on success, -1 if no view is attached or the student is not in it
+ */
+int studentdb_rank(studentdb_t *db, int id, int *rank, int *class_size) {
+    if (!db->ranked) {
+        return -1;
+    }
+    return rank_lookup(&db->ranks, id, rank, class_size);
+}
+
+/*
+ * FUNCTION: studentdb_render_reports
+ * ===================================
+ * Renders a report card for every student into dir (report_render_all)
+ * from data/snapshot.bin, writing the snapshot first if there is none.
+ * A template that shows a rank attaches the ranking view first.
+ *
+ * Returns:
+ *   - 0 if every card was written
+ *   - -1 if the snapshot or ranking view could not be read (result is
+ *     zeroed) or some cards failed (result says how many)
+ */
+int studentdb_render_reports(studentdb_t *db, const report_template_t *tpl, const char *dir,
+                             report_result_t *result) {
+    memset(result, 0, sizeof(*result));
+    if (tpl->ranked && studentdb_attach_ranks(db) != 0) {
+        return -1;
+    }
+    snapshot_t snap;
+    if (open_snapshot(&snap) != 0) {
+        return -1;
+    }
+    int status = report_render_all(tpl, &snap, &db->ranks, dir, result);
+    snapshot_close(&snap);
+    return status;
+}
+
+/*
+ * FUNCTION: studentdb_card
+ * =========================
+ * Returns one student's report card, from data/cards/ when it is current
+ * (card_fetch). A template that shows a rank attaches the ranking view
+ * first.
+ *
+ * Parameters:
+ *   - card: set to the card text, NUL-terminated; free with free()
+ *   - hit: set to 1 if the card came from the cache
+ *
+ * Returns:
+ *   - 0 on success, -1 if the student is not found or on error
+ */
+int studentdb_card(studentdb_t *db, const report_template_t *tpl, int id, char **card, size_t *length,
+                   int *hit) {
+    *hit = 0;
+    if (tpl->ranked && studentdb_attach_ranks(db) != 0) {
+        return -1;
+    }
+    return card_fetch(tpl, &db->ranks, id, card, length, hit);
+}
+
+typedef struct {
+    studentdb_filter_fn filter;
+    void *arg;
+    student_t *results;
+    int count;
+    int capacity;
+    int failed;
+} query_state_t;
+
+static void collect(const student_t *student, void *arg) {
+    query_state_t *state = arg;
+    if (state->failed || (state->filter && !state->filter(student, state->arg))) {
+        return;
+    }
+    if (state->count == state->capacity) {
+        int capacity = state->capacity ? state->capacity * 2 : 64;
+        student_t *grown = realloc(state->results, (size_t)capacity * sizeof(student_t));
+        if (!grown) {
+            state->failed = 1;
+            return;
+        }
+        state->results = grown;
+        state->capacity = capacity;
+    }
+    state->results[state->count++] = *student;
+}
+
+/*
+ * FUNCTION: studentdb_query
+ * ==========================
+ * Collects the students with first_id <= ID <= last_id that pass filter
+ * (NULL keeps all), in ID order
+ * The scan holds the same lock as studentdb_update (see record_scan), so
+ * it never sees a record half-way through an edit. filter must not call
+ * back into studentdb.
+ *
+ * Parameters:
+ *   - results: Set to a malloc'd array the caller frees
+ *
+ * Returns:
+ *   - Number of students returned, or -1 on error
+ */
+int studentdb_query(studentdb_t *db, int first_id, int last_id, studentdb_filter_fn filter, void *arg,
+                    student_t **results) {
+    query_state_t state = { filter, arg, NULL, 0, 0, 0 };
+    (void)db;
+    if (record_scan(first_id, last_id, collect, &state) < 0 || state.failed) {
+        free(state.results);
+        return -1;
+    }
+    *results = state.results ? state.results : malloc(sizeof(student_t));
+    return *results ? state.count : -1;
+}
+
+/*
+ * FUNCTION: studentdb_location
+ * =============================
+ * Describes where a student's record is stored, for messages
+ */
+void studentdb_location(const studentdb_t *db, int id, char *buf, size_t size) {
+    if (db->store.ops == &store_btree_ops) {
+        snprintf(buf, size, "%s", BTREE_PATH);
+    } else if (db->store.ops == &store_lsm_ops) {
+        snprintf(buf, size, "%s", LSM_DIR);
+    } else {
+        record_path(id, buf, size);
+    }
+}
@@ -0,0 +1,103 @@
+/*
+ * ============================================================================
+ * STUDENTDB LIBRARY API
+ * ============================================================================
+ *
+ * Non-interactive entry points for programs that embed the student store
+ * instead of driving `app` through its prompts. `app` itself is a thin
+ * CLI over these calls.
+ *
+ * All paths are relative to the current directory, as for `app`: the
+ * counter is data/next_id.txt and the records live in whichever store
+ * studentdb_open selects (see store.h):
+ *
+ *     data/students.db exists   B+tree store
+ *     data/lsm/ exists          LSM store
+ *     otherwise                 output_<id>.txt files
+ *
+ * If data/shards.txt exists, creates, reads and edits also go through
+ * the shard engine (see shard.h and studentdb_use_shards).
+ *
+ * studentdb_attach_ranks builds the class ranking view (rank.h) from
+ * data/snapshot.bin once and keeps it current through the commit hooks,
+ * so studentdb_rank is one O(log n) lookup. Long-running callers (app
+ * run, serve, rpc) attach it before their threads start.
+ * studentdb_render_reports and studentdb_card attach it themselves when
+ * the template shows a rank.
+ *
+ * studentdb_convert_to_btree and studentdb_convert_to_lsm move the text
+ * records into a new store; studentdb_compact merges the LSM store's runs.
+ *
+ * Only one studentdb_t may be open at a time (the record layer's store
+ * selection and commit hooks are process-wide). Its functions may be
+ * called from several threads.
+ *
+ * Usage:
+ *     studentdb_t db;
+ *     studentdb_open(&db);
+ *     student_t s = {0};
+ *     str_set(&s.name, "Ada"); ... fill in the fields ...
+ *     int id = studentdb_create(&db, &s);
+ *     studentdb_update(&db, id, FIELD_SUBJECT1_GRADE, "95");
+ *     studentdb_close(&db);
+ *
+ * ============================================================================
+ */
+
+#ifndef STUDENTDB_H
+#define STUDENTDB_H
+
+#include "student.h"
+#include "record.h"
+#include "store.h"
+#include "shard.h"
+#include "rank.h"
+#include "report.h"
+
+#define STUDENTDB_COUNTER_PATH "data/next_id.txt"
+
+// A new student as text, in `app import` column order (see studentdb_column_names)
+#define STUDENTDB_COLUMNS 16
+
+extern const char *const studentdb_column_names[STUDENTDB_COLUMNS];
+
+typedef struct {
+    store_t store;
+    btree_t tree;            // when store is the B+tree
+    lsm_t lsm;               // when store is the LSM store
+    shard_engine_t shards;   // shard_count is 0 unless data/shards.txt exists
+    rank_view_t ranks;       // when ranked (studentdb_attach_ranks)
+    int ranked;
+} studentdb_t;
+
+// Returns nonzero to keep a student in the results of studentdb_query
+typedef int (*studentdb_filter_fn)(const student_t *student, void *arg);
+
+int studentdb_open(studentdb_t *db);
+void studentdb_close(studentdb_t *db);
+int studentdb_use_btree(studentdb_t *db);
+int studentdb_use_lsm(studentdb_t *db, const lsm_options_t *options);
+int studentdb_use_shards(studentdb_t *db, int shard_count);
+int studentdb_attach_ranks(studentdb_t *db);
+int studentdb_convert_to_btree(studentdb_t *db, int *copied);
+int studentdb_convert_to_lsm(studentdb_t *db, int *copied);
+int studentdb_compact(studentdb_t *db, lsm_stats_t *stats);
+
+const char *studentdb_validate(const student_t *student);
+int studentdb_parse_columns(student_t *student, const char *const *columns, char *error, size_t size);
+int studentdb_field_by_name(const char *name, field_t *field);
+int studentdb_next_id(void);
+int studentdb_create(studentdb_t *db, student_t *student);
+int studentdb_create_many(studentdb_t *db, student_t *students, int count);
+int studentdb_get(studentdb_t *db, int id, student_t *student);
+int studentdb_update(studentdb_t *db, int id, field_t field, const char *value);
+int studentdb_rank(studentdb_t *db, int id, int *rank, int *class_size);
+int studentdb_render_reports(studentdb_t *db, const report_template_t *tpl, const char *dir,
+                             report_result_t *result);
+int studentdb_card(studentdb_t *db, const report_template_t *tpl, int id, char **card, size_t *length,
+                   int *hit);
+int studentdb_query(studentdb_t *db, int first_id, int last_id, studentdb_filter_fn filter, void *arg,
+                    student_t **results);
+void studentdb_location(const studentdb_t *db, int id, char *buf, size_t size);
+
+#endif
@@ -0,0 +1,351 @@
+/*
+ * ============================================================================
+ * FIELD VALIDATION
+ * ============================================================================
+ *
+ * See validate.h for the rules.
+ *
+ * ============================================================================
+ */
+
+#include "validate.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+/*
+ * Character Classes
+ * =================
+ * Most rules reduce to "every byte is in some class". all_in_class tests
+ * 16 bytes at a time with SSE2 where available: a byte x is in [lo, hi]
+ * when the unsigned saturating (x - lo) - (hi - lo) is zero, and letters
+ * are matched case-insensitively by setting bit 0x20 first.
+ */
+typedef enum {
+    CLASS_NAME,        // letters, '-', '\''
+    CLASS_ALNUM,       // letters, digits
+    CLASS_ALNUM_DASH,  // letters, digits, '-'
+    CLASS_DIGIT        // digits
+} char_class_t;
+
+#ifndef __SSE2__
+static int is_letter(char c) {
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z');
+}
+
+static int is_digit(char c) {
+    return c >= '0' && c <= '9';
+}
+
+static int in_class_scalar(char c, char_class_t cls) {
+    switch (cls) {
+    case CLASS_NAME:
+        return is_letter(c) || c == '-' || c == '\'';
+    case CLASS_ALNUM:
+        return is_letter(c) || is_digit(c);
+    case CLASS_ALNUM_DASH:
+        return is_letter(c) || is_digit(c) || c == '-';
+    case CLASS_DIGIT:
+        return is_digit(c);
+    }
+    return 0;
+}
+#endif
+
+#ifdef __SSE2__
+static __m128i in_range(__m128i bytes, char lo, char hi) {
+    __m128i offset = _mm_sub_epi8(bytes, _mm_set1_epi8(lo));
+    return _mm_cmpeq_epi8(_mm_subs_epu8(offset, _mm_set1_epi8((char)(hi - lo))), _mm_setzero_si128());
+}
+
+static int class_mask(__m128i bytes, char_class_t cls) {
+    __m128i digit = in_range(bytes, '0', '9');
+    if (cls == CLASS_DIGIT) {
+        return _mm_movemask_epi8(digit);
+    }
+    __m128i hits = in_range(_mm_or_si128(bytes, _mm_set1_epi8(0x20)), 'a', 'z');
+    if (cls == CLASS_NAME) {
+        hits = _mm_or_si128(hits, _mm_cmpeq_epi8(bytes, _mm_set1_epi8('-')));
+        hits = _mm_or_si128(hits, _mm_cmpeq_epi8(bytes, _mm_set1_epi8('\'')));
+        return _mm_movemask_epi8(hits);
+    }
+    hits = _mm_or_si128(hits, digit);
+    if (cls == CLASS_ALNUM_DASH) {
+        hits = _mm_or_si128(hits, _mm_cmpeq_epi8(bytes, _mm_set1_epi8('-')));
+    }
+    return _mm_movemask_epi8(hits);
+}
+
+/*
+ * Loads up to 16 bytes without reading past value + length (values may
+ * sit at the very end of an mmapped file), padding with fill.
+ */
+static __m128i load_padded(const char *value, size_t length, char fill) {
+    if (length >= 16) {
+        return _mm_loadu_si128((const __m128i *)value);
+    }
+    char buf[16];
+    memset(buf, fill, sizeof(buf));
+    memcpy(buf, value, length);
+    return _mm_loadu_si128((const __m128i *)buf);
+}
+#endif
+
+static int all_in_class(const char *value, size_t length, char_class_t cls) {
+#ifdef __SSE2__
+    char fill = cls == CLASS_DIGIT ? '0' : 'a';
+    for (size_t i = 0; i < length; i += 16) {
+        if (class_mask(load_padded(value + i, length - i, fill), cls) != 0xFFFF) {
+            return 0;
+        }
+    }
+    return 1;
+#else
+    for (size_t i = 0; i < length; i++) {
+        if (!in_class_scalar(value[i], cls)) {
+            return 0;
+        }
+    }
+    return 1;
+#endif
+}
+
+static const char *check_name(const char *value, size_t length, int allow_empty) {
+    if (length == 0) {
+        return allow_empty ? NULL : "must not be empty";
+    }
+    if (length > VALIDATE_NAME_MAX) {
+        return "must be at most 255 characters";
+    }
+    if (!all_in_class(value, length, CLASS_NAME)) {
+        return "must contain only letters, '-' or '\\''";
+    }
+    return NULL;
+}
+
+static const char *check_alnum(const char *value, size_t length, size_t max, int allow_dash) {
+    if (length == 0) {
+        return "must not be empty";
+    }
+    if (length > max) {
+        return "is too long";
+    }
+    if (!all_in_class(value, length, allow_dash ? CLASS_ALNUM_DASH : CLASS_ALNUM)) {
+        return allow_dash ? "must contain only letters, digits or '-'" : "must contain only letters and digits";
+    }
+    return NULL;
+}
+
+static int two_digits(const char *p) {
+    return (p[0] - '0') * 10 + (p[1] - '0');
+}
+
+static const char *check_date(const char *value, size_t length) {
+    if (length != 10) {
+        return "must be DD/MM/YYYY";
+    }
+#ifdef __SSE2__
+    // One load: digits expected at bits 0,1,3,4,6-9 and '/' at bits 2,5
+    __m128i bytes = load_padded(value, length, '0');
+    int digits = _mm_movemask_epi8(in_range(bytes, '0', '9'));
+    int slashes = _mm_movemask_epi8(_mm_cmpeq_epi8(bytes, _mm_set1_epi8('/')));
+    if ((digits & 0x3DB) != 0x3DB || (slashes & 0x24) != 0x24) {
+        return "must be DD/MM/YYYY";
+    }
+#else
+    for (size_t i = 0; i < length; i++) {
+        if ((i == 2 || i == 5) ? value[i] != '/' : !is_digit(value[i])) {
+            return "must be DD/MM/YYYY";
+        }
+    }
+#endif
+    static const int days_in_month[] = { 31, 29, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31 };
+    int day = two_digits(value);
+    int month = two_digits(value + 3);
+    if (month < 1 || month > 12) {
+        return "has an invalid month";
+    }
+    if (day < 1 || day > days_in_month[month - 1]) {
+        return "has an invalid day";
+    }
+    return NULL;
+}
+
+static const char *check_digits(const char *value, size_t length) {
+    if (length == 0) {
+        return "must not be empty";
+    }
+    if (length > 14) {
+        return "must be at most 14 digits";
+    }
+    if (!all_in_class(value, length, CLASS_DIGIT)) {
+        return "must contain only digits";
+    }
+    return NULL;
+}
+
+static const char *check_number(const char *value, size_t length, double min, double max, int whole) {
+    // Fast path for plain digit strings, which is nearly every real value
+    if (length > 0 && length <= 9 && all_in_class(value, length, CLASS_DIGIT)) {
+        long number = 0;
+        for (size_t i = 0; i < length; i++) {
+            number = number * 10 + (value[i] - '0');
+        }
+        if (number < min || number > max) {
+            return whole ? "must be between 1 and 12" : "must be between 0 and 100";
+        }
+        return NULL;
+    }
+
+    char buf[32];
+    if (length == 0 || length >= sizeof(buf)) {
+        return "must be a number";
+    }
+    memcpy(buf, value, length);
+    buf[length] = '\0';
+
+    char *end;
+    double number = whole ? (double)strtol(buf, &end, 10) : strtod(buf, &end);
+    if (end == buf || *end != '\0') {
+        return whole ? "must be a whole number" : "must be a number";
+    }
+    if (!(number >= min && number <= max)) {  // also rejects NaN
+        return whole ? "must be between 1 and 12" : "must be between 0 and 100";
+    }
+    return NULL;
+}
+
+/*
+ * Per-Kind Checks
+ * ===============
+ * One function per value_kind_t, so validate_column can pick the check
+ * once for a whole column
+ */
+typedef const char *(*value_check_fn)(const char *value, size_t length);
+
+static const char *check_required_name(const char *value, size_t length) {
+    return check_name(value, length, 0);
+}
+
+static const char *check_family_name(const char *value, size_t length) {
+    return check_name(value, length, 1);
+}
+
+static const char *check_student_id(const char *value, size_t length) {
+    return check_alnum(value, length, 14, 0);
+}
+
+static const char *check_class_grade(const char *value, size_t length) {
+    return check_number(value, length, 1, 12, 1);
+}
+
+static const char *check_subject_name(const char *value, size_t length) {
+    return check_alnum(value, length, VALIDATE_NAME_MAX, 1);
+}
+
+static const char *check_subject_grade(const char *value, size_t length) {
+    return check_number(value, length, 0, 100, 0);
+}
+
+static value_check_fn check_for(value_kind_t kind) {
+    switch (kind) {
+    case VALUE_NAME:
+        return check_required_name;
+    case VALUE_FAMILY_NAME:
+        return check_family_name;
+    case VALUE_DATE_OF_BIRTH:
+        return check_date;
+    case VALUE_PHONE_NUMBER:
+        return check_digits;
+    case VALUE_STUDENT_ID:
+        return check_student_id;
+    case VALUE_CLASS_GRADE:
+        return check_class_grade;
+    case VALUE_SUBJECT_NAME:
+        return check_subject_name;
+    case VALUE_SUBJECT_GRADE:
+        return check_subject_grade;
+    }
+    return NULL;
+}
+
+/*
+ * FUNCTION: validate_value
+ * =========================
+ * Checks one value (length bytes, need not be NUL-terminated)
+ *
+ * Returns:
+ *   - NULL if valid, otherwise an error message
+ */
+const char *validate_value(value_kind_t kind, const char *value, size_t length) {
+    value_check_fn check = check_for(kind);
+    return check ? check(value, length) : "unknown field";
+}
+
+/*
+ * FUNCTION: validate_field
+ * =========================
+ * Checks a new value for one of the edit_student menu fields
+ *
+ * Returns:
+ *   - NULL if valid, otherwise an error message
+ */
+const char *validate_field(field_t field, const char *value) {
+    size_t length = strlen(value);
+    switch (field) {
+    case FIELD_NAME:
+    case FIELD_FATHER_NAME:
+    case FIELD_MOTHER_NAME:
+        return validate_value(VALUE_NAME, value, length);
+    case FIELD_FAMILY_NAME:
+        return validate_value(VALUE_FAMILY_NAME, value, length);
+    case FIELD_GRADE:
+        return validate_value(VALUE_CLASS_GRADE, value, length);
+    case FIELD_PHONE_NUMBER:
+        return validate_value(VALUE_PHONE_NUMBER, value, length);
+    case FIELD_DATE_OF_BIRTH:
+        return validate_value(VALUE_DATE_OF_BIRTH, value, length);
+    case FIELD_SUBJECT1_GRADE:
+    case FIELD_SUBJECT2_GRADE:
+    case FIELD_SUBJECT3_GRADE:
+    case FIELD_SUBJECT4_GRADE:
+        return validate_value(VALUE_SUBJECT_GRADE, value, length);
+    }
+    return "unknown field";
+}
+
+/*
+ * FUNCTION: validate_column
+ * ==========================
+ * Checks one column of a batch of rows. The check for kind is chosen
+ * once before the loop; each value is then tested by that check alone
+ * (its character classes 16 bytes at a time with SSE2, as for
+ * validate_value).
+ *
+ * Parameters:
+ *   - kind: Rule for every value in the column
+ *   - values, lengths: count values (need not be NUL-terminated)
+ *   - errors: Per-row error slots. Rows whose slot is already set (failed
+ *             an earlier column) are skipped; failing rows get a message.
+ *
+ * Returns:
+ *   - Number of rows that failed this column
+ */
+size_t validate_column(value_kind_t kind, const char *const *values, const size_t *lengths,
+                       size_t count, const char **errors) {
+    value_check_fn check = check_for(kind);
+    size_t failed = 0;
+    for (size_t i = 0; i < count; i++) {
+        if (errors[i]) {
+            continue;
+        }
+        if ((errors[i] = check ? check(values[i], lengths[i]) : "unknown field") != NULL) {
+            failed++;
+        }
+    }
+    return failed;
+}
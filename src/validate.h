@@ -0,0 +1,49 @@
+/*
+ * ============================================================================
+ * FIELD VALIDATION
+ * ============================================================================
+ *
+ * Format rules shared by edit_student and bulk import:
+ *   - Names: letters, '-' and '\'' only, 1-VALIDATE_NAME_MAX characters
+ *   - Family name: same as names but may be empty
+ *   - Date of birth: DD/MM/YYYY with a real day and month
+ *   - Phone number: digits only, 1-14 characters
+ *   - Student ID: letters and digits, 1-14 characters
+ *   - Class level (GRADE): whole number 1-12
+ *   - Subject name: letters, digits and '-', 1-VALIDATE_NAME_MAX characters
+ *   - Subject grade: number 0-100
+ *
+ * Every check returns NULL when the value is valid, or a short message
+ * describing the problem. Character classes are tested 16 bytes at a time
+ * with SSE2 where available. validate_column checks a whole column of a
+ * batch of rows for the bulk importer.
+ *
+ * ============================================================================
+ */
+
+#ifndef VALIDATE_H
+#define VALIDATE_H
+
+#include <stddef.h>
+#include "record.h"
+
+// Longest name accepted; names are str_t, so this is a sanity limit only
+#define VALIDATE_NAME_MAX 255
+
+typedef enum {
+    VALUE_NAME,
+    VALUE_FAMILY_NAME,
+    VALUE_DATE_OF_BIRTH,
+    VALUE_PHONE_NUMBER,
+    VALUE_STUDENT_ID,
+    VALUE_CLASS_GRADE,
+    VALUE_SUBJECT_NAME,
+    VALUE_SUBJECT_GRADE
+} value_kind_t;
+
+const char *validate_value(value_kind_t kind, const char *value, size_t length);
+const char *validate_field(field_t field, const char *value);
+size_t validate_column(value_kind_t kind, const char *const *values, const size_t *lengths,
+                       size_t count, const char **errors);
+
+#endif
@@ -0,0 +1,275 @@
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstdio>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+#include <sys/stat.h>
+
+#include "test_util.h"
+
+extern "C" {
+#include "btree.h"
+#include "record.h"
+#include "store.h"
+}
+
+static long file_size(const char *path) {
+    struct stat st;
+    return stat(path, &st) == 0 ? (long)st.st_size : -1;
+}
+
+TEST(BTree, PutGetRoundTrip) {
+    ScopedTempDir guard;
+    btree_t tree;
+    ASSERT_EQ(0, btree_open(&tree, BTREE_PATH));
+
+    student_t s = make_student({.id = 7, .subject_grade = 81.25f});
+    std::string long_name(200, 'y');
+    str_set(&s.father_name, long_name.c_str());
+    ASSERT_EQ(0, btree_store(&tree, 7, &s));
+
+    student_t back;
+    ASSERT_EQ(0, btree_load(&tree, 7, &back));
+    EXPECT_EQ(7, back.student_id);
+    EXPECT_STREQ("Katherine", str_get(&back.name));
+    EXPECT_EQ(long_name, str_get(&back.father_name));
+    EXPECT_STREQ("Mathematics", str_get(&back.subject1.name));
+    EXPECT_STREQ("kj00007", back.studentid);
+    EXPECT_FLOAT_EQ(81.25f, back.average_grade);
+    EXPECT_EQ(-1, btree_load(&tree, 8, &back));
+
+    std::string huge(2000, 'z');
+    str_set(&s.name, huge.c_str());
+    errno = 0;
+    EXPECT_EQ(-1, btree_store(&tree, 9, &s));
+    EXPECT_EQ(E2BIG, errno);
+    btree_close(&tree);
+}
+
+TEST(BTree, SplitsScansDeletesAndPersists) {
+    ScopedTempDir guard;
+    btree_t tree;
+    ASSERT_EQ(0, btree_open(&tree, BTREE_PATH));
+
+    const int count = 5000;
+    std::vector<int> ids(count);
+    for (int i = 0; i < count; i++) {
+        ids[i] = i + 1;
+    }
+    std::shuffle(ids.begin(), ids.end(), std::mt19937(42));
+    btree_txn_t txn;
+    for (int i = 0; i < count; i++) {
+        if (i % 1000 == 0) {
+            if (i > 0) {
+                ASSERT_EQ(0, btree_commit(&txn));
+            }
+            btree_begin(&tree, &txn);
+        }
+        student_t s = make_student({.id = ids[i], .subject_grade = (float)(ids[i] % 100)});
+        ASSERT_EQ(0, btree_put(&txn, ids[i], &s));
+    }
+    ASSERT_EQ(0, btree_commit(&txn));
+
+    btree_reader_t reader;
+    ASSERT_EQ(0, btree_read_begin(&tree, &reader));
+    EXPECT_EQ((uint64_t)count, reader.record_count);
+    std::vector<int> seen;
+    EXPECT_EQ(101, btree_scan(&reader, 1000, 1100, collect_ids, &seen));
+    ASSERT_EQ(101u, seen.size());
+    for (int i = 0; i < 101; i++) {
+        EXPECT_EQ(1000 + i, seen[i]);
+    }
+    btree_read_end(&reader);
+
+    // Remove every even ID
+    btree_begin(&tree, &txn);
+    for (int id = 2; id <= count; id += 2) {
+        ASSERT_EQ(1, btree_delete(&txn, id));
+    }
+    EXPECT_EQ(0, btree_delete(&txn, 2));
+    ASSERT_EQ(0, btree_commit(&txn));
+    btree_close(&tree);
+
+    ASSERT_EQ(0, btree_open(&tree, BTREE_PATH));
+    ASSERT_EQ(0, btree_read_begin(&tree, &reader));
+    EXPECT_EQ((uint64_t)count / 2, reader.record_count);
+    seen.clear();
+    EXPECT_EQ(count / 2, btree_scan(&reader, INT32_MIN, INT32_MAX, collect_ids, &seen));
+    EXPECT_TRUE(std::is_sorted(seen.begin(), seen.end()));
+    student_t back;
+    EXPECT_EQ(0, btree_get(&reader, 4999, &back));
+    EXPECT_FLOAT_EQ(99.0f, back.average_grade);
+    EXPECT_EQ(-1, btree_get(&reader, 5000, &back));
+    btree_read_end(&reader);
+
+    // Deleting everything leaves an empty tree
+    btree_begin(&tree, &txn);
+    for (int id = 1; id <= count; id += 2) {
+        ASSERT_EQ(1, btree_delete(&txn, id));
+    }
+    EXPECT_EQ(0u, txn.record_count);
+    EXPECT_EQ(0u, txn.root);
+    ASSERT_EQ(0, btree_commit(&txn));
+    btree_close(&tree);
+}
+
+TEST(BTree, ReaderKeepsItsVersion) {
+    ScopedTempDir guard;
+    btree_t tree;
+    ASSERT_EQ(0, btree_open(&tree, BTREE_PATH));
+    student_t s = make_student({.id = 1, .subject_grade = 50.0f});
+    ASSERT_EQ(0, btree_store(&tree, 1, &s));
+
+    btree_reader_t old_reader;
+    ASSERT_EQ(0, btree_read_begin(&tree, &old_reader));
+    // Many commits: the pinned version's pages must not be reused
+    for (int i = 0; i < 50; i++) {
+        s.average_grade = 60.0f + i;
+        ASSERT_EQ(0, btree_store(&tree, 1, &s));
+    }
+    student_t back;
+    ASSERT_EQ(0, btree_get(&old_reader, 1, &back));
+    EXPECT_FLOAT_EQ(50.0f, back.average_grade);
+    btree_read_end(&old_reader);
+
+    ASSERT_EQ(0, btree_load(&tree, 1, &back));
+    EXPECT_FLOAT_EQ(109.0f, back.average_grade);
+
+    // Uncommitted writes are invisible and dropped on abort
+    btree_txn_t txn;
+    btree_begin(&tree, &txn);
+    s.average_grade = 1.0f;
+    ASSERT_EQ(0, btree_put(&txn, 1, &s));
+    ASSERT_EQ(0, btree_txn_get(&txn, 1, &back));
+    EXPECT_FLOAT_EQ(1.0f, back.average_grade);
+    ASSERT_EQ(0, btree_load(&tree, 1, &back));
+    EXPECT_FLOAT_EQ(109.0f, back.average_grade);
+    btree_abort(&txn);
+    btree_close(&tree);
+}
+
+TEST(BTree, FreedPagesAreReused) {
+    ScopedTempDir guard;
+    btree_t tree;
+    ASSERT_EQ(0, btree_open(&tree, BTREE_PATH));
+    for (int id = 1; id <= 200; id++) {
+        student_t s = make_student({.id = id, .subject_grade = 1.0f});
+        ASSERT_EQ(0, btree_store(&tree, id, &s));
+    }
+    long size = file_size(BTREE_PATH);
+    for (int i = 0; i < 500; i++) {
+        student_t s = make_student({.id = 100, .subject_grade = (float)i});
+        ASSERT_EQ(0, btree_store(&tree, 100, &s));
+    }
+    EXPECT_LE(file_size(BTREE_PATH), size + 4 * BTREE_PAGE_SIZE);
+    btree_close(&tree);
+}
+
+TEST(BTree, TornMetaFallsBackToPreviousCommit) {
+    ScopedTempDir guard;
+    btree_t tree;
+    ASSERT_EQ(0, btree_open(&tree, BTREE_PATH));
+    student_t s = make_student({.id = 1, .subject_grade = 10.0f});
+    ASSERT_EQ(0, btree_store(&tree, 1, &s));
+    s.average_grade = 20.0f;
+    ASSERT_EQ(0, btree_store(&tree, 1, &s));
+    uint64_t last = tree.txn_id;
+    btree_close(&tree);
+
+    // Damage the meta page of the last commit, as a crash mid-write would
+    FILE *file = std::fopen(BTREE_PATH, "r+b");
+    ASSERT_NE(nullptr, file);
+    std::fseek(file, (long)(last % 2) * BTREE_PAGE_SIZE + 20, SEEK_SET);
+    std::fputc(0x5a, file);
+    std::fclose(file);
+
+    ASSERT_EQ(0, btree_open(&tree, BTREE_PATH));
+    EXPECT_EQ(last - 1, tree.txn_id);
+    student_t back;
+    ASSERT_EQ(0, btree_load(&tree, 1, &back));
+    EXPECT_FLOAT_EQ(10.0f, back.average_grade);
+    btree_close(&tree);
+}
+
+TEST(BTree, SecondOpenIsRefused) {
+    ScopedTempDir guard;
+    btree_t tree;
+    ASSERT_EQ(0, btree_open(&tree, BTREE_PATH));
+    btree_t other;
+    EXPECT_EQ(-1, btree_open(&other, BTREE_PATH));
+    EXPECT_EQ(EWOULDBLOCK, errno);
+    btree_close(&tree);
+    ASSERT_EQ(0, btree_open(&other, BTREE_PATH));
+    btree_close(&other);
+}
+
+TEST(BTree, ConcurrentReadersSeeWholeCommits) {
+    ScopedTempDir guard;
+    btree_t tree;
+    ASSERT_EQ(0, btree_open(&tree, BTREE_PATH));
+    // Every commit gives all 300 records the same average
+    auto write_all = [&](float average) {
+        btree_txn_t txn;
+        btree_begin(&tree, &txn);
+        for (int id = 1; id <= 300; id++) {
+            student_t s = make_student({.id = id, .subject_grade = average});
+            ASSERT_EQ(0, btree_put(&txn, id, &s));
+        }
+        ASSERT_EQ(0, btree_commit(&txn));
+    };
+    write_all(0.0f);
+
+    std::atomic<bool> stop(false);
+    std::atomic<int> torn(0);
+    std::vector<std::thread> readers;
+    for (int t = 0; t < 4; t++) {
+        readers.emplace_back([&] {
+            while (!stop) {
+                btree_reader_t reader;
+                if (btree_read_begin(&tree, &reader) != 0) {
+                    continue;
+                }
+                student_t first, last;
+                if (btree_get(&reader, 1, &first) != 0 || btree_get(&reader, 300, &last) != 0 ||
+                    first.average_grade != last.average_grade) {
+                    torn++;
+                }
+                btree_read_end(&reader);
+            }
+        });
+    }
+    for (int i = 1; i <= 30; i++) {
+        write_all((float)i);
+    }
+    stop = true;
+    for (auto &reader : readers) {
+        reader.join();
+    }
+    EXPECT_EQ(0, torn.load());
+    btree_close(&tree);
+}
+
+TEST(BTree, RecordFunctionsUseSelectedTree) {
+    ScopedTempDir guard;
+    btree_t tree;
+    ASSERT_EQ(0, btree_open(&tree, BTREE_PATH));
+    store_t store;
+    store_btree(&store, &tree);
+    record_use_store(&store);
+
+    student_t s = make_student({.id = 3, .subject_grade = 0.0f});
+    s.subject1.grade = 80.0f;
+    ASSERT_EQ(0, record_save(3, &s));
+    ASSERT_EQ(0, record_update(3, FIELD_SUBJECT2_GRADE, "40"));
+    student_t back;
+    ASSERT_EQ(0, record_load(3, &back));
+    EXPECT_FLOAT_EQ(30.0f, back.average_grade);
+    EXPECT_EQ(-1, file_size("output_3.txt"));
+
+    record_use_store(nullptr);
+    btree_close(&tree);
+}
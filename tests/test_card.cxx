@@ -0,0 +1,129 @@
+#include <gtest/gtest.h>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+#include "test_util.h"
+
+extern "C" {
+#include "card.h"
+#include "record.h"
+#include "snapshot.h"
+}
+
+static void add_record(int id, int grade, float g) {
+    student_t s = make_student({.name = "Ana", .grade = grade, .subject_grade = g});
+    ASSERT_EQ(0, record_save(id, &s));
+}
+
+static std::string fetch(const report_template_t *tpl, int id, int *hit, rank_view_t *ranks = nullptr) {
+    char *card;
+    size_t length;
+    EXPECT_EQ(0, card_fetch(tpl, ranks, id, &card, &length, hit));
+    std::string s(card, length);
+    free(card);
+    return s;
+}
+
+TEST(CardCache, RepeatRequestIsServedFromCache) {
+    ScopedTempDir guard;
+    add_record(1, 10, 80.0f);
+    ASSERT_EQ(1, snapshot_build(SNAPSHOT_PATH, 1, 1));
+
+    report_template_t tpl;
+    ASSERT_EQ(0, report_compile(&tpl, "{NAME} {AVERAGE}"));
+    int hit;
+    EXPECT_EQ("Ana 80.00", fetch(&tpl, 1, &hit));
+    EXPECT_EQ(0, hit);
+    EXPECT_EQ("Ana 80.00", fetch(&tpl, 1, &hit));
+    EXPECT_EQ(1, hit);
+
+    // A different template never sees this entry
+    report_template_t other;
+    ASSERT_EQ(0, report_compile(&other, "{NAME}!"));
+    EXPECT_EQ("Ana!", fetch(&other, 1, &hit));
+    EXPECT_EQ(0, hit);
+
+    // No commit hook is attached: the record version alone catches the edit
+    ASSERT_EQ(0, record_update(1, FIELD_NAME, "Anabel"));
+    EXPECT_EQ("Anabel 80.00", fetch(&tpl, 1, &hit));
+    EXPECT_EQ(0, hit);
+    EXPECT_EQ("Anabel 80.00", fetch(&tpl, 1, &hit));
+    EXPECT_EQ(1, hit);
+
+    int missing;
+    char *card;
+    size_t length;
+    EXPECT_EQ(-1, card_fetch(&tpl, nullptr, 9, &card, &length, &missing));
+    report_template_free(&tpl);
+    report_template_free(&other);
+}
+
+TEST(CardCache, RendersTheStoredRecord) {
+    ScopedTempDir guard;
+    add_record(1, 10, 80.0f);
+    // A stale snapshot (here: none at all) never decides what a card shows
+    report_template_t tpl;
+    ASSERT_EQ(0, report_compile(&tpl, "{NAME} {AVERAGE}"));
+    int hit;
+    EXPECT_EQ("Ana 80.00", fetch(&tpl, 1, &hit));
+    EXPECT_EQ(0, hit);
+    report_template_free(&tpl);
+}
+
+TEST(CardCache, EditInvalidatesCard) {
+    ScopedTempDir guard;
+    ASSERT_EQ(0, card_cache_attach());
+    add_record(1, 10, 80.0f);
+    add_record(2, 10, 70.0f);
+    ASSERT_EQ(2, snapshot_build(SNAPSHOT_PATH, 1, 2));
+
+    report_template_t tpl;
+    ASSERT_EQ(0, report_compile(&tpl, "{AVERAGE}"));
+    int hit;
+    EXPECT_EQ("80.00", fetch(&tpl, 1, &hit));
+    EXPECT_EQ("70.00", fetch(&tpl, 2, &hit));
+
+    ASSERT_EQ(0, record_update(1, FIELD_SUBJECT1_GRADE, "100"));
+    EXPECT_EQ("85.00", fetch(&tpl, 1, &hit));
+    EXPECT_EQ(0, hit);
+    // Unranked cards of other students stay cached
+    EXPECT_EQ("70.00", fetch(&tpl, 2, &hit));
+    EXPECT_EQ(1, hit);
+
+    card_cache_detach();
+    report_template_free(&tpl);
+}
+
+TEST(CardCache, RankedCardsFollowClassmates) {
+    ScopedTempDir guard;
+    ASSERT_EQ(0, card_cache_attach());
+    add_record(1, 10, 80.0f);
+    add_record(2, 10, 70.0f);
+    ASSERT_EQ(2, snapshot_build(SNAPSHOT_PATH, 1, 2));
+    snapshot_t snap;
+    rank_view_t ranks;
+    ASSERT_EQ(0, snapshot_open(&snap, SNAPSHOT_PATH));
+    ASSERT_EQ(0, rank_init(&ranks));
+    ASSERT_EQ(0, rank_build(&ranks, &snap));
+    snapshot_close(&snap);
+    ASSERT_EQ(0, rank_attach(&ranks));
+
+    report_template_t tpl;
+    ASSERT_EQ(0, report_compile(&tpl, "{RANK}/{CLASS_SIZE}"));
+    int hit;
+    EXPECT_EQ("2/2", fetch(&tpl, 2, &hit, &ranks));
+    EXPECT_EQ("2/2", fetch(&tpl, 2, &hit, &ranks));
+    EXPECT_EQ(1, hit);
+
+    // Student 1 drops below student 2: student 2's card must change
+    ASSERT_EQ(0, record_update(1, FIELD_SUBJECT1_GRADE, "0"));
+    EXPECT_EQ("1/2", fetch(&tpl, 2, &hit, &ranks));
+    EXPECT_EQ(0, hit);
+
+    rank_detach(&ranks);
+    rank_free(&ranks);
+    card_cache_detach();
+    report_template_free(&tpl);
+}
@@ -0,0 +1,175 @@
+#include <gtest/gtest.h>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <string>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "test_util.h"
+
+extern "C" {
+#include "command.h"
+#include "record.h"
+#include "history.h"
+}
+
+static const char *const kAdd =
+    "add,Katherine,Johnson,26/08/2008,KJ1918,Joshua,Joylette,5550100,10,"
+    "Mathematics,90,Physics,80,Chemistry,70,Biology,60\n";
+
+// Runs script through command_run and returns what it wrote
+static std::string run(studentdb_t *db, const std::string &script, int *failed = nullptr) {
+    FILE *in = std::fopen("script.txt", "w");
+    std::fputs(script.c_str(), in);
+    std::fclose(in);
+    FILE *out = std::tmpfile();
+    int fd = open("script.txt", O_RDONLY);
+    int result = command_run(db, fd, out);
+    close(fd);
+    if (failed) {
+        *failed = result;
+    }
+    std::string text;
+    std::rewind(out);
+    char buf[4096];
+    size_t n;
+    while ((n = std::fread(buf, 1, sizeof(buf), out)) > 0) {
+        text.append(buf, n);
+    }
+    std::fclose(out);
+    return text;
+}
+
+static int saves = 0;
+static void count_saves(int, const student_t *, void *) {
+    saves++;
+}
+
+TEST(Command, AddEditGetQuery) {
+    ScopedTempDir guard;
+    studentdb_t db;
+    ASSERT_EQ(0, studentdb_open(&db));
+    std::string script = std::string("# enrolment\n") + kAdd + kAdd + "\n" +
+                         "edit,2,subject1_grade,50\n"
+                         "edit,1,1,Dorothy\n"
+                         "get,2\n" + kAdd +
+                         "query,1,2\n"
+                         "query,1,10,11\n";
+    int failed = -1;
+    std::string out = run(&db, script, &failed);
+    EXPECT_EQ(0, failed);
+    EXPECT_EQ("ok 1\n"
+              "ok 2\n"
+              "ok\n"
+              "ok\n"
+              "ok 1\n"
+              "2,Katherine,Johnson,26/08/2008,KJ1918,Joshua,Joylette,5550100,10,"
+              "Mathematics,50,Physics,80,Chemistry,70,Biology,60,65.00\n"
+              "ok 3\n"
+              "ok 2\n"
+              "1,Dorothy,Johnson,26/08/2008,KJ1918,Joshua,Joylette,5550100,10,"
+              "Mathematics,90,Physics,80,Chemistry,70,Biology,60,75.00\n"
+              "2,Katherine,Johnson,26/08/2008,KJ1918,Joshua,Joylette,5550100,10,"
+              "Mathematics,50,Physics,80,Chemistry,70,Biology,60,65.00\n"
+              "ok 0\n",
+              out);
+    EXPECT_EQ(4, studentdb_next_id());
+    studentdb_close(&db);
+}
+
+TEST(Command, RankFollowsEditsThroughTheAttachedView) {
+    ScopedTempDir guard;
+    studentdb_t db;
+    ASSERT_EQ(0, studentdb_open(&db));
+    EXPECT_EQ("ok 1\nok 2\n", run(&db, std::string(kAdd) + kAdd));
+    ASSERT_EQ(0, studentdb_attach_ranks(&db));
+
+    // Both average 75: a shared first place until student 1 drops
+    std::string out = run(&db, "rank,2\n"
+                               "edit,1,subject1_grade,10\n"
+                               "rank,1\n"
+                               "rank,2\n"
+                               "rank,9\n");
+    EXPECT_EQ("ok 1 2\nok\nok 2 2\nok 1 2\nerror 5: no such student\n", out);
+    studentdb_close(&db);
+}
+
+TEST(Command, FailedHistoryUpdateIsAWarning) {
+    ScopedTempDir guard;
+    studentdb_t db;
+    ASSERT_EQ(0, studentdb_open(&db));
+    std::ofstream(HISTORY_TERM_PATH) << "1\n";
+    EXPECT_EQ("ok 1\n", run(&db, kAdd));
+    char path[128];
+    history_path(1, path, sizeof(path));
+    std::ofstream(path) << "not a history file";
+
+    int failed = -1;
+    std::string out = run(&db, "edit,1,subject1_grade,50\n", &failed);
+    EXPECT_EQ("ok\nwarning 1: the grade history could not be updated\n", out);
+    EXPECT_EQ(1, failed);
+    student_t back;
+    ASSERT_EQ(0, studentdb_get(&db, 1, &back));
+    EXPECT_FLOAT_EQ(50.0f, back.subject1.grade);
+    studentdb_close(&db);
+}
+
+TEST(Command, ErrorsKeepInputOrder) {
+    ScopedTempDir guard;
+    studentdb_t db;
+    ASSERT_EQ(0, studentdb_open(&db));
+    std::string bad_dob = kAdd;
+    bad_dob.replace(bad_dob.find("26/08"), 5, "31/02");
+    std::string script = std::string(kAdd) + bad_dob + kAdd +
+                         "add,Too,Few\n"
+                         "edit,9,name,Mary\n"
+                         "edit,1,grade,13\n"
+                         "edit,1,nickname,Kat\n"
+                         "get,x\n"
+                         "frobnicate\n";
+    int failed = -1;
+    std::string out = run(&db, script, &failed);
+    EXPECT_EQ(7, failed);
+    EXPECT_EQ(0u, out.find("ok 1\nerror 2: dob: "));
+    EXPECT_NE(std::string::npos, out.find("\nok 2\nerror 4: add takes 16 columns\n"
+                                          "error 5: no such student\nerror 6: "));
+    EXPECT_NE(std::string::npos, out.find("\nerror 7: unknown field\n"
+                                          "error 8: usage: get,ID\n"
+                                          "error 9: unknown command\n"));
+    studentdb_close(&db);
+}
+
+TEST(Command, ConsecutiveAddsAreSavedAsOneBatch) {
+    ScopedTempDir guard;
+    studentdb_t db;
+    ASSERT_EQ(0, studentdb_open(&db));
+    ASSERT_EQ(0, studentdb_use_lsm(&db, nullptr));
+    saves = 0;
+    ASSERT_EQ(0, record_add_commit_hook(count_saves, nullptr));
+    std::string script;
+    for (int i = 0; i < 300; i++) {
+        script += kAdd;
+    }
+    script += "get,300\n";
+    int failed = -1;
+    std::string out = run(&db, script, &failed);
+    EXPECT_EQ(0, failed);
+    EXPECT_EQ(300, saves);
+    EXPECT_EQ(0u, out.find("ok 1\nok 2\n"));
+    EXPECT_NE(std::string::npos, out.find("ok 300\nok 1\n300,Katherine,"));
+    EXPECT_EQ(301, studentdb_next_id());
+    record_remove_commit_hook(count_saves, nullptr);
+    studentdb_close(&db);
+}
+
+TEST(Command, QuotedFieldsAndMissingFinalNewline) {
+    ScopedTempDir guard;
+    studentdb_t db;
+    ASSERT_EQ(0, studentdb_open(&db));
+    std::string out = run(&db, std::string(kAdd) + "  edit,1,\"family_name\",\"O'Neil\"\r\nget,1");
+    EXPECT_EQ("ok 1\nok\nok 1\n1,Katherine,O'Neil,26/08/2008,KJ1918,Joshua,Joylette,5550100,10,"
+              "Mathematics,90,Physics,80,Chemistry,70,Biology,60,75.00\n",
+              out);
+    studentdb_close(&db);
+}
@@ -0,0 +1,38 @@
+#include <gtest/gtest.h>
+#include <cstring>
+#include <vector>
+
+extern "C" {
+#include "crc32c.h"
+}
+
+TEST(Crc32c, KnownVectors) {
+    EXPECT_EQ(0u, crc32c(0, "", 0));
+    EXPECT_EQ(0xE3069283u, crc32c(0, "123456789", 9));
+    unsigned char zeros[32] = {};
+    EXPECT_EQ(0x8A9136AAu, crc32c(0, zeros, sizeof(zeros)));
+}
+
+TEST(Crc32c, KernelsAgreeAtEveryLengthAndAlignment) {
+    std::vector<unsigned char> data(300);
+    for (size_t i = 0; i < data.size(); i++) {
+        data[i] = (unsigned char)(i * 131 + 7);
+    }
+    for (size_t offset = 0; offset < 8; offset++) {
+        for (size_t length = 0; length + offset <= data.size(); length += 13) {
+            uint32_t expected = crc32c_with(CRC32C_KERNEL_SCALAR, 0, data.data() + offset, length);
+            if (crc32c_kernel_supported(CRC32C_KERNEL_SSE42)) {
+                ASSERT_EQ(expected, crc32c_with(CRC32C_KERNEL_SSE42, 0, data.data() + offset, length));
+            }
+            ASSERT_EQ(expected, crc32c(0, data.data() + offset, length));
+        }
+    }
+}
+
+TEST(Crc32c, ContinuesAcrossCalls) {
+    const char *text = "SCHEMA_VERSION = 3\nNAME = Rosa\n";
+    size_t length = std::strlen(text);
+    uint32_t whole = crc32c(0, text, length);
+    EXPECT_EQ(whole, crc32c(crc32c(0, text, 10), text + 10, length - 10));
+    EXPECT_EQ(whole, crc32c_with(CRC32C_KERNEL_SCALAR, crc32c(0, text, 5), text + 5, length - 5));
+}
@@ -0,0 +1,74 @@
+#include <gtest/gtest.h>
+#include <string>
+#include <vector>
+
+extern "C" {
+#include "csv.h"
+}
+
+static std::vector<std::vector<std::string>> split(const std::string &text, char separator, csv_kernel_t kernel) {
+    std::vector<std::vector<std::string>> rows;
+    csv_reader_t reader;
+    csv_field_t fields[8];
+    csv_reader_init(&reader, text.data(), text.size(), separator, kernel);
+
+    int count;
+    while ((count = csv_next_row(&reader, fields, 8)) >= 0) {
+        std::vector<std::string> row;
+        for (int i = 0; i < count && i < 8; i++) {
+            char buf[256];
+            csv_field_copy(&fields[i], buf, sizeof(buf));
+            row.push_back(buf);
+        }
+        rows.push_back(row);
+    }
+    return rows;
+}
+
+static const csv_kernel_t kKernels[] = { CSV_KERNEL_SCALAR, CSV_KERNEL_SSE2, CSV_KERNEL_AVX2 };
+
+TEST(Csv, QuotesEscapesAndLineEndings) {
+    std::string text = "a,\"b,c\",\"say \"\"hi\"\"\"\r\n"
+                       "\"multi\nline\",,x\n"
+                       "last,row,";
+    for (csv_kernel_t kernel : kKernels) {
+        if (!csv_kernel_supported(kernel)) {
+            continue;
+        }
+        auto rows = split(text, ',', kernel);
+        ASSERT_EQ(3u, rows.size()) << csv_kernel_name(kernel);
+        EXPECT_EQ((std::vector<std::string>{ "a", "b,c", "say \"hi\"" }), rows[0]);
+        EXPECT_EQ((std::vector<std::string>{ "multi\nline", "", "x" }), rows[1]);
+        EXPECT_EQ((std::vector<std::string>{ "last", "row", "" }), rows[2]);
+    }
+}
+
+TEST(Csv, KernelsAgreeAcrossBlockBoundaries) {
+    // Fields of every length around the 64-byte block size
+    std::string text;
+    for (int i = 0; i < 200; i++) {
+        text += std::string(i % 70, 'a' + i % 26) + "\t" + std::to_string(i) + "\t\"q\tq\"\n";
+    }
+    auto expected = split(text, '\t', CSV_KERNEL_SCALAR);
+    ASSERT_EQ(200u, expected.size());
+    EXPECT_EQ("q\tq", expected[199][2]);
+    for (csv_kernel_t kernel : kKernels) {
+        if (csv_kernel_supported(kernel)) {
+            EXPECT_EQ(expected, split(text, '\t', kernel)) << csv_kernel_name(kernel);
+        }
+    }
+}
+
+TEST(Csv, ReportsRowLinesAndZeroCopyViews) {
+    std::string text = "x,\"two\nlines\"\ny,z\n";
+    csv_reader_t reader;
+    csv_field_t fields[4];
+    csv_reader_init(&reader, text.data(), text.size(), ',', CSV_KERNEL_AUTO);
+
+    ASSERT_EQ(2, csv_next_row(&reader, fields, 4));
+    EXPECT_EQ(1, reader.row_line);
+    EXPECT_EQ(text.data(), fields[0].data);
+    ASSERT_EQ(2, csv_next_row(&reader, fields, 4));
+    EXPECT_EQ(3, reader.row_line);
+    EXPECT_EQ(-1, csv_next_row(&reader, fields, 4));
+}
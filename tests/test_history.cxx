@@ -0,0 +1,206 @@
+#include <gtest/gtest.h>
+#include <cerrno>
+#include <climits>
+#include <cstdio>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "test_util.h"
+
+extern "C" {
+#include "history.h"
+#include "record.h"
+}
+
+static long file_size(const char *path) {
+    FILE *f = fopen(path, "rb");
+    if (!f) {
+        return -1;
+    }
+    fseek(f, 0, SEEK_END);
+    long size = ftell(f);
+    fclose(f);
+    return size;
+}
+
+static student_t grades(float a, float b, float c, float d) {
+    student_t s = {};
+    s.subject1.grade = a;
+    s.subject2.grade = b;
+    s.subject3.grade = c;
+    s.subject4.grade = d;
+    return s;
+}
+
+TEST(History, RoundTripAcrossBlocks) {
+    ScopedTempDir guard;
+    const int terms = 3 * HISTORY_BLOCK + 5;
+    for (int i = 0; i < terms; i++) {
+        student_t s = grades(50 + i * 0.25f, 90 - i, 70.5f, (i % 2) ? 100 : 0);
+        ASSERT_EQ(0, history_record(7, 100 + i * 10, &s));
+    }
+
+    history_t h;
+    ASSERT_EQ(0, history_load(7, &h));
+    EXPECT_EQ((uint32_t)terms, h.header->count);
+    EXPECT_EQ(4u, h.header->block_count);
+
+    history_entry_t entries[64];
+    ASSERT_EQ(terms, history_range(&h, INT_MIN, INT_MAX, entries, 64));
+    for (int i = 0; i < terms; i++) {
+        EXPECT_EQ(100 + i * 10, entries[i].term);
+        EXPECT_FLOAT_EQ(50 + i * 0.25f, entries[i].grades[0]);
+        EXPECT_FLOAT_EQ(90.0f - i, entries[i].grades[1]);
+        EXPECT_FLOAT_EQ(70.5f, entries[i].grades[2]);
+        EXPECT_FLOAT_EQ((i % 2) ? 100.0f : 0.0f, entries[i].grades[3]);
+    }
+    history_free(&h);
+}
+
+TEST(History, RangeDecodesOnlyMatchingTerms) {
+    ScopedTempDir guard;
+    for (int i = 0; i < 40; i++) {
+        student_t s = grades((float)i, 0, 0, 0);
+        ASSERT_EQ(0, history_record(1, i + 1, &s));
+    }
+    history_t h;
+    ASSERT_EQ(0, history_load(1, &h));
+
+    history_entry_t entries[8];
+    // Straddles the boundary between the first and second block
+    ASSERT_EQ(5, history_range(&h, 14, 18, entries, 8));
+    for (int i = 0; i < 5; i++) {
+        EXPECT_EQ(14 + i, entries[i].term);
+        EXPECT_FLOAT_EQ((float)(13 + i), entries[i].grades[0]);
+    }
+    // Count covers the whole range even when the buffer is smaller
+    EXPECT_EQ(10, history_range(&h, 31, 45, entries, 8));
+    EXPECT_EQ(0, history_range(&h, 50, 60, entries, 8));
+    history_free(&h);
+}
+
+TEST(History, SameTermIsReplacedAndOlderTermRejected) {
+    ScopedTempDir guard;
+    student_t first = grades(60, 60, 60, 60);
+    student_t second = grades(80, 60, 60, 60);
+    ASSERT_EQ(0, history_record(2, 20241, &first));
+    ASSERT_EQ(0, history_record(2, 20242, &first));
+    ASSERT_EQ(0, history_record(2, 20242, &second));
+    EXPECT_EQ(-1, history_record(2, 20241, &second));
+
+    history_t h;
+    ASSERT_EQ(0, history_load(2, &h));
+    history_entry_t entries[4];
+    ASSERT_EQ(2, history_range(&h, INT_MIN, INT_MAX, entries, 4));
+    EXPECT_FLOAT_EQ(60.0f, entries[0].grades[0]);
+    EXPECT_FLOAT_EQ(80.0f, entries[1].grades[0]);
+    history_free(&h);
+}
+
+TEST(History, TrendAndGpa) {
+    ScopedTempDir guard;
+    for (int i = 0; i < 6; i++) {
+        student_t s = grades(50 + 5.0f * i, 80, 70 - 2.0f * i, 90);
+        ASSERT_EQ(0, history_record(3, 2020 + i, &s));
+    }
+    history_t h;
+    ASSERT_EQ(0, history_load(3, &h));
+
+    float slope;
+    ASSERT_EQ(0, history_trend(&h, 0, INT_MIN, INT_MAX, &slope));
+    EXPECT_NEAR(5.0f, slope, 1e-4);
+    ASSERT_EQ(0, history_trend(&h, 2, 2022, 2025, &slope));
+    EXPECT_NEAR(-2.0f, slope, 1e-4);
+    ASSERT_EQ(0, history_trend(&h, 1, INT_MIN, INT_MAX, &slope));
+    EXPECT_NEAR(0.0f, slope, 1e-4);
+    EXPECT_EQ(-1, history_trend(&h, 0, 2025, 2030, &slope));
+
+    history_gpa_t points[8];
+    ASSERT_EQ(2, history_gpa(&h, 2020, 2021, points, 8));
+    EXPECT_EQ(2020, points[0].term);
+    EXPECT_FLOAT_EQ((50 + 80 + 70 + 90) / 4.0f, points[0].average);
+    EXPECT_FLOAT_EQ((55 + 80 + 68 + 90) / 4.0f, points[1].average);
+    history_free(&h);
+}
+
+TEST(History, CorruptFileIsRejected) {
+    ScopedTempDir guard;
+    student_t s = grades(1, 2, 3, 4);
+    ASSERT_EQ(0, history_record(4, 1, &s));
+    ASSERT_EQ(0, history_record(4, 2, &s));
+
+    char path[64];
+    history_path(4, path, sizeof(path));
+    FILE *f = fopen(path, "ab");
+    fputc(0, f);
+    fclose(f);
+
+    history_t h;
+    EXPECT_EQ(-1, history_load(4, &h));
+    EXPECT_EQ(EINVAL, errno);
+    EXPECT_EQ(-1, history_load(5, &h));
+    EXPECT_EQ(ENOENT, errno);
+
+    // A damaged history is left for repair instead of being started over
+    long size = file_size(path);
+    EXPECT_EQ(-1, history_record(4, 3, &s));
+    EXPECT_EQ(size, file_size(path));
+}
+
+TEST(History, UpdateCurrentFollowsOpenTerm) {
+    ScopedTempDir guard;
+    student_t s = grades(40, 50, 60, 70);
+    ASSERT_EQ(0, record_save(5, &s));
+
+    // No open term: nothing is recorded
+    EXPECT_EQ(0, history_update_current(5));
+    history_t h;
+    EXPECT_EQ(-1, history_load(5, &h));
+
+    FILE *f = fopen(HISTORY_TERM_PATH, "w");
+    fprintf(f, "3\n");
+    fclose(f);
+    EXPECT_EQ(3, history_current_term());
+    ASSERT_EQ(0, history_update_current(5));
+    ASSERT_EQ(0, history_load(5, &h));
+    history_entry_t e;
+    ASSERT_EQ(1, history_range(&h, 3, 3, &e, 1));
+    EXPECT_FLOAT_EQ(70.0f, e.grades[3]);
+    history_free(&h);
+}
+
+TEST(History, ConcurrentEditsKeepLatestGrades) {
+    ScopedTempDir guard;
+    student_t s = grades(0, 0, 0, 0);
+    ASSERT_EQ(0, record_save(5, &s));
+    FILE *f = fopen(HISTORY_TERM_PATH, "w");
+    fprintf(f, "3\n");
+    fclose(f);
+
+    // Each thread edits its own subject; every edit re-records the term
+    std::vector<std::thread> editors;
+    for (int subject = 0; subject < HISTORY_SUBJECTS; subject++) {
+        editors.emplace_back([subject] {
+            for (int grade = 1; grade <= 40; grade++) {
+                std::string value = std::to_string(grade + subject);
+                if (record_update(5, static_cast<field_t>(FIELD_SUBJECT1_GRADE + subject), value.c_str()) != 0 ||
+                    history_update_current(5) != 0) {
+                    ADD_FAILURE() << "subject " << subject << " grade " << grade;
+                }
+            }
+        });
+    }
+    for (auto &editor : editors) {
+        editor.join();
+    }
+
+    history_t h;
+    ASSERT_EQ(0, history_load(5, &h));
+    history_entry_t e;
+    ASSERT_EQ(1, history_range(&h, 3, 3, &e, 1));
+    for (int subject = 0; subject < HISTORY_SUBJECTS; subject++) {
+        EXPECT_FLOAT_EQ(40.0f + subject, e.grades[subject]);
+    }
+    history_free(&h);
+}
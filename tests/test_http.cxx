@@ -0,0 +1,184 @@
+#include <gtest/gtest.h>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "test_util.h"
+
+extern "C" {
+#include "http.h"
+}
+
+static const char *const kStudent =
+    "{\"name\":\"Katherine\",\"family_name\":\"Johnson\",\"dob\":\"26/08/2008\",\"student_id\":\"KJ1918\","
+    "\"father_name\":\"Joshua\",\"mother_name\":\"Joylette\",\"phone\":\"5550100\",\"grade\":10,"
+    "\"subject1_name\":\"Mathematics\",\"subject1_grade\":90,\"subject2_name\":\"Physics\",\"subject2_grade\":80,"
+    "\"subject3_name\":\"Chemistry\",\"subject3_grade\":70,\"subject4_name\":\"Biology\",\"subject4_grade\":60}";
+
+struct Response {
+    int status;
+    std::string headers;
+    std::string body;
+};
+
+static int connect_to(int port) {
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    sockaddr_in addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(static_cast<uint16_t>(port));
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (connect(fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) != 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+static std::string request(const char *method, const std::string &target, const std::string &body = "",
+                           const char *extra = "") {
+    std::string text = std::string(method) + " " + target + " HTTP/1.1\r\nHost: localhost\r\n" + extra;
+    if (!body.empty()) {
+        text += "Content-Length: " + std::to_string(body.size()) + "\r\n";
+    }
+    return text + "\r\n" + body;
+}
+
+// Sends data in one write, then reads count responses (fewer if the server closes)
+static std::vector<Response> exchange(int fd, const std::string &data, size_t count) {
+    send(fd, data.data(), data.size(), MSG_NOSIGNAL);
+    std::vector<Response> responses;
+    std::string in;
+    char buf[65536];
+    while (responses.size() < count) {
+        size_t end = in.find("\r\n\r\n");
+        if (end != std::string::npos) {
+            size_t length_at = in.find("Content-Length: ");
+            size_t length = std::strtoul(in.c_str() + length_at + 16, nullptr, 10);
+            if (in.size() >= end + 4 + length) {
+                responses.push_back({ std::atoi(in.c_str() + 9), in.substr(0, end), in.substr(end + 4, length) });
+                in.erase(0, end + 4 + length);
+                continue;
+            }
+        }
+        ssize_t got = recv(fd, buf, sizeof(buf), 0);
+        if (got <= 0) {
+            break;
+        }
+        in.append(buf, static_cast<size_t>(got));
+    }
+    return responses;
+}
+
+class HttpTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        ASSERT_EQ(0, studentdb_open(&db));
+        ASSERT_EQ(0, http_server_start(&server, &db, 0));
+        fd = connect_to(server.net.port);
+        ASSERT_GE(fd, 0);
+    }
+    void TearDown() override {
+        close(fd);
+        http_server_stop(&server);
+        studentdb_close(&db);
+    }
+    ScopedTempDir guard;
+    studentdb_t db;
+    http_server_t server;
+    int fd = -1;
+};
+
+TEST_F(HttpTest, PipelinedRequestsOnOneConnection) {
+    std::string pipeline = request("POST", "/students", kStudent) + request("POST", "/students", kStudent) +
+                           request("GET", "/students/2") +
+                           request("PATCH", "/students/1", "{\"name\":\"Dorothy\",\"subject1_grade\":\"50\"}") +
+                           request("GET", "/students?from=1&to=9&class=10") + request("GET", "/students/7");
+    auto responses = exchange(fd, pipeline, 6);
+    ASSERT_EQ(6u, responses.size());
+    EXPECT_EQ(201, responses[0].status);
+    EXPECT_EQ("{\"id\":1}", responses[0].body);
+    EXPECT_EQ("{\"id\":2}", responses[1].body);
+    EXPECT_EQ(200, responses[2].status);
+    EXPECT_EQ(0u, responses[2].body.find("{\"id\":2,\"name\":\"Katherine\",\"family_name\":\"Johnson\""));
+    EXPECT_NE(std::string::npos, responses[2].body.find("\"average\":75}"));
+    EXPECT_EQ(200, responses[3].status);
+    EXPECT_NE(std::string::npos, responses[3].body.find("\"name\":\"Dorothy\""));
+    EXPECT_NE(std::string::npos, responses[3].body.find("\"average\":65}"));
+    EXPECT_EQ(0u, responses[4].body.find("[{\"id\":1,"));
+    EXPECT_NE(std::string::npos, responses[4].body.find("},{\"id\":2,"));
+    EXPECT_EQ(404, responses[5].status);
+    EXPECT_NE(std::string::npos, responses[5].headers.find("Connection: keep-alive"));
+
+    // The connection is still usable
+    responses = exchange(fd, request("GET", "/students/1"), 1);
+    ASSERT_EQ(1u, responses.size());
+    EXPECT_EQ(200, responses[0].status);
+    EXPECT_EQ(3, studentdb_next_id());
+}
+
+TEST_F(HttpTest, RankComesFromTheAttachedView) {
+    // No request is in flight yet, so the view can still be attached
+    ASSERT_EQ(0, studentdb_attach_ranks(&db));
+    std::string pipeline = request("POST", "/students", kStudent) + request("POST", "/students", kStudent) +
+                           request("PATCH", "/students/1", "{\"subject1_grade\":\"10\"}") +
+                           request("GET", "/students/1/rank") + request("GET", "/students/9/rank") +
+                           request("PATCH", "/students/1/rank", "{}");
+    auto responses = exchange(fd, pipeline, 6);
+    ASSERT_EQ(6u, responses.size());
+    EXPECT_EQ(200, responses[3].status);
+    EXPECT_EQ("{\"rank\":2,\"class_size\":2}", responses[3].body);
+    EXPECT_EQ(404, responses[4].status);
+    EXPECT_EQ(405, responses[5].status);
+}
+
+TEST_F(HttpTest, RejectsBadInputWithoutChanges) {
+    std::string bad_dob = kStudent;
+    bad_dob.replace(bad_dob.find("26/08"), 5, "31/02");
+    std::string missing = "{\"name\":\"Ada\"}";
+    auto responses = exchange(fd,
+                              request("POST", "/students", bad_dob) + request("POST", "/students", missing) +
+                                  request("POST", "/students", "{\"name\":") + request("POST", "/students", kStudent) +
+                                  request("PATCH", "/students/1", "{\"name\":\"Dorothy\",\"grade\":13}") +
+                                  request("PATCH", "/students/1", "{\"nickname\":\"Kat\"}") +
+                                  request("PATCH", "/students/9", "{\"name\":\"Dorothy\"}") +
+                                  request("DELETE", "/students/1") + request("GET", "/teachers") +
+                                  request("GET", "/students?limit=3"),
+                              10);
+    ASSERT_EQ(10u, responses.size());
+    const int expected[] = { 400, 400, 400, 201, 400, 400, 404, 405, 404, 400 };
+    for (size_t i = 0; i < 10; i++) {
+        EXPECT_EQ(expected[i], responses[i].status) << i;
+    }
+    EXPECT_EQ(0u, responses[0].body.find("{\"error\":\"dob: "));
+    EXPECT_EQ("{\"error\":\"dob: missing\"}", responses[1].body);
+    EXPECT_EQ("{\"id\":1}", responses[3].body);
+    student_t back;
+    ASSERT_EQ(0, studentdb_get(&db, 1, &back));
+    EXPECT_STREQ("Katherine", str_get(&back.name));
+}
+
+TEST_F(HttpTest, ConnectionCloseAndMalformedRequests) {
+    auto responses = exchange(fd, request("GET", "/students/1", "", "Connection: close\r\n") + request("GET", "/"), 2);
+    ASSERT_EQ(1u, responses.size());
+    EXPECT_NE(std::string::npos, responses[0].headers.find("Connection: close"));
+    char byte;
+    EXPECT_EQ(0, recv(fd, &byte, 1, 0));
+
+    int other = connect_to(server.net.port);
+    responses = exchange(other, "GET /students/1 SPDY/9\r\n\r\n", 1);
+    ASSERT_EQ(1u, responses.size());
+    EXPECT_EQ(400, responses[0].status);
+    close(other);
+
+    other = connect_to(server.net.port);
+    responses = exchange(other, "POST /students HTTP/1.1\r\nContent-Length: 999999\r\n\r\n", 1);
+    ASSERT_EQ(1u, responses.size());
+    EXPECT_EQ(413, responses[0].status);
+    close(other);
+}
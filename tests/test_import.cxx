@@ -0,0 +1,123 @@
+#include <gtest/gtest.h>
+#include <fstream>
+#include <string>
+
+#include "test_util.h"
+
+extern "C" {
+#include "import.h"
+#include "record.h"
+#include "store.h"
+}
+
+static const char *kRow =
+    "Rosa,Perez,12/02/2009,rp32144,George,Lisa,93213124,11,CP1,99,ADS,66,CANTO,33,TECH,1\n";
+
+TEST(Import, AssignsIdsInInputOrder) {
+    ScopedTempDir guard;
+    std::ofstream("data/next_id.txt") << "5\n";
+    {
+        std::ofstream csv("roster.csv");
+        csv << "name,family_name,dob,student_id,father_name,mother_name,phone,grade,"
+               "subject1_name,subject1_grade,subject2_name,subject2_grade,"
+               "subject3_name,subject3_grade,subject4_name,subject4_grade\n";
+        for (int i = 0; i < 200; i++) {
+            csv << "Kid,Fam,01/01/2010,k" << i << ",Dad,Mum,555,"
+                << (1 + i % 12) << ",Math," << (i % 100) << ",Art,50,Bio,50,Chem,50\n";
+        }
+    }
+
+    FILE *errors = std::tmpfile();
+    import_options_t options = { .writers = 3, .queue_capacity = 8, .counter_path = "data/next_id.txt",
+                                  .errors = errors, .separator = ',' };
+    import_result_t result;
+    ASSERT_EQ(0, import_csv("roster.csv", &options, &result));
+    std::fclose(errors);
+
+    EXPECT_EQ(200, result.rows);
+    EXPECT_EQ(200, result.imported);
+    EXPECT_EQ(0, result.rejected);
+    EXPECT_EQ(5, result.first_id);
+    EXPECT_EQ(204, result.last_id);
+    for (int stage = 0; stage < IMPORT_STAGE_COUNT; stage++) {
+        EXPECT_EQ(200, result.stages[stage].rows) << stage;
+    }
+
+    // Row i always lands on ID 5 + i
+    student_t s;
+    ASSERT_EQ(0, record_load(5 + 37, &s));
+    EXPECT_STREQ("k37", s.studentid);
+    EXPECT_FLOAT_EQ((37 + 150) / 4.0f, s.average_grade);
+
+    std::ifstream counter("data/next_id.txt");
+    int next = 0;
+    counter >> next;
+    EXPECT_EQ(205, next);
+}
+
+TEST(Import, RejectsInvalidRowsWithoutConsumingIds) {
+    ScopedTempDir guard;
+    std::ofstream("data/next_id.txt") << "1\n";
+    {
+        std::ofstream csv("roster.csv");
+        csv << kRow;
+        csv << "R0sa,Perez,12/02/2009,rp2,George,Lisa,93213124,11,CP1,99,ADS,66,CANTO,33,TECH,1\n";
+        csv << "\"Ana\",\"Lopez\",31/04/2009,al3,Jose,Maria,555,10,CP1,1,ADS,2,CANTO,3,TECH,4\n";
+        csv << "too,few,fields\n";
+        csv << "\"Ana\",\"O'Brien\",01/04/2009,al4,Jose,Maria,555,10,CP1,1,ADS,2,CANTO,3,TECH,4\n";
+    }
+
+    char *buffer = nullptr;
+    size_t size = 0;
+    FILE *errors = open_memstream(&buffer, &size);
+    import_options_t options = { .writers = 1, .queue_capacity = 4, .counter_path = "data/next_id.txt",
+                                  .errors = errors, .separator = ',' };
+    import_result_t result;
+    ASSERT_EQ(0, import_csv("roster.csv", &options, &result));
+    std::fclose(errors);
+    std::string report(buffer, size);
+    free(buffer);
+
+    EXPECT_EQ(5, result.rows);
+    EXPECT_EQ(2, result.imported);
+    EXPECT_EQ(3, result.rejected);
+    EXPECT_NE(report.find("line 2: name"), std::string::npos);
+    EXPECT_NE(report.find("line 3: dob"), std::string::npos);
+    EXPECT_NE(report.find("line 4: wrong number of fields"), std::string::npos);
+
+    student_t s;
+    ASSERT_EQ(0, record_load(2, &s));
+    EXPECT_STREQ("O'Brien", str_get(&s.family_name));
+}
+
+TEST(Import, WritesToSelectedStore) {
+    ScopedTempDir guard;
+    std::ofstream("data/next_id.txt") << "1\n";
+    {
+        std::ofstream csv("roster.csv");
+        for (int i = 0; i < 20; i++) {
+            csv << kRow;
+        }
+    }
+    btree_t tree;
+    ASSERT_EQ(0, btree_open(&tree, BTREE_PATH));
+    store_t store;
+    store_btree(&store, &tree);
+    record_use_store(&store);
+
+    FILE *errors = std::tmpfile();
+    import_options_t options = { .writers = 2, .queue_capacity = 4, .counter_path = "data/next_id.txt",
+                                  .errors = errors, .separator = ',' };
+    import_result_t result;
+    ASSERT_EQ(0, import_csv("roster.csv", &options, &result));
+    std::fclose(errors);
+    EXPECT_EQ(20, result.imported);
+
+    student_t s;
+    ASSERT_EQ(0, btree_load(&tree, 20, &s));
+    EXPECT_STREQ("rp32144", s.studentid);
+    EXPECT_FALSE(std::ifstream("output_20.txt").good());
+
+    record_use_store(nullptr);
+    btree_close(&tree);
+}
@@ -0,0 +1,87 @@
+#include <gtest/gtest.h>
+#include <cerrno>
+#include <string>
+#include <thread>
+#include <vector>
+
+extern "C" {
+#include "intern.h"
+#include "str.h"
+}
+
+TEST(Intern, EqualStringsShareOneCopy) {
+    std::string a = "Maximilian-Alexander";
+    std::string b = a;
+    const char *pa = intern(a.c_str());
+    const char *pb = intern_n(b.data(), b.size());
+    EXPECT_EQ(pa, pb);
+    EXPECT_NE(a.c_str(), pa);
+    EXPECT_STREQ("Maximilian-Alexander", pa);
+    EXPECT_NE(pa, intern("Maximilian-Alexandra"));
+
+    // Not NUL-terminated input
+    EXPECT_EQ(intern("Maxim"), intern_n("Maximilian", 5));
+}
+
+TEST(Intern, ConcurrentCallersAgree) {
+    const int kThreads = 4;
+    const int kNames = 2000;
+    std::vector<std::vector<const char *>> seen(kThreads, std::vector<const char *>(kNames));
+    std::vector<std::thread> threads;
+    for (int t = 0; t < kThreads; t++) {
+        threads.emplace_back([&, t] {
+            for (int i = 0; i < kNames; i++) {
+                std::string name = "Concurrent-Parent-Name-" + std::to_string(i);
+                seen[t][i] = intern(name.c_str());
+            }
+        });
+    }
+    for (auto &thread : threads) {
+        thread.join();
+    }
+    for (int t = 1; t < kThreads; t++) {
+        EXPECT_EQ(seen[0], seen[t]);
+    }
+
+    intern_stats_t stats;
+    intern_stats(&stats);
+    EXPECT_GE(stats.strings, (size_t)kNames);
+    EXPECT_GE(stats.hits, (size_t)(kThreads - 1) * kNames);
+}
+
+TEST(Intern, LongStrValuesCompareByPointer) {
+    str_t a, b, c;
+    str_set(&a, "Bartholomew-Fitzgerald");
+    str_set(&b, "Bartholomew-Fitzgerald");
+    str_set(&c, "Bartholomew");
+    EXPECT_EQ(a.heap.ptr, b.heap.ptr);
+    EXPECT_TRUE(str_eq(&a, &b));
+    EXPECT_FALSE(str_eq(&a, &c));
+}
+
+TEST(Intern, FullPoolRefusesNewStringsButFindsOldOnes) {
+    const char *old = intern("Pool-Limit-Existing-Name");
+    intern_stats_t before;
+    intern_stats(&before);
+
+    intern_set_limit(before.bytes);
+    std::string fresh(2000, 'x');
+    errno = 0;
+    EXPECT_EQ(nullptr, intern(fresh.c_str()));
+    EXPECT_EQ(ENOMEM, errno);
+    EXPECT_EQ(old, intern("Pool-Limit-Existing-Name"));
+
+    str_t s;
+    str_set(&s, "Pool-Limit-Existing-Name");
+    EXPECT_EQ(-1, str_set(&s, fresh.c_str()));
+    EXPECT_STREQ("Pool-Limit-Existing-Name", str_get(&s));
+    EXPECT_EQ(0, str_set(&s, "short"));
+
+    intern_stats_t after;
+    intern_stats(&after);
+    EXPECT_EQ(before.bytes, after.limit);
+    EXPECT_GE(after.refused, before.refused + 2);
+
+    intern_set_limit(INTERN_DEFAULT_LIMIT);
+    EXPECT_NE(nullptr, intern(fresh.c_str()));
+}
@@ -0,0 +1,80 @@
+#include <gtest/gtest.h>
+#include <cstdio>
+#include <cstring>
+#include <string>
+
+extern "C" {
+#include "json.h"
+}
+
+static std::string text(const json_buf_t &buf) {
+    return std::string(buf.data, buf.length);
+}
+
+TEST(Json, StudentIsOneFlatObject) {
+    student_t s = {};
+    s.student_id = 12;
+    str_set(&s.name, "Ada");
+    str_set(&s.family_name, "O\"Hara\\\n");
+    std::snprintf(s.dateofbirth, sizeof(s.dateofbirth), "10/12/2008");
+    std::snprintf(s.studentid, sizeof(s.studentid), "AL1");
+    std::snprintf(s.phone_number, sizeof(s.phone_number), "555");
+    s.grade = 9;
+    s.subject1.grade = 90.5f;
+    s.subject2.grade = 80.0f;
+    s.subject3.grade = 66.666f;
+    s.subject4.grade = 0.05f;
+    s.average_grade = 59.3f;
+    json_buf_t buf = {};
+    json_student(&buf, &s);
+    EXPECT_EQ("{\"id\":12,\"name\":\"Ada\",\"family_name\":\"O\\\"Hara\\\\\\u000a\",\"dob\":\"10/12/2008\","
+              "\"student_id\":\"AL1\",\"father_name\":\"\",\"mother_name\":\"\",\"phone\":\"555\",\"grade\":9,"
+              "\"subject1_name\":\"\",\"subject1_grade\":90.5,\"subject2_name\":\"\",\"subject2_grade\":80,"
+              "\"subject3_name\":\"\",\"subject3_grade\":66.67,\"subject4_name\":\"\",\"subject4_grade\":0.05,"
+              "\"average\":59.3}",
+              text(buf));
+    json_buf_free(&buf);
+
+    json_int(&buf, -2147483647L - 1);
+    json_buf_append(&buf, " ", 1);
+    json_grade(&buf, -0.5f);
+    EXPECT_EQ("-2147483648 -0.5", text(buf));
+    json_buf_free(&buf);
+}
+
+TEST(Json, ParsesFlatObjects) {
+    const char *body = " { \"name\" : \"Ada \\\"A\\\" \\u00e9\\ud83d\\ude00\", \"grade\":9,\"x\":-1.5e2,"
+                       "\"t\":true,\"n\":null }\r\n";
+    json_member_t members[8];
+    ASSERT_EQ(5, json_parse_object(body, std::strlen(body), members, 8));
+    EXPECT_TRUE(json_key_is(&members[0], "name"));
+    EXPECT_EQ(JSON_STRING, members[0].type);
+    char value[64];
+    json_copy(&members[0].value, value, sizeof(value));
+    EXPECT_STREQ("Ada \"A\" \xc3\xa9\xf0\x9f\x98\x80", value);
+    EXPECT_EQ(JSON_NUMBER, members[1].type);
+    json_copy(&members[1].value, value, sizeof(value));
+    EXPECT_STREQ("9", value);
+    json_copy(&members[2].value, value, sizeof(value));
+    EXPECT_STREQ("-1.5e2", value);
+    EXPECT_EQ(JSON_TRUE, members[3].type);
+    EXPECT_EQ(JSON_NULL, members[4].type);
+
+    // Truncation keeps whole characters
+    json_copy(&members[0].value, value, 10);
+    EXPECT_STREQ("Ada \"A\" ", value);
+    EXPECT_EQ(0, json_parse_object("{}", 2, members, 8));
+}
+
+TEST(Json, RejectsWhatItDoesNotHandle) {
+    const char *bad[] = {
+        "", "[]", "{\"a\":{}}", "{\"a\":[1]}", "{\"a\":1,}", "{\"a\" 1}", "{\"a\":\"x}",
+        "{\"a\":1} x", "{a:1}", "{\"a\":tru}", "{\"a\":-}", "{\"a\":\"\x01\"}",
+    };
+    json_member_t members[2];
+    for (const char *body : bad) {
+        EXPECT_EQ(-1, json_parse_object(body, std::strlen(body), members, 2)) << body;
+    }
+    const char *many = "{\"a\":1,\"b\":2,\"c\":3}";
+    EXPECT_EQ(-1, json_parse_object(many, std::strlen(many), members, 2));
+}
@@ -0,0 +1,340 @@
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include <dirent.h>
+#include <sys/stat.h>
+
+#include "test_util.h"
+
+extern "C" {
+#include "lsm.h"
+#include "record.h"
+#include "store.h"
+}
+
+// Number of files in LSM_DIR whose names start with prefix
+static int count_files(const char *prefix) {
+    int count = 0;
+    DIR *dir = opendir(LSM_DIR);
+    if (!dir) {
+        return -1;
+    }
+    while (struct dirent *entry = readdir(dir)) {
+        count += std::strncmp(entry->d_name, prefix, std::strlen(prefix)) == 0;
+    }
+    closedir(dir);
+    return count;
+}
+
+TEST(Lsm, PutGetDeleteAcrossFlushes) {
+    ScopedTempDir guard;
+    lsm_t lsm;
+    ASSERT_EQ(0, lsm_open(&lsm, LSM_DIR, nullptr));
+
+    student_t s = make_student({.id = 5, .subject_grade = 70.5f});
+    std::string long_name(3000, 'q');
+    str_set(&s.father_name, long_name.c_str());
+    ASSERT_EQ(0, lsm_put(&lsm, 5, &s));
+    for (int id = 6; id <= 20; id++) {
+        student_t other = make_student({.id = id, .subject_grade = (float)id});
+        ASSERT_EQ(0, lsm_put(&lsm, id, &other));
+    }
+    ASSERT_EQ(0, lsm_flush(&lsm));
+
+    // Newer versions in the memtable shadow the run
+    s.average_grade = 90.0f;
+    ASSERT_EQ(0, lsm_put(&lsm, 5, &s));
+    ASSERT_EQ(0, lsm_delete(&lsm, 6));
+
+    student_t back;
+    ASSERT_EQ(0, lsm_get(&lsm, 5, &back));
+    EXPECT_FLOAT_EQ(90.0f, back.average_grade);
+    EXPECT_EQ(long_name, str_get(&back.father_name));
+    EXPECT_STREQ("kj00005", back.studentid);
+    EXPECT_EQ(-1, lsm_get(&lsm, 6, &back));
+    ASSERT_EQ(0, lsm_get(&lsm, 7, &back));
+    EXPECT_FLOAT_EQ(7.0f, back.average_grade);
+
+    // ...and still do once they are in a newer run
+    ASSERT_EQ(0, lsm_flush(&lsm));
+    EXPECT_EQ(-1, lsm_get(&lsm, 6, &back));
+    ASSERT_EQ(0, lsm_get(&lsm, 5, &back));
+    EXPECT_FLOAT_EQ(90.0f, back.average_grade);
+
+    lsm_stats_t stats;
+    lsm_get_stats(&lsm, &stats);
+    EXPECT_EQ(2, stats.runs);
+    EXPECT_EQ(2, stats.flushes);
+    EXPECT_EQ(0, stats.memtable_entries);
+
+    std::string huge(9000, 'z');
+    str_set(&s.name, huge.c_str());
+    errno = 0;
+    EXPECT_EQ(-1, lsm_put(&lsm, 9, &s));
+    EXPECT_EQ(E2BIG, errno);
+    lsm_close(&lsm);
+}
+
+TEST(Lsm, BloomFiltersSkipRuns) {
+    ScopedTempDir guard;
+    lsm_t lsm;
+    ASSERT_EQ(0, lsm_open(&lsm, LSM_DIR, nullptr));
+    // Three runs with disjoint IDs
+    for (int run = 0; run < 3; run++) {
+        for (int id = run * 1000 + 1; id <= run * 1000 + 500; id++) {
+            student_t s = make_student({.id = id, .subject_grade = 1.0f});
+            ASSERT_EQ(0, lsm_put(&lsm, id, &s));
+        }
+        ASSERT_EQ(0, lsm_flush(&lsm));
+    }
+    student_t back;
+    for (int id = 1; id <= 500; id++) {
+        ASSERT_EQ(0, lsm_get(&lsm, id, &back));
+    }
+    lsm_stats_t stats;
+    lsm_get_stats(&lsm, &stats);
+    // 1000 lookups in the two newer runs; ~1% false positives at 10 bits per ID
+    EXPECT_GT(stats.bloom_skips, 950);
+    lsm_close(&lsm);
+}
+
+TEST(Lsm, CompactionMergesRunsAndDropsDeletes) {
+    ScopedTempDir guard;
+    lsm_t lsm;
+    lsm_options_t options = { 0, 8, 0 };
+    ASSERT_EQ(0, lsm_open(&lsm, LSM_DIR, &options));
+    for (int round = 0; round < 4; round++) {
+        for (int id = 1; id <= 300; id++) {
+            student_t s = make_student({.id = id, .subject_grade = (float)round});
+            ASSERT_EQ(0, lsm_put(&lsm, id, &s));
+        }
+        ASSERT_EQ(0, lsm_flush(&lsm));
+    }
+    for (int id = 1; id <= 300; id += 3) {
+        ASSERT_EQ(0, lsm_delete(&lsm, id));
+    }
+    ASSERT_EQ(0, lsm_flush(&lsm));
+    EXPECT_EQ(5, count_files("run_"));
+
+    ASSERT_EQ(0, lsm_compact(&lsm));
+    lsm_stats_t stats;
+    lsm_get_stats(&lsm, &stats);
+    EXPECT_EQ(1, stats.runs);
+    EXPECT_EQ(1, stats.compactions);
+    EXPECT_EQ(1, count_files("run_"));
+    EXPECT_EQ(200u, lsm.runs[0]->header->count);
+
+    student_t back;
+    EXPECT_EQ(-1, lsm_get(&lsm, 1, &back));
+    ASSERT_EQ(0, lsm_get(&lsm, 2, &back));
+    EXPECT_FLOAT_EQ(3.0f, back.average_grade);
+    lsm_close(&lsm);
+
+    // The MANIFEST names the merged run only
+    ASSERT_EQ(0, lsm_open(&lsm, LSM_DIR, nullptr));
+    lsm_get_stats(&lsm, &stats);
+    EXPECT_EQ(1, stats.runs);
+    std::vector<int> seen;
+    EXPECT_EQ(200, lsm_scan(&lsm, INT32_MIN, INT32_MAX, collect_ids, &seen));
+    lsm_close(&lsm);
+}
+
+TEST(Lsm, BackgroundCompactionKeepsRunCountLow) {
+    ScopedTempDir guard;
+    lsm_t lsm;
+    lsm_options_t options = { 16 * 1024, 3, 0 };
+    ASSERT_EQ(0, lsm_open(&lsm, LSM_DIR, &options));
+    for (int id = 1; id <= 5000; id++) {
+        student_t s = make_student({.id = id % 700 + 1, .subject_grade = (float)id});
+        ASSERT_EQ(0, lsm_put(&lsm, id % 700 + 1, &s));
+    }
+    ASSERT_EQ(0, lsm_flush(&lsm));
+    lsm_stats_t stats;
+    lsm_get_stats(&lsm, &stats);
+    EXPECT_GT(stats.flushes, 3);
+    EXPECT_GT(stats.compactions, 0);
+    EXPECT_LE(stats.runs, 4);
+
+    // Every ID holds its last write
+    student_t back;
+    ASSERT_EQ(0, lsm_get(&lsm, 5000 % 700 + 1, &back));
+    EXPECT_FLOAT_EQ(5000.0f, back.average_grade);
+    std::vector<int> seen;
+    EXPECT_EQ(700, lsm_scan(&lsm, INT32_MIN, INT32_MAX, collect_ids, &seen));
+    lsm_close(&lsm);
+}
+
+TEST(Lsm, ReopenReplaysWalAndIgnoresTornTail) {
+    ScopedTempDir guard;
+    lsm_t lsm;
+    ASSERT_EQ(0, lsm_open(&lsm, LSM_DIR, nullptr));
+    for (int id = 1; id <= 10; id++) {
+        student_t s = make_student({.id = id, .subject_grade = (float)id});
+        ASSERT_EQ(0, lsm_put(&lsm, id, &s));
+    }
+    ASSERT_EQ(0, lsm_delete(&lsm, 4));
+    uint64_t wal = lsm.active.wal_seq;
+    lsm_close(&lsm);
+
+    // A crash mid-append leaves half a record at the end of the log
+    char path[300];
+    std::snprintf(path, sizeof(path), "%s/wal_%llu.log", LSM_DIR, (unsigned long long)wal);
+    FILE *file = std::fopen(path, "ab");
+    ASSERT_NE(nullptr, file);
+    std::fputs("\x01\x02\x03\x04\x05\x06", file);
+    std::fclose(file);
+
+    ASSERT_EQ(0, lsm_open(&lsm, LSM_DIR, nullptr));
+    student_t back;
+    ASSERT_EQ(0, lsm_get(&lsm, 10, &back));
+    EXPECT_FLOAT_EQ(10.0f, back.average_grade);
+    EXPECT_EQ(-1, lsm_get(&lsm, 4, &back));
+    lsm_stats_t stats;
+    lsm_get_stats(&lsm, &stats);
+    // Recovery wrote the log into a run and removed it
+    EXPECT_EQ(1, stats.runs);
+    EXPECT_EQ(1, count_files("wal_"));
+    lsm_close(&lsm);
+}
+
+TEST(Lsm, FlushedWalIsNeverReplayed) {
+    ScopedTempDir guard;
+    lsm_t lsm;
+    ASSERT_EQ(0, lsm_open(&lsm, LSM_DIR, nullptr));
+    student_t s = make_student({.id = 1, .subject_grade = 10.0f});
+    ASSERT_EQ(0, lsm_put(&lsm, 1, &s));
+    char wal[300];
+    std::snprintf(wal, sizeof(wal), "%s/wal_%llu.log", LSM_DIR, (unsigned long long)lsm.active.wal_seq);
+    std::string saved = std::string(wal) + ".saved";
+    {
+        std::ifstream in(wal, std::ios::binary);
+        std::ofstream out(saved, std::ios::binary);
+        out << in.rdbuf();
+    }
+    ASSERT_EQ(0, lsm_flush(&lsm));
+
+    s.average_grade = 20.0f;
+    ASSERT_EQ(0, lsm_put(&lsm, 1, &s));
+    ASSERT_EQ(0, lsm_flush(&lsm));
+    ASSERT_EQ(0, lsm_compact(&lsm));
+    lsm_close(&lsm);
+
+    // A WAL whose removal failed after its flush must stay flushed
+    ASSERT_EQ(0, std::rename(saved.c_str(), wal));
+    ASSERT_EQ(0, lsm_open(&lsm, LSM_DIR, nullptr));
+    student_t back;
+    ASSERT_EQ(0, lsm_get(&lsm, 1, &back));
+    EXPECT_FLOAT_EQ(20.0f, back.average_grade);
+    lsm_close(&lsm);
+}
+
+TEST(Lsm, SecondOpenIsRefused) {
+    ScopedTempDir guard;
+    lsm_t lsm;
+    ASSERT_EQ(0, lsm_open(&lsm, LSM_DIR, nullptr));
+    lsm_t other;
+    EXPECT_EQ(-1, lsm_open(&other, LSM_DIR, nullptr));
+    EXPECT_EQ(EWOULDBLOCK, errno);
+    lsm_close(&lsm);
+    ASSERT_EQ(0, lsm_open(&other, LSM_DIR, nullptr));
+    lsm_close(&other);
+}
+
+TEST(Lsm, DestroyRemovesTheStore) {
+    ScopedTempDir guard;
+    lsm_t lsm;
+    ASSERT_EQ(0, lsm_open(&lsm, LSM_DIR, nullptr));
+    student_t s = make_student({.id = 1, .subject_grade = 50.0f});
+    ASSERT_EQ(0, lsm_put(&lsm, 1, &s));
+    ASSERT_EQ(0, lsm_flush(&lsm));
+    lsm_close(&lsm);
+
+    ASSERT_EQ(0, lsm_destroy(LSM_DIR));
+    struct stat st;
+    EXPECT_NE(0, stat(LSM_DIR, &st));
+    EXPECT_EQ(0, lsm_destroy(LSM_DIR));
+}
+
+TEST(Lsm, ScanMergesMemtableAndRuns) {
+    ScopedTempDir guard;
+    lsm_t lsm;
+    lsm_options_t options = { 0, 8, 0 };
+    ASSERT_EQ(0, lsm_open(&lsm, LSM_DIR, &options));
+    for (int id = 1; id <= 100; id += 2) {
+        student_t s = make_student({.id = id, .subject_grade = 1.0f});
+        ASSERT_EQ(0, lsm_put(&lsm, id, &s));
+    }
+    ASSERT_EQ(0, lsm_flush(&lsm));
+    for (int id = 2; id <= 100; id += 2) {
+        student_t s = make_student({.id = id, .subject_grade = 2.0f});
+        ASSERT_EQ(0, lsm_put(&lsm, id, &s));
+    }
+    ASSERT_EQ(0, lsm_delete(&lsm, 51));
+
+    std::vector<int> seen;
+    EXPECT_EQ(20, lsm_scan(&lsm, 41, 61, collect_ids, &seen));
+    ASSERT_EQ(20u, seen.size());
+    EXPECT_TRUE(std::is_sorted(seen.begin(), seen.end()));
+    EXPECT_EQ(seen.end(), std::find(seen.begin(), seen.end(), 51));
+    EXPECT_EQ(41, seen.front());
+    EXPECT_EQ(61, seen.back());
+    lsm_close(&lsm);
+}
+
+TEST(Lsm, ConcurrentWritersAndReaders) {
+    ScopedTempDir guard;
+    lsm_t lsm;
+    lsm_options_t options = { 32 * 1024, 3, 0 };
+    ASSERT_EQ(0, lsm_open(&lsm, LSM_DIR, &options));
+    std::atomic<int> failures(0);
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; t++) {
+        threads.emplace_back([&, t] {
+            for (int i = 0; i < 1000; i++) {
+                int id = t * 1000 + i + 1;
+                student_t s = make_student({.id = id, .subject_grade = (float)id});
+                student_t back;
+                if (lsm_put(&lsm, id, &s) != 0 || lsm_get(&lsm, id, &back) != 0 ||
+                    back.average_grade != (float)id) {
+                    failures++;
+                }
+            }
+        });
+    }
+    for (auto &thread : threads) {
+        thread.join();
+    }
+    EXPECT_EQ(0, failures.load());
+    std::vector<int> seen;
+    EXPECT_EQ(4000, lsm_scan(&lsm, INT32_MIN, INT32_MAX, collect_ids, &seen));
+    lsm_close(&lsm);
+}
+
+TEST(Lsm, RecordFunctionsUseSelectedStore) {
+    ScopedTempDir guard;
+    lsm_t lsm;
+    ASSERT_EQ(0, lsm_open(&lsm, LSM_DIR, nullptr));
+    store_t store;
+    store_lsm(&store, &lsm);
+    record_use_store(&store);
+
+    student_t s = make_student({.id = 3, .subject_grade = 0.0f});
+    s.subject1.grade = 60.0f;
+    ASSERT_EQ(0, record_save(3, &s));
+    ASSERT_EQ(0, record_update(3, FIELD_SUBJECT2_GRADE, "100"));
+    student_t back;
+    ASSERT_EQ(0, record_load(3, &back));
+    EXPECT_FLOAT_EQ(40.0f, back.average_grade);
+    struct stat st;
+    EXPECT_NE(0, stat("output_3.txt", &st));
+
+    record_use_store(nullptr);
+    lsm_close(&lsm);
+}
@@ -0,0 +1,56 @@
+#include <gtest/gtest.h>
+#include <cstring>
+
+#include "test_util.h"
+
+extern "C" {
+#include "mem.h"
+#include "record.h"
+#include "snapshot.h"
+}
+
+TEST(Mem, TracksBlocksPerSubsystem) {
+    mem_usage_t before, during, after;
+    mem_usage(MEM_CACHES, &before);
+
+    char *block = static_cast<char *>(mem_malloc(MEM_CACHES, 1000));
+    ASSERT_NE(nullptr, block);
+    std::memset(block, 'x', 1000);
+    mem_usage(MEM_CACHES, &during);
+    EXPECT_EQ(before.requested + 1000, during.requested);
+    EXPECT_EQ(before.blocks + 1, during.blocks);
+    EXPECT_GE(during.reserved - before.reserved, 1000u);
+
+    // realloc keeps the subsystem and the contents
+    block = static_cast<char *>(mem_realloc(MEM_RECORDS, block, 5000));
+    ASSERT_NE(nullptr, block);
+    EXPECT_EQ('x', block[999]);
+    mem_usage(MEM_CACHES, &during);
+    EXPECT_EQ(before.requested + 5000, during.requested);
+    EXPECT_GE(during.peak, before.requested + 5000);
+
+    mem_free(block);
+    mem_usage(MEM_CACHES, &after);
+    EXPECT_EQ(before.requested, after.requested);
+    EXPECT_EQ(before.blocks, after.blocks);
+    EXPECT_EQ(before.reserved, after.reserved);
+}
+
+TEST(Mem, SnapshotMappingIsCharged) {
+    ScopedTempDir guard;
+    student_t s;
+    std::memset(&s, 0, sizeof(s));
+    str_set(&s.name, "Rosa");
+    s.student_id = 1;
+    ASSERT_EQ(1, snapshot_write(SNAPSHOT_PATH, &s, 1));
+
+    mem_usage_t before, open;
+    mem_usage(MEM_RECORDS, &before);
+    snapshot_t snap;
+    ASSERT_EQ(0, snapshot_open(&snap, SNAPSHOT_PATH));
+    mem_usage(MEM_RECORDS, &open);
+    EXPECT_GE(open.mapped - before.mapped, sizeof(snap_record_t));
+    snapshot_close(&snap);
+    mem_usage(MEM_RECORDS, &open);
+    EXPECT_EQ(before.mapped, open.mapped);
+}
@@ -0,0 +1,142 @@
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <cstring>
+#include <random>
+#include <vector>
+
+#include "test_util.h"
+
+extern "C" {
+#include "rank.h"
+#include "record.h"
+}
+
+TEST(Rank, TiesShareRank) {
+    rank_view_t view;
+    ASSERT_EQ(0, rank_init(&view));
+    ASSERT_EQ(0, rank_set(&view, 1, 10, 70.0f));
+    ASSERT_EQ(0, rank_set(&view, 2, 10, 90.0f));
+    ASSERT_EQ(0, rank_set(&view, 3, 10, 80.0f));
+    ASSERT_EQ(0, rank_set(&view, 4, 10, 80.0f));
+    ASSERT_EQ(0, rank_set(&view, 5, 11, 50.0f));
+
+    int rank, size;
+    ASSERT_EQ(0, rank_lookup(&view, 2, &rank, &size));
+    EXPECT_EQ(1, rank);
+    EXPECT_EQ(4, size);
+    ASSERT_EQ(0, rank_lookup(&view, 4, &rank, nullptr));
+    EXPECT_EQ(2, rank);
+    ASSERT_EQ(0, rank_lookup(&view, 3, &rank, nullptr));
+    EXPECT_EQ(2, rank);
+    ASSERT_EQ(0, rank_lookup(&view, 1, &rank, nullptr));
+    EXPECT_EQ(4, rank);
+    ASSERT_EQ(0, rank_lookup(&view, 5, &rank, &size));
+    EXPECT_EQ(1, rank);
+    EXPECT_EQ(1, size);
+    EXPECT_EQ(-1, rank_lookup(&view, 6, &rank, &size));
+
+    int id;
+    ASSERT_EQ(0, rank_nth(&view, 10, 2, &id));
+    EXPECT_EQ(3, id);
+    ASSERT_EQ(0, rank_nth(&view, 10, 4, &id));
+    EXPECT_EQ(1, id);
+    EXPECT_EQ(-1, rank_nth(&view, 10, 5, &id));
+    EXPECT_EQ(-1, rank_nth(&view, 12, 1, &id));
+    rank_free(&view);
+}
+
+TEST(Rank, MovesOnUpdateAndClassChange) {
+    rank_view_t view;
+    ASSERT_EQ(0, rank_init(&view));
+    rank_set(&view, 1, 10, 60.0f);
+    rank_set(&view, 2, 10, 70.0f);
+    rank_set(&view, 3, 10, 80.0f);
+
+    int rank, size;
+    ASSERT_EQ(0, rank_set(&view, 1, 10, 95.0f));
+    ASSERT_EQ(0, rank_lookup(&view, 1, &rank, &size));
+    EXPECT_EQ(1, rank);
+    EXPECT_EQ(3, size);
+
+    ASSERT_EQ(0, rank_set(&view, 3, 11, 80.0f));
+    ASSERT_EQ(0, rank_lookup(&view, 2, &rank, &size));
+    EXPECT_EQ(2, rank);
+    EXPECT_EQ(2, size);
+
+    rank_remove(&view, 1);
+    ASSERT_EQ(0, rank_lookup(&view, 2, &rank, &size));
+    EXPECT_EQ(1, rank);
+    EXPECT_EQ(1, size);
+    EXPECT_EQ(-1, rank_lookup(&view, 1, &rank, &size));
+    rank_free(&view);
+}
+
+TEST(Rank, MatchesSortAfterRandomUpdates) {
+    rank_view_t view;
+    ASSERT_EQ(0, rank_init(&view));
+    std::mt19937 rng(42);
+    const int n = 3000;
+    std::vector<float> averages(n + 1);
+    for (int step = 0; step < 20000; step++) {
+        int id = 1 + (int)(rng() % n);
+        averages[id] = (float)(rng() % 400) / 4.0f;   // plenty of ties
+        ASSERT_EQ(0, rank_set(&view, id, 9, averages[id]));
+    }
+
+    std::vector<float> present;
+    for (int id = 1; id <= n; id++) {
+        int rank;
+        if (rank_lookup(&view, id, &rank, nullptr) == 0) {
+            present.push_back(averages[id]);
+        }
+    }
+    for (int id = 1; id <= n; id++) {
+        int rank, size;
+        if (rank_lookup(&view, id, &rank, &size) != 0) {
+            continue;
+        }
+        int ahead = (int)std::count_if(present.begin(), present.end(),
+                                       [&](float a) { return a > averages[id]; });
+        ASSERT_EQ(ahead + 1, rank) << "id " << id;
+        ASSERT_EQ((int)present.size(), size);
+    }
+    rank_free(&view);
+}
+
+TEST(Rank, AttachedViewFollowsRecordWrites) {
+    ScopedTempDir guard;
+    rank_view_t view;
+    ASSERT_EQ(0, rank_init(&view));
+    ASSERT_EQ(0, rank_attach(&view));
+
+    for (int id = 1; id <= 3; id++) {
+        student_t s;
+        std::memset(&s, 0, sizeof(s));
+        s.grade = 10;
+        s.subject1.grade = s.subject2.grade = s.subject3.grade = s.subject4.grade = 50.0f + id;
+        calculate_average(&s);
+        ASSERT_EQ(0, record_save(id, &s));
+    }
+    int rank;
+    ASSERT_EQ(0, rank_lookup(&view, 1, &rank, nullptr));
+    EXPECT_EQ(3, rank);
+
+    ASSERT_EQ(0, record_update(1, FIELD_SUBJECT1_GRADE, "100"));
+    ASSERT_EQ(0, rank_lookup(&view, 1, &rank, nullptr));
+    EXPECT_EQ(1, rank);
+
+    // A delete takes the student out of their class
+    int size;
+    ASSERT_EQ(0, record_delete(3));
+    EXPECT_EQ(-1, rank_lookup(&view, 3, &rank, nullptr));
+    ASSERT_EQ(0, rank_lookup(&view, 2, &rank, &size));
+    EXPECT_EQ(2, rank);
+    EXPECT_EQ(2, size);
+
+    rank_detach(&view);
+    // Detached: the write no longer reaches the view
+    ASSERT_EQ(0, record_update(2, FIELD_SUBJECT1_GRADE, "100"));
+    ASSERT_EQ(0, rank_lookup(&view, 2, &rank, nullptr));
+    EXPECT_EQ(2, rank);
+    rank_free(&view);
+}
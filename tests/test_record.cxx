@@ -0,0 +1,300 @@
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <cerrno>
+#include <cstring>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "test_util.h"
+
+extern "C" {
+#include "record.h"
+}
+
+static std::string slurp(const char *path) {
+    std::ifstream ifs(path);
+    return std::string((std::istreambuf_iterator<char>(ifs)), std::istreambuf_iterator<char>());
+}
+
+static void write_legacy_record(const char *path) {
+    std::ofstream ofs(path);
+    ofs << "NAME = Rosa\n"
+        << "DOB = 12/02/2009\n"
+        << "STUDENT_ID = rp32144\n"
+        << "FATHER_NAME = George\n"
+        << "MOTHER_NAME = Lisa\n"
+        << "PHONE_NUMBER = 93213124\n"
+        << "GRADE = 11\n"
+        << "SUBJECT1_NAME = CP1\n"
+        << "SUBJECT1_GRADE = 99.00\n"
+        << "SUBJECT2_NAME = ADS\n"
+        << "SUBJECT2_GRADE = 66.00\n"
+        << "SUBJECT3_NAME = CANTO\n"
+        << "SUBJECT3_GRADE = 33.00\n"
+        << "SUBJECT4_NAME = TECH\n"
+        << "SUBJECT4_GRADE = 1.00\n"
+        << "AVERAGE_GRADE = 49.75\n";
+}
+
+TEST(RecordRead, LegacyFileIsVersionOne) {
+    ScopedTempDir guard;
+    write_legacy_record("output_1.txt");
+
+    student_t s;
+    int version = 0;
+    ASSERT_EQ(0, record_read("output_1.txt", &s, &version));
+    EXPECT_EQ(1, version);
+    EXPECT_STREQ("Rosa", str_get(&s.name));
+    EXPECT_STREQ("George", str_get(&s.father_name));
+    EXPECT_EQ(11, s.grade);
+    EXPECT_FLOAT_EQ(33.0f, s.subject3.grade);
+    EXPECT_FLOAT_EQ(49.75f, s.average_grade);
+}
+
+TEST(RecordLoad, MigratesLegacyFileOnFirstRead) {
+    ScopedTempDir guard;
+    write_legacy_record("output_1.txt");
+
+    student_t s;
+    ASSERT_EQ(0, record_load(1, &s));
+    EXPECT_EQ(1, s.student_id);
+    EXPECT_STREQ("", str_get(&s.family_name));
+
+    std::string contents = slurp("output_1.txt");
+    EXPECT_EQ(0u, contents.find("SCHEMA_VERSION = 3\n"));
+    EXPECT_NE(contents.find("FAMILY_NAME = \n"), std::string::npos);
+    EXPECT_NE(contents.find("SUBJECT4_NAME = TECH\n"), std::string::npos);
+    EXPECT_FALSE(fs::exists("temp_1.txt"));
+
+    // Second migration is a no-op
+    EXPECT_EQ(0, record_migrate(1));
+}
+
+TEST(RecordUpdate, SubjectGradeRecomputesAverage) {
+    ScopedTempDir guard;
+    write_legacy_record("output_1.txt");
+
+    ASSERT_EQ(0, record_update(1, FIELD_SUBJECT4_GRADE, "33"));
+    student_t s;
+    ASSERT_EQ(0, record_load(1, &s));
+    EXPECT_FLOAT_EQ(57.75f, s.average_grade);
+
+    EXPECT_EQ(-1, record_update(1, FIELD_GRADE, "eleven"));
+    EXPECT_EQ(-1, record_update(2, FIELD_NAME, "Nobody"));
+}
+
+TEST(Migrator, UpgradesWholeRangeAndSkipsGaps) {
+    ScopedTempDir guard;
+    write_legacy_record("output_1.txt");
+    write_legacy_record("output_3.txt");
+
+    migrator_t m;
+    ASSERT_EQ(0, migrator_start(&m, 1, 4, 0));
+    migrator_wait(&m);
+    EXPECT_EQ(2, m.migrated);
+    EXPECT_EQ(0, m.failed);
+
+    int version = 0;
+    student_t s;
+    ASSERT_EQ(0, record_read("output_3.txt", &s, &version));
+    EXPECT_EQ(RECORD_SCHEMA_VERSION, version);
+}
+
+TEST(RecordWrite, LongNamesRoundTrip) {
+    ScopedTempDir guard;
+    std::string name(120, 'x');
+    student_t s;
+    std::memset(&s, 0, sizeof(s));
+    str_set(&s.name, name.c_str());
+    str_set(&s.subject1.name, "Mathematics-And-Statistics");
+
+    ASSERT_EQ(0, record_write("output_1.txt", &s));
+    student_t back;
+    ASSERT_EQ(0, record_read("output_1.txt", &back, nullptr));
+    EXPECT_EQ(name, str_get(&back.name));
+    EXPECT_STREQ("Mathematics-And-Statistics", str_get(&back.subject1.name));
+}
+
+TEST(RecordChecksum, DamagedFileIsRejected) {
+    ScopedTempDir guard;
+    student_t s;
+    std::memset(&s, 0, sizeof(s));
+    str_set(&s.name, "Rosa");
+    s.grade = 11;
+    ASSERT_EQ(0, record_write("output_1.txt", &s));
+
+    std::string contents = slurp("output_1.txt");
+    EXPECT_NE(contents.find("\nCHECKSUM = "), std::string::npos);
+
+    // One changed byte
+    std::string flipped = contents;
+    flipped[flipped.find("Rosa")] = 'P';
+    std::ofstream("output_1.txt", std::ios::binary) << flipped;
+    student_t back;
+    errno = 0;
+    EXPECT_EQ(-1, record_read("output_1.txt", &back, nullptr));
+    EXPECT_EQ(EBADMSG, errno);
+
+    // Cut short, as after a crash mid-write
+    std::ofstream("output_1.txt", std::ios::binary | std::ios::trunc) << contents.substr(0, contents.size() / 2);
+    EXPECT_EQ(-1, record_read("output_1.txt", &back, nullptr));
+    std::ofstream("output_1.txt", std::ios::binary | std::ios::trunc) << "";
+    EXPECT_EQ(-1, record_read("output_1.txt", &back, nullptr));
+
+    std::ofstream("output_1.txt", std::ios::binary | std::ios::trunc) << contents;
+    ASSERT_EQ(0, record_read("output_1.txt", &back, nullptr));
+    EXPECT_STREQ("Rosa", str_get(&back.name));
+}
+
+TEST(RecordChecksum, VersionTwoFileGainsChecksumOnLoad) {
+    ScopedTempDir guard;
+    std::ofstream("output_1.txt") << "SCHEMA_VERSION = 2\nNAME = Ana\nFAMILY_NAME = Lopez\nGRADE = 9\n";
+
+    student_t s;
+    int version = 0;
+    ASSERT_EQ(0, record_read("output_1.txt", &s, &version));
+    EXPECT_EQ(2, version);
+    ASSERT_EQ(0, record_load(1, &s));
+    EXPECT_STREQ("Lopez", str_get(&s.family_name));
+    EXPECT_NE(slurp("output_1.txt").find("\nCHECKSUM = "), std::string::npos);
+}
+
+static void count_commit(int id, const student_t *student, void *arg) {
+    (void)student;
+    static_cast<std::vector<int> *>(arg)->push_back(id);
+}
+
+TEST(RecordBatch, CommitReplacesRecordsAndLogsOnce) {
+    ScopedTempDir guard;
+    std::vector<int> hooked;
+    ASSERT_EQ(0, record_add_commit_hook(count_commit, &hooked));
+
+    student_t s;
+    std::memset(&s, 0, sizeof(s));
+    str_set(&s.name, "Old");
+    ASSERT_EQ(0, record_commit(2, &s, RECORD_CHANGE_LOG));
+
+    record_batch_t batch;
+    record_batch_init(&batch, RECORD_CHANGE_LOG);
+    for (int id = 1; id <= 20; id++) {
+        str_set(&s.name, id == 2 ? "First" : "New");
+        ASSERT_EQ(0, record_batch_add(&batch, id, &s));
+    }
+    // A second version of the same ID replaces the pending one
+    str_set(&s.name, "Second");
+    ASSERT_EQ(0, record_batch_add(&batch, 2, &s));
+    EXPECT_EQ(20, batch.count);
+
+    // Nothing is replaced before the commit
+    student_t back;
+    ASSERT_EQ(0, record_read("output_2.txt", &back, nullptr));
+    EXPECT_STREQ("Old", str_get(&back.name));
+    EXPECT_NE(0, access("output_1.txt", F_OK));
+
+    EXPECT_EQ(20, record_batch_commit(&batch));
+    EXPECT_EQ(0, batch.count);
+    ASSERT_EQ(0, record_read("output_2.txt", &back, nullptr));
+    EXPECT_STREQ("Second", str_get(&back.name));
+    ASSERT_EQ(0, record_read("output_20.txt", &back, nullptr));
+    EXPECT_STREQ("New", str_get(&back.name));
+    EXPECT_NE(0, access("temp_2.txt", F_OK));
+
+    std::string log = slurp(RECORD_CHANGE_LOG);
+    EXPECT_EQ(21, std::count(log.begin(), log.end(), '\n'));
+    EXPECT_EQ(21u, hooked.size());
+    record_batch_free(&batch);
+    record_remove_commit_hook(count_commit, &hooked);
+}
+
+TEST(RecordBatch, FailedRenameIsReported) {
+    ScopedTempDir guard;
+    // A directory in the way of output_2.txt makes its rename fail
+    ASSERT_EQ(0, mkdir("output_2.txt", 0755));
+    std::ofstream("output_2.txt/keep") << "x";
+
+    student_t s;
+    std::memset(&s, 0, sizeof(s));
+    str_set(&s.name, "New");
+    record_batch_t batch;
+    record_batch_init(&batch, RECORD_CHANGE_LOG);
+    ASSERT_EQ(0, record_batch_add(&batch, 1, &s));
+    ASSERT_EQ(0, record_batch_add(&batch, 2, &s));
+    EXPECT_EQ(-1, record_batch_commit(&batch));
+    EXPECT_NE(0, errno);
+    EXPECT_NE(0, access("temp_2.txt", F_OK));
+
+    // The record that did commit is still logged
+    student_t back;
+    ASSERT_EQ(0, record_read("output_1.txt", &back, nullptr));
+    EXPECT_EQ("1\n", slurp(RECORD_CHANGE_LOG));
+    record_batch_free(&batch);
+}
+
+TEST(RecordSave, FailedChangeLogIsReported) {
+    ScopedTempDir guard;
+    // A directory in the way of the change log makes every append fail
+    ASSERT_EQ(0, mkdir(RECORD_CHANGE_LOG, 0755));
+
+    student_t s = make_student({.id = 1});
+    errno = 0;
+    EXPECT_EQ(-1, record_save(1, &s));
+    EXPECT_NE(0, errno);
+    student_t back;
+    ASSERT_EQ(0, record_load(1, &back));
+    EXPECT_STREQ("Katherine", str_get(&back.name));
+
+    s.student_id = 2;
+    EXPECT_EQ(-1, record_save_many(&s, 1));
+    EXPECT_EQ(-1, record_delete(1));
+
+    record_batch_t batch;
+    record_batch_init(&batch, RECORD_CHANGE_LOG);
+    ASSERT_EQ(0, record_batch_add(&batch, 3, &s));
+    EXPECT_EQ(-1, record_batch_commit(&batch));
+    EXPECT_EQ(0, record_read("output_3.txt", &back, nullptr));
+    record_batch_free(&batch);
+}
+
+TEST(RecordCounter, ReplacesCounterDurably) {
+    ScopedTempDir guard;
+    ASSERT_EQ(0, record_write_counter("data/next_id.txt", 42));
+    EXPECT_EQ("42\n", slurp("data/next_id.txt"));
+    EXPECT_NE(0, access("data/next_id.txt.tmp", F_OK));
+    EXPECT_EQ(-1, record_write_counter("missing/next_id.txt", 1));
+}
+
+TEST(RecordCounter, ReleaseOnlyWhenNobodyReservedAfter) {
+    ScopedTempDir guard;
+    ASSERT_EQ(0, record_write_counter("data/next_id.txt", 5));
+    EXPECT_EQ(5, record_reserve_ids("data/next_id.txt", 10));
+    EXPECT_EQ(15, record_reserve_ids("data/next_id.txt", 1));
+
+    // ID 15 was handed out after the block, so nothing is given back
+    ASSERT_EQ(0, record_release_ids("data/next_id.txt", 8, 15));
+    EXPECT_EQ("16\n", slurp("data/next_id.txt"));
+    ASSERT_EQ(0, record_release_ids("data/next_id.txt", 15, 16));
+    EXPECT_EQ("15\n", slurp("data/next_id.txt"));
+}
+
+TEST(RecordBatch, AbortLeavesOriginals) {
+    ScopedTempDir guard;
+    student_t s;
+    std::memset(&s, 0, sizeof(s));
+    str_set(&s.name, "Kept");
+    ASSERT_EQ(0, record_commit(1, &s, RECORD_CHANGE_LOG));
+
+    record_batch_t batch;
+    record_batch_init(&batch, RECORD_CHANGE_LOG);
+    str_set(&s.name, "Dropped");
+    ASSERT_EQ(0, record_batch_add(&batch, 1, &s));
+    EXPECT_EQ(0, access("temp_1.txt", F_OK));
+    record_batch_free(&batch);
+
+    EXPECT_NE(0, access("temp_1.txt", F_OK));
+    student_t back;
+    ASSERT_EQ(0, record_read("output_1.txt", &back, nullptr));
+    EXPECT_STREQ("Kept", str_get(&back.name));
+}
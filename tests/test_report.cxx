@@ -0,0 +1,81 @@
+#include <gtest/gtest.h>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <string>
+
+#include "test_util.h"
+
+extern "C" {
+#include "record.h"
+#include "report.h"
+#include "snapshot.h"
+}
+
+static std::string read_file(const std::string &path) {
+    std::ifstream in(path);
+    std::stringstream ss;
+    ss << in.rdbuf();
+    return ss.str();
+}
+
+TEST(Report, CompileAndRender) {
+    report_template_t tpl;
+    ASSERT_EQ(0, report_compile(&tpl, "{{{NAME}} {SUBJECT1_NAME}={SUBJECT1_GRADE} #{RANK}/{CLASS_SIZE}\n"));
+    // "{{" + "{" -> text, NAME, "} " -> text, ...
+    EXPECT_EQ(REPORT_OP_TEXT, tpl.ops[0].kind);
+    EXPECT_EQ(REPORT_OP_NAME, tpl.ops[1].kind);
+
+    student_t s = make_student({.id = 3, .name = "Ana", .grade = 10, .subject_grade = 87.5f});
+    report_stats_t stats = { 2, 30 };
+    char buf[128];
+    size_t n = report_render(&tpl, &s, &stats, buf, sizeof(buf));
+    EXPECT_STREQ("{Ana} Mathematics=87.50 #2/30\n", buf);
+    EXPECT_EQ(std::strlen(buf), n);
+
+    // Too small: cut short, full length still reported
+    char small[8];
+    EXPECT_EQ(n, report_render(&tpl, &s, &stats, small, sizeof(small)));
+    EXPECT_STREQ("{Ana} M", small);
+    report_template_free(&tpl);
+}
+
+TEST(Report, RejectsBadPlaceholders) {
+    report_template_t tpl;
+    EXPECT_EQ(-1, report_compile(&tpl, "Hello {NOPE}"));
+    EXPECT_EQ(-1, report_compile(&tpl, "Hello {NAME"));
+}
+
+TEST(Report, RenderAllWritesRankedCards) {
+    ScopedTempDir guard;
+    student_t students[] = {
+        make_student({.id = 1, .name = "Ana", .grade = 10, .subject_grade = 70.0f}),
+        make_student({.id = 2, .name = "Rosa", .grade = 10, .subject_grade = 90.0f}),
+        make_student({.id = 3, .name = "Luis", .grade = 11, .subject_grade = 60.0f}),
+    };
+    ASSERT_EQ(3, snapshot_write(SNAPSHOT_PATH, students, 3));
+    snapshot_t snap;
+    ASSERT_EQ(0, snapshot_open(&snap, SNAPSHOT_PATH));
+
+    report_template_t tpl;
+    ASSERT_EQ(0, report_compile(&tpl, "{ID} {NAME} {AVERAGE} {RANK}/{CLASS_SIZE}"));
+    rank_view_t ranks;
+    ASSERT_EQ(0, rank_init(&ranks));
+    ASSERT_EQ(0, rank_build(&ranks, &snap));
+    report_result_t result;
+    ASSERT_EQ(0, report_render_all(&tpl, &snap, &ranks, REPORT_DIR, &result));
+    EXPECT_EQ(3, result.cards);
+    EXPECT_EQ(0, result.failed);
+
+    char path[128];
+    report_card_path(REPORT_DIR, 1, path, sizeof(path));
+    EXPECT_EQ("1 Ana 70.00 2/2", read_file(path));
+    report_card_path(REPORT_DIR, 2, path, sizeof(path));
+    EXPECT_EQ("2 Rosa 90.00 1/2", read_file(path));
+    report_card_path(REPORT_DIR, 3, path, sizeof(path));
+    EXPECT_EQ("3 Luis 60.00 1/1", read_file(path));
+
+    rank_free(&ranks);
+    report_template_free(&tpl);
+    snapshot_close(&snap);
+}
@@ -0,0 +1,160 @@
+#include <gtest/gtest.h>
+#include <cstring>
+#include <string>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "test_util.h"
+
+extern "C" {
+#include "rpc.h"
+}
+
+class RpcTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        ASSERT_EQ(0, studentdb_open(&db));
+        ASSERT_EQ(0, rpc_server_start(&server, &db, 0));
+        fd = net_connect(server.net.port);
+        ASSERT_GE(fd, 0);
+    }
+    void TearDown() override {
+        close(fd);
+        rpc_server_stop(&server);
+        rpc_buf_free(&request);
+        rpc_buf_free(&response);
+        studentdb_close(&db);
+    }
+    ScopedTempDir guard;
+    studentdb_t db;
+    rpc_server_t server;
+    rpc_buf_t request = {};
+    rpc_buf_t response = {};
+    int fd = -1;
+};
+
+TEST_F(RpcTest, BatchedFramesAnsweredInOrder) {
+    student_t katherine = make_student({.name = "Katherine"});
+    student_t dorothy = make_student({.name = "Dorothy", .subject_grade = 75.0f});
+    rpc_begin(&request, 7);
+    rpc_add(&request, &katherine);
+    rpc_add(&request, &dorothy);
+    rpc_get(&request, 2);
+    rpc_edit(&request, 1, FIELD_SUBJECT1_GRADE, "50");
+    rpc_get(&request, 1);
+    rpc_get(&request, 9);
+    ASSERT_EQ(0, rpc_end(&request));
+    rpc_begin(&request, 8);
+    rpc_get(&request, 1);
+    ASSERT_EQ(0, rpc_end(&request));
+    ASSERT_EQ(0, rpc_call(fd, &request, &response));
+
+    rpc_reader_t reader = rpc_reader(&response);
+    rpc_result_t results[8];
+    int count = 0;
+    while (count < 8 && rpc_read(&reader, &results[count]) > 0) {
+        count++;
+    }
+    ASSERT_EQ(7, count);
+    EXPECT_EQ(RPC_ADD, results[0].op);
+    EXPECT_EQ(RPC_OK, results[0].status);
+    EXPECT_EQ(1, results[0].id);
+    EXPECT_EQ(2, results[1].id);
+    EXPECT_EQ(7u, results[2].tag);
+
+    student_t back;
+    ASSERT_EQ(RPC_OK, results[2].status);
+    ASSERT_EQ(0, student_unpack(results[2].data, results[2].length, &back));
+    EXPECT_EQ(2, back.student_id);
+    EXPECT_STREQ("Dorothy", str_get(&back.name));
+    EXPECT_FLOAT_EQ(75.0f, back.average_grade);
+    EXPECT_EQ(RPC_OK, results[3].status);
+    ASSERT_EQ(0, student_unpack(results[4].data, results[4].length, &back));
+    EXPECT_FLOAT_EQ(50.0f, back.subject1.grade);
+    EXPECT_FLOAT_EQ(72.5f, back.average_grade);
+    EXPECT_EQ(RPC_NOT_FOUND, results[5].status);
+    EXPECT_EQ(8u, results[6].tag);
+    EXPECT_EQ(RPC_OK, results[6].status);
+    EXPECT_EQ(3, studentdb_next_id());
+}
+
+TEST_F(RpcTest, RankFollowsEdits) {
+    ASSERT_EQ(0, studentdb_attach_ranks(&db));
+    student_t katherine = make_student({.name = "Katherine"});
+    student_t dorothy = make_student({.name = "Dorothy"});
+    rpc_begin(&request, 1);
+    rpc_add(&request, &katherine);
+    rpc_add(&request, &dorothy);
+    rpc_edit(&request, 2, FIELD_SUBJECT1_GRADE, "100");
+    rpc_rank(&request, 1);
+    rpc_rank(&request, 9);
+    ASSERT_EQ(0, rpc_end(&request));
+    ASSERT_EQ(0, rpc_call(fd, &request, &response));
+
+    rpc_reader_t reader = rpc_reader(&response);
+    rpc_result_t results[5];
+    for (rpc_result_t &result : results) {
+        ASSERT_EQ(1, rpc_read(&reader, &result));
+    }
+    EXPECT_EQ(RPC_RANK, results[3].op);
+    ASSERT_EQ(RPC_OK, results[3].status);
+    int32_t ranked[2];
+    ASSERT_EQ(sizeof(ranked), results[3].length);
+    std::memcpy(ranked, results[3].data, sizeof(ranked));
+    EXPECT_EQ(2, ranked[0]);
+    EXPECT_EQ(2, ranked[1]);
+    EXPECT_EQ(RPC_NOT_FOUND, results[4].status);
+}
+
+TEST_F(RpcTest, InvalidOperationsChangeNothing) {
+    student_t katherine = make_student({.name = "Katherine"});
+    student_t bad = make_student({.name = "Ada"});
+    std::strcpy(bad.dateofbirth, "31/02/2008");
+    rpc_begin(&request, 1);
+    rpc_add(&request, &bad);
+    rpc_add(&request, &katherine);
+    rpc_edit(&request, 1, FIELD_GRADE, "13");
+    rpc_edit(&request, 1, static_cast<field_t>(99), "x");
+    rpc_edit(&request, 5, FIELD_NAME, "Dorothy");
+    ASSERT_EQ(0, rpc_end(&request));
+    ASSERT_EQ(0, rpc_call(fd, &request, &response));
+
+    rpc_reader_t reader = rpc_reader(&response);
+    rpc_result_t result;
+    const rpc_status_t expected[] = { RPC_INVALID, RPC_OK, RPC_INVALID, RPC_INVALID, RPC_NOT_FOUND };
+    for (rpc_status_t status : expected) {
+        ASSERT_EQ(1, rpc_read(&reader, &result));
+        EXPECT_EQ(status, result.status);
+    }
+    EXPECT_EQ(0, rpc_read(&reader, &result));
+    reader = rpc_reader(&response);
+    rpc_read(&reader, &result);
+    EXPECT_EQ("date of birth", std::string(reinterpret_cast<const char *>(result.data), result.length));
+
+    student_t back;
+    ASSERT_EQ(0, studentdb_get(&db, 1, &back));
+    EXPECT_STREQ("Katherine", str_get(&back.name));
+    EXPECT_EQ(10, back.grade);
+    EXPECT_EQ(2, studentdb_next_id());
+}
+
+TEST_F(RpcTest, MalformedFrameClosesConnection) {
+    rpc_begin(&request, 1);
+    rpc_get(&request, 1);
+    ASSERT_EQ(0, rpc_end(&request));
+    // Claims a second operation that is not there
+    rpc_frame_header_t head;
+    std::memcpy(&head, request.data, sizeof(head));
+    head.count = 2;
+    std::memcpy(request.data, &head, sizeof(head));
+    ASSERT_EQ(static_cast<ssize_t>(request.length), send(fd, request.data, request.length, MSG_NOSIGNAL));
+    char byte;
+    EXPECT_EQ(0, recv(fd, &byte, 1, 0));
+
+    // An oversized frame is refused before its body arrives
+    int other = net_connect(server.net.port);
+    head.length = RPC_MAX_FRAME + 4;
+    ASSERT_EQ(static_cast<ssize_t>(sizeof(head)), send(other, &head, sizeof(head), MSG_NOSIGNAL));
+    EXPECT_EQ(0, recv(other, &byte, 1, 0));
+    close(other);
+}
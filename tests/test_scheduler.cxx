@@ -0,0 +1,80 @@
+#include <gtest/gtest.h>
+#include <atomic>
+#include <vector>
+#include <unistd.h>
+
+extern "C" {
+#include "scheduler.h"
+}
+
+static void add_range(long begin, long end, void *arg) {
+    auto *hits = static_cast<std::vector<std::atomic<int>> *>(arg);
+    for (long i = begin; i < end; i++) {
+        (*hits)[i]++;
+    }
+}
+
+TEST(Scheduler, ParallelForCoversEveryIndexOnce) {
+    sched_pool_t pool;
+    ASSERT_EQ(0, sched_pool_init(&pool, 4));
+
+    std::vector<std::atomic<int>> hits(10000);
+    ASSERT_EQ(0, sched_parallel_for(&pool, 0, 10000, 64, add_range, &hits));
+    for (auto &h : hits) {
+        ASSERT_EQ(1, h.load());
+    }
+
+    sched_stats_t stats;
+    sched_stats(&pool, &stats);
+    EXPECT_EQ(4, stats.worker_count);
+    EXPECT_EQ(0, stats.queued);
+    sched_pool_destroy(&pool);
+}
+
+struct Fanout {
+    sched_pool_t *pool;
+    sched_group_t *group;
+    std::atomic<int> done{0};
+};
+
+static void sleepy_task(void *arg) {
+    usleep(1000);
+    static_cast<Fanout *>(arg)->done++;
+}
+
+static void spawner(void *arg) {
+    auto *f = static_cast<Fanout *>(arg);
+    // Everything lands on this worker's own deque; idle workers must steal it
+    for (int i = 0; i < 64; i++) {
+        sched_submit(f->pool, f->group, sleepy_task, f);
+    }
+}
+
+TEST(Scheduler, IdleWorkersStealFromBusyDeque) {
+    sched_pool_t pool;
+    ASSERT_EQ(0, sched_pool_init(&pool, 4));
+
+    sched_group_t group;
+    sched_group_init(&group);
+    Fanout f;
+    f.pool = &pool;
+    f.group = &group;
+    ASSERT_EQ(0, sched_submit(&pool, &group, spawner, &f));
+    sched_group_wait(&pool, &group);
+    EXPECT_EQ(64, f.done.load());
+
+    sched_stats_t stats;
+    sched_stats(&pool, &stats);
+    EXPECT_GT(stats.total_steals, 0u);
+    int deepest = 0;
+    for (int i = 0; i < stats.worker_count; i++) {
+        deepest = std::max(deepest, stats.max_depth[i]);
+    }
+    EXPECT_GE(deepest, 2);
+    sched_pool_destroy(&pool);
+}
+
+TEST(Scheduler, DefaultPoolIsShared) {
+    EXPECT_NE(nullptr, sched_default());
+    EXPECT_EQ(sched_default(), sched_default());
+}
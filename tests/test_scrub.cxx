@@ -0,0 +1,124 @@
+#include <gtest/gtest.h>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <string>
+
+#include "test_util.h"
+
+extern "C" {
+#include "record.h"
+#include "scrub.h"
+#include "btree.h"
+}
+
+static void write_counter(int value) {
+    std::ofstream("data/next_id.txt") << value << "\n";
+}
+
+TEST(Scrub, CleanStorePasses) {
+    ScopedTempDir guard;
+    for (int id = 1; id <= 3; id++) {
+        student_t s = make_student({.name = "Rosa"});
+        ASSERT_EQ(0, record_save(id, &s));
+    }
+    write_counter(4);
+
+    scrub_options_t options = { .record_dir = ".", .counter_path = "data/next_id.txt", .repair = 0, .report = nullptr };
+    scrub_result_t result;
+    EXPECT_EQ(0, scrub_store(&options, &result));
+    EXPECT_EQ(3, result.records);
+    EXPECT_EQ(3, result.max_id);
+    EXPECT_EQ(0, result.damaged);
+    EXPECT_EQ(0, result.invalid);
+}
+
+TEST(Scrub, FindsProblemsAndRepairs) {
+    ScopedTempDir guard;
+    student_t good = make_student({.name = "Rosa"});
+    ASSERT_EQ(0, record_save(1, &good));
+    ASSERT_EQ(0, record_save(2, &good));
+    student_t bad = make_student({.name = "R0sa"});
+    ASSERT_EQ(0, record_save(3, &bad));
+    ASSERT_EQ(0, record_save(7, &good));
+    write_counter(5);
+
+    // Record 2 is cut short; record 4 only exists as a finished temp file
+    std::string contents;
+    {
+        std::ifstream in("output_2.txt");
+        contents.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+    }
+    std::ofstream("output_2.txt", std::ios::trunc) << contents.substr(0, 40);
+    ASSERT_EQ(0, record_write("temp_4.txt", &good));
+    std::ofstream("temp_1.txt") << "SCHEMA_VERSION = 3\nNAME = Ha";
+    std::ofstream("next_id.tmp") << "6\n";
+    std::ofstream("data/snapshot.bin.tmp") << "x";
+    // Not ours: never listed or removed
+    std::ofstream("data/notes.tmp") << "keep";
+
+    scrub_options_t options = { .record_dir = ".", .counter_path = "data/next_id.txt", .repair = 0, .report = nullptr };
+    scrub_result_t result;
+    EXPECT_EQ(1, scrub_store(&options, &result));
+    EXPECT_EQ(4, result.records);
+    EXPECT_EQ(1, result.damaged);
+    EXPECT_EQ(1, result.invalid);
+    EXPECT_EQ(4, result.orphans);
+    EXPECT_EQ(7, result.max_id);
+    EXPECT_EQ(5, result.counter);
+    EXPECT_TRUE(fs::exists("temp_4.txt"));
+
+    options.repair = 1;
+    EXPECT_EQ(1, scrub_store(&options, &result));   // 2 and 3 still need a person
+    EXPECT_EQ(1, result.recovered);
+    EXPECT_EQ(3, result.removed);
+    EXPECT_EQ(5, result.records);
+    EXPECT_EQ(8, result.counter_repaired);
+    EXPECT_TRUE(fs::exists("output_4.txt"));
+    EXPECT_FALSE(fs::exists("temp_1.txt"));
+    EXPECT_FALSE(fs::exists("next_id.tmp"));
+    EXPECT_FALSE(fs::exists("data/snapshot.bin.tmp"));
+    EXPECT_TRUE(fs::exists("data/notes.tmp"));
+
+    student_t s;
+    ASSERT_EQ(0, record_load(4, &s));
+    EXPECT_STREQ("Rosa", str_get(&s.name));
+    std::ifstream counter("data/next_id.txt");
+    int next = 0;
+    counter >> next;
+    EXPECT_EQ(8, next);
+}
+
+TEST(Scrub, ChecksTheSelectedStore) {
+    ScopedTempDir guard;
+    btree_t tree;
+    store_t store;
+    ASSERT_EQ(0, btree_open(&tree, BTREE_PATH));
+    store_btree(&store, &tree);
+    record_use_store(&store);
+    student_t good = make_student({.name = "Rosa"});
+    good.student_id = 1;
+    ASSERT_EQ(0, record_save(1, &good));
+    student_t bad = make_student({.name = "R0sa"});
+    bad.student_id = 2;
+    ASSERT_EQ(0, record_save(2, &bad));
+    write_counter(2);
+    // A text file left over from before the conversion is not a record
+    ASSERT_EQ(0, record_write("output_9.txt", &good));
+
+    scrub_options_t options = {
+        .record_dir = ".", .counter_path = "data/next_id.txt", .repair = 0, .report = nullptr, .store = &store
+    };
+    scrub_result_t result;
+    EXPECT_EQ(1, scrub_store(&options, &result));
+    EXPECT_EQ(2, result.records);
+    EXPECT_EQ(1, result.invalid);
+    EXPECT_EQ(0, result.damaged);
+    EXPECT_EQ(2, result.max_id);
+
+    options.repair = 1;
+    EXPECT_EQ(1, scrub_store(&options, &result));
+    EXPECT_EQ(3, result.counter_repaired);
+    record_use_store(nullptr);
+    btree_close(&tree);
+}
@@ -0,0 +1,170 @@
+#include <gtest/gtest.h>
+#include <cstring>
+#include <set>
+#include <string>
+
+#include "test_util.h"
+
+extern "C" {
+#include "record.h"
+#include "snapshot.h"
+#include "store.h"
+}
+
+static void add_record(int id, const char *name, const char *sid, int grade) {
+    student_t s = make_student({.name = name, .studentid = sid, .grade = grade});
+    ASSERT_EQ(0, record_save(id, &s));
+}
+
+TEST(Snapshot, BuildAndLookupWithoutParsing) {
+    ScopedTempDir guard;
+    add_record(1, "Rosa", "rp1", 11);
+    add_record(2, "Ana", "ab2", 10);
+    add_record(4, "Luis", "lm4", 11);
+
+    ASSERT_EQ(3, snapshot_build(SNAPSHOT_PATH, 1, 5));
+
+    snapshot_t snap;
+    ASSERT_EQ(0, snapshot_open(&snap, SNAPSHOT_PATH));
+    EXPECT_EQ(0, snap.overlay_count);
+
+    student_t s;
+    ASSERT_EQ(0, snapshot_get(&snap, 4, &s));
+    EXPECT_STREQ("Luis", str_get(&s.name));
+    EXPECT_EQ(-1, snapshot_get(&snap, 3, &s));
+
+    ASSERT_EQ(0, snapshot_find_studentid(&snap, "ab2", &s));
+    EXPECT_EQ(2, s.student_id);
+    EXPECT_EQ(-1, snapshot_find_studentid(&snap, "zz9", &s));
+
+    std::vector<int> ids;
+    EXPECT_EQ(2, snapshot_scan_class(&snap, 11, collect_ids, &ids));
+    EXPECT_EQ((std::vector<int>{1, 4}), ids);
+    snapshot_close(&snap);
+}
+
+TEST(Snapshot, ReplaysChangesMadeAfterBuild) {
+    ScopedTempDir guard;
+    add_record(1, "Rosa", "rp1", 11);
+    add_record(2, "Ana", "ab2", 10);
+    ASSERT_EQ(2, snapshot_build(SNAPSHOT_PATH, 1, 2));
+
+    ASSERT_EQ(0, record_update(2, FIELD_NAME, "Anabel"));
+    add_record(3, "Nuevo", "nn3", 10);
+
+    snapshot_t snap;
+    ASSERT_EQ(0, snapshot_open(&snap, SNAPSHOT_PATH));
+    EXPECT_EQ(2, snap.overlay_count);
+
+    student_t s;
+    ASSERT_EQ(0, snapshot_get(&snap, 2, &s));
+    EXPECT_STREQ("Anabel", str_get(&s.name));
+    ASSERT_EQ(0, snapshot_get(&snap, 3, &s));
+    EXPECT_STREQ("Nuevo", str_get(&s.name));
+
+    std::vector<int> all;
+    EXPECT_EQ(3, snapshot_scan(&snap, collect_ids, &all));
+    EXPECT_EQ((std::vector<int>{1, 2, 3}), all);
+
+    std::vector<int> tenth;
+    EXPECT_EQ(2, snapshot_scan_class(&snap, 10, collect_ids, &tenth));
+    EXPECT_EQ((std::set<int>{2, 3}), std::set<int>(tenth.begin(), tenth.end()));
+    snapshot_close(&snap);
+}
+
+TEST(Snapshot, DeletedStudentIsHiddenAfterBuild) {
+    ScopedTempDir guard;
+    add_record(1, "Rosa", "rp1", 11);
+    add_record(2, "Ana", "ab2", 11);
+    ASSERT_EQ(2, snapshot_build(SNAPSHOT_PATH, 1, 2));
+    ASSERT_EQ(0, record_delete(2));
+
+    snapshot_t snap;
+    ASSERT_EQ(0, snapshot_open(&snap, SNAPSHOT_PATH));
+    student_t s;
+    EXPECT_EQ(-1, snapshot_get(&snap, 2, &s));
+    EXPECT_EQ(-1, snapshot_find_studentid(&snap, "ab2", &s));
+    std::vector<int> all;
+    EXPECT_EQ(1, snapshot_scan(&snap, collect_ids, &all));
+    EXPECT_EQ((std::vector<int>{1}), all);
+    std::vector<int> eleventh;
+    EXPECT_EQ(1, snapshot_scan_class(&snap, 11, collect_ids, &eleventh));
+    EXPECT_EQ((std::vector<int>{1}), eleventh);
+    snapshot_close(&snap);
+}
+
+TEST(Snapshot, BuildsAndReplaysFromSelectedStore) {
+    ScopedTempDir guard;
+    btree_t tree;
+    ASSERT_EQ(0, btree_open(&tree, BTREE_PATH));
+    store_t store;
+    store_btree(&store, &tree);
+    record_use_store(&store);
+
+    add_record(1, "Rosa", "rp1", 11);
+    add_record(2, "Ana", "ab2", 10);
+    ASSERT_EQ(2, snapshot_build(SNAPSHOT_PATH, 1, 5));
+    ASSERT_EQ(0, record_update(2, FIELD_NAME, "Anabel"));
+    add_record(3, "Nuevo", "nn3", 10);
+
+    snapshot_t snap;
+    ASSERT_EQ(0, snapshot_open(&snap, SNAPSHOT_PATH));
+    EXPECT_EQ(2, snap.overlay_count);
+    student_t s;
+    ASSERT_EQ(0, snapshot_get(&snap, 2, &s));
+    EXPECT_STREQ("Anabel", str_get(&s.name));
+    ASSERT_EQ(0, snapshot_get(&snap, 3, &s));
+    EXPECT_STREQ("Nuevo", str_get(&s.name));
+    snapshot_close(&snap);
+
+    record_use_store(nullptr);
+    btree_close(&tree);
+}
+
+TEST(Snapshot, RejectsCorruptFile) {
+    ScopedTempDir guard;
+    FILE *f = std::fopen(SNAPSHOT_PATH, "wb");
+    std::fputs("not a snapshot at all, just some text padding it out....", f);
+    std::fclose(f);
+
+    snapshot_t snap;
+    EXPECT_EQ(-1, snapshot_open(&snap, SNAPSHOT_PATH));
+}
+
+TEST(Snapshot, MapModesSeeSameRecords) {
+    ScopedTempDir guard;
+    add_record(1, "Rosa", "rp1", 11);
+    add_record(2, "Ana", "ab2", 10);
+    ASSERT_EQ(2, snapshot_build(SNAPSHOT_PATH, 1, 2));
+
+    const int modes[] = { SNAPSHOT_MAP_ADVISE, SNAPSHOT_MAP_THP,
+                          SNAPSHOT_MAP_HUGETLB | SNAPSHOT_MAP_ADVISE, SNAPSHOT_MAP_POPULATE };
+    for (int flags : modes) {
+        snapshot_t snap;
+        ASSERT_EQ(0, snapshot_open_with(&snap, SNAPSHOT_PATH, flags));
+        std::vector<int> ids;
+        EXPECT_EQ(2, snapshot_scan(&snap, collect_ids, &ids));
+        student_t s;
+        ASSERT_EQ(0, snapshot_find_studentid(&snap, "rp1", &s));
+        EXPECT_STREQ("Rosa", str_get(&s.name));
+        snapshot_close(&snap);
+    }
+}
+
+TEST(Snapshot, LongNamesLiveInStringSection) {
+    ScopedTempDir guard;
+    std::string name(80, 'L');
+    add_record(1, name.c_str(), "ln1", 9);
+    add_record(2, "Short", "sh2", 9);
+    ASSERT_EQ(2, snapshot_build(SNAPSHOT_PATH, 1, 2));
+
+    snapshot_t snap;
+    ASSERT_EQ(0, snapshot_open(&snap, SNAPSHOT_PATH));
+    EXPECT_EQ(81u, snap.header->strings_size);
+    student_t s;
+    ASSERT_EQ(0, snapshot_get(&snap, 1, &s));
+    EXPECT_EQ(name, str_get(&s.name));
+    ASSERT_EQ(0, snapshot_get(&snap, 2, &s));
+    EXPECT_STREQ("Short", str_get(&s.name));
+    snapshot_close(&snap);
+}
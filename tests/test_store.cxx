@@ -0,0 +1,121 @@
+#include <gtest/gtest.h>
+#include <cerrno>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "test_util.h"
+
+extern "C" {
+#include "store.h"
+}
+
+// The same operations must behave alike on every backend
+static void exercise(const store_t *store) {
+    SCOPED_TRACE(store->ops->name);
+    for (int id = 1; id <= 20; id++) {
+        student_t s = make_student({.id = id, .subject_grade = 50.0f});
+        ASSERT_EQ(0, store_put(store, id, &s));
+    }
+
+    student_t back;
+    ASSERT_EQ(0, store_get(store, 7, &back));
+    EXPECT_STREQ("Katherine", str_get(&back.name));
+    EXPECT_STREQ("kj00007", back.studentid);
+    EXPECT_EQ(-1, store_get(store, 21, &back));
+
+    ASSERT_EQ(0, store_update(store, 7, FIELD_SUBJECT1_GRADE, "90"));
+    ASSERT_EQ(0, store_update(store, 7, FIELD_NAME, "Ada"));
+    EXPECT_EQ(-1, store_update(store, 7, FIELD_GRADE, "abc"));
+    EXPECT_EQ(-1, store_update(store, 21, FIELD_NAME, "Nobody"));
+    ASSERT_EQ(0, store_get(store, 7, &back));
+    EXPECT_STREQ("Ada", str_get(&back.name));
+    EXPECT_FLOAT_EQ(60.0f, back.average_grade);
+
+    ASSERT_EQ(0, store_delete(store, 8));
+    EXPECT_EQ(-1, store_get(store, 8, &back));
+
+    std::vector<int> seen;
+    EXPECT_EQ(4, store_scan(store, 6, 10, collect_ids, &seen));
+    EXPECT_EQ((std::vector<int>{ 6, 7, 9, 10 }), seen);
+    seen.clear();
+    EXPECT_EQ(19, store_scan(store, INT32_MIN, INT32_MAX, collect_ids, &seen));
+
+    std::vector<student_t> batch;
+    for (int id = 21; id <= 30; id++) {
+        batch.push_back(make_student({.id = id, .subject_grade = 70.0f}));
+    }
+    batch[0].student_id = 7;
+    ASSERT_EQ(0, store_put_many(store, batch.data(), (int)batch.size()));
+    ASSERT_EQ(0, store_get(store, 7, &back));
+    EXPECT_STREQ("kj00021", back.studentid);
+    ASSERT_EQ(0, store_get(store, 30, &back));
+    EXPECT_FLOAT_EQ(70.0f, back.average_grade);
+    seen.clear();
+    EXPECT_EQ(28, store_scan(store, INT32_MIN, INT32_MAX, collect_ids, &seen));
+}
+
+TEST(Store, TextBackend) {
+    ScopedTempDir guard;
+    store_t store;
+    store_text(&store);
+    exercise(&store);
+    errno = 0;
+    EXPECT_EQ(-1, store_delete(&store, 8));
+    EXPECT_EQ(ENOENT, errno);
+}
+
+TEST(Store, BtreeBackend) {
+    ScopedTempDir guard;
+    btree_t tree;
+    ASSERT_EQ(0, btree_open(&tree, BTREE_PATH));
+    store_t store;
+    store_btree(&store, &tree);
+    exercise(&store);
+    errno = 0;
+    EXPECT_EQ(-1, store_delete(&store, 8));
+    EXPECT_EQ(ENOENT, errno);
+    btree_close(&tree);
+}
+
+TEST(Store, LsmBackend) {
+    ScopedTempDir guard;
+    lsm_t lsm;
+    ASSERT_EQ(0, lsm_open(&lsm, LSM_DIR, nullptr));
+    store_t store;
+    store_lsm(&store, &lsm);
+    exercise(&store);
+    lsm_close(&lsm);
+}
+
+static void count_commit(int id, const student_t *student, void *arg) {
+    (void)id;
+    (void)student;
+    ++*static_cast<int *>(arg);
+}
+
+TEST(Store, RecordFunctionsCallHooksOnAnyStore) {
+    ScopedTempDir guard;
+    btree_t tree;
+    ASSERT_EQ(0, btree_open(&tree, BTREE_PATH));
+    int commits = 0;
+    ASSERT_EQ(0, record_add_commit_hook(count_commit, &commits));
+
+    student_t s = make_student({.id = 1, .subject_grade = 70.0f});
+    ASSERT_EQ(0, record_save(1, &s));
+    EXPECT_EQ(1, commits);
+
+    store_t store;
+    store_btree(&store, &tree);
+    record_use_store(&store);
+    ASSERT_EQ(0, record_save(1, &s));
+    ASSERT_EQ(0, record_update(1, FIELD_NAME, "Ada"));
+    EXPECT_EQ(3, commits);
+    // Direct store calls do not run hooks
+    ASSERT_EQ(0, store_put(&store, 2, &s));
+    EXPECT_EQ(3, commits);
+
+    record_use_store(nullptr);
+    record_remove_commit_hook(count_commit, &commits);
+    btree_close(&tree);
+}
@@ -0,0 +1,32 @@
+#include <gtest/gtest.h>
+#include <string>
+
+extern "C" {
+#include "str.h"
+}
+
+TEST(Str, ShortValuesStayInline) {
+    str_t s = {};
+    EXPECT_STREQ("", str_get(&s));
+
+    str_set(&s, "Fifteen-chars-x");
+    EXPECT_FALSE(str_is_heap(&s));
+    EXPECT_STREQ("Fifteen-chars-x", str_get(&s));
+    EXPECT_EQ(15u, str_len(&s));
+}
+
+TEST(Str, LongValuesAreNotTruncated) {
+    std::string longer(300, 'a');
+    str_t s;
+    str_set(&s, longer.c_str());
+    EXPECT_TRUE(str_is_heap(&s));
+    EXPECT_EQ(longer, str_get(&s));
+    EXPECT_EQ(300u, str_len(&s));
+
+    // Copies share the heap value
+    str_t copy = s;
+    EXPECT_TRUE(str_eq(&s, &copy));
+    str_set(&copy, "short");
+    EXPECT_FALSE(str_eq(&s, &copy));
+    EXPECT_EQ(longer, str_get(&s));
+}
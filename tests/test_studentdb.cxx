@@ -0,0 +1,226 @@
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+#include "test_util.h"
+
+extern "C" {
+#include "studentdb.h"
+}
+
+static int in_class(const student_t *student, void *arg) {
+    return student->grade == *static_cast<int *>(arg);
+}
+
+TEST(StudentDb, CreateGetUpdateQuery) {
+    ScopedTempDir guard;
+    studentdb_t db;
+    ASSERT_EQ(0, studentdb_open(&db));
+
+    student_t s = make_student({.grade = 10, .subject_grade = 80.0f});
+    ASSERT_EQ(1, studentdb_create(&db, &s));
+    EXPECT_EQ(1, s.student_id);
+    EXPECT_FLOAT_EQ(80.0f, s.average_grade);
+    s = make_student({.grade = 11, .subject_grade = 60.0f});
+    ASSERT_EQ(2, studentdb_create(&db, &s));
+    s = make_student({.grade = 10, .subject_grade = 70.0f});
+    ASSERT_EQ(3, studentdb_create(&db, &s));
+    EXPECT_EQ(4, studentdb_next_id());
+
+    student_t back;
+    ASSERT_EQ(0, studentdb_get(&db, 2, &back));
+    EXPECT_STREQ("Katherine", str_get(&back.name));
+    EXPECT_EQ(11, back.grade);
+    EXPECT_EQ(-1, studentdb_get(&db, 4, &back));
+
+    ASSERT_EQ(0, studentdb_update(&db, 2, FIELD_SUBJECT1_GRADE, "100"));
+    ASSERT_EQ(0, studentdb_get(&db, 2, &back));
+    EXPECT_FLOAT_EQ(70.0f, back.average_grade);
+    errno = 0;
+    EXPECT_EQ(-1, studentdb_update(&db, 2, FIELD_GRADE, "13"));
+    EXPECT_EQ(EINVAL, errno);
+    EXPECT_EQ(-1, studentdb_update(&db, 9, FIELD_NAME, "Dorothy"));
+
+    student_t *results = nullptr;
+    int klass = 10;
+    ASSERT_EQ(2, studentdb_query(&db, 1, INT32_MAX, in_class, &klass, &results));
+    EXPECT_EQ(1, results[0].student_id);
+    EXPECT_EQ(3, results[1].student_id);
+    std::free(results);
+    ASSERT_EQ(3, studentdb_query(&db, 1, INT32_MAX, nullptr, nullptr, &results));
+    std::free(results);
+    ASSERT_EQ(0, studentdb_query(&db, 50, 60, nullptr, nullptr, &results));
+    std::free(results);
+
+    char location[128];
+    studentdb_location(&db, 3, location, sizeof(location));
+    EXPECT_STREQ("output_3.txt", location);
+    studentdb_close(&db);
+}
+
+TEST(StudentDb, CreateRejectsInvalidFields) {
+    ScopedTempDir guard;
+    studentdb_t db;
+    ASSERT_EQ(0, studentdb_open(&db));
+
+    student_t s = make_student({.grade = 10, .subject_grade = 80.0f});
+    std::snprintf(s.dateofbirth, sizeof(s.dateofbirth), "31/02/2008");
+    EXPECT_STREQ("date of birth", studentdb_validate(&s));
+    errno = 0;
+    EXPECT_EQ(-1, studentdb_create(&db, &s));
+    EXPECT_EQ(EINVAL, errno);
+
+    s = make_student({.grade = 10, .subject_grade = 80.0f});
+    s.subject3.grade = 101.0f;
+    EXPECT_STREQ("subject 3 grade", studentdb_validate(&s));
+    s = make_student({.grade = 0, .subject_grade = 80.0f});
+    EXPECT_STREQ("class level", studentdb_validate(&s));
+    s = make_student({.grade = 12, .subject_grade = 80.0f});
+    EXPECT_EQ(nullptr, studentdb_validate(&s));
+    // Nothing was saved, so no ID was used
+    EXPECT_EQ(1, studentdb_next_id());
+    studentdb_close(&db);
+}
+
+TEST(StudentDb, ConcurrentCreatesGetDistinctIds) {
+    ScopedTempDir guard;
+    studentdb_t db;
+    ASSERT_EQ(0, studentdb_open(&db));
+    std::vector<int> ids(4 * 25);
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; t++) {
+        threads.emplace_back([&, t] {
+            for (int i = 0; i < 25; i++) {
+                student_t s = make_student({.grade = 9, .subject_grade = 50.0f});
+                ids[t * 25 + i] = studentdb_create(&db, &s);
+            }
+        });
+    }
+    for (auto &thread : threads) {
+        thread.join();
+    }
+    std::sort(ids.begin(), ids.end());
+    for (int i = 0; i < 100; i++) {
+        EXPECT_EQ(i + 1, ids[i]);
+    }
+    studentdb_close(&db);
+}
+
+TEST(StudentDb, QueryNeverRewritesRecords) {
+    ScopedTempDir guard;
+    const char *legacy = "NAME = Rosa\nDOB = 12/02/2009\nSTUDENT_ID = rp32144\nFATHER_NAME = George\n"
+                         "MOTHER_NAME = Lisa\nPHONE_NUMBER = 93213124\nGRADE = 11\n"
+                         "SUBJECT1_NAME = CP1\nSUBJECT1_GRADE = 99.00\nSUBJECT2_NAME = ADS\n"
+                         "SUBJECT2_GRADE = 66.00\nSUBJECT3_NAME = CANTO\nSUBJECT3_GRADE = 33.00\n"
+                         "SUBJECT4_NAME = TECH\nSUBJECT4_GRADE = 1.00\nAVERAGE_GRADE = 49.75\n";
+    std::ofstream("output_1.txt") << legacy;
+    studentdb_t db;
+    ASSERT_EQ(0, studentdb_open(&db));
+
+    // The old record is upgraded in the results but left as it is on disk
+    student_t *results = nullptr;
+    ASSERT_EQ(1, studentdb_query(&db, 1, 10, nullptr, nullptr, &results));
+    EXPECT_STREQ("Rosa", str_get(&results[0].name));
+    free(results);
+    std::stringstream after;
+    after << std::ifstream("output_1.txt").rdbuf();
+    EXPECT_EQ(legacy, after.str());
+    studentdb_close(&db);
+}
+
+TEST(StudentDb, OpensExistingBtreeStore) {
+    ScopedTempDir guard;
+    studentdb_t db;
+    ASSERT_EQ(0, studentdb_open(&db));
+    ASSERT_EQ(0, studentdb_use_btree(&db));
+    student_t s = make_student({.grade = 10, .subject_grade = 90.0f});
+    ASSERT_EQ(1, studentdb_create(&db, &s));
+    studentdb_close(&db);
+
+    // The file's presence selects the B+tree on the next open
+    ASSERT_EQ(0, studentdb_open(&db));
+    EXPECT_EQ(&store_btree_ops, db.store.ops);
+    student_t back;
+    ASSERT_EQ(0, studentdb_get(&db, 1, &back));
+    EXPECT_FLOAT_EQ(90.0f, back.average_grade);
+    EXPECT_EQ(-1, studentdb_use_lsm(&db, nullptr));
+    studentdb_close(&db);
+}
+
+TEST(StudentDb, ShardedWritesGoThroughTheSelectedStore) {
+    ScopedTempDir guard;
+    studentdb_t db;
+    ASSERT_EQ(0, studentdb_open(&db));
+    ASSERT_EQ(0, studentdb_use_btree(&db));
+    ASSERT_EQ(0, studentdb_use_shards(&db, 2));
+
+    student_t s = make_student({.grade = 10, .subject_grade = 90.0f});
+    int id = studentdb_create(&db, &s);
+    ASSERT_GT(id, 0);
+    std::vector<student_t> batch(2, make_student({.grade = 11, .subject_grade = 70.0f}));
+    int first_id = studentdb_create_many(&db, batch.data(), 2);
+    ASSERT_GT(first_id, 0);
+    EXPECT_NE(id, first_id);
+    EXPECT_NE(id, first_id + 1);
+
+    // Records written outside the engine are found on their shard
+    student_t back;
+    ASSERT_EQ(0, studentdb_get(&db, first_id + 1, &back));
+    EXPECT_EQ(11, back.grade);
+    ASSERT_EQ(0, studentdb_update(&db, first_id + 1, FIELD_NAME, "Dorothy"));
+    ASSERT_EQ(0, studentdb_update(&db, id, FIELD_SUBJECT1_GRADE, "50"));
+    studentdb_close(&db);
+
+    EXPECT_FALSE(std::ifstream("data/shard_0_changes.log").good());
+    std::ifstream log("data/changes.log");
+    std::vector<int> logged;
+    for (int logged_id; log >> logged_id;) {
+        logged.push_back(logged_id);
+    }
+    EXPECT_NE(logged.end(), std::find(logged.begin(), logged.end(), id));
+    EXPECT_NE(logged.end(), std::find(logged.begin(), logged.end(), first_id + 1));
+
+    ASSERT_EQ(0, studentdb_open(&db));
+    EXPECT_EQ(2, db.shards.shard_count);
+    ASSERT_EQ(0, record_load(first_id + 1, &back));
+    EXPECT_STREQ("Dorothy", str_get(&back.name));
+    ASSERT_EQ(0, record_load(id, &back));
+    EXPECT_FLOAT_EQ(80.0f, back.average_grade);
+    studentdb_close(&db);
+}
+
+TEST(StudentDb, ConvertCopiesTextRecordsIntoTheBtree) {
+    ScopedTempDir guard;
+    studentdb_t db;
+    ASSERT_EQ(0, studentdb_open(&db));
+    student_t s = make_student({.grade = 10, .subject_grade = 90.0f});
+    ASSERT_EQ(1, studentdb_create(&db, &s));
+    s = make_student({.name = "Dorothy", .grade = 11});
+    ASSERT_EQ(2, studentdb_create(&db, &s));
+
+    int copied = 0;
+    ASSERT_EQ(0, studentdb_convert_to_btree(&db, &copied));
+    EXPECT_EQ(2, copied);
+    EXPECT_EQ(&store_btree_ops, db.store.ops);
+    errno = 0;
+    EXPECT_EQ(-1, studentdb_convert_to_lsm(&db, &copied));
+    EXPECT_EQ(EEXIST, errno);
+    errno = 0;
+    EXPECT_EQ(-1, studentdb_compact(&db, nullptr));
+    EXPECT_EQ(ENOTSUP, errno);
+    studentdb_close(&db);
+
+    // The text files are no longer read once the B+tree took over
+    std::remove("output_2.txt");
+    ASSERT_EQ(0, studentdb_open(&db));
+    student_t back;
+    ASSERT_EQ(0, studentdb_get(&db, 2, &back));
+    EXPECT_STREQ("Dorothy", str_get(&back.name));
+    studentdb_close(&db);
+}
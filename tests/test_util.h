@@ -0,0 +1,84 @@
+#ifndef TEST_UTIL_H
+#define TEST_UTIL_H
+
+#include <filesystem>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <cstdio>
+#include <cstdlib>
+#include <unistd.h>
+
+extern "C" {
+#include "student.h"
+}
+
+namespace fs = std::filesystem;
+
+// Simple scoped helper to run tests inside a temp directory so files stay isolated.
+class ScopedTempDir {
+public:
+    ScopedTempDir() : old_path(fs::current_path()) {
+        path = fs::temp_directory_path() / fs::path("cp1gp_test_XXXXXX");
+        std::string tmpl = path.string();
+        std::vector<char> mutable_path(tmpl.begin(), tmpl.end());
+        mutable_path.push_back('\0');
+        char *res = mkdtemp(mutable_path.data());
+        if (!res) {
+            throw std::runtime_error("mkdtemp failed");
+        }
+        path = res;
+        fs::current_path(path);
+        fs::create_directory("data");
+    }
+    ~ScopedTempDir() {
+        fs::current_path(old_path);
+        fs::remove_all(path);
+    }
+private:
+    fs::path old_path;
+    fs::path path;
+};
+
+// What make_student varies; every other field gets a value that passes
+// the validate.h rules
+struct StudentSpec {
+    int id = 0;
+    const char *name = "Katherine";
+    const char *family_name = "Johnson";
+    const char *studentid = nullptr;    // nullptr: "kj" and the ID, e.g. kj00007
+    int grade = 10;
+    float subject_grade = 80.0f;        // all four subjects, so also the average
+};
+
+inline student_t make_student(const StudentSpec &spec = {}) {
+    student_t s = {};
+    s.student_id = spec.id;
+    str_set(&s.name, spec.name);
+    str_set(&s.family_name, spec.family_name);
+    str_set(&s.father_name, "Joshua");
+    str_set(&s.mother_name, "Joylette");
+    if (spec.studentid) {
+        std::snprintf(s.studentid, sizeof(s.studentid), "%s", spec.studentid);
+    } else {
+        std::snprintf(s.studentid, sizeof(s.studentid), "kj%05d", spec.id);
+    }
+    std::snprintf(s.dateofbirth, sizeof(s.dateofbirth), "26/08/2008");
+    std::snprintf(s.phone_number, sizeof(s.phone_number), "5550100");
+    s.grade = spec.grade;
+    const char *names[] = { "Mathematics", "Physics", "Chemistry", "Biology" };
+    subject_t *subjects[] = { &s.subject1, &s.subject2, &s.subject3, &s.subject4 };
+    for (int i = 0; i < 4; i++) {
+        str_set(&subjects[i]->name, names[i]);
+        subjects[i]->grade = spec.subject_grade;
+    }
+    calculate_average(&s);
+    return s;
+}
+
+// Scan callback: appends each student's ID to the std::vector<int> in arg
+inline void collect_ids(const student_t *student, void *arg) {
+    static_cast<std::vector<int> *>(arg)->push_back(student->student_id);
+}
+
+#endif
@@ -0,0 +1,65 @@
+#include <gtest/gtest.h>
+#include <cstring>
+
+extern "C" {
+#include "validate.h"
+}
+
+static bool ok(value_kind_t kind, const char *value) {
+    return validate_value(kind, value, std::strlen(value)) == nullptr;
+}
+
+TEST(Validate, Names) {
+    EXPECT_TRUE(ok(VALUE_NAME, "Rosa"));
+    EXPECT_TRUE(ok(VALUE_NAME, "O'Neil-Smith"));
+    EXPECT_FALSE(ok(VALUE_NAME, ""));
+    EXPECT_FALSE(ok(VALUE_NAME, "R0sa"));
+    EXPECT_TRUE(ok(VALUE_FAMILY_NAME, ""));
+}
+
+TEST(Validate, DateOfBirth) {
+    EXPECT_TRUE(ok(VALUE_DATE_OF_BIRTH, "12/02/2009"));
+    EXPECT_TRUE(ok(VALUE_DATE_OF_BIRTH, "29/02/2008"));
+    EXPECT_FALSE(ok(VALUE_DATE_OF_BIRTH, "31/04/2009"));
+    EXPECT_FALSE(ok(VALUE_DATE_OF_BIRTH, "12/13/2009"));
+    EXPECT_FALSE(ok(VALUE_DATE_OF_BIRTH, "2009-02-12"));
+}
+
+TEST(Validate, NumbersAndDigits) {
+    EXPECT_TRUE(ok(VALUE_PHONE_NUMBER, "93213124"));
+    EXPECT_FALSE(ok(VALUE_PHONE_NUMBER, "932-13124"));
+    EXPECT_TRUE(ok(VALUE_CLASS_GRADE, "11"));
+    EXPECT_FALSE(ok(VALUE_CLASS_GRADE, "13"));
+    EXPECT_FALSE(ok(VALUE_CLASS_GRADE, "11.5"));
+    EXPECT_TRUE(ok(VALUE_SUBJECT_GRADE, "99.5"));
+    EXPECT_FALSE(ok(VALUE_SUBJECT_GRADE, "101"));
+    EXPECT_FALSE(ok(VALUE_SUBJECT_GRADE, "nan"));
+}
+
+TEST(Validate, EditMenuFields) {
+    EXPECT_EQ(nullptr, validate_field(FIELD_SUBJECT3_GRADE, "75"));
+    EXPECT_NE(nullptr, validate_field(FIELD_SUBJECT3_GRADE, "seventy"));
+    EXPECT_NE(nullptr, validate_field(FIELD_MOTHER_NAME, "Li5a"));
+}
+
+TEST(Validate, LongValuesCheckEveryBlock) {
+    // Bad character in the second and in the partial third 16-byte block
+    EXPECT_TRUE(ok(VALUE_NAME, "Abcdefghijklmnopqrstuvwxyz-Abcdefghijk"));
+    EXPECT_FALSE(ok(VALUE_NAME, "Abcdefghijklmnopq1stuvwxyz"));
+    EXPECT_FALSE(ok(VALUE_NAME, "Abcdefghijklmnopqrstuvwxyzabcdefgh!"));
+    EXPECT_FALSE(ok(VALUE_SUBJECT_NAME, "Math@"));
+    EXPECT_FALSE(ok(VALUE_DATE_OF_BIRTH, "12/0a/2009"));
+    EXPECT_FALSE(ok(VALUE_DATE_OF_BIRTH, "12/02-2009"));
+}
+
+TEST(Validate, ColumnSkipsRowsThatAlreadyFailed) {
+    const char *values[] = { "12", "0", "x", "7" };
+    size_t lengths[] = { 2, 1, 1, 1 };
+    const char *errors[] = { nullptr, nullptr, nullptr, "earlier column" };
+
+    EXPECT_EQ(2u, validate_column(VALUE_CLASS_GRADE, values, lengths, 4, errors));
+    EXPECT_EQ(nullptr, errors[0]);
+    EXPECT_NE(nullptr, errors[1]);
+    EXPECT_NE(nullptr, errors[2]);
+    EXPECT_STREQ("earlier column", errors[3]);
+}